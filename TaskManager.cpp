@@ -7,391 +7,1699 @@
 // - Deleting tasks by their unique IDs.
 // The program enhances user experience by offering color-coded output based on task priority and deadline proximity, making it easier to identify critical tasks at a glance.
 
+#ifndef TASK_MANAGER_CPP
+#define TASK_MANAGER_CPP
+
 #include <iostream>
-#include <ctime>     // Used for time-related functions like time, mktime, and difftime to handle deadlines and time calculations
+#include <ctime>     // Used for time-related functions like time and strftime to handle deadlines and time calculations
 #include <string>    // String manipulation functions like getline()
 #include <vector>    // Store a list of tasks managed by the TaskManager class
-#include <sstream>   // Used to parse strings into tokens (loadTaskFromFile()) for extracting task details from lines read from a file
 #include <fstream>   // Used to read from and write to files (loadTaskFromFile() and saveTaskToFile())
 #include <algorithm> // Transformations such as converting strings to lowercase
 #include <cctype>    // Used for the tolower(), applied during string transformations to convert characters to lowercase
-#include <iomanip>   // Used for get_time in convertStringToTime()
-#include <cmath>     // for abs()
+#include <filesystem> // Used to read the size and modification time of the task file (taskFileSignature())
+#include <limits>     // numeric_limits for skipping the rest of an input line
+#include <iomanip>    // setprecision() for the throughput of imports and exports
+#include <chrono>     // Timing imports and exports
+#include <cstdio>     // rename() for replacing a converted task file in one step
+#include <mutex>      // Serializes the changes made by concurrent claims
 #include "processor.cpp"  // Include the Task class implementation file
+#include "metrics.cpp"    // Counters and latency histograms for the hot paths
+#include "trace.cpp"      // Scoped trace spans for per-operation profiling
+#include "search_index.cpp" // Full-text index over task titles and descriptions
+#include "record_format.cpp" // Quoted record format and the vectorized field scanner
+#include "record_checksum.cpp" // CRC32C of every record and the parallel scrubber
+#include "task_schema.cpp"   // Field table that generates the record parser, serializer and comparators
+#include "dependency_graph.cpp" // Dependencies between tasks and the set of tasks ready to start
+#include "task_dispatcher.cpp"  // Priority queue of the tasks ready to be worked on
+#include "task_archive.cpp"     // Compressed archive of old completed tasks
+#include "project_cache.cpp"    // Loaded projects kept in least recently used order
+#include "replication.cpp"      // Shipping changes to read-only followers
+#include "task_writer.cpp"      // Saves the task file on a background thread
+#include "urgency.cpp"          // Classifies tasks by deadline, status and priority
+#include "task_export.cpp"      // JSON Lines and CSV export and import
+#include "task_statistics.cpp"  // Counters of the tasks by category, status, priority and deadline
 
 using namespace std;
 
+// Result of the operations that change tasks without prompting (used by the menu and by programs that embed the TaskManager)
+enum class StoreStatus
+{
+    OK,             // The operation was carried out
+    NOT_FOUND,      // No task has the given ID
+    ALREADY_EXISTS, // The ID is already used by a task or an archived task
+    INVALID,        // The task was refused (for example its dependencies would create a cycle)
+    IO_ERROR        // A file could not be read or written
+};
+
 // TaskManager class definition
 class TaskManager
 {
 private:
-    vector<Task> tasks; // List of tasks managed by the task manager
+    BackgroundWriter writer; // Writes the task files without making the menu wait (declared first so it outlives the projects)
+
+    ProjectCache projects; // Loaded projects, most recently used first
+    Project *project;      // Project the menu operations work on (always the most recently used one in projects)
+
+    ChangeSubscription menuSubscription; // Position of viewChanges() in the change feed
+
+    vector<ViewDefinition> viewDefinitions; // Orders kept as materialized views in every loaded project (the built-in ones first)
+    size_t pageSize = defaultPageSize;      // Tasks shown on each page of a view
+    UrgencyClassifier urgency;              // Deadline buckets used to colour tasks and find the ones due soon
+    bool verifyStatistics = false;          // Recount the statistics after every operation and report any difference (for testing)
+    bool lazyDescriptions = false;          // Leave long descriptions in the task file when projects are loaded (see cold_fields.cpp)
+    bool deferSaves = false;                // Changes are not written until the end of applyBatch()
+
+    mutex claimMutex;           // Serializes the changes claimNext() makes to the tasks, views and change feed
+    bool unsavedClaims = false; // Tasks were claimed since the task file of the current project was last rewritten
+
+    Project *replicatedProject = nullptr;        // Project shipped to followers (nullptr when not replicating)
+    unique_ptr<ReplicationPrimary> replication;  // Declared after projects so it stops before the projects go away
 
 public:
-    TaskManager() {} // Default constructor
+    // Start with the project stored in initialProject (its tasks are read when first needed).
+    // Cached projects are unloaded when together they use more than cacheBudget bytes.
+    explicit TaskManager(const string &initialProject = "project.txt", size_t cacheBudget = ProjectCache::defaultBudget) : projects(cacheBudget)
+    {
+        project = &projects.get(initialProject);
+        viewDefinitions.push_back(ViewDefinition::of<TaskSchema::ByDate>("date"));
+        viewDefinitions.push_back(ViewDefinition::of<TaskSchema::ByPriority>("priority"));
+        viewDefinitions.push_back(ViewDefinition::of<TaskSchema::ByCategory>("category"));
+    }
+
+    // Positions of the built-in views in viewDefinitions
+    static const size_t DATE_VIEW = 0;
+    static const size_t PRIORITY_VIEW = 1;
+    static const size_t CATEGORY_VIEW = 2;
+
+    static const size_t defaultPageSize = 50; // Tasks shown on each page of a view unless setPageSize() is called
+    static const int statisticsDays = 14;     // Days of the deadline histogram shown by viewStatistics()
+    static const size_t coldDescriptionBytes = 64; // Shortest description a lazy load leaves in the task file (shorter ones cost less than a reference)
+
+    // Change the number of tasks shown on each page of a view (0 shows every task on one page)
+    void setPageSize(size_t tasksPerPage)
+    {
+        pageSize = tasksPerPage;
+    }
 
-    // Save a task to a file
-    void saveTaskToFile(string filename, int taskID)
+    // Leave long descriptions in the task file when projects are loaded and read them back only when they are needed, keeping at
+    // most cacheBytes of the descriptions read back in memory. Descriptions typed in after a project was loaded are left in the
+    // file too once they add up to more than cacheBytes. Applies to the projects loaded from now on.
+    void setLazyDescriptions(size_t cacheBytes)
     {
-        ofstream file(filename, ios::app); // Open the file in append mode
+        lazyDescriptions = true;
+        ColdFieldCache::instance().setBudget(cacheBytes);
+    }
 
-        // Check if the file exists
-        if (!file)
+    // Keep the tasks of every project in another order, built with TaskSchema::Order, and return the number of the new view.
+    // The view is then kept up to date like the built-in ones and can be displayed with viewTasksInView().
+    template <typename Order>
+    size_t addView(const string &name)
+    {
+        viewDefinitions.push_back(ViewDefinition::of<Order>(name));
+        for (Project *cached : projects.projects())
         {
-            // If the file doesn't exist, create it
-            file.open(filename);
+            if (cached->tasksLoaded)
+            {
+                cached->views.push_back(viewDefinitions.back().make());
+                cached->views.back()->rebuild(cached->tasks);
+            }
         }
+        return viewDefinitions.size() - 1;
+    }
 
-        // Check if the file is successfully open for writing
-        if (file.is_open())
+    // Finish writing the task files and save the search indexes before the task manager goes away
+    ~TaskManager()
+    {
+        flushWrites();
+        for (Project *cached : projects.projects())
         {
-            /* find_if is a standard library algorithm used to search for an element in a range (tasks.begin() to tasks.end() in this case) that satisfies a specified condition.
-            The lambda function [taskID](Task &task) { return task.getTaskID() == taskID; } is used as the condition. It captures the taskID variable by value and checks if the ID of the task (task.getTaskID()) matches the provided taskID.
-            If a task with the specified ID is found within the tasks vector, the iterator it will point to that task. Otherwise, it will point to tasks.end(), indicating that the task with the specified ID was not found. */
+            saveSearchIndex(*cached);
+        }
+    }
+
+    // Wait until every change made so far has been written to disk; returns false if a write failed
+    bool flushWrites()
+    {
+        TraceSpan span("flushWrites", "io");
+        saveClaims();
+        return writer.flush();
+    }
+
+    // Compute a value that changes whenever the task file is modified (its size combined with its modification time)
+    uint64_t taskFileSignature(const string &filename)
+    {
+        error_code ec;
+        uint64_t size = filesystem::file_size(filename, ec);
+        if (ec)
+        {
+            return 0; // The file does not exist yet
+        }
+        uint64_t modified = uint64_t(filesystem::last_write_time(filename, ec).time_since_epoch().count());
+        return size * 1000003u ^ modified;
+    }
 
-            // 'auto' avoids explicitly specifying the type of it, letting the compiler infer it from the context (Task &task)
-            auto it = find_if(tasks.begin(), tasks.end(), [taskID](Task &task)
-                              { return task.getTaskID() == taskID; });
+    // Get the search index of the current project, loading it from the index file next to the task file on first use.
+    // If the saved index is missing or was built from a different version of the task file, it is rebuilt from the task file.
+    SearchIndex &getSearchIndex()
+    {
+        if (!project->searchIndexLoaded)
+        {
+            TraceSpan span("loadSearchIndex", "io");
+            project->searchIndexLoaded = true;
+            // The signature must describe the file with every change written; if a change could not be written, the saved index
+            // may match the file but not the tasks, so it is rebuilt
+            bool written = writer.wait(project->taskFile);
+            if (!written || !project->searchIndex.load(project->indexFile(), taskFileSignature(project->taskFile)))
+            {
+                // Rebuild the index from every task in the file (a missing file simply gives an empty index). Descriptions left in
+                // the file are read back one at a time; the index keeps only postings, so none of them stays in memory.
+                ensureTasksLoaded();
+                for (auto &task : project->tasks)
+                {
+                    project->searchIndex.addTask(task.getTaskID(), task.getTitle(), task.loadDescription());
+                }
+            }
+        }
+        return project->searchIndex;
+    }
 
-            // Check if the task with the specified ID was found
-            if (it != tasks.end())
+    // Search the current project, verifying the candidates of the index against the text of the tasks (a description left in the
+    // task file is read back for the check, but not kept)
+    vector<SearchHit> searchCurrentProject(const string &query)
+    {
+        ensureTasksLoaded(); // The index holds no text, so matches are checked against the tasks
+        SearchIndex &index = getSearchIndex();
+        auto titleOf = [this](int taskID, string &title)
+        {
+            const Task *task = findTask(taskID);
+            if (task == nullptr)
             {
-                // Write task details to the file
-                file << taskID << "," << it->getCategory() << "," << it->getTitle() << "," << it->getDescription() << "," << it->getDeadline() << "," << it->getPriority() << ","
-                     << it->getStatus() << "," << it->getLabel();
-                file << endl; // End the line
-                cout << "Task with ID " << taskID << " saved to file." << endl;
+                return false;
             }
-            else
+            title = task->getTitle();
+            return true;
+        };
+        auto descriptionOf = [this](int taskID, string &description)
+        {
+            description = findTask(taskID)->loadDescription();
+        };
+        return index.search(query, titleOf, descriptionOf);
+    }
+
+    // Write the search index of a project next to its task file if it has unsaved changes
+    void saveSearchIndex(Project &saved)
+    {
+        if (saved.searchIndexLoaded && saved.searchIndex.isDirty())
+        {
+            TraceSpan span("saveSearchIndex", "io");
+            // The signature must describe the file with every change written; an index of changes missing from the file is not saved
+            if (writer.wait(saved.taskFile))
             {
-                cout << "Task with ID " << taskID << " not found." << endl;
+                saved.searchIndex.save(saved.indexFile(), taskFileSignature(saved.taskFile));
             }
-            file.close(); // Close the file
         }
-        else
+    }
+
+    // Get the archive of the current project, reading its block headers on first use
+    TaskArchive &getArchive()
+    {
+        if (!project->archiveLoaded)
         {
-            cout << "Unable to open file: " << filename << endl;
+            TraceSpan span("loadArchive", "io");
+            project->archive.open(project->archiveFile());
+            project->archiveLoaded = true;
         }
+        return project->archive;
     }
 
-    // Load tasks from a file
-    void loadTaskFromFile(string filename)
+    // Save a task to a file by appending its record in the background; returns false if the task is not loaded
+    bool saveTaskToFile(const string &filename, int taskID)
     {
-        ifstream file(filename); // Open the file for reading
+        TraceSpan span("saveTaskToFile", "io");
 
-        // Check if the file was successfully opened
-        if (file.is_open())
+        const Task *task = findTask(taskID);
+        if (task == nullptr || deferSaves)
         {
-            string line;
-            // Read each line from the file
-            while (getline(file, line))
-            {
-                // stringstream created to parse each line into individual tokens to extract specific details such as task ID, etc
-                stringstream ss(line); // Create a stringstream to parse the line
+            return task != nullptr; // A batch writes every task once it is applied
+        }
 
-                // Extract task details from the line
-                string idStr;
-                getline(ss, idStr, ','); // Read the task ID string until the comma delimiter
-                int id = stoi(idStr);    // Convert the ID string to an integer
+        // Records can only be appended to a file with checksums. A version 2 file is rewritten with every loaded task (this one
+        // included); a legacy file is converted first, keeping a backup, since its records may have been repaired when read.
+        if (project->loadedFormat == TaskFileFormat::QUOTED)
+        {
+            return saveAllTasks();
+        }
+        if (project->loadedFormat == TaskFileFormat::LEGACY && migrateTaskFile(filename))
+        {
+            project->loadedFormat = TaskFileFormat::CHECKSUMMED;
+        }
 
-                Task task;          // Create a new Task object to store the extracted details
-                task.setTaskID(id); // Set the task ID
+        // Queue the task details for the file, starting a new file with the format header
+        string record;
+        if (project->loadedFormat != TaskFileFormat::CHECKSUMMED)
+        {
+            record = RecordFormat::header() + "\n";
+        }
+        appendTaskRecord(record, *task);
+        writer.append(filename, record);
+        project->loadedFormat = TaskFileFormat::CHECKSUMMED;
+        return true;
+    }
 
-                getline(ss, task.category, ',');    // Read the category string until the comma delimiter and store it in the task object
-                getline(ss, task.title, ',');       // Read the title string until the comma delimiter and store it in the task object
-                getline(ss, task.description, ','); // Read the description string until the comma delimiter and store it in the task object
-                getline(ss, task.deadline, ',');    // Read the deadline string until the comma delimiter and store it in the task object
+    // Append the record of a task to out, followed by its checksum
+    static void appendTaskRecord(string &out, const Task &task)
+    {
+        size_t start = out.size();
+        TaskSchema::appendRecord(out, task);
+        RecordChecksum::seal(out, start);
+    }
 
-                string priorityStr;
-                getline(ss, priorityStr, ','); // Extract the priority string from the stringstream
+    // Write a list of tasks to a file in the current format, replacing its contents.
+    // The tasks go to a temporary file that is synced and renamed over the file, as the background writer does, so a crash never
+    // leaves it torn. Returns the number of bytes written, or -1 if the file could not be written.
+    long long writeTaskFile(const string &filename, vector<Task> &taskList)
+    {
+        // Build the whole file in memory so that it is written with a single call
+        unsavedClaims = false; // Every claim is in the file being written
+        string contents = RecordFormat::header() + "\n";
+        for (auto &task : taskList)
+        {
+            appendTaskRecord(contents, task);
+        }
 
-                // Convert priority string to TaskPriority enum and set it
-                transform(priorityStr.begin(), priorityStr.end(), priorityStr.begin(), ::tolower);
-                if (priorityStr == "low")
-                {
-                    task.setPriority("Low");
-                }
-                else if (priorityStr == "medium")
+        if (!DurableFile::replace(filename, contents))
+        {
+            return -1;
+        }
+        return (long long)contents.size();
+    }
+
+    // Convert a task file in the legacy format or version 2 of the quoted format to the current format.
+    // A copy of the original file is kept with the extension ".bak".
+    bool migrateTaskFile(const string &filename)
+    {
+        TraceSpan span("migrateTaskFile", "io");
+
+        // Convert the file as it is after every queued change; a file missing some of them is left alone
+        if (!writer.wait(filename))
+        {
+            cerr << "Changes to " << filename << " could not be written, so it was not converted." << endl;
+            return false;
+        }
+
+        string contents;
+        if (!RecordFormat::readFile(filename, contents))
+        {
+            cerr << "Unable to open file: " << filename << endl;
+            return false;
+        }
+        TaskFileFormat format = RecordFormat::detect(contents.data(), contents.size());
+        if (format != TaskFileFormat::LEGACY && format != TaskFileFormat::QUOTED)
+        {
+            return true; // Nothing to convert
+        }
+
+        // Keep the original file in case the conversion needs to be checked
+        ofstream backup(filename + ".bak", ios::binary | ios::trunc);
+        backup.write(contents.data(), contents.size());
+        backup.close();
+
+        vector<Task> legacyTasks;
+        size_t damagedRanges = 0; // Invalid records are copied aside and left out of the converted file
+        readTaskFile(filename, legacyTasks, nullptr, &damagedRanges);
+        if (writeTaskFile(filename, legacyTasks) < 0)
+        {
+            cerr << "Unable to open file for writing: " << filename << endl;
+            return false;
+        }
+        cout << "Converted " << legacyTasks.size() << " task(s) in " << filename << " to the checksummed record format";
+        if (damagedRanges > 0)
+        {
+            cout << ", leaving out " << damagedRanges << " invalid record(s)";
+        }
+        cout << "." << endl;
+        return true;
+    }
+
+    // Read all tasks from a file in any format and append them to a list.
+    // If extents is given, the start and end offset of the record of every task read is appended to it.
+    // In a file with checksums, records whose checksum does not match are skipped up to the next intact record. Records of any format
+    // that cannot be parsed into a valid task are skipped too. Each skipped range is reported on the error stream and copied to the
+    // file with the extension ".damaged", and the number of ranges is added to damagedRanges if it is given.
+    // Returns false if the file cannot be opened.
+    bool readTaskFile(const string &filename, vector<Task> &taskList, vector<pair<uint64_t, uint64_t>> *extents = nullptr,
+                      size_t *damagedRanges = nullptr)
+    {
+        ScopedTimer timer(MetricTimer::FILE_LOAD); // Time the whole load
+        TraceSpan span("loadTaskFromFile", "io");
+        Metrics &metrics = Metrics::instance();
+
+        // Read the whole file into memory first, so that reading and parsing are measured separately
+        TraceSpan readSpan("read", "io");
+        string contents;
+        if (!RecordFormat::readFile(filename, contents))
+        {
+            return false;
+        }
+        metrics.add(MetricCounter::FILE_LOAD_BYTES, contents.size());
+        readSpan.end();
+
+        TraceSpan parseSpan("parse");
+        TaskFileFormat format = RecordFormat::detect(contents.data(), contents.size());
+        bool checksummed = format == TaskFileFormat::CHECKSUMMED;
+        FieldScanner scanner(contents.data(), contents.size(), format == TaskFileFormat::LEGACY);
+        size_t base = 0; // Offset in the file of the buffer the scanner reads (it starts again after damage)
+        vector<string> fields;
+
+        // Read each record from the file contents
+        while (scanner.nextRecord(fields))
+        {
+            size_t start = base + scanner.recordOffset();
+            size_t end = base + scanner.offset();
+            if (checksummed)
+            {
+                // Skip a damaged record, and anything after it that is not an intact record, and scan again from there
+                if (!RecordChecksum::verify(contents.data() + start, contents.data() + end))
                 {
-                    task.setPriority("Medium");
+                    base = RecordChecksum::nextIntactRecord(contents.data(), start + 1, contents.size());
+                    reportDamage(filename, contents, start, base);
+                    if (damagedRanges != nullptr)
+                    {
+                        (*damagedRanges)++;
+                    }
+                    scanner = FieldScanner(contents.data() + base, contents.size() - base, false);
+                    continue;
                 }
-                else if (priorityStr == "high")
+                fields.pop_back(); // The checksum is not a field of the task
+            }
+            metrics.add(MetricCounter::FILE_LOAD_RECORDS);
+            if (format == TaskFileFormat::LEGACY)
+            {
+                RecordFormat::repairLegacyFields(fields); // Put back commas that were split out of descriptions
+            }
+
+            // Extract task details from the record using the field table
+            Task task;
+            if (!TaskSchema::parseRecord(fields, task) || task.getTaskID() <= 0 || task.getTaskID() > IdAllocator::maxTaskID)
+            {
+                // A record that is intact but holds an invalid task (bad date or value, ID out of range) is skipped like
+                // a damaged one, so a single bad record does not keep the rest of the project from loading
+                metrics.add(MetricCounter::FILE_PARSE_FAILURES);
+                reportDamage(filename, contents, start, end);
+                if (damagedRanges != nullptr)
                 {
-                    task.setPriority("High");
+                    (*damagedRanges)++;
                 }
+                continue;
+            }
+
+            taskList.push_back(task); // Add the task to the vector
+            if (extents != nullptr)
+            {
+                extents->emplace_back(start, end);
+            }
+        }
+        return true;
+    }
+
+    // Report the damaged bytes [start, end) of a task file, keeping a copy of them in the file with the extension ".damaged"
+    void reportDamage(const string &filename, const string &contents, size_t start, size_t end)
+    {
+        Metrics::instance().add(MetricCounter::DAMAGED_RECORDS);
+        cerr << "Skipped " << (end - start) << " damaged byte(s) at byte " << start << " of " << filename << " (copied to "
+             << filename << ".damaged)." << endl;
+        ofstream damaged(filename + ".damaged", ios::binary | ios::app);
+        damaged << "#DAMAGED " << start << "-" << end << "\n";
+        damaged.write(contents.data() + start, end - start);
+        damaged << "\n";
+    }
+
+    // Switch to the project stored in a file and read its tasks again, replacing the tasks held in memory
+    void loadTaskFromFile(string filename)
+    {
+        openProject(filename);
+        project->tasksLoaded = false;
+        if (!ensureTasksLoaded())
+        {
+            cout << "Unable to open file." << endl;
+        }
+    }
+
+    // Make the project stored in a file the current one. Switching to a project that is still cached reuses everything
+    // already loaded for it; other projects are loaded from disk, and the projects used longest ago are unloaded if the cache
+    // grows past its memory budget.
+    void openProject(const string &filename)
+    {
+        TraceSpan span("openProject");
+        saveClaims(); // Claims belong to the project being left
+        project = &projects.get(filename);
+        ensureTasksLoaded();
+        projects.enforceBudget([this](Project &evicted)
+                               { saveSearchIndex(evicted); });
+    }
+
+    // File of the current project
+    const string &currentProject() const
+    {
+        return project->taskFile;
+    }
+
+    // Display the cached projects, most recently used first, with the memory they use
+    void listProjects()
+    {
+        cout << "Loaded projects (memory budget " << projects.getBudget() / 1024 << " KB):" << endl;
+        for (Project *cached : projects.projects())
+        {
+            cout << (cached == project ? "* " : "  ") << cached->taskFile << " - " << cached->tasks.size() << " task(s), about "
+                 << (cached->memoryUsage() + 1023) / 1024 << " KB" << endl;
+        }
+        if (lazyDescriptions)
+        {
+            ColdFieldCache &cache = ColdFieldCache::instance();
+            cout << "Descriptions read back from task files: about " << (cache.memoryUsage() + 1023) / 1024 << " KB cached (budget "
+                 << cache.getBudget() / 1024 << " KB)" << endl;
+        }
+    }
+
+    // Publish a change of the current project on its change feed, and give the replication thread a new snapshot if it asked for one
+    void publishChange(ChangeType type, int taskID, const Task &task = Task())
+    {
+        project->changeFeed.publish(type, taskID, task);
+        serviceReplication();
+    }
+
+    // Give the replication thread a new snapshot of the replicated project if it fell behind the change feed
+    void serviceReplication()
+    {
+        if (replication && replication->snapshotRequested() && replicatedProject->tasksLoaded)
+        {
+            replication->provideSnapshot(replicatedProject->tasks, replicatedProject->changeFeed.resyncPosition());
+        }
+    }
+
+    // Start shipping the changes of the current project to follower processes connecting to a Unix socket.
+    // The project stays loaded while it is replicated. Returns false if the socket could not be created.
+    bool startReplication(const string &socketPath)
+    {
+        ensureTasksLoaded();
+        auto primary = make_unique<ReplicationPrimary>();
+        if (!primary->start(socketPath, project->changeFeed, project->tasks, project->changeFeed.resyncPosition()))
+        {
+            return false;
+        }
+        replication = move(primary);
+        replicatedProject = project;
+        replicatedProject->pinned = true;
+        return true;
+    }
+
+    // Display the state of replication on the primary, with the checksum followers should report once they have caught up
+    void viewReplicationStatus()
+    {
+        if (!replication)
+        {
+            cout << "Replication is not running. Start the program with --replicate <socket> to enable it." << endl;
+            return;
+        }
+        serviceReplication();
+        uint64_t sequence = replicatedProject->changeFeed.currentSequence();
+        cout << "Replicating " << replicatedProject->taskFile << " to " << replication->followerCount() << " follower(s)." << endl;
+        cout << "Changes committed: " << sequence - 1 << ", shipped: " << (replication->shippedSequence() > 0 ? replication->shippedSequence() - 1 : 0) << endl;
+        cout << "Tasks: " << replicatedProject->tasks.size() << ", checksum: " << hex
+             << ReplicaStore::checksum(ReplicaStore::serialize(replicatedProject->tasks)) << dec << endl;
+    }
+
+    // Get the change feed of the current project
+    ChangeFeed &getChangeFeed()
+    {
+        return project->changeFeed;
+    }
+
+    // Bring a subscriber of the current project up to date.
+    // Normally only the changes since the subscriber's last call are returned in delta. If the subscriber is new, fell too far
+    // behind or follows another project, RESYNC is returned instead with every task in snapshot, and the subscription restarts from there.
+    FeedStatus readChanges(ChangeSubscription &subscription, vector<ChangeEvent> &delta, vector<Task> &snapshot)
+    {
+        TraceSpan span("readChanges");
+        ensureTasksLoaded();
+        snapshot.clear();
+        if (project->changeFeed.read(subscription, delta) == FeedStatus::DELTAS)
+        {
+            return FeedStatus::DELTAS;
+        }
+        Metrics::instance().add(MetricCounter::CHANGE_FEED_RESYNCS);
+        snapshot = project->tasks;
+        subscription = project->changeFeed.resyncPosition();
+        return FeedStatus::RESYNC;
+    }
+
+    // Display what changed in the current project since this was last called (every task the first time)
+    void viewChanges()
+    {
+        vector<ChangeEvent> delta;
+        vector<Task> snapshot;
+        if (readChanges(menuSubscription, delta, snapshot) == FeedStatus::RESYNC)
+        {
+            cout << "Showing all " << snapshot.size() << " task(s); later calls only show what changed." << endl
+                 << endl;
+            for (auto &task : snapshot)
+            {
+                printTaskWithColour(task);
+                cout << endl;
+            }
+            return;
+        }
 
-                string statusStr;
-                getline(ss, statusStr, ','); // Extract status string
+        if (delta.empty())
+        {
+            cout << "No changes since the last time." << endl;
+            return;
+        }
+        for (auto &event : delta)
+        {
+            if (event.type == ChangeType::DELETED)
+            {
+                cout << "#" << event.sequence << " Deleted task " << event.taskID << endl
+                     << endl;
+                continue;
+            }
+            cout << "#" << event.sequence << (event.type == ChangeType::CREATED ? " Created:" : " Updated:") << endl;
+            printTaskWithColour(event.task);
+            cout << endl;
+        }
+    }
 
-                // Convert status string to TaskStatus enum and set it
-                transform(statusStr.begin(), statusStr.end(), statusStr.begin(), ::tolower);
-                if (statusStr == "pending")
+    // Load the tasks of the current project the first time they are needed; later calls reuse the tasks already in memory.
+    // Every change made through the TaskManager updates both the tasks in memory and the file.
+    // Returns false if the file could not be opened, or if changes queued for it could not be written (the task list is then empty).
+    bool ensureTasksLoaded()
+    {
+        if (project->tasksLoaded)
+        {
+            return true;
+        }
+
+        // Read the file as it is after every queued change; a file missing some of them is not read
+        const string &filename = project->taskFile;
+        if (!writer.wait(filename))
+        {
+            cerr << "Changes to " << filename << " could not be written, so it was not loaded again." << endl;
+            return false;
+        }
+        project->tasks.clear();
+        error_code ec;
+        uint64_t fileSize = filesystem::file_size(filename, ec);
+        vector<pair<uint64_t, uint64_t>> extents;
+        size_t damagedRanges = 0;
+        bool opened = readTaskFile(filename, project->tasks, lazyDescriptions ? &extents : nullptr, &damagedRanges);
+        project->loadedFormat = RecordFormat::detectFile(filename);
+        project->tasksLoaded = true;
+
+        // Records of legacy files cannot be read back on their own, so their descriptions stay in memory
+        if (lazyDescriptions && !ec && project->loadedFormat != TaskFileFormat::LEGACY)
+        {
+            leaveDescriptionsInFile(extents, fileSize);
+        }
+
+        // Write the file again without its damaged records (they were copied aside), so that records appended later start on a
+        // line of their own rather than after a torn one
+        if (damagedRanges > 0)
+        {
+            saveAllTasks();
+        }
+        project->changeFeed.invalidate(); // Subscribers cannot tell what changed in the file, so they read the whole list again
+        if (replication && project == replicatedProject)
+        {
+            replication->provideSnapshot(project->tasks, project->changeFeed.resyncPosition());
+        }
+        project->reindex();
+
+        // Never hand out an ID that a loaded or archived task already uses, even if the high-water mark file is missing
+        int largestID = getArchive().maxTaskID();
+        for (const Task &task : project->tasks)
+        {
+            largestID = max(largestID, task.getTaskID());
+        }
+        project->idAllocator.open(project->idFile(), largestID + 1);
+
+        // Build the materialized views from the loaded tasks
+        project->views.clear();
+        for (const ViewDefinition &definition : viewDefinitions)
+        {
+            project->views.push_back(definition.make());
+            project->views.back()->rebuild(project->tasks);
+        }
+
+        // Count the loaded tasks for the statistics; the sync tree is built again when it is next needed
+        project->statistics.rebuild(project->tasks);
+        project->syncTree.clear();
+
+        // Rebuild the dependency graph and the dispatcher from the loaded tasks
+        project->dependencyGraph.clear();
+        project->dispatcher.clear();
+        for (auto &task : project->tasks)
+        {
+            project->dependencyGraph.addTask(task.getTaskID(), task.getDependencies(), task.isCompleted());
+        }
+        for (auto &task : project->tasks)
+        {
+            updateDispatcher(task.getTaskID());
+        }
+        return opened;
+    }
+
+    // Find a loaded task by its ID (nullptr if there is none)
+    Task *findTask(int taskID)
+    {
+        auto it = project->positions.find(taskID);
+        return it == project->positions.end() ? nullptr : &project->tasks[it->second];
+    }
+
+    // Move a task to its new place in every view, to its new counters in the statistics and to its new digest in the sync tree,
+    // after its fields changed
+    void updateViews(const Task &task)
+    {
+        for (auto &view : project->views)
+        {
+            view->update(task);
+        }
+        project->statistics.update(task);
+        project->syncTree.update(task);
+    }
+
+    // Take a task out of every view, out of the statistics and out of the sync tree
+    void removeFromViews(int taskID)
+    {
+        for (auto &view : project->views)
+        {
+            view->remove(taskID);
+        }
+        project->statistics.remove(taskID);
+        project->syncTree.remove(taskID);
+    }
+
+    // Queue a task in the dispatcher if it is pending and ready, and take it out otherwise
+    void updateDispatcher(int taskID)
+    {
+        Task *task = findTask(taskID);
+        if (task != nullptr && project->dependencyGraph.isReady(taskID) && task->getStatusValue() == TaskStatus::PENDING)
+        {
+            project->dispatcher.push(DispatchKey::of(*task));
+        }
+        else
+        {
+            project->dispatcher.remove(taskID);
+        }
+    }
+
+    // Update a task and the tasks waiting on it in the dispatcher
+    void updateDispatcherAround(int taskID)
+    {
+        updateDispatcher(taskID);
+        for (int dependent : project->dependencyGraph.dependentsOf(taskID))
+        {
+            updateDispatcher(dependent);
+        }
+    }
+
+    // Queue a rewrite of the file the tasks were loaded from with every loaded task.
+    // Returns as soon as the new contents are queued; the background writer reports any failure and flushWrites() waits for it.
+    // With lazy descriptions, once the descriptions held in memory add up to more than the cache budget, the rewrite is waited for
+    // and every long description is left in the new file; false is returned, and the descriptions stay in memory, if it failed.
+    bool saveAllTasks()
+    {
+        if (deferSaves)
+        {
+            return true; // A batch writes every task once it is applied
+        }
+        TraceSpan rewriteSpan("rewrite", "io");
+
+        // Build the whole file in memory so that it is written with a single call
+        unsavedClaims = false; // Every claim is in the file being written
+        string contents = RecordFormat::header() + "\n";
+        vector<pair<uint64_t, uint64_t>> extents;
+        size_t residentBytes = 0; // Bytes of long descriptions held in memory
+        for (auto &task : project->tasks)
+        {
+            size_t start = contents.size();
+            appendTaskRecord(contents, task);
+            if (lazyDescriptions)
+            {
+                extents.emplace_back(start, contents.size());
+                residentBytes += task.description.size() >= coldDescriptionBytes ? task.description.capacity() : 0;
+            }
+        }
+        uint64_t fileSize = contents.size();
+        writer.replace(project->taskFile, move(contents));
+        project->loadedFormat = TaskFileFormat::CHECKSUMMED;
+
+        if (lazyDescriptions && residentBytes > ColdFieldCache::instance().getBudget())
+        {
+            TraceSpan demoteSpan("leaveDescriptionsInFile", "io");
+            // The records must be in the file before they can be referenced; if the rewrite failed, nothing is referenced
+            if (!writer.wait(project->taskFile))
+            {
+                return false;
+            }
+            leaveDescriptionsInFile(extents, fileSize);
+        }
+        return true;
+    }
+
+    // Leave the long descriptions of the tasks of the current project in its task file, which holds fileSize bytes with the record
+    // of every task at the given extents (start and end offsets, in the order of the tasks). Descriptions left in an earlier version
+    // of the file are pointed at this one too, so the earlier version is closed once nothing else refers to it.
+    // Nothing changes if the file does not have the expected size (for example because it could not be written).
+    void leaveDescriptionsInFile(const vector<pair<uint64_t, uint64_t>> &extents, uint64_t fileSize)
+    {
+        shared_ptr<const ColdFieldFile> file = ColdFieldFile::open(project->taskFile, TaskSchema::descriptionColumn);
+        if (file == nullptr || file->size() != fileSize || extents.size() != project->tasks.size())
+        {
+            return;
+        }
+        for (size_t i = 0; i < extents.size(); i++)
+        {
+            Task &task = project->tasks[i];
+            uint64_t length = extents[i].second - extents[i].first;
+            if ((task.isDescriptionCold() || task.description.size() >= coldDescriptionBytes) && length <= ColdFieldRef::maxLength)
+            {
+                task.setColdDescription(ColdFieldRef(file, extents[i].first, uint32_t(length)));
+            }
+        }
+    }
+
+    // Add a task to the current project. A task with ID 0 gets the next ID from the allocator, which is written back into task.
+    // Nothing is printed; on failure error explains why and the project is unchanged.
+    StoreStatus addTask(Task &task, string &error)
+    {
+        TraceSpan span("addTask");
+
+        // Make sure the tasks and the search index are loaded before the task file changes
+        ensureTasksLoaded();
+        getSearchIndex();
+
+        // A task without an ID gets the next one from the allocator, which is never in use
+        if (task.getTaskID() == 0)
+        {
+            int assigned = project->idAllocator.allocate();
+            if (assigned == 0)
+            {
+                error = "Unable to assign a task ID! The task was not created.";
+                return StoreStatus::IO_ERROR;
+            }
+            task.taskID = assigned;
+        }
+
+        else if (task.getTaskID() < 0 || task.getTaskID() > IdAllocator::maxTaskID)
+        {
+            error = "Task IDs must be between 1 and " + to_string(IdAllocator::maxTaskID) + ".";
+            return StoreStatus::INVALID;
+        }
+
+        // Check the loaded tasks for the same ID (the file may still have writes queued, so it is not read here)
+        else
+        {
+            ScopedTimer timer(MetricTimer::DUPLICATE_CHECK); // Time the duplicate-ID scan
+            TraceSpan checkSpan("duplicateCheck");
+            Metrics::instance().add(MetricCounter::DUPLICATE_CHECKS);
+
+            // Skip tasks with the same ID as the one being added
+            if (findTask(task.getTaskID()) != nullptr)
+            {
+                Metrics::instance().add(MetricCounter::DUPLICATE_REJECTIONS);
+                error = "Task with the same ID already exists! Please choose a different ID.";
+                return StoreStatus::ALREADY_EXISTS;
+            }
+
+            // Archived tasks keep their IDs, so the archive is checked too (only blocks whose ID range contains the ID are read)
+            if (getArchive().contains(task.getTaskID()))
+            {
+                Metrics::instance().add(MetricCounter::DUPLICATE_REJECTIONS);
+                error = "An archived task already uses this ID! Please choose a different ID.";
+                return StoreStatus::ALREADY_EXISTS;
+            }
+        }
+
+        // Refuse dependencies that would make tasks wait on each other forever
+        const vector<int> &dependencies = task.getDependencies();
+        if (find(dependencies.begin(), dependencies.end(), task.getTaskID()) != dependencies.end() ||
+            project->dependencyGraph.wouldCreateCycle(task.getTaskID(), dependencies))
+        {
+            error = "The dependencies of this task would create a cycle! The task was not created.";
+            return StoreStatus::INVALID;
+        }
+
+        // A user-chosen ID is never handed out by the allocator afterwards
+        project->idAllocator.observe(task.getTaskID());
+
+        // Add the task to the task manager, the search index and the dependency graph
+        project->tasks.push_back(task);
+        project->positions[task.getTaskID()] = project->tasks.size() - 1;
+        updateViews(task);
+        project->searchIndex.addTask(task.getTaskID(), task.getTitle(), task.loadDescription());
+        project->dependencyGraph.addTask(task.getTaskID(), task.getDependencies(), task.isCompleted());
+        updateDispatcherAround(task.getTaskID());
+        publishChange(ChangeType::CREATED, task.getTaskID(), task);
+
+        // Save the task to txt file
+        saveTaskToFile(project->taskFile, task.getTaskID());
+        return StoreStatus::OK;
+    }
+
+    // The task with an ID in the current project (nullptr if there is none). The pointer is valid until the tasks next change.
+    const Task *getTask(int taskID)
+    {
+        ensureTasksLoaded();
+        return findTask(taskID);
+    }
+
+    // Replace a task of the current project with a changed copy of it (found by its ID), updating everything built from it.
+    // Nothing is printed; on failure error explains why and the project is unchanged.
+    StoreStatus updateTask(const Task &changed, string &error)
+    {
+        TraceSpan span("updateTask");
+
+        // Make sure the tasks and the search index are loaded before the task file changes
+        ensureTasksLoaded();
+        getSearchIndex();
+
+        int taskID = changed.getTaskID();
+        Task *task = findTask(taskID);
+        if (task == nullptr)
+        {
+            error = "Task with ID " + to_string(taskID) + " not found.";
+            return StoreStatus::NOT_FOUND;
+        }
+
+        // Dependencies that would make tasks wait on each other forever are refused
+        const vector<int> &dependencies = changed.getDependencies();
+        bool dependenciesChanged = dependencies != task->getDependencies();
+        if (dependenciesChanged && (find(dependencies.begin(), dependencies.end(), taskID) != dependencies.end() ||
+                                    project->dependencyGraph.wouldCreateCycle(taskID, dependencies)))
+        {
+            error = "These dependencies would create a cycle.";
+            return StoreStatus::INVALID;
+        }
+        // The index is given the text the task was indexed with, before the task is replaced
+        if (changed.getTitle() != task->getTitle() || !changed.hasSameDescription(*task))
+        {
+            project->searchIndex.updateTask(taskID, task->getTitle(), task->loadDescription(), changed.getTitle(),
+                                            changed.loadDescription());
+        }
+
+        *task = changed;
+        if (dependenciesChanged)
+        {
+            project->dependencyGraph.setDependencies(taskID, dependencies);
+        }
+
+        // Completing (or re-opening) the task only updates the tasks that depend on it
+        project->dependencyGraph.setCompleted(taskID, task->isCompleted());
+        updateDispatcherAround(taskID); // Moves the task in the dispatcher if its priority changed
+        updateViews(*task);
+        publishChange(ChangeType::UPDATED, taskID, *task);
+
+        // Write all tasks back to the task file of the current project
+        ScopedTimer rewriteTimer(MetricTimer::EDIT_REWRITE);
+        saveAllTasks();
+        return StoreStatus::OK;
+    }
+
+    // Remove a task from the current project by its ID.
+    // Nothing is printed; on failure error explains why and the project is unchanged.
+    StoreStatus removeTask(int taskID, string &error)
+    {
+        ScopedTimer timer(MetricTimer::DELETE_REWRITE); // Time the read and rewrite of the file
+        TraceSpan span("removeTask");
+
+        // Load the tasks of the file the first time they are needed, and make sure the search index is loaded before the file changes
+        if (!ensureTasksLoaded())
+        {
+            error = "Unable to open file: " + project->taskFile;
+            return StoreStatus::IO_ERROR;
+        }
+        getSearchIndex();
+
+        // Remove the task with the given ID, keeping the others in their original order
+        auto it = project->positions.find(taskID);
+        if (it == project->positions.end())
+        {
+            error = "Task with ID " + to_string(taskID) + " not found.";
+            return StoreStatus::NOT_FOUND;
+        }
+        size_t position = it->second;
+
+        // Remove the task from the search index, which needs the text it was indexed with
+        const Task &removed = project->tasks[position];
+        project->searchIndex.removeTask(taskID, removed.getTitle(), removed.loadDescription());
+
+        project->tasks.erase(project->tasks.begin() + position);
+        project->positions.erase(it);
+        project->reindex(position); // The tasks after the deleted one moved down by one
+        removeFromViews(taskID);
+
+        // Write remaining tasks to the file
+        saveAllTasks();
+
+        // Tasks that depended on the deleted task no longer wait for it
+        vector<int> dependents = project->dependencyGraph.dependentsOf(taskID);
+        project->dependencyGraph.removeTask(taskID);
+        project->dispatcher.remove(taskID);
+        for (int dependent : dependents)
+        {
+            updateDispatcher(dependent);
+        }
+
+        publishChange(ChangeType::DELETED, taskID);
+        return StoreStatus::OK;
+    }
+
+    // Apply a batch of changes to the current project: tasks to create or to replace (by ID), and IDs of tasks to delete.
+    // The task file is rewritten once at the end rather than after every change. A change refused because its dependencies would
+    // create a cycle is tried again after the rest of the batch, which may have removed the cycle. Nothing is printed; returns the
+    // number of changes applied, and appends the reason for every change still refused to errors.
+    size_t applyBatch(const vector<Task> &upserts, const vector<int> &deletes, vector<string> &errors)
+    {
+        TraceSpan span("applyBatch");
+        ensureTasksLoaded();
+        size_t applied = 0;
+        string error;
+        deferSaves = true;
+        try
+        {
+            for (int taskID : deletes)
+            {
+                if (removeTask(taskID, error) == StoreStatus::OK)
                 {
-                    task.setStatus("Pending");
+                    applied++;
                 }
-                else if (statusStr == "in progress")
+                else
                 {
-                    task.setStatus("In Progress");
+                    errors.push_back("Task " + to_string(taskID) + ": " + error);
                 }
-                else if (statusStr == "completed")
+            }
+
+            // Try every remaining change until a pass applies none of them
+            vector<const Task *> pending;
+            for (const Task &task : upserts)
+            {
+                pending.push_back(&task);
+            }
+            vector<string> reasons;
+            while (!pending.empty())
+            {
+                vector<const Task *> refused;
+                reasons.clear();
+                for (const Task *task : pending)
                 {
-                    task.setStatus("Completed");
+                    Task copy = *task;
+                    StoreStatus status = findTask(copy.getTaskID()) != nullptr ? updateTask(copy, error) : addTask(copy, error);
+                    if (status == StoreStatus::OK)
+                    {
+                        applied++;
+                        continue;
+                    }
+                    refused.push_back(task);
+                    reasons.push_back("Task " + to_string(copy.getTaskID()) + ": " + error);
                 }
-
-                getline(ss, task.label, ','); // Read the label until the comma delimiter and store it in the task object
-
-                tasks.push_back(task); // Add the task to the vector
+                if (refused.size() == pending.size())
+                {
+                    break;
+                }
+                pending.swap(refused);
             }
-            file.close(); // Close the file
+            errors.insert(errors.end(), reasons.begin(), reasons.end());
         }
-        else
+        catch (...)
         {
-            cout << "Unable to open file." << endl;
+            deferSaves = false;
+            saveAllTasks(); // Keep the file in step with the changes applied before the failure
+            throw;
         }
+        deferSaves = false;
+        if (applied > 0)
+        {
+            saveAllTasks();
+        }
+        return applied;
     }
 
-    // Create a new task and add it to the task list
+    // IDs of the tasks of the current project matching a search query, best match first
+    vector<int> searchTaskIDs(const string &query)
+    {
+        ensureTasksLoaded();
+        vector<int> ids;
+        for (const SearchHit &hit : searchCurrentProject(query))
+        {
+            if (findTask(hit.taskID) != nullptr)
+            {
+                ids.push_back(hit.taskID);
+            }
+        }
+        return ids;
+    }
+
+    // Create a new task from the details entered by the user and add it to the task list
     void createTask()
     {
+        TraceSpan span("createTask");
+
         Task newTask;
         cin >> newTask; // Utilize the operator>> to input task details
 
-        // Load existing tasks from the file
-        ifstream infile("project.txt");
-        if (infile.is_open())
+        bool assignID = newTask.getTaskID() == 0;
+        string error;
+        if (addTask(newTask, error) != StoreStatus::OK)
+        {
+            cout << error << endl;
+            return;
+        }
+        if (assignID)
+        {
+            cout << "Assigned Task ID: " << newTask.getTaskID() << endl;
+        }
+        warnAboutMissingDependencies(newTask.getDependencies());
+        cout << "Task created successfully!" << endl;
+        cout << "Task with ID " << newTask.getTaskID() << " saved to file." << endl;
+    }
+
+    static const size_t importBatchSize = 1024; // Imported tasks inserted, and appended to the task file, at a time
+
+    // Add the tasks of a JSON Lines or CSV file to the current project. The file is read in a streaming fashion and the valid
+    // records are inserted in batches, each batch appended to the task file with one write. Records with ID 0 get an ID from the
+    // allocator; records whose ID is already used are skipped. Returns false if the file could not be read or the task file written.
+    bool importTasks(const string &filename, ExportFormat format)
+    {
+        TraceSpan span("importTasks", "io");
+        TaskImporter importer(format);
+        if (!importer.open(filename))
         {
-            string line;
-            while (getline(infile, line))
+            cerr << "Unable to open file: " << filename << endl;
+            return false;
+        }
+
+        // Make sure the tasks and the search index are loaded before the task file changes (the throughput does not count the loading)
+        ensureTasksLoaded();
+        getSearchIndex();
+        auto start = chrono::steady_clock::now();
+
+        vector<Task> batch;
+        batch.reserve(importBatchSize);
+        size_t imported = 0;
+        Task task;
+        project->searchIndex.beginBatch(); // The posting lists are put in order once, after the last record
+        while (importer.next(task))
+        {
+            batch.push_back(move(task));
+            if (batch.size() == importBatchSize)
             {
-                stringstream ss(line);
-                string idStr;
+                imported += insertImportedBatch(batch, importer);
+            }
+        }
+        imported += insertImportedBatch(batch, importer);
+        project->searchIndex.endBatch();
+        bool written = flushWrites();
+
+        Metrics::instance().add(MetricCounter::IMPORT_REJECTIONS, importer.rejectedCount());
+        cout << "Imported " << imported << " of " << importer.recordCount() << " record(s) from " << filename << ", skipped "
+             << importer.rejectedCount() << "." << endl;
+        reportThroughput(cout, importer.recordCount(), start);
+        return written;
+    }
+
+    // Write the tasks of the current project to a JSON Lines or CSV file ("-" for the standard output) in the order of a view.
+    // Only one record is formatted at a time, so the memory used does not depend on the number of tasks.
+    bool exportView(const string &filename, ExportFormat format, size_t view)
+    {
+        TraceSpan span("exportView", "io");
+        ensureTasksLoaded();
+        auto start = chrono::steady_clock::now();
+        if (view >= project->views.size())
+        {
+            throw invalid_argument("There is no view number " + to_string(view) + ".");
+        }
+
+        TaskExporter exporter(format);
+        if (!exporter.open(filename))
+        {
+            cerr << "Unable to write file: " << filename << endl;
+            return false;
+        }
+        project->views[view]->forEach([this, &exporter](int taskID)
+                                      { exporter.write(*findTask(taskID)); });
+        return finishExport(exporter, filename, start);
+    }
 
-                getline(ss, idStr, ',');
-                int id = stoi(idStr);
+    // Write the tasks of the current project that match a search query to a JSON Lines or CSV file, best match first
+    bool exportSearch(const string &filename, ExportFormat format, const string &query)
+    {
+        TraceSpan span("exportSearch", "io");
+        ensureTasksLoaded();
+        getSearchIndex();
+        auto start = chrono::steady_clock::now();
+        vector<SearchHit> hits = searchCurrentProject(query);
+
+        TaskExporter exporter(format);
+        if (!exporter.open(filename))
+        {
+            cerr << "Unable to write file: " << filename << endl;
+            return false;
+        }
+        for (const SearchHit &hit : hits)
+        {
+            const Task *task = findTask(hit.taskID);
+            if (task != nullptr)
+            {
+                exporter.write(*task);
+            }
+        }
+        return finishExport(exporter, filename, start);
+    }
 
-                // Skip tasks with the same ID as the one being added
-                if (id == newTask.getTaskID())
+    // Number of the view with a given name (SIZE_MAX if there is none)
+    size_t findView(const string &name) const
+    {
+        for (size_t i = 0; i < viewDefinitions.size(); i++)
+        {
+            if (viewDefinitions[i].name == name)
+            {
+                return i;
+            }
+        }
+        return SIZE_MAX;
+    }
+
+    // Add a batch of validated imported tasks like createTask() would, and append them to the task file with one write.
+    // Returns the number of tasks added; the batch is emptied.
+    size_t insertImportedBatch(vector<Task> &batch, TaskImporter &importer)
+    {
+        // Records can only be appended to a file with checksums: a legacy file is converted first, and a version 2 file is
+        // rewritten with every loaded task once the batch is added (see saveTaskToFile())
+        if (project->loadedFormat == TaskFileFormat::LEGACY && migrateTaskFile(project->taskFile))
+        {
+            project->loadedFormat = TaskFileFormat::CHECKSUMMED;
+        }
+        string records;
+        if (project->loadedFormat != TaskFileFormat::CHECKSUMMED)
+        {
+            records = RecordFormat::header() + "\n";
+        }
+
+        // Tasks without an ID take theirs from one block reserved for the whole batch, so the high-water mark is saved once
+        int unnumbered = int(count_if(batch.begin(), batch.end(), [](const Task &task)
+                                      { return task.getTaskID() == 0; }));
+        IdBlock block = unnumbered > 0 ? project->idAllocator.reserveBlock(unnumbered) : IdBlock{0, 0};
+
+        size_t inserted = 0;
+        for (Task &task : batch)
+        {
+            if (task.getTaskID() == 0)
+            {
+                // An imported ID may fall in the block (it was observed after the block was reserved), so it is skipped
+                while (block.first < block.end && findTask(block.first) != nullptr)
                 {
-                    cout << "Task with the same ID already exists! Please choose a different ID." << endl;
-                    infile.close();
-                    return;
+                    block.first++;
                 }
+                task.taskID = block.first < block.end ? block.first++ : project->idAllocator.allocate();
+                if (task.taskID == 0)
+                {
+                    importer.reject(task, "no task ID could be assigned");
+                    continue;
+                }
+            }
+            else if (task.getTaskID() < 0 || task.getTaskID() > IdAllocator::maxTaskID)
+            {
+                importer.reject(task, "the ID is out of range");
+                continue;
+            }
+            else if (findTask(task.getTaskID()) != nullptr || getArchive().contains(task.getTaskID()))
+            {
+                importer.reject(task, "the ID is already used");
+                continue;
+            }
+            if (project->dependencyGraph.wouldCreateCycle(task.getTaskID(), task.getDependencies()))
+            {
+                importer.reject(task, "its dependencies would create a cycle");
+                continue;
+            }
+
+            project->idAllocator.observe(task.getTaskID());
+            project->tasks.push_back(task);
+            project->positions[task.getTaskID()] = project->tasks.size() - 1;
+            updateViews(task);
+            project->searchIndex.addTask(task.getTaskID(), task.getTitle(), task.getDescription()); // Imported descriptions are in memory
+            project->dependencyGraph.addTask(task.getTaskID(), task.getDependencies(), task.isCompleted());
+            updateDispatcherAround(task.getTaskID());
+            publishChange(ChangeType::CREATED, task.getTaskID(), task);
+            appendTaskRecord(records, task);
+            inserted++;
+        }
+
+        if (inserted > 0 && project->loadedFormat == TaskFileFormat::QUOTED)
+        {
+            saveAllTasks();
+        }
+        else if (inserted > 0)
+        {
+            writer.append(project->taskFile, records);
+            project->loadedFormat = TaskFileFormat::CHECKSUMMED;
+        }
+        Metrics::instance().add(MetricCounter::TASKS_IMPORTED, inserted);
+        batch.clear();
+        return inserted;
+    }
+
+    // Close an export and report it (on the error stream when the tasks went to the standard output)
+    bool finishExport(TaskExporter &exporter, const string &filename, chrono::steady_clock::time_point start)
+    {
+        bool written = exporter.close();
+        if (!written)
+        {
+            cerr << "Unable to write file: " << filename << endl;
+        }
+        Metrics::instance().add(MetricCounter::TASKS_EXPORTED, exporter.recordCount());
+        ostream &report = filename == "-" ? cerr : cout;
+        report << "Exported " << exporter.recordCount() << " task(s) (" << exporter.bytesWritten() << " bytes) to " << filename << "." << endl;
+        reportThroughput(report, exporter.recordCount(), start);
+        return written;
+    }
+
+    // Print how many records per second were processed since start
+    static void reportThroughput(ostream &out, size_t records, chrono::steady_clock::time_point start)
+    {
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        out << fixed << setprecision(3) << seconds << " s, " << setprecision(0) << (seconds > 0 ? records / seconds : 0.0)
+            << " records/s" << endl;
+        out << defaultfloat << setprecision(6);
+    }
+
+    // Search the titles and descriptions of all tasks and display the matches, best first
+    void searchTasks(const string &query)
+    {
+        TraceSpan span("searchTasks");
+
+        // Look up the matching task IDs in the index
+        ScopedTimer searchTimer(MetricTimer::SEARCH);
+        TraceSpan searchSpan("search");
+        vector<SearchHit> hits = searchCurrentProject(query);
+        searchTimer.stop();
+        searchSpan.end();
+
+        if (hits.empty())
+        {
+            cout << "No tasks match \"" << query << "\"." << endl;
+            return;
+        }
+
+        const size_t maxShown = 20; // Only display the best matches
+        size_t shown = 0;
+        for (const SearchHit &hit : hits)
+        {
+            if (shown == maxShown)
+            {
+                break;
+            }
+
+            Task *task = findTask(hit.taskID);
+            if (task != nullptr)
+            {
+                printTaskWithColour(*task);
+                cout << endl;
+                shown++;
+            }
+        }
+        cout << "Showing " << shown << " of " << hits.size() << " matching task(s)." << endl;
+    }
+
+    // Print task details with colored output based on their urgency class:
+    // completed tasks are green, and tasks that are overdue, due today or of high priority are red
+    void printTaskWithColour(const Task &task, UrgencyClass urgencyClass)
+    {
+        ScopedTimer timer(MetricTimer::RENDER); // Time the rendering of this task
+        TraceSpan span("printTaskWithColour", "render");
+        Metrics::instance().add(MetricCounter::TASKS_RENDERED);
+
+        if (urgencyClass.completed())
+        {
+            cout << "\033[1;32m"; // ANSI escape code for green colour
+        }
+        else if (urgencyClass.needsAttention() || urgencyClass.priority() == TaskPriority::HIGH)
+        {
+            cout << "\033[1;31m"; // ANSI escape code for red colour
+        }
+
+        task.getTaskDetails(); // Call this once after setting the colour
+        cout << "\033[0m";     // Reset colour after printing details
+    }
+
+    // Print a single task with its colour (lists of tasks are classified together, see viewTasksInView())
+    void printTaskWithColour(const Task &task)
+    {
+        urgency.snapshot();
+        printTaskWithColour(task, urgency.classify(task));
+    }
+
+    // Change how far ahead "due today" and "due this week" reach
+    void setUrgencyHorizons(UrgencyHorizons horizons)
+    {
+        urgency.setHorizons(horizons);
+    }
+
+    // Display the reminders of the current project: how many unfinished tasks are in each deadline bucket, followed by the
+    // unfinished tasks that are overdue or due this week, earliest deadline first
+    void viewDueTasks()
+    {
+        TraceSpan span("viewDueTasks");
+        ensureTasksLoaded();
+
+        // Classify every task against the same date in one pass
+        urgency.snapshot();
+        vector<UrgencyClass> classes;
+        urgency.classify(project->tasks, classes);
+
+        size_t counts[5] = {};
+        for (UrgencyClass urgencyClass : classes)
+        {
+            if (!urgencyClass.completed())
+            {
+                counts[int(urgencyClass.urgency())]++;
+            }
+        }
+        const UrgencyHorizons &horizons = urgency.getHorizons();
+        cout << "Unfinished tasks: " << counts[int(Urgency::OVERDUE)] << " overdue, " << counts[int(Urgency::DUE_TODAY)] << " due "
+             << (horizons.todayDays == 0 ? string("today") : "within " + to_string(horizons.todayDays) + " day(s)") << ", "
+             << counts[int(Urgency::DUE_THIS_WEEK)] << " due within " << horizons.weekDays << " days, " << counts[int(Urgency::LATER)]
+             << " later, " << counts[int(Urgency::NO_DEADLINE)] << " without a valid deadline." << endl
+             << endl;
+
+        project->views[DATE_VIEW]->forEach([this, &classes](int taskID)
+                                           {
+            size_t position = project->positions[taskID];
+            UrgencyClass urgencyClass = classes[position];
+            if (!urgencyClass.completed() && urgencyClass.urgency() <= Urgency::DUE_THIS_WEEK)
+            {
+                printTaskWithColour(project->tasks[position], urgencyClass);
+                cout << endl;
+            } });
+    }
+
+    // One occurrence of a task on a day: the deadline of a task that does not repeat, or one of the days a repeating task occurs on
+    struct Occurrence
+    {
+        int day;          // Day number of the occurrence
+        const Task *task; // The task (the template of a repeating task)
+        bool completed;   // Whether this occurrence was completed
+    };
+
+    // Collect the occurrences of the tasks of the current project between two day numbers (inclusive), earliest first and then by
+    // priority. Repeating tasks are expanded from their rules for these days only; their other occurrences are never generated.
+    void collectOccurrences(int fromDay, int toDay, vector<Occurrence> &occurrences)
+    {
+        ensureTasksLoaded();
+        occurrences.clear();
+        for (const Task &task : project->tasks)
+        {
+            int startDay;
+            if (!DeadlineCodec::dayNumber(task.getDeadline(), startDay))
+            {
+                continue;
+            }
+            if (task.isRecurring())
+            {
+                const RecurrenceRule &rule = task.getRecurrence();
+                rule.expand(startDay, fromDay, toDay, [&occurrences, &task, &rule](int day)
+                            {
+                    occurrences.push_back({day, &task, task.isCompleted() || rule.isCompleted(day)});
+                    return true; });
+            }
+            else if (startDay >= fromDay && startDay <= toDay)
+            {
+                occurrences.push_back({startDay, &task, task.isCompleted()});
             }
-            infile.close();
         }
-
-        // Add the task to the task manager
-        tasks.push_back(newTask);
-
-        cout << "Task created successfully!" << endl;
-
-        // Save the task to txt file
-        saveTaskToFile("project.txt", newTask.getTaskID());
+        stable_sort(occurrences.begin(), occurrences.end(), [](const Occurrence &a, const Occurrence &b)
+                    { return a.day != b.day ? a.day < b.day : a.task->getPriorityValue() > b.task->getPriorityValue(); });
     }
 
-    // Convert string representation of date to time_t object
-    time_t convertStringToTime(string &dateString)
+    // Display the agenda of the current project: every occurrence from today up to a number of days ahead, one line each.
+    // Completed occurrences are green; occurrences due within the "today" horizon and tasks of high priority are red.
+    void viewAgenda(int days)
     {
-        // Create a stringstream to parse the dateString
-        istringstream ss(dateString);
-
-        // Initialize a tm struct to store the parsed date
-        struct tm tm = {};
-
-        // Parse the dateString using get_time() to fill the tm struct with date components
-        ss >> get_time(&tm, "%d/%m/%Y");
-
-        // Check if parsing failed
-        if (ss.fail())
+        TraceSpan span("viewAgenda");
+        urgency.snapshot();
+        int today = urgency.snapshotDay();
+        int todayEnd = today + urgency.getHorizons().todayDays;
+
+        vector<Occurrence> occurrences;
+        collectOccurrences(today, today + min(max(days, 0), UrgencyClassifier::maxHorizonDays), occurrences);
+        if (occurrences.empty())
         {
-            // Handle parsing error by returning -1
-            return -1;
+            cout << "Nothing is due in the next " << days << " day(s)." << endl;
+            return;
         }
-        else
+        for (const Occurrence &occurrence : occurrences)
         {
-            // Convert the parsed tm struct into a time_t object and return it
-            return mktime(&tm);
+            const Task &task = *occurrence.task;
+            if (occurrence.completed)
+            {
+                cout << "\033[1;32m"; // ANSI escape code for green colour
+            }
+            else if (occurrence.day <= todayEnd || task.getPriorityValue() == TaskPriority::HIGH)
+            {
+                cout << "\033[1;31m"; // ANSI escape code for red colour
+            }
+            cout << DeadlineCodec::fromDayNumber(occurrence.day) << (occurrence.completed ? "  [done]  " : "  [ ]     ") << "Task "
+                 << task.getTaskID() << ": " << task.getTitle() << " (" << task.getCategory() << ", " << task.getPriority() << ")"
+                 << (task.isRecurring() ? " - repeats " + task.getRecurrence().describe() : "") << "\033[0m" << endl;
         }
+        cout << occurrences.size() << " occurrence(s) in the next " << days << " day(s)." << endl;
     }
 
-    // Check if the deadline is near (within a defined threshold)
-    bool isDeadlineNear(string deadline)
+    // Mark the occurrence of a repeating task on a date as completed, or as not completed if it already was.
+    // Only the date is recorded in the rule of the task; the other occurrences stay as they are.
+    void toggleOccurrence(Task task, const string &date)
     {
-        // Convert the deadline string to a time_t object using convertStringToTime() function
-        time_t deadlineTime = convertStringToTime(deadline);
-
-        // Check if conversion failed (-1 indicates an error)
-        if (deadlineTime == -1)
+        int startDay;
+        int day;
+        if (!DeadlineCodec::dayNumber(date, day))
         {
-            // Handle parsing error by returning false
-            return false;
+            throw invalid_argument("Invalid date! Please enter in DD/MM/YYYY format.");
+        }
+        if (!DeadlineCodec::dayNumber(task.getDeadline(), startDay) || !task.getRecurrence().occursOn(startDay, day))
+        {
+            throw invalid_argument("Task " + to_string(task.getTaskID()) + " does not occur on " + date + ".");
         }
 
-        // Get the current time in seconds since the epoch (00:00:00 UTC on January 1, 1970)
-        time_t currentTime = time(nullptr);
-
-        // Calculate the time difference in seconds between the deadline and the current time
-        double diffInSeconds = difftime(deadlineTime, currentTime);
-
-        // Define the threshold for considering a deadline as near (e.g., 24 hours)
-        double threshold = 24 * 3600; // 24 hours threshold, you can adjust this as needed
-
-        // Check if the absolute value of the time difference is less than or equal to the threshold
-        return abs(diffInSeconds) <= threshold;
+        bool completed = !task.getRecurrence().isCompleted(day);
+        task.setOccurrenceCompleted(day, completed);
+        string error;
+        if (updateTask(task, error) != StoreStatus::OK)
+        {
+            throw invalid_argument(error);
+        }
+        cout << "The occurrence on " << date << " is now " << (completed ? "completed." : "pending again.") << endl;
     }
 
-    // Print task details with colored output based on status and priority
-    void printTaskWithColour(Task &task)
+    // The statistics of the current project, kept up to date with every change
+    const TaskStatistics &getStatistics()
     {
-        // Convert status and priority strings to lowercase for case insensitivity
-        string status = task.getStatus();
-        transform(status.begin(), status.end(), status.begin(), ::tolower);
+        ensureTasksLoaded();
+        return project->statistics;
+    }
 
-        string priority = task.getPriority();
-        transform(priority.begin(), priority.end(), priority.begin(), ::tolower);
+    // Recount the statistics after every operation when checkStatistics() is called (for testing the incremental updates)
+    void setVerifyStatistics(bool verify)
+    {
+        verifyStatistics = verify;
+    }
 
-        if (isDeadlineNear(task.getDeadline()) && status == "completed")
-        {
-            // Print task details with green colour for nearing deadline and completed status
-            cout << "\033[1;32m"; // ANSI escape code for green colour
-        }
-        else if (isDeadlineNear(task.getDeadline()))
-        {
-            // Print task details with red colour for nearing deadline
-            cout << "\033[1;31m"; // ANSI escape code for red colour
-        }
-        else if (status == "completed" && priority == "high")
+    // Compare the statistics and the sync tree of the current project with a full recount if verification is enabled; returns false
+    // if they differ. The sync tree is built by the first check, so that the checks after it test its incremental updates.
+    bool checkStatistics()
+    {
+        if (!verifyStatistics || !project->tasksLoaded)
         {
-            // Print task details with green colour for high priority and completed status
-            cout << "\033[1;32m"; // ANSI escape code for green colour
+            return true;
         }
-        else if (status == "completed")
+        string difference;
+        if (!project->statistics.verify(project->tasks, difference))
         {
-            // Print task details with green colour if the task is completed
-            cout << "\033[1;32m"; // ANSI escape code for green colour
+            Metrics::instance().add(MetricCounter::STATISTICS_MISMATCHES);
+            cerr << "The statistics of " << project->taskFile << " do not match a full recount: " << difference << endl;
+            return false;
         }
-        else if (priority == "high")
+        if (!getSyncTree().verify(project->tasks, difference))
         {
-            // Print task details with red colour for high priority but not completed status
-            cout << "\033[1;31m"; // ANSI escape code for red colour
+            Metrics::instance().add(MetricCounter::STATISTICS_MISMATCHES);
+            cerr << "The sync tree of " << project->taskFile << " does not match a rebuilt one: " << difference << endl;
+            return false;
         }
-        else
+        return true;
+    }
+
+    // The sync tree of the current project, built from its tasks the first time it is needed and kept up to date after that
+    const SyncTree &getSyncTree()
+    {
+        ensureTasksLoaded();
+        if (!project->syncTree.isBuilt())
         {
-            // No colour for other cases
+            TraceSpan span("buildSyncTree");
+            project->syncTree.rebuild(project->tasks);
         }
-
-        task.getTaskDetails(); // Call this once after setting the colour
-        cout << "\033[0m";     // Reset colour after printing details
+        return project->syncTree;
     }
 
-    // View tasks sorted by date
-    void viewTasksByDate()
+    // Display the statistics of the current project: the tasks of every category by status and priority, the unfinished deadlines in
+    // each deadline bucket, and how many deadlines fall on each of the next days. Everything is read from the counters.
+    void viewStatistics()
     {
-        // Clear existing tasks from the vector before loading new tasks
-        tasks.clear();
-
-        // Load tasks from the file "project.txt"
-        loadTaskFromFile("project.txt");
-
-        // Check if there are tasks to display
-        if (tasks.empty())
+        TraceSpan span("viewStatistics");
+        const TaskStatistics &statistics = getStatistics();
+        if (statistics.taskCount() == 0)
         {
             cout << "No tasks present in the file!" << endl;
             return;
         }
 
-        // Sort tasks by deadline using a lambda function as the comparison criterion
-        sort(tasks.begin(), tasks.end(), [](Task &a, Task &b)
-             {
-        // The lambda function compares tasks based on their deadlines
-        // It takes two task objects (a and b) as input parameters and returns a boolean value
-        // The tasks are sorted in ascending order based on their deadlines
-
-        // Return true if the deadline of task a is less than the deadline of task b
-        return a.getDeadline() < b.getDeadline(); });
-
-        // Display sorted tasks with color highlighting based on deadline proximity
-        for (auto &task : tasks)
+        static const TaskStatus statuses[] = {TaskStatus::PENDING, TaskStatus::IN_PROGRESS, TaskStatus::COMPLETED};
+        auto printCounts = [](const string &name, const StatusPriorityCounts &counts)
         {
-            // Call printTaskWithColour() function to print each task with appropriate color
-            printTaskWithColour(task);
-            cout << endl;
+            cout << name << ": " << counts.total() << " task(s)" << endl;
+            for (TaskStatus status : statuses)
+            {
+                cout << "  " << left << setw(13) << Task::taskStatusToString(status) + ":" << right << "High " << counts.get(status, TaskPriority::HIGH)
+                     << ", Medium " << counts.get(status, TaskPriority::MEDIUM) << ", Low " << counts.get(status, TaskPriority::LOW) << endl;
+            }
+        };
+        for (const auto &category : statistics.categoryCounts())
+        {
+            printCounts(category.first, category.second);
+        }
+        printCounts("All categories", statistics.totals());
+        cout << endl;
+
+        // Deadline buckets of the unfinished tasks, from the histogram
+        urgency.snapshot();
+        int today = urgency.snapshotDay();
+        const UrgencyHorizons &horizons = urgency.getHorizons();
+        cout << "Unfinished tasks: " << statistics.deadlinesBetween(INT_MIN, today - 1).unfinished << " overdue, "
+             << statistics.deadlinesBetween(today, today + horizons.todayDays).unfinished << " due "
+             << (horizons.todayDays == 0 ? string("today") : "within " + to_string(horizons.todayDays) + " day(s)") << ", "
+             << statistics.deadlinesBetween(today + horizons.todayDays + 1, today + horizons.weekDays).unfinished << " due within "
+             << horizons.weekDays << " days, " << statistics.deadlinesBetween(today + horizons.weekDays + 1, INT_MAX).unfinished << " later, "
+             << statistics.withoutDeadline().unfinished << " without a valid deadline." << endl
+             << endl;
+
+        cout << "Deadlines in the next " << statisticsDays << " days (unfinished / all):" << endl;
+        for (int day = today; day < today + statisticsDays; day++)
+        {
+            DeadlineCounts counts = statistics.deadlinesOn(day);
+            cout << DeadlineCodec::fromDayNumber(day) << "  " << setw(5) << counts.unfinished << " / " << setw(5) << counts.total() << "  "
+                 << string(min(counts.unfinished, size_t(50)), '#') << endl;
+        }
+        if (verifyStatistics)
+        {
+            cout << endl
+                 << (checkStatistics() ? "The statistics match a full recount." : "The statistics do NOT match a full recount.") << endl;
         }
     }
 
-    // View tasks sorted by priority
-    void viewTasksByPriority()
+    // Read one page of a view of the current project: at most limit tasks, starting after cursor ("" for the first page).
+    // nextCursor is set to the cursor of the following page, or "" if this was the last page. Only the tasks of the page are copied,
+    // so a page costs the same however many tasks the project has. Returns false if the cursor was not returned by this view.
+    bool readViewPage(size_t view, const string &cursor, size_t limit, vector<Task> &page, string &nextCursor)
     {
-        tasks.clear(); // Clear existing tasks before loading
+        ensureTasksLoaded();
+        if (view >= project->views.size())
+        {
+            throw invalid_argument("There is no view number " + to_string(view) + ".");
+        }
+        page.clear();
+        return project->views[view]->page(cursor, limit, [this, &page](int taskID)
+                                          { page.push_back(*findTask(taskID)); }, nextCursor);
+    }
 
-        // Load tasks from file
-        loadTaskFromFile("project.txt");
+    // Display the tasks of the current project in the order of a view, one page at a time.
+    // After each page the user is asked whether to show the next one, so tasks after the last page read are never collected.
+    // The view is already in order, so each page is a short walk of the view with no sorting (orderTimer records how long it takes).
+    void viewTasksInView(size_t view, MetricTimer orderTimer = MetricTimer::VIEW_PAGE_DATE)
+    {
+        // Load the tasks of the current project the first time they are needed
+        ensureTasksLoaded();
 
         // Check if there are tasks to display
-        if (tasks.empty())
+        if (project->tasks.empty())
         {
             cout << "No tasks present in the file!" << endl;
             return;
         }
+        if (view >= project->views.size())
+        {
+            throw invalid_argument("There is no view number " + to_string(view) + ".");
+        }
 
-        // Sort tasks by priority: HIGH > MEDIUM > LOW
-        sort(tasks.begin(), tasks.end(), [](Task &a, Task &b)
-             {
-        // Convert priority strings to lowercase for case insensitivity
-        string priorityA = a.getPriority();
-        string priorityB = b.getPriority();
-
-        transform(priorityA.begin(), priorityA.end(), priorityA.begin(), ::tolower);
-        transform(priorityB.begin(), priorityB.end(), priorityB.begin(), ::tolower);
-
-        // Define priority order
-        int priorityOrderA = 0, priorityOrderB = 0;
-
-        // Assign priority order based on priority string
-        if (priorityA == "high") priorityOrderA = 3;
-        else if (priorityA == "medium") priorityOrderA = 2;
-        else if (priorityA == "low") priorityOrderA = 1;
-
-        if (priorityB == "high") priorityOrderB = 3;
-        else if (priorityB == "medium") priorityOrderB = 2;
-        else if (priorityB == "low") priorityOrderB = 1;
-
-        // Compare priorities based on the defined order
-        return priorityOrderA > priorityOrderB; });
-
-        // Display sorted tasks with colour based on priority
-        for (auto &task : tasks)
+        size_t limit = pageSize == 0 ? project->tasks.size() : pageSize;
+        string cursor;
+        size_t pageNumber = 1;
+        while (true)
         {
-            printTaskWithColour(task);
+            // Collect the tasks of this page in the order of the view
+            ScopedTimer orderTimerScope(orderTimer);
+            TraceSpan orderSpan("order");
+            vector<const Task *> ordered;
+            ordered.reserve(min(limit, project->tasks.size()));
+            string nextCursor;
+            project->views[view]->page(cursor, limit, [this, &ordered](int taskID)
+                                       { ordered.push_back(findTask(taskID)); }, nextCursor);
+            orderTimerScope.stop();
+            orderSpan.end();
+
+            // Display the tasks with colour highlighting based on deadline proximity and priority, classifying the page in one pass
+            urgency.snapshot();
+            vector<UrgencyClass> classes;
+            urgency.classify(ordered, classes);
+            for (size_t i = 0; i < ordered.size(); i++)
+            {
+                printTaskWithColour(*ordered[i], classes[i]);
+                cout << endl;
+            }
+
+            if (nextCursor.empty())
+            {
+                return; // That was the last page
+            }
+            cout << "Page " << pageNumber << " of " << (project->tasks.size() + limit - 1) / limit << ". Show the next page? (y/n): ";
+            string answer;
+            if (!(cin >> answer) || (answer != "y" && answer != "Y"))
+            {
+                return;
+            }
             cout << endl;
+            cursor = nextCursor;
+            pageNumber++;
         }
     }
 
-    // View tasks sorted by category
-    void viewTasksByCategory()
+    // View tasks sorted by date; the field table compares deadlines as dates (year, then month, then day)
+    void viewTasksByDate()
     {
-        tasks.clear(); // Clear existing tasks before loading
-
-        // Load tasks from file
-        loadTaskFromFile("project.txt");
-
-        // Check if there are tasks to display
-        if (tasks.empty())
-        {
-            cout << "No tasks present in the file!" << endl;
-            return;
-        }
+        TraceSpan span("viewTasksByDate");
+        viewTasksInView(DATE_VIEW, MetricTimer::VIEW_PAGE_DATE);
+    }
 
-        // Sort tasks alphabetically by category
-        sort(tasks.begin(), tasks.end(), [](Task &a, Task &b)
-             { return a.getCategory() < b.getCategory(); });
+    // View tasks sorted by priority: HIGH > MEDIUM > LOW
+    void viewTasksByPriority()
+    {
+        TraceSpan span("viewTasksByPriority");
+        viewTasksInView(PRIORITY_VIEW, MetricTimer::VIEW_PAGE_PRIORITY);
+    }
 
-        // Display sorted tasks with colour based on category
-        for (auto &task : tasks)
-        {
-            printTaskWithColour(task);
-            cout << endl;
-        }
+    // View tasks sorted by category
+    void viewTasksByCategory()
+    {
+        TraceSpan span("viewTasksByCategory");
+        viewTasksInView(CATEGORY_VIEW, MetricTimer::VIEW_PAGE_CATEGORY);
     }
 
     // View tasks based on the chosen sorting method
@@ -418,19 +1726,13 @@ public:
     // Function to edit the priority and status of a task by its ID
     void editTaskPriorityAndStatus(int taskID)
     {
-        // Clear the existing tasks and load them from file if the tasks vector is empty
-        if (tasks.empty())
-        {
-            tasks.clear(); // Clear any existing tasks to avoid duplication
-            loadTaskFromFile("project.txt");
-        }
+        TraceSpan span("editTaskPriorityAndStatus");
 
-        // Find the task with the specified taskID
-        auto it = find_if(tasks.begin(), tasks.end(), [taskID](Task &task)
-                          { return task.getTaskID() == taskID; });
+        // Find the task with the specified taskID (its tasks are loaded from file the first time they are needed)
+        const Task *found = getTask(taskID);
 
         // If the task is not found, throw an exception or handle the error
-        if (it == tasks.end())
+        if (found == nullptr)
         {
             // Print an error message to standard error (cerr; alternative of cout for error messages only)
             cerr << "Task with ID " << taskID << " not found." << endl;
@@ -441,8 +1743,23 @@ public:
 
         try
         {
-            // Obtain a reference to the task found with the provided task ID
-            Task &updatedTask = *it; // Reference the task to edit it directly
+            // Edit a copy of the task found with the provided task ID; updateTask() puts it in place
+            Task updatedTask = *found;
+
+            // The occurrences of a repeating task are completed one at a time
+            if (updatedTask.isRecurring())
+            {
+                cout << "This task repeats " << updatedTask.getRecurrence().describe() << "." << endl;
+                cout << "Enter the date of an occurrence to mark it completed (or pending again), or leave empty to edit the whole task: ";
+                string date;
+                cin.ignore(numeric_limits<streamsize>::max(), '\n');
+                getline(cin, date);
+                if (!date.empty())
+                {
+                    toggleOccurrence(updatedTask, date);
+                    return;
+                }
+            }
 
             // Prompt the user to enter the new Priority
             cout << "Enter the new Priority (Low, Medium, High): ";
@@ -480,28 +1797,16 @@ public:
                 throw invalid_argument("Invalid status. Status must be 'Pending', 'In Progress', or 'Completed'.");
             }
 
-            cout << "Task edited successfully." << endl;
-
-            // Write all tasks back to the file "project.txt"
-            ofstream file("project.txt");
-
-            // Check if the file is successfully opened
-            if (file.is_open())
+            bool wasCompleted = found->getStatusValue() == TaskStatus::COMPLETED;
+            string error;
+            if (updateTask(updatedTask, error) != StoreStatus::OK)
             {
-                // Iterate over each task in the tasks vector
-                for (auto &task : tasks)
-                {
-                    // Write task details to the file
-                    file << task.getTaskID() << "," << task.getCategory() << "," << task.getTitle() << "," << task.getDescription() << ","
-                         << task.getDeadline() << "," << task.getPriority() << "," << task.getStatus() << "," << task.getLabel() << endl;
-                }
-                // Close the file after writing all tasks
-                file.close();
+                throw invalid_argument(error);
             }
-            else
+            cout << "Task edited successfully." << endl;
+            if (!wasCompleted && updatedTask.getStatusValue() == TaskStatus::COMPLETED)
             {
-                // Output an error message if the file cannot be opened
-                cerr << "Unable to open file for writing." << endl;
+                reportUnblockedTasks(taskID);
             }
         }
         // Catch any exceptions that might occur during task editing
@@ -516,121 +1821,320 @@ public:
     }
 
     // Function to delete a task by its ID
-    void deleteTask(const string &filename, int taskID)
+    void deleteTask(int taskID)
+    {
+        TraceSpan span("deleteTask");
+        string error;
+        StoreStatus status = removeTask(taskID, error);
+        if (status == StoreStatus::OK)
+        {
+            cout << "Task with ID " << taskID << " has been deleted." << endl;
+        }
+        else if (status == StoreStatus::NOT_FOUND)
+        {
+            cout << error << endl;
+        }
+        else
+        {
+            cerr << error << endl;
+        }
+    }
+
+    // Print a warning for every dependency that does not refer to an existing task
+    void warnAboutMissingDependencies(const vector<int> &dependencies)
     {
-        // Vector to store loaded tasks from the file
-        vector<Task> loadedTasks;
+        for (int dependency : dependencies)
+        {
+            if (findTask(dependency) == nullptr)
+            {
+                cout << "Warning: task " << dependency << " does not exist yet, so it will not block this task until it is created." << endl;
+            }
+        }
+    }
 
-        // Input file stream to read tasks from the file
-        ifstream file(filename);
+    // Print the tasks that became ready because the given task was just completed.
+    // Only the tasks that depend on it are looked at, so this costs O(number of dependents) whatever the size of the project.
+    void reportUnblockedTasks(int taskID)
+    {
+        for (int dependent : project->dependencyGraph.dependentsOf(taskID))
+        {
+            const Task *task = findTask(dependent);
+            if (task != nullptr && project->dependencyGraph.isReady(dependent))
+            {
+                cout << "Task " << dependent << " (" << task->getTitle() << ") is now ready to start." << endl;
+            }
+        }
+    }
 
-        // Flag to track if the task with the given ID is found
-        bool taskFound = false;
+    // Display the tasks that are not completed and are not waiting on any unfinished task
+    void viewReadyTasks()
+    {
+        TraceSpan span("viewReadyTasks");
+        ensureTasksLoaded();
 
-        // Check if the file is open
-        if (!file.is_open())
+        vector<int> ready = project->dependencyGraph.readyTasks();
+        if (ready.empty())
         {
-            cerr << "Unable to open file: " << filename << endl;
+            cout << "No tasks are ready to start." << endl;
             return;
         }
 
-        string line;
-        // Read each line of the file
-        while (getline(file, line))
+        for (int taskID : ready)
         {
-            // Create a stringstream to parse the line containing task details
-            stringstream ss(line);
+            printTaskWithColour(*findTask(taskID));
+            cout << endl;
+        }
+        cout << ready.size() << " task(s) ready to start." << endl;
+    }
 
-            // String to store the task ID as a string
-            string idStr;
+    // Display the longest chain of unfinished tasks that depend on each other
+    void viewCriticalPath()
+    {
+        TraceSpan span("viewCriticalPath");
+        ensureTasksLoaded();
 
-            // Extract the task ID from the stringstream delimited by ','
-            getline(ss, idStr, ',');
+        vector<int> path = project->dependencyGraph.criticalPath();
+        if (path.empty())
+        {
+            if (!project->dependencyGraph.findCycle().empty())
+            {
+                cout << "The dependencies contain a cycle, so there is no critical path. Use the cycle check to find it." << endl;
+            }
+            else
+            {
+                cout << "There are no unfinished tasks." << endl;
+            }
+            return;
+        }
 
-            // Convert the extracted ID string to an integer
-            int id = stoi(idStr);
+        cout << "Critical path (" << path.size() << " task(s), in the order they must be done):" << endl;
+        for (size_t i = 0; i < path.size(); i++)
+        {
+            Task *task = findTask(path[i]);
+            cout << "  " << i + 1 << ". Task " << path[i] << ": " << task->getTitle() << " (due " << task->getDeadline() << ")" << endl;
+        }
+    }
 
-            // If the task ID matches the ID to be deleted, skip it
-            if (id != taskID)
-            {
-                Task task;
-                task.setTaskID(id);
+    // Check the dependencies for a cycle and display it if there is one
+    void checkDependencyCycles()
+    {
+        TraceSpan span("checkDependencyCycles");
+        ensureTasksLoaded();
 
-                // Read and set other task details
-                getline(ss, task.category, ',');
-                getline(ss, task.title, ',');
-                getline(ss, task.description, ',');
-                getline(ss, task.deadline, ',');
+        vector<int> cycle = project->dependencyGraph.findCycle();
+        if (cycle.empty())
+        {
+            cout << "No dependency cycles found." << endl;
+            return;
+        }
 
-                // Read and set priority
-                string priorityStr;
-                getline(ss, priorityStr, ',');
-                if (priorityStr == "LOW")
-                {
-                    task.setPriority("LOW");
-                }
-                else if (priorityStr == "MEDIUM")
-                {
-                    task.setPriority("MEDIUM");
-                }
-                else if (priorityStr == "HIGH")
-                {
-                    task.setPriority("HIGH");
-                }
+        cout << "Dependency cycle found: ";
+        for (int taskID : cycle)
+        {
+            cout << taskID << " -> ";
+        }
+        cout << cycle.front() << endl;
+    }
 
-                // Read and set status
-                string statusStr;
-                getline(ss, statusStr, ',');
-                if (statusStr == "PENDING")
-                {
-                    task.setStatus("PENDING");
-                }
-                else if (statusStr == "IN_PROGRESS")
-                {
-                    task.setStatus("IN_PROGRESS");
-                }
-                else if (statusStr == "COMPLETED")
-                {
-                    task.setStatus("COMPLETED");
-                }
+    // Function to replace the dependencies of a task by its ID
+    void editTaskDependencies(int taskID)
+    {
+        TraceSpan span("editTaskDependencies");
+        ensureTasksLoaded();
 
-                // Read and set label
-                getline(ss, task.label, ',');
+        Task *task = findTask(taskID);
+        if (task == nullptr)
+        {
+            cerr << "Task with ID " << taskID << " not found." << endl;
+            return;
+        }
 
-                // Add the task to the vector of loaded tasks
-                loadedTasks.push_back(task);
-            }
-            else
+        try
+        {
+            // Prompt the user for the new list of dependencies
+            cout << "Enter the IDs of the tasks this task depends on (comma separated, leave empty for none): ";
+            string dependenciesStr;
+            cin.ignore(numeric_limits<streamsize>::max(), '\n'); // Skip the rest of the line holding the task ID
+            getline(cin, dependenciesStr);
+            vector<int> dependencies = Task::parseIdList(dependenciesStr);
+
+            // Dependencies that would make tasks wait on each other forever are refused by updateTask()
+            Task updatedTask = *task;
+            updatedTask.setDependencies(dependencies);
+            string error;
+            if (updateTask(updatedTask, error) != StoreStatus::OK)
             {
-                // Mark task as found
-                taskFound = true;
+                throw invalid_argument(error);
             }
+            warnAboutMissingDependencies(dependencies);
+            cout << "Dependencies updated. Task " << taskID << (project->dependencyGraph.isReady(taskID) ? " is ready to start." : " is waiting on other tasks.") << endl;
+        }
+        catch (exception &ex)
+        {
+            cerr << "Error: " << ex.what() << endl;
+        }
+    }
+
+    // Take the best task that is ready to be worked on (highest priority, then earliest deadline) and mark it as in progress
+    void claimNextTask()
+    {
+        TraceSpan span("claimNextTask");
+        ensureTasksLoaded();
+
+        Task claimed;
+        if (!claimNext(claimed))
+        {
+            cout << "No pending tasks are ready to be worked on." << endl;
+            return;
+        }
+
+        cout << "Next task to work on (now marked as In Progress):" << endl;
+        printTaskWithColour(claimed);
+        cout << endl
+             << project->dispatcher.size() << " other task(s) ready to be worked on." << endl;
+
+        saveAllTasks();
+    }
+
+    // Take the next task of the current project that is ready to be worked on off the dispatcher and mark it In Progress, copying
+    // it to claimed; returns false if no task is ready. Nothing is printed.
+    // Several threads may claim at the same time, as long as nothing else uses the task manager meanwhile: the dispatcher hands
+    // every task to one caller, and the lock is only held while the claimed task, the views and the change feed are updated.
+    // The task file is not rewritten for each claim; saveClaims() (which flushWrites() calls) or any other change writes them.
+    bool claimNext(Task &claimed)
+    {
+        TraceSpan span("claimNext");
+        {
+            lock_guard<mutex> lock(claimMutex);
+            ensureTasksLoaded();
         }
-        file.close();
 
-        // If task is found, rewrite the file without the deleted task
-        if (taskFound)
+        int taskID;
+        if (!project->dispatcher.claim(taskID))
         {
-            ofstream outfile(filename);
-            if (!outfile.is_open())
+            return false;
+        }
+
+        // The claimed task is now in progress, so it stays out of the dispatcher
+        lock_guard<mutex> lock(claimMutex);
+        Task *task = findTask(taskID);
+        task->setStatus("in progress");
+        updateViews(*task);
+        publishChange(ChangeType::UPDATED, taskID, *task);
+        claimed = *task;
+        unsavedClaims = true;
+        return true;
+    }
+
+    // Queue a rewrite of the task file if tasks were claimed with claimNext() since it was last written
+    void saveClaims()
+    {
+        lock_guard<mutex> lock(claimMutex);
+        if (unsavedClaims)
+        {
+            saveAllTasks();
+        }
+    }
+
+    // Move completed tasks whose deadline is more than the given number of days ago from the task file to the archive
+    void archiveCompletedTasks(int olderThanDays)
+    {
+        TraceSpan span("archiveCompletedTasks");
+        ensureTasksLoaded();
+        getSearchIndex();
+
+        // Today's date as a day number
+        time_t now = time(nullptr);
+        char todayText[16];
+        strftime(todayText, sizeof(todayText), "%d/%m/%Y", localtime(&now));
+        int today = 0;
+        DeadlineCodec::dayNumber(todayText, today);
+
+        // Split the tasks into the ones to archive and the ones to keep
+        vector<Task> archived;
+        vector<Task> remaining;
+        for (auto &task : project->tasks)
+        {
+            int day;
+            if (task.isCompleted() && DeadlineCodec::dayNumber(task.getDeadline(), day) && day < today - olderThanDays)
             {
-                cerr << "Unable to open file for writing: " << filename << endl;
-                return;
+                archived.push_back(task);
             }
-
-            // Write remaining tasks to the file
-            for (Task &task : loadedTasks)
+            else
             {
-                outfile << task.getTaskID() << "," << task.getCategory() << "," << task.getTitle() << "," << task.getDescription() << ","
-                        << task.getDeadline() << "," << task.getPriority() << "," << task.getStatus() << ","
-                        << task.getLabel() << endl;
+                remaining.push_back(task);
             }
-            outfile.close();
-            cout << "Task with ID " << taskID << " has been deleted." << endl;
         }
-        else
+        if (archived.empty())
+        {
+            cout << "No completed tasks are old enough to be archived." << endl;
+            return;
+        }
+
+        // The archive is written first, so a failure part way through never loses a task
+        if (!getArchive().append(archived))
+        {
+            cerr << "Unable to write to the archive. No tasks were archived." << endl;
+            return;
+        }
+        project->tasks.swap(remaining);
+        project->reindex();
+        for (auto &task : archived)
+        {
+            removeFromViews(task.getTaskID());
+            project->searchIndex.removeTask(task.getTaskID(), task.getTitle(), task.loadDescription());
+            publishChange(ChangeType::DELETED, task.getTaskID());
+            project->dependencyGraph.removeTask(task.getTaskID());
+        }
+        saveAllTasks();
+
+        cout << archived.size() << " task(s) archived. The archive now holds " << project->archive.taskCount() << " task(s) in " << project->archive.blockCount() << " block(s)." << endl;
+    }
+
+    // Display an archived task by its ID
+    void findArchivedTask(int taskID)
+    {
+        TraceSpan span("findArchivedTask");
+        ScopedTimer timer(MetricTimer::ARCHIVE_LOOKUP);
+
+        Task task;
+        if (!getArchive().findById(taskID, task))
+        {
+            cout << "Task with ID " << taskID << " is not in the archive." << endl;
+            return;
+        }
+        timer.stop();
+        printTaskWithColour(task);
+    }
+
+    // Display the archived tasks whose deadline is between two DD/MM/YYYY dates (inclusive)
+    void findArchivedTasksByDate(const string &fromDate, const string &toDate)
+    {
+        TraceSpan span("findArchivedTasksByDate");
+
+        int fromDay;
+        int toDay;
+        if (!DeadlineCodec::dayNumber(fromDate, fromDay) || !DeadlineCodec::dayNumber(toDate, toDay))
+        {
+            throw invalid_argument("Invalid date. Dates must be in the DD/MM/YYYY format.");
+        }
+
+        ScopedTimer timer(MetricTimer::ARCHIVE_LOOKUP);
+        vector<Task> found = getArchive().findByDateRange(fromDay, toDay);
+        timer.stop();
+
+        if (found.empty())
+        {
+            cout << "No archived tasks are due between " << fromDate << " and " << toDate << "." << endl;
+            return;
+        }
+        for (auto &task : found)
         {
-            cout << "Task with ID " << taskID << " not found." << endl;
+            printTaskWithColour(task);
+            cout << endl;
         }
+        cout << found.size() << " archived task(s) found." << endl;
     }
-};
\ No newline at end of file
+};
+
+#endif
@@ -0,0 +1,159 @@
+// This file implements the byte-level helpers used by the task archive: variable-length integers and a small LZ77 block compressor.
+// Variable-length integers store 7 bits per byte, so the small differences between consecutive IDs and deadlines take one byte each.
+// The compressor replaces repeated byte sequences (such as categories, labels and status names that appear in every record)
+// with a back-reference to their previous occurrence. It favours speed and simplicity over compression ratio.
+
+#ifndef TASK_BLOCK_COMPRESSION_CPP
+#define TASK_BLOCK_COMPRESSION_CPP
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring> // memcpy() and memcmp()
+
+using namespace std;
+
+// Append an unsigned integer using 7 bits per byte; the high bit of a byte marks that another byte follows
+inline void appendVarint(string &out, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        out += char((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    out += char(value);
+}
+
+// Read an integer written by appendVarint(); returns false if the buffer ends too early
+inline bool readVarint(const char *&p, const char *end, uint64_t &value)
+{
+    value = 0;
+    for (int shift = 0; shift < 64 && p < end; shift += 7)
+    {
+        unsigned char byte = (unsigned char)*p++;
+        value |= uint64_t(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Map signed integers to unsigned ones so that small negative numbers stay small (0, -1, 1, -2 ... become 0, 1, 2, 3 ...)
+inline uint64_t zigzagEncode(int64_t value)
+{
+    return (uint64_t(value) << 1) ^ uint64_t(value >> 63);
+}
+
+inline int64_t zigzagDecode(uint64_t value)
+{
+    return int64_t(value >> 1) ^ -int64_t(value & 1);
+}
+
+// The BlockCompressor class compresses whole blocks of bytes.
+// A compressed block is a sequence of (literal length, literal bytes, match length, match offset) entries;
+// the last entry has no match.
+class BlockCompressor
+{
+public:
+    // Compress a block and append the result to out
+    static void compress(const string &input, string &out)
+    {
+        const char *data = input.data();
+        size_t size = input.size();
+        vector<uint32_t> table(hashSize, 0); // Last position + 1 of each hashed 4-byte sequence (0 means none)
+
+        size_t literalStart = 0;
+        size_t pos = 0;
+        while (size >= minMatch && pos + minMatch <= size)
+        {
+            uint32_t hash = hashAt(data + pos);
+            size_t candidate = table[hash];
+            table[hash] = uint32_t(pos + 1);
+
+            // Use the previous occurrence if it really matches and is inside the window
+            if (candidate == 0 || pos - (candidate - 1) > maxOffset || memcmp(data + candidate - 1, data + pos, minMatch) != 0)
+            {
+                pos++;
+                continue;
+            }
+            size_t matchStart = candidate - 1;
+            size_t length = minMatch;
+            while (pos + length < size && data[matchStart + length] == data[pos + length])
+            {
+                length++;
+            }
+
+            appendVarint(out, pos - literalStart);
+            out.append(data + literalStart, pos - literalStart);
+            appendVarint(out, length - minMatch);
+            appendVarint(out, pos - matchStart);
+
+            pos += length;
+            literalStart = pos;
+        }
+
+        // Whatever is left is stored as it is
+        appendVarint(out, size - literalStart);
+        out.append(data + literalStart, size - literalStart);
+    }
+
+    // Decompress a block whose uncompressed size is known; returns false if the data is damaged
+    static bool decompress(const char *p, size_t size, size_t rawSize, string &out)
+    {
+        const char *end = p + size;
+        out.clear();
+        out.reserve(rawSize);
+        while (p < end)
+        {
+            uint64_t literals = 0;
+            if (!readVarint(p, end, literals) || literals > uint64_t(end - p) || out.size() + literals > rawSize)
+            {
+                return false;
+            }
+            out.append(p, size_t(literals));
+            p += literals;
+            if (p == end)
+            {
+                break;
+            }
+
+            uint64_t length = 0;
+            uint64_t offset = 0;
+            if (!readVarint(p, end, length) || !readVarint(p, end, offset))
+            {
+                return false;
+            }
+            length += minMatch;
+            if (offset == 0 || offset > out.size() || out.size() + length > rawSize)
+            {
+                return false;
+            }
+
+            // Copy one byte at a time, because the match may overlap the bytes it produces
+            size_t from = out.size() - size_t(offset);
+            for (uint64_t i = 0; i < length; i++)
+            {
+                out += out[from + i];
+            }
+        }
+        return out.size() == rawSize;
+    }
+
+private:
+    static const size_t minMatch = 4;        // Shorter repeats are cheaper to store as literals
+    static const size_t maxOffset = 1 << 16; // How far back a match may start
+    static const size_t hashBits = 14;
+    static const size_t hashSize = size_t(1) << hashBits;
+
+    // Hash of the 4 bytes starting at p
+    static uint32_t hashAt(const char *p)
+    {
+        uint32_t value;
+        memcpy(&value, p, sizeof(value));
+        return (value * 2654435761u) >> (32 - hashBits);
+    }
+};
+
+#endif
@@ -0,0 +1,111 @@
+// This file implements the date arithmetic shared by the deadlines and the recurrence rules of tasks.
+// Dates are handled as day numbers (days since 01/01/1970), which can be compared and subtracted directly, and are only turned
+// into a year, month and day (or DD/MM/YYYY text) at the edges. The conversions use the proleptic Gregorian calendar and count
+// years from March, so the leap day is the last day of the year and no table lookup is needed.
+
+#ifndef TASK_CALENDAR_CPP
+#define TASK_CALENDAR_CPP
+
+#include <string>
+#include <cctype> // isdigit() for reading dates
+#include <cstdio> // snprintf() for formatting dates
+
+using namespace std;
+
+// A date split into its parts
+struct CivilDate
+{
+    int year;
+    int month; // 1-12
+    int day;   // 1-31
+};
+
+// The Calendar struct converts between day numbers, dates and DD/MM/YYYY text.
+struct Calendar
+{
+    // Sort key of a date in the form YYYYMMDD, or -1 if the text is not in the DD/MM/YYYY form
+    static int dateKey(const string &date)
+    {
+        if (date.size() != 10 || date[2] != '/' || date[5] != '/')
+        {
+            return -1;
+        }
+        int key = 0;
+        for (int i : {6, 7, 8, 9, 3, 4, 0, 1})
+        {
+            if (!isdigit((unsigned char)date[i]))
+            {
+                return -1;
+            }
+            key = key * 10 + (date[i] - '0');
+        }
+        return key;
+    }
+
+    static bool isLeapYear(int year)
+    {
+        return (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+    }
+
+    static int daysInMonth(int year, int month)
+    {
+        static const int days[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+        return days[month - 1] + (month == 2 && isLeapYear(year));
+    }
+
+    // Day number of a date (the date must be valid)
+    static int toDayNumber(CivilDate date)
+    {
+        int y = date.year - (date.month <= 2);
+        int era = (y >= 0 ? y : y - 399) / 400;
+        int yearOfEra = y - era * 400;
+        int dayOfYear = (153 * (date.month + (date.month > 2 ? -3 : 9)) + 2) / 5 + date.day - 1;
+        int dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+        return era * 146097 + dayOfEra - 719468;
+    }
+
+    // Date of a day number
+    static CivilDate fromDayNumber(int day)
+    {
+        day += 719468;
+        int era = (day >= 0 ? day : day - 146096) / 146097;
+        int dayOfEra = day - era * 146097;
+        int yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+        int dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+        int mp = (5 * dayOfYear + 2) / 153;
+        int d = dayOfYear - (153 * mp + 2) / 5 + 1;
+        int m = mp < 10 ? mp + 3 : mp - 9;
+        return {yearOfEra + era * 400 + (m <= 2), m, d};
+    }
+
+    // Day of the week of a day number: 0 for Monday up to 6 for Sunday (01/01/1970 was a Thursday)
+    static int weekday(int day)
+    {
+        int shifted = (day + 3) % 7;
+        return shifted < 0 ? shifted + 7 : shifted;
+    }
+
+    // Day number of a DD/MM/YYYY date; returns false if the text is not a valid date
+    static bool parse(const string &date, int &day)
+    {
+        int key = dateKey(date);
+        CivilDate parts = {key / 10000, key / 100 % 100, key % 100};
+        if (key < 0 || parts.month < 1 || parts.month > 12 || parts.day < 1 || parts.day > daysInMonth(parts.year, parts.month))
+        {
+            return false;
+        }
+        day = toDayNumber(parts);
+        return true;
+    }
+
+    // Format a day number as DD/MM/YYYY
+    static string format(int day)
+    {
+        CivilDate date = fromDayNumber(day);
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), "%02d/%02d/%04d", date.day, date.month, date.year);
+        return buffer;
+    }
+};
+
+#endif
@@ -0,0 +1,173 @@
+// This file implements the change feed of a project.
+// Every change made to the tasks of a project (a task created, updated or deleted) is published as an event with a sequence number
+// one higher than the previous event. A client that shows the tasks keeps a subscription holding the next sequence number it
+// expects, and asks the feed only for the events after it instead of reading the whole task list again.
+// The feed keeps the most recent events in a ring buffer of fixed size, so its memory use does not grow with the number of changes.
+// A subscriber that falls so far behind that the events it needs were overwritten, or that follows a feed that was replaced
+// (for example because the project was unloaded and read again), is told to resync: it reads the full task list once and then
+// continues with deltas from there.
+// The feed has its own lock, so subscribers on other threads can read it while the TaskManager publishes.
+
+#ifndef TASK_CHANGE_FEED_CPP
+#define TASK_CHANGE_FEED_CPP
+
+#include <vector>
+#include <mutex>              // Protects the ring buffer
+#include <condition_variable> // Wakes subscribers waiting for new events
+#include <chrono>             // Timeout of waitForChanges()
+#include <atomic>             // Source of unique feed IDs
+#include <cstdint>
+#include "processor.cpp"
+
+using namespace std;
+
+// Kinds of change published on the feed
+enum class ChangeType
+{
+    CREATED, // A task was added
+    UPDATED, // Some fields of a task changed
+    DELETED  // A task was removed (deleted or archived)
+};
+
+// One change published on the feed
+struct ChangeEvent
+{
+    uint64_t sequence = 0;           // Position of the event in the feed, starting at 1
+    ChangeType type = ChangeType::UPDATED;
+    int taskID = 0;                  // Task that changed
+    Task task;                       // The task after the change (empty for DELETED)
+    int64_t publishedMicros = 0;     // Wall-clock time the change was published, in microseconds
+};
+
+// Position of a subscriber in a feed
+struct ChangeSubscription
+{
+    uint64_t feedID = 0;       // Feed the position belongs to (0 before the first resync)
+    uint64_t nextSequence = 0; // Sequence number of the next event the subscriber has not seen
+};
+
+// Result of reading a feed
+enum class FeedStatus
+{
+    DELTAS, // The events after the subscriber's position were returned (possibly none)
+    RESYNC  // The subscriber must read the full task list again and restart from the current position
+};
+
+// The ChangeFeed class publishes the changes of one project through a bounded ring buffer.
+class ChangeFeed
+{
+public:
+    static const size_t defaultCapacity = 1024; // Events kept for subscribers that are behind
+
+    explicit ChangeFeed(size_t eventCapacity = defaultCapacity) : capacity(eventCapacity), feedID(nextFeedID()) {}
+
+    // Publish a change and return its sequence number
+    uint64_t publish(ChangeType type, int taskID, const Task &task = Task())
+    {
+        uint64_t sequence;
+        {
+            lock_guard<mutex> lock(feedMutex);
+            sequence = nextSequence++;
+
+            // The buffer grows until it is full, then each event overwrites the oldest one
+            size_t slot = size_t((sequence - 1) % capacity);
+            if (slot == events.size())
+            {
+                events.emplace_back();
+            }
+            ChangeEvent &event = events[slot];
+            event.sequence = sequence;
+            event.type = type;
+            event.taskID = taskID;
+            event.task = type == ChangeType::DELETED ? Task() : task;
+            event.publishedMicros = chrono::duration_cast<chrono::microseconds>(chrono::system_clock::now().time_since_epoch()).count();
+            if (sequence - oldestSequence >= capacity)
+            {
+                oldestSequence = sequence - capacity + 1; // The oldest event was just overwritten
+            }
+        }
+        changed.notify_all();
+        return sequence;
+    }
+
+    // Drop every event and make all subscribers resync, for changes that are not described by events (such as reading the file again)
+    void invalidate()
+    {
+        {
+            lock_guard<mutex> lock(feedMutex);
+            feedID = nextFeedID();
+            oldestSequence = nextSequence;
+        }
+        changed.notify_all();
+    }
+
+    // Read the events after a subscriber's position and move the position past them.
+    // Returns RESYNC without any events if the subscriber has to start again from a full task list (see resyncPosition()).
+    FeedStatus read(ChangeSubscription &subscription, vector<ChangeEvent> &delta) const
+    {
+        delta.clear();
+        lock_guard<mutex> lock(feedMutex);
+        if (subscription.feedID != feedID || subscription.nextSequence < oldestSequence || subscription.nextSequence > nextSequence)
+        {
+            return FeedStatus::RESYNC;
+        }
+        for (uint64_t sequence = subscription.nextSequence; sequence < nextSequence; sequence++)
+        {
+            delta.push_back(events[(sequence - 1) % capacity]);
+        }
+        subscription.nextSequence = nextSequence;
+        return FeedStatus::DELTAS;
+    }
+
+    // Position of a subscriber that has just read the full task list: every later event is a delta to it
+    ChangeSubscription resyncPosition() const
+    {
+        lock_guard<mutex> lock(feedMutex);
+        return {feedID, nextSequence};
+    }
+
+    // Wait until there are events after a subscriber's position or the timeout passes; returns true if there are
+    bool waitForChanges(const ChangeSubscription &subscription, chrono::milliseconds timeout) const
+    {
+        unique_lock<mutex> lock(feedMutex);
+        return changed.wait_for(lock, timeout, [this, &subscription]
+                                { return subscription.feedID != feedID || subscription.nextSequence < nextSequence; });
+    }
+
+    // Approximate number of bytes of memory used by the ring buffer
+    size_t memoryUsage() const
+    {
+        lock_guard<mutex> lock(feedMutex);
+        size_t bytes = sizeof(*this) + events.capacity() * sizeof(ChangeEvent);
+        for (const ChangeEvent &event : events)
+        {
+            bytes += event.task.textCapacity();
+        }
+        return bytes;
+    }
+
+    // Sequence number the next event will get
+    uint64_t currentSequence() const
+    {
+        lock_guard<mutex> lock(feedMutex);
+        return nextSequence;
+    }
+
+private:
+    // Every feed gets a different ID, so a subscription can never be used with the wrong feed
+    static uint64_t nextFeedID()
+    {
+        static atomic<uint64_t> counter{1};
+        return counter.fetch_add(1);
+    }
+
+    mutable mutex feedMutex;              // Protects everything below
+    mutable condition_variable changed;   // Signalled when an event is published or the feed is invalidated
+    size_t capacity;                      // Size of the ring buffer
+    uint64_t feedID;                      // Changes when the feed is invalidated
+    vector<ChangeEvent> events;           // Ring buffer; the event with sequence s is stored at (s - 1) % capacity
+    uint64_t nextSequence = 1;            // Sequence number of the next event
+    uint64_t oldestSequence = 1;          // Oldest event still in the ring buffer
+};
+
+#endif
@@ -0,0 +1,341 @@
+// This file implements the cold fields of tasks: text that a lazy load leaves in the task file instead of keeping it in memory.
+// Sorting, filtering, the views, the statistics and the dispatcher never look at the description of a task, and it is usually
+// the longest field, so when lazy loading is enabled the TaskManager keeps only a reference to the record the description is in
+// (its offset and length in the task file) and reads the description back when something asks for it.
+// A ColdFieldFile maps the task file as it was when the references were taken. Rewrites of the task file replace it with a
+// new file (see task_writer.cpp) and appends only add bytes at its end, so the records a reference points at never change under
+// it, and references copied into the change feed or a replication snapshot stay valid for as long as they exist. The old version
+// of a rewritten file stays on disk until the last reference to it goes away.
+// Descriptions read back are kept in a small least recently used cache shared by every project, whose size is the memory budget
+// given with --lazy-descriptions; the cache has its own lock, so other threads (such as the replication thread) can read cold
+// fields while the TaskManager works.
+
+#ifndef TASK_COLD_FIELDS_CPP
+#define TASK_COLD_FIELDS_CPP
+
+#include <string>
+#include <vector>
+#include <list>          // Cached fields in least recently used order
+#include <unordered_map> // Finds a cached field by its file and offset
+#include <memory>        // shared_ptr keeps a file open while references to it exist
+#include <mutex>         // Protects the cache
+#include <atomic>        // Source of unique file serial numbers
+#include <stdexcept>     // runtime_error when a field cannot be read back
+#include <cstdint>
+#include <fcntl.h>       // open()
+#include <unistd.h>      // close()
+#include <sys/stat.h>    // fstat() for the size of the opened file
+#include <sys/mman.h>    // mmap() maps the task file instead of reading it
+#include "metrics.cpp"   // Cold field reads and cache hits
+
+using namespace std;
+
+// The ColdFieldCache class keeps the cold fields read back most recently, within a memory budget (a single shared instance).
+class ColdFieldCache
+{
+public:
+    static const size_t defaultBudget = 1024 * 1024; // Default memory budget in bytes
+
+    // Access the single cache instance
+    static ColdFieldCache &instance()
+    {
+        static ColdFieldCache cache;
+        return cache;
+    }
+
+    // Change the memory budget, dropping the fields used longest ago if the cache no longer fits
+    void setBudget(size_t bytes)
+    {
+        lock_guard<mutex> lock(cacheMutex);
+        budget = bytes;
+        shrink();
+    }
+
+    size_t getBudget() const
+    {
+        lock_guard<mutex> lock(cacheMutex);
+        return budget;
+    }
+
+    // Approximate number of bytes of memory used by the cached fields
+    size_t memoryUsage() const
+    {
+        lock_guard<mutex> lock(cacheMutex);
+        return used;
+    }
+
+    // Copy a cached field into text and mark it as the most recently used one; returns false if it is not cached
+    bool lookup(uint64_t file, uint64_t offset, string &text)
+    {
+        lock_guard<mutex> lock(cacheMutex);
+        auto it = byKey.find(Key{file, offset});
+        if (it == byKey.end())
+        {
+            return false;
+        }
+        order.splice(order.begin(), order, it->second);
+        text = it->second->text;
+        return true;
+    }
+
+    // Add a field that was just read back (fields larger than the whole budget are not cached)
+    void insert(uint64_t file, uint64_t offset, const string &text)
+    {
+        lock_guard<mutex> lock(cacheMutex);
+        if (entryBytes(text) > budget || byKey.count(Key{file, offset}) > 0)
+        {
+            return;
+        }
+        order.push_front(Entry{Key{file, offset}, text});
+        byKey[order.front().key] = order.begin();
+        used += entryBytes(order.front().text);
+        shrink();
+    }
+
+private:
+    ColdFieldCache() {} // Use instance() instead
+
+    // A field is identified by the serial number of its file and the offset of its record
+    struct Key
+    {
+        uint64_t file;
+        uint64_t offset;
+
+        bool operator==(const Key &other) const
+        {
+            return file == other.file && offset == other.offset;
+        }
+    };
+
+    struct KeyHash
+    {
+        size_t operator()(const Key &key) const
+        {
+            return hash<uint64_t>()(key.file * 0x9E3779B97F4A7C15ull ^ key.offset);
+        }
+    };
+
+    struct Entry
+    {
+        Key key;
+        string text;
+    };
+
+    // Memory used by one cached field, including the list node and the index entry
+    static size_t entryBytes(const string &text)
+    {
+        return sizeof(Entry) + text.capacity() + sizeof(pair<Key, list<Entry>::iterator>) + 4 * sizeof(void *);
+    }
+
+    // Drop the fields used longest ago until the cache fits in its budget
+    void shrink()
+    {
+        while (used > budget && !order.empty())
+        {
+            used -= entryBytes(order.back().text);
+            byKey.erase(order.back().key);
+            order.pop_back();
+        }
+    }
+
+    mutable mutex cacheMutex;                                  // Protects everything below
+    size_t budget = defaultBudget;                             // Memory the cached fields may use
+    size_t used = 0;                                           // Memory the cached fields use
+    list<Entry> order;                                         // Cached fields, most recently used first
+    unordered_map<Key, list<Entry>::iterator, KeyHash> byKey;  // Position of every cached field in order
+};
+
+// The ColdFieldFile class maps a task file into memory so that fields of its records can be read back later.
+// Nothing is read when the file is opened; the pages holding a record are only read from disk when one of its fields is.
+class ColdFieldFile
+{
+public:
+    // Open a task file whose records keep the cold field in column fieldIndex; returns nullptr if it cannot be opened
+    static shared_ptr<const ColdFieldFile> open(const string &filename, size_t fieldIndex)
+    {
+        int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            return nullptr;
+        }
+        struct stat info;
+        void *mapped = nullptr;
+        if (fstat(fd, &info) == 0 && info.st_size > 0)
+        {
+            mapped = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_SHARED, fd, 0);
+        }
+        ::close(fd); // The mapping keeps the file itself alive
+        if (mapped == nullptr || mapped == MAP_FAILED)
+        {
+            return nullptr;
+        }
+        return shared_ptr<const ColdFieldFile>(new ColdFieldFile((const char *)mapped, uint64_t(info.st_size), fieldIndex, filename));
+    }
+
+    ~ColdFieldFile()
+    {
+        munmap((void *)data, size_t(fileSize));
+    }
+
+    ColdFieldFile(const ColdFieldFile &) = delete;
+    ColdFieldFile &operator=(const ColdFieldFile &) = delete;
+
+    // Size of the file when it was opened (records appended later are never referenced)
+    uint64_t size() const
+    {
+        return fileSize;
+    }
+
+    // Read back the cold field of the record stored at [offset, offset + length) into text, from the cache if it is there
+    void fetch(uint64_t offset, uint32_t length, string &text) const
+    {
+        text.clear();
+        ColdFieldCache &cache = ColdFieldCache::instance();
+        if (cache.lookup(serial, offset, text))
+        {
+            Metrics::instance().add(MetricCounter::COLD_FIELD_CACHE_HITS);
+            return;
+        }
+        Metrics::instance().add(MetricCounter::COLD_FIELD_READS);
+
+        // Undo the quoting of the field the same way the FieldScanner does
+        const char *p, *last;
+        locate(offset, length, p, last);
+        if (p < last && *p == '"')
+        {
+            for (p++; p < last; p++)
+            {
+                if (*p == '"')
+                {
+                    if (p + 1 < last && p[1] == '"')
+                    {
+                        p++; // Escaped double quote
+                    }
+                    else
+                    {
+                        text.append(p + 1, last); // Anything after the closing quote is kept as it is
+                        break;
+                    }
+                }
+                text += *p;
+            }
+        }
+        else
+        {
+            text.assign(p, last);
+        }
+        cache.insert(serial, offset, text);
+    }
+
+    // Append the cold field of a record to out exactly as it is stored (already quoted), without decoding it.
+    // Rewriting the task file copies cold fields this way, so it neither reads them into strings nor disturbs the cache.
+    void appendStored(uint64_t offset, uint32_t length, string &out) const
+    {
+        const char *first, *last;
+        locate(offset, length, first, last);
+        out.append(first, last);
+    }
+
+private:
+    ColdFieldFile(const char *mapped, uint64_t bytes, size_t fieldIndex, const string &name)
+        : data(mapped), fileSize(bytes), field(fieldIndex), serial(nextSerial()), filename(name) {}
+
+    // Find the stored bytes of the cold field in the record at [offset, offset + length), walking the fields before it.
+    // Throws runtime_error if the record lies outside the file or has too few fields, rather than passing on an empty field
+    // that could then be saved.
+    void locate(uint64_t offset, uint32_t length, const char *&first, const char *&last) const
+    {
+        if (offset + length > fileSize)
+        {
+            throw runtime_error("A task description refers past the end of " + filename);
+        }
+        const char *p = data + offset;
+        const char *end = p + length;
+        for (size_t column = 0;; column++)
+        {
+            const char *start = p;
+            bool inQuotes = p < end && *p == '"';
+            for (p += inQuotes ? 1 : 0; p < end; p++)
+            {
+                if (inQuotes)
+                {
+                    if (*p == '"' && p + 1 < end && p[1] == '"')
+                    {
+                        p++; // Escaped double quote
+                    }
+                    else if (*p == '"')
+                    {
+                        inQuotes = false; // Closing quote
+                    }
+                }
+                else if (*p == ',' || *p == '\n' || *p == '\r')
+                {
+                    break;
+                }
+            }
+            if (column == field)
+            {
+                first = start;
+                last = p;
+                return;
+            }
+            if (p >= end || *p != ',')
+            {
+                throw runtime_error("Unable to read a task description back from " + filename);
+            }
+            p++; // Step over the comma
+        }
+    }
+
+    // Every opened file gets its own serial number, so cached fields of a closed file are never mistaken for another file's
+    static uint64_t nextSerial()
+    {
+        static atomic<uint64_t> counter{1};
+        return counter.fetch_add(1);
+    }
+
+    const char *data;  // Contents of the file, mapped read-only
+    uint64_t fileSize; // Size of the file when it was opened
+    size_t field;      // Column of the cold field in every record
+    uint64_t serial;   // Identifies the file in the cache
+    string filename;   // Name of the file, for error messages
+};
+
+// A reference to a cold field: the file it is in and the extent of its record there. An empty reference means the field is in memory.
+struct ColdFieldRef
+{
+    static const uint32_t maxLength = (1u << 24) - 1; // Longest record that can be referenced (longer ones stay in memory)
+
+    shared_ptr<const ColdFieldFile> file;
+    uint64_t offset : 40; // Offset of the record in the file
+    uint64_t length : 24; // Length of the record in bytes
+
+    ColdFieldRef() : offset(0), length(0) {}
+
+    ColdFieldRef(shared_ptr<const ColdFieldFile> in, uint64_t recordOffset, uint32_t recordLength)
+        : file(move(in)), offset(recordOffset), length(recordLength) {}
+
+    bool isCold() const
+    {
+        return file != nullptr;
+    }
+
+    // Whether two references point at the same record of the same file (and so at the same text)
+    bool sameAs(const ColdFieldRef &other) const
+    {
+        return file == other.file && offset == other.offset;
+    }
+
+    // Read the field back into text (whose memory is reused)
+    void load(string &text) const
+    {
+        file->fetch(offset, uint32_t(length), text);
+    }
+
+    void appendStored(string &out) const
+    {
+        file->appendStored(offset, uint32_t(length), out);
+    }
+};
+
+#endif
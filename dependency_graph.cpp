@@ -0,0 +1,395 @@
+// This file implements the dependency graph used by the TaskManager class.
+// A task can depend on other tasks; it is "ready" once every task it depends on has been completed.
+// The graph keeps, for every task, the list of tasks waiting on it and a count of its own unfinished dependencies,
+// so completing (or re-opening) a task only touches the tasks that directly depend on it.
+// Cycle detection and the critical path (the longest chain of unfinished tasks) are computed on demand.
+
+#ifndef TASK_DEPENDENCY_GRAPH_CPP
+#define TASK_DEPENDENCY_GRAPH_CPP
+
+#include <vector>
+#include <unordered_map> // Nodes by task ID
+#include <unordered_set> // The ready set
+#include <algorithm>     // sort() and reverse()
+
+using namespace std;
+
+// The DependencyGraph class tracks which tasks are blocked and which are ready to be worked on.
+class DependencyGraph
+{
+public:
+    // Add a task with the IDs of the tasks it depends on (an existing task with the same ID is replaced)
+    void addTask(int taskID, const vector<int> &dependencies, bool completed)
+    {
+        if (nodes.count(taskID) && nodes[taskID].present)
+        {
+            removeTask(taskID);
+        }
+
+        Node &node = nodes[taskID];
+        node.present = true;
+        node.completed = completed;
+        node.dependencies = dependencies;
+        node.unfinished = 0;
+
+        // Tasks that were waiting on this ID (because it did not exist yet) are now blocked by it if it is unfinished
+        if (!completed)
+        {
+            adjustDependents(node, +1);
+        }
+
+        // Link the task to the tasks it depends on (references to map elements stay valid when new nodes are added)
+        for (int dependency : node.dependencies)
+        {
+            Node &target = nodes[dependency]; // May create a placeholder for a task that does not exist yet
+            target.dependents.push_back(taskID);
+            if (target.present && !target.completed)
+            {
+                node.unfinished++;
+            }
+        }
+        updateReadiness(taskID, node);
+    }
+
+    // Remove a task; tasks that depended on it no longer wait for it
+    void removeTask(int taskID)
+    {
+        auto it = nodes.find(taskID);
+        if (it == nodes.end() || !it->second.present)
+        {
+            return;
+        }
+
+        Node &node = it->second;
+        if (!node.completed)
+        {
+            adjustDependents(node, -1);
+        }
+
+        // Unlink the task from the tasks it depends on
+        for (int dependency : node.dependencies)
+        {
+            auto target = nodes.find(dependency);
+            if (target != nodes.end())
+            {
+                vector<int> &dependents = target->second.dependents;
+                dependents.erase(find(dependents.begin(), dependents.end(), taskID));
+                eraseIfUnused(target);
+            }
+        }
+
+        node.present = false;
+        node.dependencies.clear();
+        node.unfinished = 0;
+        ready.erase(taskID);
+        eraseIfUnused(it);
+    }
+
+    // Mark a task as completed or not; only the tasks that depend on it are updated
+    void setCompleted(int taskID, bool completed)
+    {
+        auto it = nodes.find(taskID);
+        if (it == nodes.end() || !it->second.present || it->second.completed == completed)
+        {
+            return;
+        }
+
+        Node &node = it->second;
+        node.completed = completed;
+        adjustDependents(node, completed ? -1 : +1);
+        updateReadiness(taskID, node);
+    }
+
+    // Replace the dependencies of an existing task
+    void setDependencies(int taskID, const vector<int> &dependencies)
+    {
+        auto it = nodes.find(taskID);
+        if (it == nodes.end() || !it->second.present)
+        {
+            return;
+        }
+        bool completed = it->second.completed;
+        removeTask(taskID);
+        addTask(taskID, dependencies, completed);
+    }
+
+    // Check whether adding the given dependencies to a task would create a cycle
+    bool wouldCreateCycle(int taskID, const vector<int> &dependencies) const
+    {
+        // A cycle appears if the task can already be reached from one of its new dependencies by following dependencies
+        vector<int> stack(dependencies.begin(), dependencies.end());
+        unordered_set<int> visited;
+        while (!stack.empty())
+        {
+            int current = stack.back();
+            stack.pop_back();
+            if (current == taskID)
+            {
+                return true;
+            }
+            if (!visited.insert(current).second)
+            {
+                continue;
+            }
+            auto it = nodes.find(current);
+            if (it != nodes.end())
+            {
+                stack.insert(stack.end(), it->second.dependencies.begin(), it->second.dependencies.end());
+            }
+        }
+        return false;
+    }
+
+    // Check whether a task is ready (not completed and not waiting on any unfinished task)
+    bool isReady(int taskID) const
+    {
+        return ready.count(taskID) != 0;
+    }
+
+    // Number of unfinished tasks a task is still waiting on
+    int unfinishedDependencies(int taskID) const
+    {
+        auto it = nodes.find(taskID);
+        return it == nodes.end() ? 0 : it->second.unfinished;
+    }
+
+    // IDs of the tasks that depend on a task
+    vector<int> dependentsOf(int taskID) const
+    {
+        auto it = nodes.find(taskID);
+        return it == nodes.end() ? vector<int>() : it->second.dependents;
+    }
+
+    // IDs of all ready tasks, in increasing order
+    vector<int> readyTasks() const
+    {
+        vector<int> result(ready.begin(), ready.end());
+        sort(result.begin(), result.end());
+        return result;
+    }
+
+    // Find a dependency cycle; returns the IDs along the cycle, or an empty list if there is none
+    vector<int> findCycle() const
+    {
+        // Iterative depth-first search; a dependency that is still on the current path closes a cycle
+        enum Colour
+        {
+            WHITE,
+            GREY,
+            BLACK
+        };
+        unordered_map<int, Colour> colour;
+        vector<int> roots = presentTasks();
+
+        for (int root : roots)
+        {
+            if (colour[root] != WHITE)
+            {
+                continue;
+            }
+
+            vector<pair<int, size_t>> path; // Task and index of the next dependency to visit
+            path.push_back({root, 0});
+            colour[root] = GREY;
+            while (!path.empty())
+            {
+                int current = path.back().first;
+                const vector<int> &dependencies = nodes.at(current).dependencies;
+                if (path.back().second == dependencies.size())
+                {
+                    colour[current] = BLACK;
+                    path.pop_back();
+                    continue;
+                }
+
+                int next = dependencies[path.back().second++];
+                auto nextNode = nodes.find(next);
+                if (nextNode == nodes.end() || !nextNode->second.present)
+                {
+                    continue; // Dependencies on missing tasks cannot be part of a cycle
+                }
+                if (colour[next] == GREY)
+                {
+                    // Collect the tasks from the repeated one to the end of the path
+                    vector<int> cycle;
+                    size_t start = 0;
+                    while (path[start].first != next)
+                    {
+                        start++;
+                    }
+                    for (size_t i = start; i < path.size(); i++)
+                    {
+                        cycle.push_back(path[i].first);
+                    }
+                    return cycle;
+                }
+                if (colour[next] == WHITE)
+                {
+                    colour[next] = GREY;
+                    path.push_back({next, 0});
+                }
+            }
+        }
+        return {};
+    }
+
+    // Longest chain of unfinished tasks, listed from the first task to work on to the last.
+    // Returns an empty list if there are no unfinished tasks or the graph contains a cycle.
+    vector<int> criticalPath() const
+    {
+        // Topological order of the unfinished tasks (Kahn's algorithm), counting only unfinished dependencies
+        unordered_map<int, int> remaining;
+        vector<int> order;
+        for (auto &entry : nodes)
+        {
+            if (entry.second.present && !entry.second.completed)
+            {
+                remaining[entry.first] = entry.second.unfinished;
+                if (entry.second.unfinished == 0)
+                {
+                    order.push_back(entry.first);
+                }
+            }
+        }
+        for (size_t i = 0; i < order.size(); i++)
+        {
+            for (int dependent : nodes.at(order[i]).dependents)
+            {
+                auto it = remaining.find(dependent);
+                if (it != remaining.end() && --it->second == 0)
+                {
+                    order.push_back(dependent);
+                }
+            }
+        }
+        if (order.size() != remaining.size())
+        {
+            return {}; // Some tasks are part of a cycle
+        }
+
+        // Length of the longest chain ending at each task, and the task before it on that chain
+        unordered_map<int, int> length;
+        unordered_map<int, int> previous;
+        int last = 0;
+        int best = 0;
+        for (int taskID : order)
+        {
+            int bestLength = 1;
+            int bestPrevious = 0;
+            bool hasPrevious = false;
+            for (int dependency : nodes.at(taskID).dependencies)
+            {
+                auto it = length.find(dependency);
+                if (it != length.end() && it->second + 1 > bestLength)
+                {
+                    bestLength = it->second + 1;
+                    bestPrevious = dependency;
+                    hasPrevious = true;
+                }
+            }
+            length[taskID] = bestLength;
+            if (hasPrevious)
+            {
+                previous[taskID] = bestPrevious;
+            }
+            if (bestLength > best)
+            {
+                best = bestLength;
+                last = taskID;
+            }
+        }
+
+        vector<int> path;
+        if (best == 0)
+        {
+            return path;
+        }
+        for (int current = last;;)
+        {
+            path.push_back(current);
+            auto it = previous.find(current);
+            if (it == previous.end())
+            {
+                break;
+            }
+            current = it->second;
+        }
+        reverse(path.begin(), path.end());
+        return path;
+    }
+
+    // Remove everything from the graph
+    void clear()
+    {
+        nodes.clear();
+        ready.clear();
+    }
+
+private:
+    // One task in the graph
+    struct Node
+    {
+        bool present = false;     // The task exists (nodes can also be placeholders for IDs that are depended on but missing)
+        bool completed = false;   // The task is completed
+        int unfinished = 0;       // Number of dependencies that exist and are not completed
+        vector<int> dependencies; // Tasks this task waits on
+        vector<int> dependents;   // Tasks waiting on this task
+    };
+
+    // IDs of all existing tasks, in increasing order
+    vector<int> presentTasks() const
+    {
+        vector<int> result;
+        for (auto &entry : nodes)
+        {
+            if (entry.second.present)
+            {
+                result.push_back(entry.first);
+            }
+        }
+        sort(result.begin(), result.end());
+        return result;
+    }
+
+    // Change the unfinished count of every task waiting on a node
+    void adjustDependents(Node &node, int delta)
+    {
+        for (int dependent : node.dependents)
+        {
+            auto it = nodes.find(dependent);
+            if (it != nodes.end() && it->second.present)
+            {
+                // A task can list the same dependency more than once, and each listing counts
+                it->second.unfinished += delta;
+                updateReadiness(dependent, it->second);
+            }
+        }
+    }
+
+    // Add a task to or remove it from the ready set
+    void updateReadiness(int taskID, const Node &node)
+    {
+        if (node.present && !node.completed && node.unfinished == 0)
+        {
+            ready.insert(taskID);
+        }
+        else
+        {
+            ready.erase(taskID);
+        }
+    }
+
+    // Drop a placeholder node once nothing refers to it
+    void eraseIfUnused(unordered_map<int, Node>::iterator it)
+    {
+        if (!it->second.present && it->second.dependents.empty())
+        {
+            nodes.erase(it);
+        }
+    }
+
+    unordered_map<int, Node> nodes; // Every task, plus placeholders for missing tasks that are depended on
+    unordered_set<int> ready;       // Tasks that can be worked on now
+};
+
+#endif
@@ -0,0 +1,126 @@
+// This file implements the task ID allocator of a project.
+// Instead of asking the user for an ID and checking that nobody used it, the allocator hands out IDs that were never used before,
+// even by tasks that were deleted or archived since. The highest reserved ID (the high-water mark) is saved in a small file next
+// to the task file, so IDs keep increasing across restarts.
+// IDs are reserved in blocks: the file is only written when a block runs out, not for every ID. A creator that makes many tasks
+// (an import) takes a whole block with reserveBlock() and assigns the IDs in it without going back to the allocator.
+// The file is replaced with DurableFile, so once an ID is handed out a crash cannot roll the high-water mark back below it.
+// Task IDs go up to maxTaskID, which leaves room for the ID after the highest one; files with larger IDs are refused on load.
+
+#ifndef TASK_ID_ALLOCATOR_CPP
+#define TASK_ID_ALLOCATOR_CPP
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <mutex>   // Serializes allocations from several threads
+#include <climits> // INT_MAX
+#include "metrics.cpp" // Counts the blocks reserved
+#include "task_writer.cpp" // DurableFile for saving the high-water mark
+
+using namespace std;
+
+// A range of reserved IDs [first, end)
+struct IdBlock
+{
+    int first;
+    int end;
+};
+
+// The IdAllocator class hands out unique, increasing task IDs and remembers the highest one reserved.
+class IdAllocator
+{
+public:
+    static const int defaultBlockSize = 64; // IDs reserved each time the file is written
+    static const int maxTaskID = INT_MAX - 1; // Highest ID a task can have
+
+    // Read the high-water mark from a file. IDs below firstFree are already in use (by tasks in the task file or the archive),
+    // so they are never handed out even if the file is missing or older than the tasks.
+    void open(const string &path, int firstFree)
+    {
+        lock_guard<mutex> lock(allocatorMutex);
+        filePath = path;
+        int saved = 0;
+        ifstream file(path);
+        if (!(file >> saved))
+        {
+            saved = 0; // No IDs were reserved yet
+        }
+        reserved = max(saved, max(firstFree, 1));
+        next = reserved;
+        blockEnd = reserved; // Nothing is reserved for allocate() until it is first called
+    }
+
+    // Hand out the next unused ID; returns 0 if the high-water mark could not be saved
+    int allocate()
+    {
+        lock_guard<mutex> lock(allocatorMutex);
+        if (next >= blockEnd)
+        {
+            // The block is used up: reserve a new one after everything reserved so far
+            int first = max(next, reserved);
+            if (first > maxTaskID || !saveHighWaterMark(first + min(defaultBlockSize, maxTaskID + 1 - first)))
+            {
+                return 0;
+            }
+            next = first;
+            blockEnd = reserved;
+        }
+        return next++;
+    }
+
+    // Reserve a block of count IDs for a creator to hand out itself; returns an empty block if the high-water mark could not be saved
+    IdBlock reserveBlock(int count)
+    {
+        lock_guard<mutex> lock(allocatorMutex);
+        int first = reserved;
+        if (count <= 0 || count > maxTaskID + 1 - first || !saveHighWaterMark(first + count))
+        {
+            return {0, 0};
+        }
+        return {first, reserved};
+    }
+
+    // Tell the allocator an ID was chosen by the user, so it is never handed out.
+    // The ID does not need to be saved: it is in the task file, which open() looks at. It must not be above maxTaskID.
+    void observe(int taskID)
+    {
+        lock_guard<mutex> lock(allocatorMutex);
+        int following = min(taskID, maxTaskID) + 1;
+        if (following > next)
+        {
+            next = following; // The rest of the block before the ID is skipped
+        }
+        reserved = max(reserved, following);
+    }
+
+    // The ID the next call to allocate() returns (without reserving it)
+    int peek() const
+    {
+        lock_guard<mutex> lock(allocatorMutex);
+        return next < blockEnd ? next : max(next, reserved);
+    }
+
+private:
+    // Save a new high-water mark, replacing the file in one step and syncing it, so a crash never leaves it half written or older
+    // than an ID already handed out; the caller holds the lock
+    bool saveHighWaterMark(int highWaterMark)
+    {
+        if (!DurableFile::replace(filePath, to_string(highWaterMark) + "\n"))
+        {
+            cerr << "Unable to save the task ID high-water mark: " << filePath << endl;
+            return false;
+        }
+        reserved = highWaterMark;
+        Metrics::instance().add(MetricCounter::ID_BLOCKS_RESERVED);
+        return true;
+    }
+
+    mutable mutex allocatorMutex; // Protects everything below
+    string filePath;              // File holding the high-water mark
+    int next = 1;                 // Next ID allocate() hands out
+    int blockEnd = 1;             // End of the block allocate() hands out IDs from
+    int reserved = 1;             // Every ID below this was reserved or used (the saved high-water mark)
+};
+
+#endif
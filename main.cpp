@@ -4,9 +4,52 @@
 // The core functionality is powered by the TaskManager class, which handles all task-related operations and stores task data in a file for persistent storage.
 // The program offers multiple viewing options, allowing users to sort tasks by date, priority, or category.
 // Additionally, users can update task details, mark tasks as completed, or delete tasks by their unique IDs, making task management efficient and flexible.
+//
+// Command line options:
+//   --stats                 Print a summary of the collected counters and latencies when the program exits
+//   --metrics-file <path>   Write the collected metrics to <path> at exit (JSON if the name ends in .json, Prometheus text otherwise)
+//   --trace <path>          Write a Chrome/Perfetto trace-event JSON file of every operation to <path> at exit
+//                           (the TASKMANAGER_TRACE environment variable can be used instead)
+//   --migrate <path>        Convert a task file from the legacy comma-joined format or version 2 to the checksummed format and exit
+//   --scrub <path>          Verify the checksum of every record of a task file, report the damaged ranges and exit (1 if any)
+//   --scrub-threads <n>     Threads verifying the file with --scrub (default: one per processor)
+//   --sync-diff <peer>      List the tasks the project and another copy of it (a task file, or the socket of --sync-serve) differ in
+//   --sync-pull <peer>      Make the project identical to another copy of it, copying only the tasks that differ, and exit
+//   --sync-push <peer>      Make another copy of the project identical to it, copying only the tasks that differ, and exit
+//   --sync-serve <socket>   Serve the project on the Unix socket <socket> for --sync-diff, --sync-pull and --sync-push of other processes
+//                           until SIGINT or SIGTERM
+//   --project <path>        Open the project stored in <path> instead of project.txt
+//   --project-cache-mb <n>  Keep at most about <n> MB of loaded projects in memory (default 64)
+//   --page-size <n>         Show <n> tasks on each page of a view (default 50, 0 for a single page)
+//   --lazy-descriptions <kb> Leave long descriptions in the task file when projects are loaded, caching at most <kb> KB of them
+//   --due-days <t>,<w>      Treat deadlines up to <t> days away as due today and up to <w> days away as due this week (default 0,7)
+//   --replicate <socket>    Ship every change of the opened project to read-only followers connecting to the Unix socket <socket>
+//   --follow <socket>       Run as a read-only follower of the primary listening on <socket> instead of the normal menu
+//   --export <path>         Write the tasks of the project to <path> as JSON Lines or CSV ("-" for the standard output) and exit
+//   --export-view <name>    Order of the exported tasks: date (default), priority or category
+//   --export-query <words>  Export only the tasks matching a search query, best match first
+//   --import <path>         Add the tasks of a JSON Lines or CSV file to the project and exit
+//   --format <jsonl|csv>    Format of the exported or imported file (default: csv if the name ends in .csv, jsonl otherwise)
+//   --verify-statistics     Recount the statistics after every operation and report any counter that differs (for testing)
+//
+// Workload options (run a scripted workload in a scratch directory, report throughput and latency percentiles, and exit):
+//   --workload-ops <n>      Number of generated operations to measure (default 1000)
+//   --workload-dataset <n>  Number of tasks created before the measurement starts (default 1000)
+//   --workload-mix <mix>    Relative weights of the operations, e.g. create=20,view=40,edit=20,delete=10,search=8,next=2
+//   --workload-rate <r>     Issue r operations per second instead of as fast as possible
+//   --workload-seed <s>     Seed of the generated operations (default 1)
+//   --workload-save <path>  Save the operations that were run as a trace file
+//   --workload-replay <path> Replay the operations of a trace file instead of generating them
+//   --workload-dir <path>   Directory to run the workload in (default a new temporary directory)
 
 #include <iostream>
-#include "TaskManager.cpp" // Include the TaskManager class implementation
+#include <string>
+#include <thread>            // hardware_concurrency() for the default number of scrub threads
+#include <algorithm>         // max()
+#include <stdexcept>         // invalid_argument for invalid menu input
+#include <cstring>           // strcmp() and strncmp() for command line parsing
+#include <cstdlib>           // getenv() for the TASKMANAGER_TRACE environment variable
+#include "taskstore_core.h"  // The task manager, from libtaskstore
 
 using namespace std;
 
@@ -18,9 +61,14 @@ void printMainMenu()
     cout << "2. View Tasks" << endl;
     cout << "3. Edit Task" << endl;
     cout << "4. Delete Task" << endl;
-    cout << "5. Exit Program" << endl;
+    cout << "5. Search Tasks" << endl;
+    cout << "6. Manage Dependencies" << endl;
+    cout << "7. Work on Next Task" << endl;
+    cout << "8. Archived Tasks" << endl;
+    cout << "9. Projects" << endl;
+    cout << "10. Exit Program" << endl;
     cout << endl
-         << "Enter your choice (1-5): ";
+         << "Enter your choice (1-10): ";
 }
 
 // Function to print the view options
@@ -30,18 +78,451 @@ void printViewOptions()
     cout << "1. View by Date" << endl;
     cout << "2. View by Priority" << endl;
     cout << "3. View by Category" << endl;
+    cout << "4. View Changes Since Last Time" << endl;
+    cout << "5. View Due Tasks" << endl;
+    cout << "6. View Agenda" << endl;
+    cout << "7. View Statistics" << endl;
+    cout << "Enter your choice (1-7): ";
+}
+
+// Function to print the dependency options
+void printDependencyOptions()
+{
+    cout << "Dependency Options:" << endl;
+    cout << "1. View Ready Tasks" << endl;
+    cout << "2. View Critical Path" << endl;
+    cout << "3. Check for Cycles" << endl;
+    cout << "4. Edit Task Dependencies" << endl;
+    cout << "Enter your choice (1-4): ";
+}
+
+// Function to print the archive options
+void printArchiveOptions()
+{
+    cout << "Archive Options:" << endl;
+    cout << "1. Archive Old Completed Tasks" << endl;
+    cout << "2. Find Archived Task by ID" << endl;
+    cout << "3. Find Archived Tasks by Date Range" << endl;
+    cout << "Enter your choice (1-3): ";
+}
+
+// Function to print the project options
+void printProjectOptions()
+{
+    cout << "Project Options:" << endl;
+    cout << "1. Switch Project" << endl;
+    cout << "2. List Loaded Projects" << endl;
+    cout << "3. Replication Status" << endl;
     cout << "Enter your choice (1-3): ";
 }
 
+// Function to print the menu of a read-only follower
+void printFollowerMenu()
+{
+    cout << "Follower Menu:" << endl;
+    cout << "1. View by Date" << endl;
+    cout << "2. View by Priority" << endl;
+    cout << "3. View by Category" << endl;
+    cout << "4. Replication Status" << endl;
+    cout << "5. Save Snapshot" << endl;
+    cout << "6. Exit Program" << endl;
+    cout << endl
+         << "Enter your choice (1-6): ";
+}
+
+// Function to run the read-only follower menu: the tasks are replicated from a primary and can be viewed but not changed
+int runFollower(const string &socketPath)
+{
+    TaskFollower follower;
+    if (!follower.connect(socketPath))
+    {
+        return 1;
+    }
+    cout << "Following the primary at " << socketPath << " (read-only)" << endl
+         << endl;
+
+    int choice = 0;
+    do
+    {
+        printFollowerMenu();
+        if (!(cin >> choice))
+        {
+            break; // End of input
+        }
+        cout << endl;
+
+        switch (choice)
+        {
+        case 1:
+        case 2:
+        case 3:
+        {
+            MenuSpan span("follower:view");
+            follower.viewTasks(choice);
+            break;
+        }
+        case 4:
+        {
+            follower.viewStatus();
+            break;
+        }
+        case 5:
+        {
+            string path;
+            cout << "Enter the file to save the snapshot to: ";
+            cin >> path;
+            cout << (follower.saveSnapshot(path) ? "Snapshot saved to " + path + "." : "Unable to write " + path + ".") << endl;
+            break;
+        }
+        case 6:
+            cout << "Thank you for using our system! Have a nice day." << endl;
+            break;
+        default:
+            cout << "Invalid choice. Please enter a number between 1 and 6." << endl;
+            break;
+        }
+        cout << endl;
+    } while (choice != 6);
+    return 0;
+}
+
+// Options given on the command line
+struct CommandLineOptions
+{
+    bool printStats = false; // Print the metrics summary at exit
+    string metricsFile;      // File to write the metrics to at exit (empty for none)
+    string traceFile;        // File to write the trace to at exit (empty for none)
+    string migrateFile;      // Task file to convert to the checksummed format (empty for none)
+    string scrubFile;        // Task file to verify (empty for none)
+    string syncMode;         // "diff", "pull" or "push" to synchronize with syncPeer (empty for none)
+    string syncPeer;         // Other copy of the project: a task file or the socket of a serving process
+    string syncServeSocket;  // Socket to serve the project on for synchronization (empty for none)
+    unsigned scrubThreads = max(1u, thread::hardware_concurrency()); // Threads verifying the file
+    string replicateSocket;  // Socket to ship changes to followers on (empty for no replication)
+    string followSocket;     // Socket of the primary to follow (empty to run normally)
+    string exportFile;       // File to export the tasks to (empty for none)
+    string exportView = "date"; // View giving the order of the exported tasks
+    string exportQuery;      // Search query selecting the exported tasks (empty for every task)
+    string importFile;       // File to import tasks from (empty for none)
+    string fileFormat;       // Format of the exported or imported file (empty to choose by its name)
+    TaskSessionSettings session; // Project opened at startup and settings of the task manager
+    bool runWorkload = false;    // Run a workload instead of the menu
+    WorkloadSettings workload;   // Settings of the workload
+};
+
+// Function to read the value of an option given as "--name value" or "--name=value"; returns false if argv[i] is a different option
+bool readOptionValue(int argc, char *argv[], int &i, const char *name, string &value)
+{
+    size_t length = strlen(name);
+    if (strncmp(argv[i], name, length) != 0)
+    {
+        return false;
+    }
+    if (argv[i][length] == '=')
+    {
+        value = argv[i] + length + 1;
+        return true;
+    }
+    if (argv[i][length] == '\0' && i + 1 < argc)
+    {
+        value = argv[++i];
+        return true;
+    }
+    return false;
+}
+
+// Function to parse the workload options; returns false if argv[i] is not a workload option
+bool parseWorkloadOption(int argc, char *argv[], int &i, CommandLineOptions &options)
+{
+    WorkloadSettings &workload = options.workload;
+    string value;
+    try
+    {
+        if (readOptionValue(argc, argv, i, "--workload-ops", value))
+        {
+            workload.operations = stoi(value);
+        }
+        else if (readOptionValue(argc, argv, i, "--workload-dataset", value))
+        {
+            workload.datasetSize = stoi(value);
+        }
+        else if (readOptionValue(argc, argv, i, "--workload-mix", value))
+        {
+            workload.mix = value; // Checked when the workload starts
+        }
+        else if (readOptionValue(argc, argv, i, "--workload-rate", value))
+        {
+            workload.rate = stod(value);
+        }
+        else if (readOptionValue(argc, argv, i, "--workload-seed", value))
+        {
+            workload.seed = unsigned(stoul(value));
+        }
+        else if (readOptionValue(argc, argv, i, "--workload-save", value))
+        {
+            workload.recordFile = value;
+        }
+        else if (readOptionValue(argc, argv, i, "--workload-replay", value))
+        {
+            workload.replayFile = value;
+        }
+        else if (readOptionValue(argc, argv, i, "--workload-dir", value))
+        {
+            workload.directory = value;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    catch (const exception &ex)
+    {
+        cerr << "Invalid value for " << argv[i] << ": " << ex.what() << endl;
+    }
+    options.runWorkload = true;
+    return true;
+}
+
+// Function to parse the command line options
+CommandLineOptions parseCommandLine(int argc, char *argv[])
+{
+    CommandLineOptions options;
+
+    // The environment variable enables tracing unless --trace overrides it
+    const char *traceEnv = getenv("TASKMANAGER_TRACE");
+    if (traceEnv != nullptr)
+    {
+        options.traceFile = traceEnv;
+    }
+
+    string value;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--stats") == 0)
+        {
+            options.printStats = true;
+        }
+        else if (strcmp(argv[i], "--verify-statistics") == 0)
+        {
+            options.session.verifyStatistics = true;
+            options.workload.verifyStatistics = true;
+        }
+        else if (strcmp(argv[i], "--metrics-file") == 0 && i + 1 < argc)
+        {
+            options.metricsFile = argv[++i];
+        }
+        else if (strncmp(argv[i], "--metrics-file=", 15) == 0)
+        {
+            options.metricsFile = argv[i] + 15;
+        }
+        else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+        {
+            options.traceFile = argv[++i];
+        }
+        else if (strncmp(argv[i], "--trace=", 8) == 0)
+        {
+            options.traceFile = argv[i] + 8;
+        }
+        else if (strcmp(argv[i], "--migrate") == 0 && i + 1 < argc)
+        {
+            options.migrateFile = argv[++i];
+        }
+        else if (strncmp(argv[i], "--migrate=", 10) == 0)
+        {
+            options.migrateFile = argv[i] + 10;
+        }
+        else if (readOptionValue(argc, argv, i, "--scrub-threads", value))
+        {
+            options.scrubThreads = unsigned(max(1, atoi(value.c_str())));
+        }
+        else if (readOptionValue(argc, argv, i, "--scrub", value))
+        {
+            options.scrubFile = value;
+        }
+        else if (readOptionValue(argc, argv, i, "--sync-diff", value))
+        {
+            options.syncMode = "diff";
+            options.syncPeer = value;
+        }
+        else if (readOptionValue(argc, argv, i, "--sync-pull", value))
+        {
+            options.syncMode = "pull";
+            options.syncPeer = value;
+        }
+        else if (readOptionValue(argc, argv, i, "--sync-push", value))
+        {
+            options.syncMode = "push";
+            options.syncPeer = value;
+        }
+        else if (readOptionValue(argc, argv, i, "--sync-serve", value))
+        {
+            options.syncServeSocket = value;
+        }
+        else if (readOptionValue(argc, argv, i, "--project", value))
+        {
+            options.session.projectFile = value;
+        }
+        else if (readOptionValue(argc, argv, i, "--replicate", value))
+        {
+            options.replicateSocket = value;
+        }
+        else if (readOptionValue(argc, argv, i, "--follow", value))
+        {
+            options.followSocket = value;
+        }
+        else if (readOptionValue(argc, argv, i, "--export-view", value))
+        {
+            options.exportView = value;
+        }
+        else if (readOptionValue(argc, argv, i, "--export-query", value))
+        {
+            options.exportQuery = value;
+        }
+        else if (readOptionValue(argc, argv, i, "--export", value))
+        {
+            options.exportFile = value;
+        }
+        else if (readOptionValue(argc, argv, i, "--import", value))
+        {
+            options.importFile = value;
+        }
+        else if (readOptionValue(argc, argv, i, "--format", value))
+        {
+            options.fileFormat = value;
+        }
+        else if (readOptionValue(argc, argv, i, "--project-cache-mb", value))
+        {
+            options.session.projectCacheBytes = size_t(atol(value.c_str())) * 1024 * 1024;
+        }
+        else if (readOptionValue(argc, argv, i, "--page-size", value))
+        {
+            options.session.pageSize = size_t(atol(value.c_str()));
+        }
+        else if (readOptionValue(argc, argv, i, "--lazy-descriptions", value))
+        {
+            options.session.lazyDescriptions = options.workload.lazyDescriptions = true;
+            options.session.descriptionCacheBytes = options.workload.descriptionCacheBytes = size_t(atol(value.c_str())) * 1024;
+        }
+        else if (readOptionValue(argc, argv, i, "--due-days", value))
+        {
+            size_t comma = value.find(',');
+            options.session.dueTodayDays = atoi(value.c_str());
+            if (comma != string::npos)
+            {
+                options.session.dueThisWeekDays = atoi(value.c_str() + comma + 1);
+            }
+        }
+        else if (!parseWorkloadOption(argc, argv, i, options))
+        {
+            cerr << "Unknown option: " << argv[i] << endl;
+        }
+    }
+    return options;
+}
+
+// Function to report the collected metrics and write the trace before the program exits
+void reportMetrics(const CommandLineOptions &options)
+{
+    TaskTools::reportDiagnostics(options.printStats, options.metricsFile);
+}
+
+// Function to run the --import and --export options (the import first, so a file can be imported and exported again in one run)
+int runExchange(TaskSession &session, const CommandLineOptions &options)
+{
+    bool ok = true;
+    try
+    {
+        if (!options.importFile.empty())
+        {
+            ok = session.importTasks(options.importFile, options.fileFormat) && ok;
+        }
+        if (!options.exportFile.empty())
+        {
+            ok = session.exportTasks(options.exportFile, options.fileFormat, options.exportView, options.exportQuery) && ok;
+        }
+    }
+    catch (const exception &ex)
+    {
+        cerr << "Error: " << ex.what() << endl;
+        ok = false;
+    }
+    reportMetrics(options);
+    return ok ? 0 : 1;
+}
+
 // Main function
-int main()
+int main(int argc, char *argv[])
 {
-    // Create an instance of the TaskManager class
-    TaskManager taskManager;
+    // Read the command line options, enable metrics collection only when they will be reported,
+    // and start recording trace spans if a trace file was requested
+    CommandLineOptions options = parseCommandLine(argc, argv);
+    TaskTools::startDiagnostics(options.printStats || !options.metricsFile.empty(), options.traceFile);
+
+    // Run a workload instead of the menu if requested (it uses a task manager of its own in a scratch directory)
+    if (options.runWorkload)
+    {
+        bool completed = TaskTools::runWorkload(options.workload);
+        reportMetrics(options);
+        return completed ? 0 : 1;
+    }
+
+    // Verify a task file instead of starting the menu if requested (it does not need a task manager)
+    if (!options.scrubFile.empty())
+    {
+        int status = TaskTools::scrub(options.scrubFile, options.scrubThreads);
+        reportMetrics(options);
+        return status;
+    }
+
+    // Run as a read-only follower of another process if requested
+    if (!options.followSocket.empty())
+    {
+        int status = runFollower(options.followSocket);
+        reportMetrics(options);
+        return status;
+    }
+
+    // Create the task manager, with the settings given on the command line
+    TaskSession taskManager(options.session);
     int choice;
 
+    // Ship the changes of the opened project to followers if requested
+    if (!options.replicateSocket.empty() && !taskManager.startReplication(options.replicateSocket))
+    {
+        return 1;
+    }
+
+    // Convert a task file in an older format instead of starting the menu if requested
+    if (!options.migrateFile.empty())
+    {
+        bool migrated = taskManager.migrateTaskFile(options.migrateFile);
+        reportMetrics(options);
+        return migrated ? 0 : 1;
+    }
+
+    // Compare or synchronize the project with another copy of it, or serve it to other processes doing so, if requested
+    if (!options.syncMode.empty())
+    {
+        int status = taskManager.sync(options.syncMode, options.syncPeer);
+        reportMetrics(options);
+        return status;
+    }
+    if (!options.syncServeSocket.empty())
+    {
+        bool served = taskManager.serveSync(options.syncServeSocket);
+        reportMetrics(options);
+        return served ? 0 : 1;
+    }
+
+    // Export or import tasks instead of starting the menu if requested
+    if (!options.exportFile.empty() || !options.importFile.empty())
+    {
+        return runExchange(taskManager, options);
+    }
+
     // Display welcome message
     cout << "Welcome To The Task Management System" << endl
+         << "Current project: " << taskManager.currentProject() << endl
          << endl;
 
     // Main program loop
@@ -61,12 +542,14 @@ int main()
             {
             case 1:
             {
+                MenuSpan span("menu:create");
                 // Create a new task
                 taskManager.createTask();
                 break;
             }
             case 2:
             {
+                MenuSpan span("menu:view");
                 int viewChoice;
                 // Print view options
                 printViewOptions();
@@ -74,19 +557,47 @@ int main()
                 cin >> viewChoice;
 
                 // Validate view choice input
-                if (viewChoice < 1 || viewChoice > 3)
+                if (viewChoice < 1 || viewChoice > 7)
                 {
-                    throw invalid_argument("Invalid view option. Please enter a number between 1 and 3.\n");
+                    throw invalid_argument("Invalid view option. Please enter a number between 1 and 7.\n");
                 }
 
                 cout << endl;
-                // View tasks based on user choice
-                taskManager.viewTask(viewChoice);
+                // View tasks based on user choice (only the changes for option 4, the reminders for option 5, the agenda for option 6, the statistics for option 7)
+                if (viewChoice == 4)
+                {
+                    taskManager.viewChanges();
+                }
+                else if (viewChoice == 5)
+                {
+                    taskManager.viewDueTasks();
+                }
+                else if (viewChoice == 6)
+                {
+                    int days;
+                    cout << "Show the occurrences of how many days ahead? ";
+                    cin >> days;
+                    if (days < 0)
+                    {
+                        throw invalid_argument("Invalid number of days. Please enter zero or a positive integer.\n");
+                    }
+                    cout << endl;
+                    taskManager.viewAgenda(days);
+                }
+                else if (viewChoice == 7)
+                {
+                    taskManager.viewStatistics();
+                }
+                else
+                {
+                    taskManager.viewTask(viewChoice);
+                }
 
                 break;
             }
             case 3:
             {
+                MenuSpan span("menu:edit");
                 int taskId;
                 // Prompt user for task ID to update
                 cout << "Enter the task ID you want to update: ";
@@ -104,6 +615,7 @@ int main()
             }
             case 4:
             {
+                MenuSpan span("menu:delete");
                 int taskIdToDelete;
                 // Prompt user for task ID to delete
                 cout << "Enter the task ID you want to delete: ";
@@ -116,10 +628,163 @@ int main()
                 }
 
                 // Delete task by ID
-                taskManager.deleteTask("project.txt", taskIdToDelete);
+                taskManager.deleteTask(taskIdToDelete);
                 break;
             }
             case 5:
+            {
+                MenuSpan span("menu:search");
+                string query;
+                // Prompt user for the words to search for
+                cout << "Enter search terms (use \"double quotes\" for phrases): ";
+                getline(cin >> ws, query);
+                cout << endl;
+
+                // Display the matching tasks, best match first
+                taskManager.searchTasks(query);
+                break;
+            }
+            case 6:
+            {
+                MenuSpan span("menu:dependencies");
+                int dependencyChoice;
+                // Print dependency options
+                printDependencyOptions();
+                // Get dependency choice
+                cin >> dependencyChoice;
+                cout << endl;
+
+                // Run the chosen dependency option
+                switch (dependencyChoice)
+                {
+                case 1:
+                    taskManager.viewReadyTasks();
+                    break;
+                case 2:
+                    taskManager.viewCriticalPath();
+                    break;
+                case 3:
+                    taskManager.checkDependencyCycles();
+                    break;
+                case 4:
+                {
+                    int taskId;
+                    // Prompt user for the task ID whose dependencies change
+                    cout << "Enter the task ID whose dependencies you want to edit: ";
+                    cin >> taskId;
+
+                    // Validate task ID input
+                    if (taskId < 0)
+                    {
+                        throw invalid_argument("Invalid task ID. Please enter a positive integer.\n");
+                    }
+
+                    taskManager.editTaskDependencies(taskId);
+                    break;
+                }
+                default:
+                    throw invalid_argument("Invalid dependency option. Please enter a number between 1 and 4.\n");
+                }
+                break;
+            }
+            case 7:
+            {
+                MenuSpan span("menu:next");
+                // Claim the highest priority task that is ready to be worked on
+                taskManager.claimNextTask();
+                break;
+            }
+            case 8:
+            {
+                MenuSpan span("menu:archive");
+                int archiveChoice;
+                // Print archive options
+                printArchiveOptions();
+                // Get archive choice
+                cin >> archiveChoice;
+
+                // Run the chosen archive option
+                switch (archiveChoice)
+                {
+                case 1:
+                {
+                    int days;
+                    cout << "Archive completed tasks whose deadline passed more than how many days ago? ";
+                    cin >> days;
+                    if (days < 0)
+                    {
+                        throw invalid_argument("Invalid number of days. Please enter zero or a positive integer.\n");
+                    }
+                    cout << endl;
+                    taskManager.archiveCompletedTasks(days);
+                    break;
+                }
+                case 2:
+                {
+                    int taskId;
+                    cout << "Enter the ID of the archived task: ";
+                    cin >> taskId;
+                    cout << endl;
+                    taskManager.findArchivedTask(taskId);
+                    break;
+                }
+                case 3:
+                {
+                    string fromDate;
+                    string toDate;
+                    cout << "Enter the start date (DD/MM/YYYY): ";
+                    cin >> fromDate;
+                    cout << "Enter the end date (DD/MM/YYYY): ";
+                    cin >> toDate;
+                    cout << endl;
+                    taskManager.findArchivedTasksByDate(fromDate, toDate);
+                    break;
+                }
+                default:
+                    throw invalid_argument("Invalid archive option. Please enter a number between 1 and 3.\n");
+                }
+                break;
+            }
+            case 9:
+            {
+                MenuSpan span("menu:projects");
+                int projectChoice;
+                // Print project options
+                printProjectOptions();
+                // Get project choice
+                cin >> projectChoice;
+
+                // Run the chosen project option
+                switch (projectChoice)
+                {
+                case 1:
+                {
+                    string projectFile;
+                    cout << "Enter the task file of the project (e.g. project.txt): ";
+                    cin >> projectFile;
+                    cout << endl;
+                    taskManager.openProject(projectFile);
+                    cout << "Current project: " << taskManager.currentProject() << endl;
+                    break;
+                }
+                case 2:
+                {
+                    cout << endl;
+                    taskManager.listProjects();
+                    break;
+                }
+                case 3:
+                {
+                    cout << endl;
+                    taskManager.viewReplicationStatus();
+                    break;
+                }
+                default:
+                    throw invalid_argument("Invalid project option. Please enter a number between 1 and 3.\n");
+                }
+                break;
+            }
+            case 10:
             {
                 // Exit the program
                 cout << "Thank you for using our system! Have a nice day." << endl;
@@ -127,9 +792,10 @@ int main()
             }
             default:
                 // Handle invalid choice
-                cout << "Invalid choice. Please enter a number between 1 and 5." << endl;
+                cout << "Invalid choice. Please enter a number between 1 and 10." << endl;
                 break;
             }
+            taskManager.checkStatistics(); // Only recounts with --verify-statistics
             cout << endl;
         }
         catch (const exception &ex)
@@ -139,7 +805,16 @@ int main()
             cin.clear();  // Clear error flags
             cin.ignore(); // Discard invalid input
         }
-    } while (choice != 5); // Continue loop until user chooses to exit
+    } while (choice != 10); // Continue loop until user chooses to exit
+
+    // Make sure every change has reached the task file before exiting
+    if (!taskManager.flushWrites())
+    {
+        cerr << "Some changes could not be saved to the task file." << endl;
+    }
+
+    // Print or write the metrics and the trace if they were requested
+    reportMetrics(options);
 
     return 0; // Exit program
 }
\ No newline at end of file
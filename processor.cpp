@@ -1,9 +1,17 @@
 // This program defines a Task class to manage tasks, including their details like ID, title, description, deadline, priority, status, category, and label.
 // It allows users to input task details and display task information.
 
+#ifndef TASK_PROCESSOR_CPP
+#define TASK_PROCESSOR_CPP
+
 #include <iostream>
 #include <string>    // String manipulation functions like getline() and substr()
 #include <algorithm> // Transformations such as converting strings to lowercase
+#include <vector>    // List of the IDs of the tasks a task depends on
+#include <limits>    // numeric_limits for skipping the rest of an input line
+#include <utility>   // move() for taking over strings instead of copying them
+#include "recurrence.cpp" // How repeating tasks repeat
+#include "cold_fields.cpp" // Descriptions left in the task file by a lazy load
 
 using namespace std;
 
@@ -31,21 +39,25 @@ enum class TaskPriority
 class Task
 {
 private:
-    int taskID;            // Unique identifier for the task
-    string title;          // Title of the task
-    string description;    // Description of the task
-    string deadline;       // Deadline for the task
-    TaskPriority priority; // Priority of the task (LOW, MEDIUM, HIGH)
-    TaskStatus status;     // Status of the task (PENDING, IN_PROGRESS, COMPLETED)
-    string category;       // Category of the task (Personal, Work, etc)
-    string label;          // Label of the task
+    int taskID;               // Unique identifier for the task
+    string title;             // Title of the task
+    string description;       // Description of the task
+    string deadline;          // Deadline for the task
+    TaskPriority priority;    // Priority of the task (LOW, MEDIUM, HIGH)
+    TaskStatus status;        // Status of the task (PENDING, IN_PROGRESS, COMPLETED)
+    string category;          // Category of the task (Personal, Work, etc)
+    string label;             // Label of the task
+    vector<int> dependencies; // IDs of the tasks that must be completed before this one can start
+    RecurrenceRule recurrence; // How the task repeats, with the deadline as its first occurrence (does not repeat by default)
+    ColdFieldRef coldDescription; // Where the description is in the task file when a lazy load left it there (description is then empty)
 
 public:
-    // Constructor to initialize task properties
+    // Constructor to initialize task properties; the strings are moved into the task rather than copied
     Task(int id, string t, string desc, string dl, TaskPriority prio, TaskStatus stat, string l, string c)
-        : taskID(id), title(t), description(desc), deadline(dl), priority(prio), status(stat), category(c), label(l) {}
+        : taskID(id), title(move(t)), description(move(desc)), deadline(move(dl)), priority(prio), status(stat), category(move(c)), label(move(l)) {}
 
-    Task() {}
+    // Default constructor; the priority and status start as Low and Pending until they are set
+    Task() : taskID(0), priority(TaskPriority::LOW), status(TaskStatus::PENDING) {}
 
     // Setters
 
@@ -112,107 +124,248 @@ public:
     // Setter for category
     void setCategory(string c)
     {
-        category = c;
+        category = move(c);
     }
 
     // Setter for label
     void setLabel(string l)
     {
-        label = l;
+        label = move(l);
     }
 
     // Getters
+    // The string getters return references to the stored strings, so reading a field never allocates.
 
     // Getter for Task ID
-    int getTaskID()
+    int getTaskID() const
     {
         return taskID;
     }
 
     // Getter for Task Title
-    string getTitle()
+    const string &getTitle() const
     {
         return title;
     }
 
-    // Getter for Task Description
-    string getDescription()
+    // Getter for Task Description held in memory. Only a lazily loaded project has tasks whose description was left in the task file
+    // (see isDescriptionCold()); they have none in memory, so code that can see such tasks calls loadDescription() instead
+    const string &getDescription() const
     {
         return description;
     }
 
+    // The full description, read back from the task file if a lazy load left it there
+    string loadDescription() const
+    {
+        if (!coldDescription.isCold())
+        {
+            return description;
+        }
+        string text;
+        coldDescription.load(text);
+        return text;
+    }
+
+    // Check whether the description was left in the task file by a lazy load
+    bool isDescriptionCold() const
+    {
+        return coldDescription.isCold();
+    }
+
+    // Leave the description in the task file, keeping only where it is; the text in memory is released
+    void setColdDescription(ColdFieldRef where)
+    {
+        coldDescription = move(where);
+        string().swap(description);
+    }
+
+    // Check whether two tasks have the same description, without reading either back if both refer to the same record
+    bool hasSameDescription(const Task &other) const
+    {
+        if (coldDescription.isCold() && coldDescription.sameAs(other.coldDescription))
+        {
+            return true;
+        }
+        if (!coldDescription.isCold() && !other.coldDescription.isCold())
+        {
+            return description == other.description;
+        }
+        return loadDescription() == other.loadDescription();
+    }
+
+    // Bytes of text the task holds in memory (a description left in the task file counts as nothing)
+    size_t textCapacity() const
+    {
+        return title.capacity() + description.capacity() + deadline.capacity() + category.capacity() + label.capacity();
+    }
+
     // Getter for Task Deadline
-    string getDeadline()
+    const string &getDeadline() const
     {
         return deadline;
     }
 
     // Convert TaskPriority enum to string
-    string getPriority()
+    const string &getPriority() const
     {
         return taskPriorityToString(priority);
     }
 
+    // Getter for the TaskPriority enum itself
+    TaskPriority getPriorityValue() const
+    {
+        return priority;
+    }
+
     // Convert TaskStatus enum to string
-    string getStatus()
+    const string &getStatus() const
     {
         return taskStatusToString(status);
     }
 
+    // Getter for the TaskStatus enum itself
+    TaskStatus getStatusValue() const
+    {
+        return status;
+    }
+
+    // Check whether the task has been completed
+    bool isCompleted() const
+    {
+        return status == TaskStatus::COMPLETED;
+    }
+
     // Getter for Task Category
-    string getCategory()
+    const string &getCategory() const
     {
         return category;
     }
 
     // Getter for Task Label
-    string getLabel()
+    const string &getLabel() const
     {
         return label;
     }
 
+    // Getter for the IDs of the tasks this task depends on
+    const vector<int> &getDependencies() const
+    {
+        return dependencies;
+    }
+
+    // Setter for the IDs of the tasks this task depends on
+    void setDependencies(const vector<int> &ids)
+    {
+        for (int id : ids)
+        {
+            if (id == taskID)
+            {
+                throw invalid_argument("A task cannot depend on itself!");
+            }
+        }
+        dependencies = ids;
+    }
+
+    // Check whether the task repeats
+    bool isRecurring() const
+    {
+        return recurrence.repeats();
+    }
+
+    // Getter for the recurrence rule of the task
+    const RecurrenceRule &getRecurrence() const
+    {
+        return recurrence;
+    }
+
+    // Setter for the recurrence rule of the task
+    void setRecurrence(RecurrenceRule rule)
+    {
+        recurrence = move(rule);
+    }
+
+    // Mark one occurrence of a repeating task (given by its day number) as completed or not completed
+    void setOccurrenceCompleted(int day, bool completed)
+    {
+        recurrence.setCompleted(day, completed);
+    }
+
+    // Convert a list of task IDs separated by commas, semicolons or spaces (e.g. "3, 5 9") into a vector
+    static vector<int> parseIdList(const string &text)
+    {
+        vector<int> ids;
+        string current;
+        for (size_t i = 0; i <= text.size(); i++)
+        {
+            char c = i < text.size() ? text[i] : ' ';
+            if (isdigit((unsigned char)c))
+            {
+                current += c;
+            }
+            else if (c == ',' || c == ';' || isspace((unsigned char)c))
+            {
+                if (!current.empty())
+                {
+                    ids.push_back(stoi(current));
+                    current.clear();
+                }
+            }
+            else
+            {
+                throw invalid_argument("Task IDs must be positive integers separated by commas!");
+            }
+        }
+        return ids;
+    }
+
     // The TaskManager class is a friend of the Task class to allow TaskManager to access private members of Task directly.
     // This friendship enables TaskManager to perform operations on Task objects without violating encapsulation.
     friend class TaskManager;
 
+    // TaskSchema (task_schema.cpp) describes where each field of a stored record lives in the Task object.
+    friend struct TaskSchema;
+
     // Task Priority and Status Conversion functions convert TaskPriority and TaskStatus enums to their corresponding string representations.
     // They are needed to facilitate input/output operations and ensure consistency in displaying task details.
     // By centralizing the conversion logic in these functions, the code becomes more modular and easier to maintain.
 
-    // Convert TaskPriority enum to string
-    string taskPriorityToString(TaskPriority priority)
+    // Convert TaskPriority enum to string (the names are created once and shared)
+    static const string &taskPriorityToString(TaskPriority priority)
     {
+        static const string names[] = {"Low", "Medium", "High", "Unknown"};
         switch (priority)
         {
         case TaskPriority::LOW:
-            return "Low";
+            return names[0];
         case TaskPriority::MEDIUM:
-            return "Medium";
+            return names[1];
         case TaskPriority::HIGH:
-            return "High";
+            return names[2];
         default:
-            return "Unknown";
+            return names[3];
         }
     }
 
-    // Convert TaskStatus enum to string
-    string taskStatusToString(TaskStatus status)
+    // Convert TaskStatus enum to string (the names are created once and shared)
+    static const string &taskStatusToString(TaskStatus status)
     {
+        static const string names[] = {"Pending", "In Progress", "Completed", "Unknown"};
         switch (status)
         {
         case TaskStatus::PENDING:
-            return "Pending";
+            return names[0];
         case TaskStatus::IN_PROGRESS:
-            return "In Progress";
+            return names[1];
         case TaskStatus::COMPLETED:
-            return "Completed";
+            return names[2];
         default:
-            return "Unknown";
+            return names[3];
         }
     }
 
     // Display task details
-    void getTaskDetails()
+    void getTaskDetails() const
     {
         cout << "Category: " << category << endl;
         cout << "Label: " << label << endl;
@@ -220,17 +373,34 @@ public:
         cout << endl;
         cout << "Task ID: " << taskID << endl;
         cout << "Title: " << title << endl;
-        cout << "Description: " << description << endl;
+        cout << "Description: " << loadDescription() << endl;
         cout << "Deadline: " << deadline << endl;
         cout << "Priority: " << taskPriorityToString(priority) << endl;
         cout << "Status: " << taskStatusToString(status) << endl;
+
+        // Only show dependencies for tasks that have them
+        if (!dependencies.empty())
+        {
+            cout << "Depends On: ";
+            for (size_t i = 0; i < dependencies.size(); i++)
+            {
+                cout << (i ? ", " : "") << dependencies[i];
+            }
+            cout << endl;
+        }
+
+        // Only show the rule of repeating tasks
+        if (recurrence.repeats())
+        {
+            cout << "Repeats: " << recurrence.describe() << " (" << recurrence.completedDays.size() << " occurrence(s) completed)" << endl;
+        }
     }
 
     friend istream &operator>>(istream &is, Task &task); // Allow input operator overload to access private members of Task
 };
 
 // Overloading >> operator to input Task objects from the standard input stream
-istream &operator>>(istream &is, Task &task)
+inline istream &operator>>(istream &is, Task &task)
 {
     try
     {
@@ -246,8 +416,8 @@ istream &operator>>(istream &is, Task &task)
 
         // Prompt the user to enter the task ID
         cout << endl;
-        cout << "Enter the Task ID: ";
-        // Read and store the task ID
+        cout << "Enter the Task ID (0 to assign one automatically): ";
+        // Read and store the task ID (0 is replaced by the next free ID when the task is created)
         is >> task.taskID;
 
         // Validate the task ID
@@ -268,6 +438,7 @@ istream &operator>>(istream &is, Task &task)
         cout << "Enter Description: ";
         // Read and store the task description
         getline(is, task.description);
+        task.coldDescription = ColdFieldRef();
 
         // Validate the task deadline
         bool validDate = false;
@@ -377,6 +548,44 @@ istream &operator>>(istream &is, Task &task)
         {
             task.status = TaskStatus::COMPLETED;
         }
+
+        // Prompt the user for the tasks this task depends on
+        validInput = false; // Resetting the flag for dependency input validation
+        while (!validInput)
+        {
+            cout << "Enter the IDs of the tasks this task depends on (comma separated, leave empty for none): ";
+            string dependenciesStr;
+            getline(is, dependenciesStr);
+
+            try
+            {
+                task.setDependencies(Task::parseIdList(dependenciesStr));
+                validInput = true;
+            }
+            catch (const invalid_argument &ex)
+            {
+                cout << "Invalid input! " << ex.what() << endl;
+            }
+        }
+
+        // Prompt the user for how the task repeats; the deadline is the first occurrence
+        validInput = false; // Resetting the flag for recurrence input validation
+        while (!validInput)
+        {
+            cout << "Repeat (daily, weekly, monthly, or a rule such as FREQ=WEEKLY;BYDAY=MO,WE;UNTIL=31/12/2026; leave empty for none): ";
+            string recurrenceStr;
+            getline(is, recurrenceStr);
+
+            try
+            {
+                task.setRecurrence(RecurrenceRule::parse(recurrenceStr));
+                validInput = true;
+            }
+            catch (const invalid_argument &ex)
+            {
+                cout << "Invalid input! " << ex.what() << endl;
+            }
+        }
     }
     catch (const exception &ex)
     {
@@ -386,4 +595,6 @@ istream &operator>>(istream &is, Task &task)
     } // End of catch block: Handles any exceptions that occur during input processing
 
     return is;
-}
\ No newline at end of file
+}
+
+#endif
@@ -0,0 +1,212 @@
+// This file implements the projects of the TaskManager and the cache that keeps recently used projects loaded.
+// A project is one task file together with everything the TaskManager builds from it: the loaded tasks, the dependency graph,
+// the dispatcher, the materialized views, the statistics, the sync tree, the search index, the archive, the change feed and the ID allocator. Each team can keep its tasks in its own file and switch between them.
+// Loaded projects stay in memory so that switching back to a project is instant. The cache keeps them in least recently used order
+// and, when the memory they use grows past a budget, unloads the projects that were used longest ago (their files are kept up to date
+// on every change, so nothing is lost; the project is simply read again the next time it is opened).
+// The project in use is never unloaded, even if it alone is larger than the budget.
+
+#ifndef TASK_PROJECT_CACHE_CPP
+#define TASK_PROJECT_CACHE_CPP
+
+#include <string>
+#include <vector>
+#include <list>          // Projects in least recently used order
+#include <unordered_map> // Finds a cached project by its file name
+#include <memory>        // unique_ptr keeps each project at a fixed address
+#include "processor.cpp"
+#include "record_format.cpp"    // TaskFileFormat
+#include "dependency_graph.cpp" // Dependencies between the tasks of a project
+#include "task_dispatcher.cpp"  // Ready tasks of a project, best first
+#include "search_index.cpp"     // Full-text index of a project
+#include "task_archive.cpp"     // Archived tasks of a project
+#include "change_feed.cpp"      // Changes of a project for subscribers
+#include "task_views.cpp"       // Tasks kept in the orders of the views
+#include "id_allocator.cpp"     // Task IDs handed out to new tasks
+#include "task_statistics.cpp"  // Counters of the tasks
+#include "sync_tree.cpp"        // Hashes of the ID ranges of the tasks
+#include "metrics.cpp"          // Cache hits, misses and evictions
+
+using namespace std;
+
+// Everything the TaskManager keeps in memory for one task file
+struct Project
+{
+    string taskFile;            // File holding the tasks of the project (also the name of the project)
+    vector<Task> tasks;         // Tasks of the project
+    bool tasksLoaded = false;   // Whether tasks holds the contents of taskFile
+    unordered_map<int, size_t> positions; // Index of every task in tasks by its ID
+    vector<unique_ptr<TaskView>> views;   // Materialized views of the tasks, one for each view definition of the TaskManager
+    TaskStatistics statistics;            // Counters of the tasks by category, status, priority and deadline
+    SyncTree syncTree;                    // Hashes of the ID ranges of the tasks, built when the project is first synchronized
+    TaskFileFormat loadedFormat = TaskFileFormat::EMPTY; // Format of taskFile, including the writes still queued for it
+
+    DependencyGraph dependencyGraph; // Dependencies between the tasks
+    TaskDispatcher dispatcher;       // Pending tasks that are ready to be worked on, best first
+
+    SearchIndex searchIndex;        // Full-text index over the titles and descriptions
+    bool searchIndexLoaded = false; // Whether searchIndex has been loaded or built yet
+
+    TaskArchive archive;        // Old completed tasks moved out of the task file
+    bool archiveLoaded = false; // Whether the block headers of the archive have been read yet
+
+    ChangeFeed changeFeed; // Recent changes to the tasks, for clients that only want deltas
+    IdAllocator idAllocator; // Hands out IDs never used by the project before
+    bool pinned = false;   // Never unloaded (for example while it is being replicated)
+
+    explicit Project(const string &file) : taskFile(file) {}
+
+    // File the search index is saved to
+    string indexFile() const
+    {
+        return taskFile + ".idx";
+    }
+
+    // File the archived tasks are stored in
+    string archiveFile() const
+    {
+        return taskFile + ".archive";
+    }
+
+    // File the high-water mark of the ID allocator is saved to
+    string idFile() const
+    {
+        return taskFile + ".ids";
+    }
+
+    // Recompute the positions of the tasks from a given index onwards (after tasks were removed or replaced)
+    void reindex(size_t from = 0)
+    {
+        if (from == 0)
+        {
+            positions.clear();
+        }
+        for (size_t i = from; i < tasks.size(); i++)
+        {
+            positions[tasks[i].getTaskID()] = i;
+        }
+    }
+
+    // Approximate number of bytes of memory used by the project
+    size_t memoryUsage() const
+    {
+        // Every task also has an entry in the dependency graph and possibly in the dispatcher
+        static const size_t graphBytesPerTask = 128;
+
+        size_t bytes = sizeof(*this) + taskFile.capacity();
+        for (const Task &task : tasks)
+        {
+            bytes += sizeof(Task) + graphBytesPerTask + task.textCapacity() + task.getDependencies().capacity() * sizeof(int) +
+                     task.getRecurrence().completedDays.capacity() * sizeof(int);
+        }
+        if (searchIndexLoaded)
+        {
+            bytes += searchIndex.memoryUsage();
+        }
+        bytes += archive.blockCount() * sizeof(ArchiveBlock);
+        bytes += changeFeed.memoryUsage();
+        bytes += positions.size() * (sizeof(pair<int, size_t>) + 2 * sizeof(void *));
+        for (const auto &view : views)
+        {
+            bytes += view->memoryUsage();
+        }
+        bytes += statistics.memoryUsage();
+        bytes += syncTree.memoryUsage();
+        return bytes;
+    }
+};
+
+// The ProjectCache class keeps the loaded projects in least recently used order within a memory budget.
+class ProjectCache
+{
+public:
+    static const size_t defaultBudget = 64 * 1024 * 1024; // Default memory budget in bytes
+
+    explicit ProjectCache(size_t budgetBytes = defaultBudget) : budget(budgetBytes) {}
+
+    // Get the project of a task file and mark it as the most recently used one.
+    // A project that is not cached yet is added without loading anything; its tasks are read when first needed.
+    Project &get(const string &taskFile)
+    {
+        auto it = byFile.find(taskFile);
+        if (it != byFile.end())
+        {
+            // Move the project to the front without copying it
+            order.splice(order.begin(), order, it->second);
+            if (order.front()->tasksLoaded)
+            {
+                Metrics::instance().add(MetricCounter::PROJECT_CACHE_HITS);
+            }
+            return *order.front();
+        }
+
+        Metrics::instance().add(MetricCounter::PROJECT_CACHE_MISSES);
+        order.push_front(make_unique<Project>(taskFile));
+        byFile[taskFile] = order.begin();
+        return *order.front();
+    }
+
+    // Unload the least recently used projects until the cached projects fit in the budget.
+    // The most recently used project and pinned projects are always kept. beforeEvict(project) is called for every project just before it is removed,
+    // so its unsaved state (such as the search index) can be written out.
+    template <typename BeforeEvict>
+    void enforceBudget(BeforeEvict beforeEvict)
+    {
+        size_t used = memoryUsage();
+        auto it = order.end();
+        while (used > budget && it != next(order.begin()))
+        {
+            --it;
+            Project &coldest = **it;
+            if (coldest.pinned)
+            {
+                continue;
+            }
+            used -= min(used, coldest.memoryUsage());
+            beforeEvict(coldest);
+            byFile.erase(coldest.taskFile);
+            it = order.erase(it);
+            Metrics::instance().add(MetricCounter::PROJECT_EVICTIONS);
+        }
+    }
+
+    // Approximate number of bytes used by all cached projects
+    size_t memoryUsage() const
+    {
+        size_t bytes = 0;
+        for (const auto &project : order)
+        {
+            bytes += project->memoryUsage();
+        }
+        return bytes;
+    }
+
+    // The cached projects, most recently used first
+    vector<Project *> projects() const
+    {
+        vector<Project *> result;
+        for (const auto &project : order)
+        {
+            result.push_back(project.get());
+        }
+        return result;
+    }
+
+    // Change the memory budget (takes effect at the next enforceBudget())
+    void setBudget(size_t budgetBytes)
+    {
+        budget = budgetBytes;
+    }
+
+    size_t getBudget() const
+    {
+        return budget;
+    }
+
+private:
+    size_t budget;                                                   // Memory budget in bytes
+    list<unique_ptr<Project>> order;                                 // Cached projects, most recently used first
+    unordered_map<string, list<unique_ptr<Project>>::iterator> byFile; // Position of every cached project in order
+};
+
+#endif
@@ -0,0 +1,431 @@
+// This file implements the checksums of task file records and the scrubber that verifies them.
+// From version 3 of the task file format every record ends with one more field: the CRC32C of the bytes of the record before that
+// field, as 8 lowercase hexadecimal digits. A record that was torn by a crash or damaged on disk no longer matches its checksum, so
+// the loader can skip it (and find the next intact record) instead of failing on the first field that does not parse.
+// CRC32C is computed with the SSE4.2 crc32 instruction, 8 bytes at a time, on processors that have it, and with a table-driven
+// software version (slicing-by-8) on the others; both give the same result.
+// The TaskFileScrubber checks a whole file without parsing it: the file is mapped into memory, split into one slice per thread,
+// and every thread verifies the records of its slice, so a large file is checked about as fast as it can be read.
+
+#ifndef TASK_RECORD_CHECKSUM_CPP
+#define TASK_RECORD_CHECKSUM_CPP
+
+#include <string>
+#include <vector>
+#include <thread>      // Scrubbing threads
+#include <chrono>      // Timing a scrub
+#include <algorithm>   // max() and min() for the slices of a scrub
+#include <cstdint>
+#include <fcntl.h>     // open()
+#include <unistd.h>    // close()
+#include <sys/stat.h>  // fstat() for the size of the scrubbed file
+#include <sys/mman.h>  // mmap() maps the scrubbed file instead of reading it
+#include "record_format.cpp" // Task file formats and the vectorized delimiter search
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <nmmintrin.h> // SSE4.2 crc32 instructions
+#endif
+
+using namespace std;
+
+// The Crc32c class computes CRC32C (the Castagnoli polynomial used by iSCSI, ext4 and many storage formats).
+class Crc32c
+{
+public:
+    // CRC32C of size bytes; pass the result of an earlier call as crc to continue it over more bytes.
+    // The implementation is chosen once, based on what the processor supports.
+    static uint32_t compute(const char *data, size_t size, uint32_t crc = 0)
+    {
+        static const ComputeFunction function = chooseCompute();
+        return function(data, size, crc);
+    }
+
+    // Name of the implementation chosen by compute() (for diagnostics)
+    static const char *implementationName()
+    {
+#ifdef TASK_SCANNER_X86
+        if (__builtin_cpu_supports("sse4.2"))
+        {
+            return "sse4.2";
+        }
+#endif
+        return "software";
+    }
+
+private:
+    typedef uint32_t (*ComputeFunction)(const char *, size_t, uint32_t);
+
+    // Eight tables of 256 entries: table[k][b] is the CRC of byte b followed by k zero bytes
+    struct Tables
+    {
+        uint32_t table[8][256];
+
+        Tables()
+        {
+            const uint32_t polynomial = 0x82F63B78; // Castagnoli polynomial, bit-reversed
+            for (uint32_t b = 0; b < 256; b++)
+            {
+                uint32_t crc = b;
+                for (int bit = 0; bit < 8; bit++)
+                {
+                    crc = (crc >> 1) ^ ((crc & 1) ? polynomial : 0);
+                }
+                table[0][b] = crc;
+            }
+            for (uint32_t b = 0; b < 256; b++)
+            {
+                for (int k = 1; k < 8; k++)
+                {
+                    table[k][b] = (table[k - 1][b] >> 8) ^ table[0][table[k - 1][b] & 0xFF];
+                }
+            }
+        }
+    };
+
+    // Portable version, 8 bytes at a time with the tables
+    static uint32_t computeSoftware(const char *data, size_t size, uint32_t crc)
+    {
+        static const Tables tables;
+        const uint32_t(&t)[8][256] = tables.table;
+        const unsigned char *p = reinterpret_cast<const unsigned char *>(data);
+        crc = ~crc;
+        for (; size >= 8; size -= 8, p += 8)
+        {
+            uint32_t low = (uint32_t(p[0]) | uint32_t(p[1]) << 8 | uint32_t(p[2]) << 16 | uint32_t(p[3]) << 24) ^ crc;
+            crc = t[7][low & 0xFF] ^ t[6][(low >> 8) & 0xFF] ^ t[5][(low >> 16) & 0xFF] ^ t[4][low >> 24] ^
+                  t[3][p[4]] ^ t[2][p[5]] ^ t[1][p[6]] ^ t[0][p[7]];
+        }
+        for (; size > 0; size--, p++)
+        {
+            crc = (crc >> 8) ^ t[0][(crc ^ *p) & 0xFF];
+        }
+        return ~crc;
+    }
+
+#ifdef TASK_SCANNER_X86
+    // SSE4.2 version, 8 bytes per crc32 instruction
+    __attribute__((target("sse4.2"))) static uint32_t computeSse42(const char *data, size_t size, uint32_t crc)
+    {
+        uint64_t state = ~crc;
+#ifdef __x86_64__
+        for (; size >= 8; size -= 8, data += 8)
+        {
+            uint64_t word;
+            memcpy(&word, data, sizeof(word));
+            state = _mm_crc32_u64(state, word);
+        }
+#endif
+        uint32_t state32 = uint32_t(state);
+        for (; size > 0; size--, data++)
+        {
+            state32 = _mm_crc32_u8(state32, uint8_t(*data));
+        }
+        return ~state32;
+    }
+#endif
+
+    // Pick the fastest implementation the processor supports
+    static ComputeFunction chooseCompute()
+    {
+#ifdef TASK_SCANNER_X86
+        if (__builtin_cpu_supports("sse4.2"))
+        {
+            return computeSse42;
+        }
+#endif
+        return computeSoftware;
+    }
+};
+
+// The RecordChecksum class adds checksums to task file records and checks them.
+class RecordChecksum
+{
+public:
+    static const size_t fieldBytes = 9;               // The comma and 8 hexadecimal digits added to every record
+    static const size_t maxRecordBytes = 16u << 20;   // Longest record looked for when searching for the next intact one
+
+    // Add the checksum field to the record that starts at offset start of out and ends with its line break
+    static void seal(string &out, size_t start)
+    {
+        static const char digits[] = "0123456789abcdef";
+        if (!out.empty() && out.back() == '\n')
+        {
+            out.pop_back();
+        }
+        uint32_t crc = Crc32c::compute(out.data() + start, out.size() - start);
+        out += ',';
+        for (int shift = 28; shift >= 0; shift -= 4)
+        {
+            out += digits[(crc >> shift) & 0xF];
+        }
+        out += '\n';
+    }
+
+    // Check the record at [first, last), where last is just after its line break (or the end of the file)
+    static bool verify(const char *first, const char *last)
+    {
+        while (last > first && (last[-1] == '\n' || last[-1] == '\r'))
+        {
+            last--;
+        }
+        if (size_t(last - first) < fieldBytes || last[-int(fieldBytes)] != ',')
+        {
+            return false;
+        }
+        uint32_t stored = 0;
+        for (const char *p = last - (fieldBytes - 1); p < last; p++)
+        {
+            int digit = hexDigit(*p);
+            if (digit < 0)
+            {
+                return false;
+            }
+            stored = (stored << 4) | uint32_t(digit);
+        }
+        return Crc32c::compute(first, size_t(last - first) - fieldBytes) == stored;
+    }
+
+    // Find the end of the record starting at p (just after its line break), honouring quoted fields; returns limit if the record
+    // does not end before it
+    static const char *recordEnd(const char *p, const char *limit)
+    {
+        while (p < limit)
+        {
+            const char *found = FieldScanner::findAny(p, limit, '"', '\n', '"', '\n');
+            if (found == limit)
+            {
+                return limit;
+            }
+            if (*found == '\n')
+            {
+                return found + 1;
+            }
+
+            // Quoted text: line breaks inside it belong to the field; a doubled quote is two quotes in a row and changes nothing
+            const char *closing = FieldScanner::findAny(found + 1, limit, '"', '"', '"', '"');
+            if (closing == limit)
+            {
+                return limit;
+            }
+            p = closing + 1;
+        }
+        return limit;
+    }
+
+    // Whether a line is not a record (a blank line or a comment such as the header); the FieldScanner skips these lines too
+    static bool isSkippedLine(const char *p, const char *limit)
+    {
+        return p < limit && (*p == '\n' || *p == '\r' || *p == '#');
+    }
+
+    // Find the first intact record that starts at or after from and before limit, at the start of a line; returns limit if there is none.
+    // Used to step over damage: every line start is tried until one holds a record whose checksum matches.
+    static size_t nextIntactRecord(const char *data, size_t from, size_t limit)
+    {
+        size_t candidate = from;
+        if (candidate > 0 && data[candidate - 1] != '\n')
+        {
+            candidate = lineAfter(data, candidate, limit);
+        }
+        while (candidate < limit)
+        {
+            const char *start = data + candidate;
+            if (!isSkippedLine(start, data + limit))
+            {
+                const char *end = recordEnd(start, data + min(limit, candidate + maxRecordBytes));
+                if (verify(start, end))
+                {
+                    return candidate;
+                }
+            }
+            candidate = lineAfter(data, candidate, limit);
+        }
+        return limit;
+    }
+
+private:
+    static int hexDigit(char c)
+    {
+        if (c >= '0' && c <= '9')
+        {
+            return c - '0';
+        }
+        if (c >= 'a' && c <= 'f')
+        {
+            return c - 'a' + 10;
+        }
+        if (c >= 'A' && c <= 'F')
+        {
+            return c - 'A' + 10;
+        }
+        return -1;
+    }
+
+    // Offset of the start of the line after the one holding offset (limit if there is none)
+    static size_t lineAfter(const char *data, size_t offset, size_t limit)
+    {
+        const char *lineBreak = FieldScanner::findAny(data + offset, data + limit, '\n', '\n', '\n', '\n');
+        return lineBreak == data + limit ? limit : size_t(lineBreak - data) + 1;
+    }
+};
+
+// Result of a scrub
+struct ScrubReport
+{
+    TaskFileFormat format = TaskFileFormat::EMPTY;    // Format of the file (only version 3 files have checksums to verify)
+    uint64_t bytes = 0;                               // Size of the file
+    size_t records = 0;                               // Records whose checksum matched
+    vector<pair<uint64_t, uint64_t>> damaged;         // Start and end offsets of every damaged range, in file order
+    unsigned threads = 1;                             // Threads that verified the file
+    double seconds = 0;                               // Time the verification took
+
+    uint64_t damagedBytes() const
+    {
+        uint64_t total = 0;
+        for (const auto &range : damaged)
+        {
+            total += range.second - range.first;
+        }
+        return total;
+    }
+};
+
+// The TaskFileScrubber class verifies the checksum of every record of a task file, on several threads.
+class TaskFileScrubber
+{
+public:
+    static const uint64_t minSliceBytes = 1u << 20; // Files are not split into slices smaller than this
+
+    // Verify a task file; returns false if it cannot be opened or mapped
+    static bool scrub(const string &filename, unsigned threads, ScrubReport &report)
+    {
+        auto started = chrono::steady_clock::now();
+        report = ScrubReport();
+        int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            return false;
+        }
+        struct stat info;
+        if (fstat(fd, &info) != 0)
+        {
+            ::close(fd);
+            return false;
+        }
+        report.bytes = uint64_t(info.st_size);
+        if (report.bytes == 0)
+        {
+            ::close(fd);
+            return true;
+        }
+        void *mapped = mmap(nullptr, size_t(report.bytes), PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd); // The mapping keeps the file itself alive
+        if (mapped == MAP_FAILED)
+        {
+            return false;
+        }
+        madvise(mapped, size_t(report.bytes), MADV_SEQUENTIAL);
+        const char *data = static_cast<const char *>(mapped);
+        size_t size = size_t(report.bytes);
+
+        report.format = RecordFormat::detect(data, size);
+        if (report.format == TaskFileFormat::CHECKSUMMED)
+        {
+            verifySlices(data, size, max(1u, threads), report);
+        }
+        munmap(mapped, size);
+        report.seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+        return true;
+    }
+
+private:
+    // What one thread found in its slice
+    struct SliceResult
+    {
+        size_t records = 0;
+        vector<pair<uint64_t, uint64_t>> damaged;
+    };
+
+    // Split the file into slices and verify them in parallel
+    static void verifySlices(const char *data, size_t size, unsigned threads, ScrubReport &report)
+    {
+        threads = unsigned(min<uint64_t>(threads, max<uint64_t>(1, size / minSliceBytes)));
+        report.threads = threads;
+
+        // A slice begins at the first intact record at or after its nominal start, so that no thread starts in the middle
+        // of a record. Every thread finds its own beginning first, then verifies up to the beginning of the next slice.
+        vector<size_t> begins(threads + 1, size);
+        begins[0] = 0;
+        vector<SliceResult> results(threads);
+        vector<thread> workers;
+        for (unsigned i = 1; i < threads; i++)
+        {
+            workers.emplace_back([data, size, threads, i, &begins]()
+                                 { begins[i] = RecordChecksum::nextIntactRecord(data, size / threads * i, size); });
+        }
+        for (thread &worker : workers)
+        {
+            worker.join();
+        }
+        for (unsigned i = 1; i < threads; i++)
+        {
+            begins[i] = max(begins[i], begins[i - 1]); // A slice whose search ran past the next one is empty
+        }
+
+        workers.clear();
+        for (unsigned i = 0; i < threads; i++)
+        {
+            workers.emplace_back([data, i, &begins, &results]()
+                                 { verifySlice(data, begins[i], begins[i + 1], results[i]); });
+        }
+        for (thread &worker : workers)
+        {
+            worker.join();
+        }
+
+        // Damage found at the end of one slice and the start of the next is one range
+        for (const SliceResult &result : results)
+        {
+            report.records += result.records;
+            for (const auto &range : result.damaged)
+            {
+                if (!report.damaged.empty() && report.damaged.back().second == range.first)
+                {
+                    report.damaged.back().second = range.second;
+                }
+                else
+                {
+                    report.damaged.push_back(range);
+                }
+            }
+        }
+    }
+
+    // Verify the records in [from, to), which starts at a record (or at the start of the file)
+    static void verifySlice(const char *data, size_t from, size_t to, SliceResult &result)
+    {
+        size_t pos = from;
+        while (pos < to)
+        {
+            const char *start = data + pos;
+            if (RecordChecksum::isSkippedLine(start, data + to))
+            {
+                const char *lineBreak = FieldScanner::findAny(start, data + to, '\n', '\n', '\n', '\n');
+                pos = lineBreak == data + to ? to : size_t(lineBreak - data) + 1;
+                continue;
+            }
+            const char *end = RecordChecksum::recordEnd(start, data + to);
+            if (RecordChecksum::verify(start, end))
+            {
+                result.records++;
+                pos = size_t(end - data);
+                continue;
+            }
+            size_t next = RecordChecksum::nextIntactRecord(data, pos + 1, to);
+            result.damaged.emplace_back(pos, next);
+            pos = next;
+        }
+    }
+};
+
+#endif
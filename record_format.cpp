@@ -0,0 +1,419 @@
+// This file implements the record format of the task file and the scanner used to read it.
+// Version 2 of the format starts with the line "#TASKFILE 2" and stores one task per line as comma-separated fields quoted in the RFC-4180 style:
+// a field containing a comma, a double quote or a line break is written in double quotes, and a double quote inside it is written twice.
+// Files without the header line use the original (legacy) format, which is a bare comma join. They are still read, with a best-effort repair
+// of descriptions that contain commas, and are converted to the current version the next time they are written (or with the --migrate option).
+// Version 3 starts with the line "#TASKFILE 3" and adds a checksum field at the end of every record (see record_checksum.cpp);
+// version 2 files are still read, and are rewritten in version 3 the next time they are written.
+// The FieldScanner looks for delimiters, quotes and line breaks 32 bytes at a time with AVX2 or 16 bytes at a time with SSE2,
+// and falls back to a plain loop on other processors.
+
+#ifndef TASK_RECORD_FORMAT_CPP
+#define TASK_RECORD_FORMAT_CPP
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstring> // memcmp()
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h> // SSE2 and AVX2 intrinsics
+#define TASK_SCANNER_X86 1
+#endif
+
+using namespace std;
+
+// Formats a task file can be in
+enum class TaskFileFormat
+{
+    EMPTY,      // The file is empty or does not exist
+    LEGACY,     // Unquoted comma-joined fields without a header
+    QUOTED,     // Version 2: header line followed by RFC-4180 style records
+    CHECKSUMMED // Version 3: like version 2, with the checksum of every record as its last field
+};
+
+// The RecordFormat class groups the helpers used to read and write task file records.
+class RecordFormat
+{
+public:
+    // First line of every task file written now (version 3)
+    static const string &header()
+    {
+        static const string headerLine = "#TASKFILE 3";
+        return headerLine;
+    }
+
+    // First line of a version 2 task file
+    static const string &quotedHeader()
+    {
+        static const string headerLine = "#TASKFILE 2";
+        return headerLine;
+    }
+
+    // Work out which format the contents of a task file are in
+    static TaskFileFormat detect(const char *data, size_t size)
+    {
+        if (size == 0)
+        {
+            return TaskFileFormat::EMPTY;
+        }
+        auto startsWith = [data, size](const string &headerLine)
+        { return size >= headerLine.size() && memcmp(data, headerLine.data(), headerLine.size()) == 0; };
+        if (startsWith(header()))
+        {
+            return TaskFileFormat::CHECKSUMMED;
+        }
+        if (startsWith(quotedHeader()))
+        {
+            return TaskFileFormat::QUOTED;
+        }
+        return TaskFileFormat::LEGACY;
+    }
+
+    // Read the whole file into a string; returns false if the file cannot be opened
+    static bool readFile(const string &filename, string &contents)
+    {
+        ifstream file(filename, ios::binary);
+        if (!file.is_open())
+        {
+            return false;
+        }
+
+        file.seekg(0, ios::end);
+        streamoff size = file.tellg();
+        file.seekg(0, ios::beg);
+        contents.resize(size > 0 ? size_t(size) : 0);
+        if (size > 0)
+        {
+            file.read(&contents[0], size);
+        }
+        return true;
+    }
+
+    // Work out which format an existing task file is in (EMPTY if it does not exist)
+    static TaskFileFormat detectFile(const string &filename)
+    {
+        ifstream file(filename, ios::binary);
+        if (!file.is_open())
+        {
+            return TaskFileFormat::EMPTY;
+        }
+        char start[32];
+        file.read(start, sizeof(start));
+        return detect(start, size_t(file.gcount()));
+    }
+
+    // Append one field to a record, quoting it when needed
+    static void appendField(string &out, const string &value)
+    {
+        if (value.find_first_of(",\"\r\n") == string::npos)
+        {
+            out += value;
+            return;
+        }
+
+        out += '"';
+        for (char c : value)
+        {
+            if (c == '"')
+            {
+                out += '"'; // Double quotes inside a quoted field are written twice
+            }
+            out += c;
+        }
+        out += '"';
+    }
+
+    // Repair the fields of a legacy record whose description (or label) contained commas.
+    // Legacy records have 8 fields: ID, category, title, description, deadline, priority, status and label.
+    // Extra fields are merged back into the description, using the DD/MM/YYYY deadline to find where the description ends.
+    static void repairLegacyFields(vector<string> &fields)
+    {
+        const size_t expected = 8;
+        if (fields.size() <= expected)
+        {
+            return;
+        }
+
+        // Find the deadline, which is the first date-shaped field after the title
+        size_t deadlineIndex = 0;
+        for (size_t i = 4; i < fields.size(); i++)
+        {
+            if (looksLikeDate(fields[i]))
+            {
+                deadlineIndex = i;
+                break;
+            }
+        }
+        if (deadlineIndex == 0)
+        {
+            return; // No deadline found, keep the fields as they are
+        }
+
+        vector<string> repaired(fields.begin(), fields.begin() + 3);
+
+        // Everything between the title and the deadline belongs to the description
+        string description = fields[3];
+        for (size_t i = 4; i < deadlineIndex; i++)
+        {
+            description += "," + fields[i];
+        }
+        repaired.push_back(description);
+
+        // The deadline, priority and status follow, and anything left over belongs to the label
+        for (size_t i = deadlineIndex; i < deadlineIndex + 3 && i < fields.size(); i++)
+        {
+            repaired.push_back(fields[i]);
+        }
+        string label;
+        for (size_t i = deadlineIndex + 3; i < fields.size(); i++)
+        {
+            label += (i == deadlineIndex + 3 ? "" : ",") + fields[i];
+        }
+        repaired.push_back(label);
+
+        fields.swap(repaired);
+    }
+
+private:
+    // Check whether a field has the DD/MM/YYYY shape
+    static bool looksLikeDate(const string &field)
+    {
+        if (field.size() != 10 || field[2] != '/' || field[5] != '/')
+        {
+            return false;
+        }
+        for (size_t i : {0, 1, 3, 4, 6, 7, 8, 9})
+        {
+            if (!isdigit((unsigned char)field[i]))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+// The FieldScanner class splits the contents of a task file into records and fields.
+class FieldScanner
+{
+public:
+    // Scan a buffer; legacy files are split on commas only, without any quote handling
+    FieldScanner(const char *buffer, size_t size, bool legacyFormat)
+        : data(buffer), pos(buffer), end(buffer + size), legacy(legacyFormat) {}
+
+    // Read the next record into fields (reusing its strings); returns false at the end of the buffer.
+    // Empty lines and lines starting with '#' (such as the header) are skipped.
+    bool nextRecord(vector<string> &fields)
+    {
+        // Skip blank lines and comment lines between records
+        while (pos < end)
+        {
+            if (*pos == '\n' || *pos == '\r')
+            {
+                pos++;
+            }
+            else if (*pos == '#')
+            {
+                pos = findAny(pos, end, '\n', '\n', '\n', '\n');
+            }
+            else
+            {
+                break;
+            }
+        }
+        if (pos >= end)
+        {
+            return false;
+        }
+
+        recordStart = pos;
+        size_t count = 0;
+        while (true)
+        {
+            if (fields.size() <= count)
+            {
+                fields.emplace_back();
+            }
+            string &field = fields[count++];
+            field.clear();
+
+            if (!legacy && pos < end && *pos == '"')
+            {
+                // Quoted field: only double quotes are special until the closing quote
+                pos++;
+                while (true)
+                {
+                    const char *quote = findAny(pos, end, '"', '"', '"', '"');
+                    field.append(pos, quote);
+                    if (quote == end)
+                    {
+                        pos = end; // Unterminated quote, keep the rest of the buffer
+                        break;
+                    }
+                    if (quote + 1 < end && quote[1] == '"')
+                    {
+                        field += '"'; // Escaped double quote
+                        pos = quote + 2;
+                        continue;
+                    }
+                    pos = quote + 1; // Closing quote
+                    break;
+                }
+
+                // Anything between the closing quote and the next delimiter is kept as it is
+                const char *delimiter = findAny(pos, end, ',', '\n', '\r', ',');
+                field.append(pos, delimiter);
+                pos = delimiter;
+            }
+            else
+            {
+                // Unquoted field: runs until the next comma or line break
+                const char *delimiter = findAny(pos, end, ',', '\n', '\r', ',');
+                field.assign(pos, delimiter);
+                pos = delimiter;
+            }
+
+            if (pos < end && *pos == ',')
+            {
+                pos++; // Another field follows
+                continue;
+            }
+
+            // End of the record: step over the line break
+            if (pos < end && *pos == '\r')
+            {
+                pos++;
+            }
+            if (pos < end && *pos == '\n')
+            {
+                pos++;
+            }
+            break;
+        }
+
+        fields.resize(count);
+        return true;
+    }
+
+    // Offset of the last record returned by nextRecord() from the start of the buffer
+    size_t recordOffset() const
+    {
+        return size_t(recordStart - data);
+    }
+
+    // Offset of the next unread byte from the start of the buffer
+    size_t offset() const
+    {
+        return size_t(pos - data);
+    }
+
+    // Find the first of up to four characters in [p, last); returns last if none is present.
+    // The implementation is chosen once, based on what the processor supports.
+    static const char *findAny(const char *p, const char *last, char c0, char c1, char c2, char c3)
+    {
+        static const FindFunction find = chooseFind();
+        return find(p, last, c0, c1, c2, c3);
+    }
+
+    // Name of the implementation chosen by findAny() (for diagnostics)
+    static const char *implementationName()
+    {
+#ifdef TASK_SCANNER_X86
+        if (__builtin_cpu_supports("avx2"))
+        {
+            return "avx2";
+        }
+        return "sse2";
+#else
+        return "scalar";
+#endif
+    }
+
+private:
+    typedef const char *(*FindFunction)(const char *, const char *, char, char, char, char);
+
+    // Portable version, one byte at a time
+    static const char *findAnyScalar(const char *p, const char *last, char c0, char c1, char c2, char c3)
+    {
+        for (; p < last; p++)
+        {
+            char c = *p;
+            if (c == c0 || c == c1 || c == c2 || c == c3)
+            {
+                return p;
+            }
+        }
+        return last;
+    }
+
+#ifdef TASK_SCANNER_X86
+    // SSE2 version, 16 bytes at a time (SSE2 is available on every x86-64 processor)
+    __attribute__((target("sse2"))) static const char *findAnySse2(const char *p, const char *last, char c0, char c1, char c2, char c3)
+    {
+        const __m128i v0 = _mm_set1_epi8(c0);
+        const __m128i v1 = _mm_set1_epi8(c1);
+        const __m128i v2 = _mm_set1_epi8(c2);
+        const __m128i v3 = _mm_set1_epi8(c3);
+        while (last - p >= 16)
+        {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+            __m128i matches = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, v0), _mm_cmpeq_epi8(chunk, v1)),
+                                           _mm_or_si128(_mm_cmpeq_epi8(chunk, v2), _mm_cmpeq_epi8(chunk, v3)));
+            int mask = _mm_movemask_epi8(matches);
+            if (mask != 0)
+            {
+                return p + __builtin_ctz(mask);
+            }
+            p += 16;
+        }
+        return findAnyScalar(p, last, c0, c1, c2, c3);
+    }
+
+    // AVX2 version, 32 bytes at a time
+    __attribute__((target("avx2"))) static const char *findAnyAvx2(const char *p, const char *last, char c0, char c1, char c2, char c3)
+    {
+        const __m256i v0 = _mm256_set1_epi8(c0);
+        const __m256i v1 = _mm256_set1_epi8(c1);
+        const __m256i v2 = _mm256_set1_epi8(c2);
+        const __m256i v3 = _mm256_set1_epi8(c3);
+        while (last - p >= 32)
+        {
+            __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+            __m256i matches = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(chunk, v0), _mm256_cmpeq_epi8(chunk, v1)),
+                                              _mm256_or_si256(_mm256_cmpeq_epi8(chunk, v2), _mm256_cmpeq_epi8(chunk, v3)));
+            unsigned mask = unsigned(_mm256_movemask_epi8(matches));
+            if (mask != 0)
+            {
+                return p + __builtin_ctz(mask);
+            }
+            p += 32;
+        }
+        return findAnySse2(p, last, c0, c1, c2, c3);
+    }
+#endif
+
+    // Pick the fastest implementation the processor supports
+    static FindFunction chooseFind()
+    {
+#ifdef TASK_SCANNER_X86
+        if (__builtin_cpu_supports("avx2"))
+        {
+            return findAnyAvx2;
+        }
+        return findAnySse2;
+#else
+        return findAnyScalar;
+#endif
+    }
+
+    const char *data;                  // Start of the buffer
+    const char *pos;                   // Next unread byte
+    const char *end;                   // End of the buffer
+    const char *recordStart = nullptr; // Start of the last record returned
+    bool legacy;                       // Split on commas only (legacy format)
+};
+
+#endif
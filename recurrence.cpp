@@ -0,0 +1,482 @@
+// This file implements the recurrence rules of repeating tasks.
+// A repeating task is stored once, as a template: its deadline is the first occurrence and its rule says how often it repeats
+// (daily, weekly on some days of the week, or monthly on a day of the month, every so many days, weeks or months, until a date
+// or for a number of times). The occurrences are never stored. They are expanded from the rule only for the window of dates a
+// view asks for, jumping straight to the start of the window, so a daily task that has run for years costs the same as a new one.
+// Completing an occurrence is recorded sparsely, as the list of the days whose occurrence was completed.
+// Rules are written in a form modelled on iCalendar RRULEs, for example "FREQ=WEEKLY;BYDAY=MO,WE;UNTIL=31/12/2026".
+
+#ifndef TASK_RECURRENCE_CPP
+#define TASK_RECURRENCE_CPP
+
+#include <string>
+#include <vector>
+#include <algorithm> // lower_bound() over the completed days
+#include <climits>   // INT_MAX for rules without an end date
+#include <cctype>    // toupper() for reading rules in any case
+#include <cstdint>
+#include <stdexcept> // invalid_argument for unreadable rules
+#include "calendar.cpp" // Day numbers, weekdays and months
+
+using namespace std;
+
+// How often a task repeats
+enum class RecurrenceFrequency
+{
+    NONE,    // The task does not repeat
+    DAILY,   // Every interval days
+    WEEKLY,  // On the chosen days of every interval-th week
+    MONTHLY  // On the chosen day of every interval-th month
+};
+
+// The RecurrenceRule struct describes when a repeating task occurs, and which of its occurrences were completed.
+struct RecurrenceRule
+{
+    static const int maxInterval = 1000;     // Largest interval accepted
+    static const int maxSkippedMonths = 120; // Months without the chosen day skipped before a monthly rule is considered finished
+
+    RecurrenceFrequency frequency = RecurrenceFrequency::NONE;
+    int interval = 1;          // Number of days, weeks or months between occurrences
+    uint8_t weekdays = 0;      // Days of the week of a weekly rule (bit 0 is Monday, bit 6 Sunday); 0: the day of the first occurrence
+    int monthDay = 0;          // Day of the month of a monthly rule; 0: the day of the first occurrence
+    int untilDay = INT_MAX;    // Day number of the last day an occurrence can fall on
+    int count = 0;             // Number of occurrences, counted from the first one (0: no limit)
+    vector<int> completedDays; // Day numbers of the completed occurrences, in increasing order
+
+    bool repeats() const
+    {
+        return frequency != RecurrenceFrequency::NONE;
+    }
+
+    // Call visit(day) for every occurrence between fromDay and toDay (inclusive), in order, until visit returns false.
+    // startDay is the day of the first occurrence (the deadline of the task). Only the occurrences in the window are generated:
+    // daily and weekly rules jump straight to the window, and monthly rules walk one month per step.
+    template <typename Visit>
+    void expand(int startDay, int fromDay, int toDay, Visit visit) const
+    {
+        long long first = max(fromDay, startDay);
+        long long last = min(toDay, untilDay);
+        if (!repeats() || first > last)
+        {
+            return;
+        }
+
+        if (frequency == RecurrenceFrequency::DAILY)
+        {
+            // Occurrence k falls on startDay + k * interval
+            for (long long k = (first - startDay + interval - 1) / interval; count == 0 || k < count; k++)
+            {
+                long long day = startDay + k * interval;
+                if (day > last || !visit(int(day)))
+                {
+                    return;
+                }
+            }
+        }
+        else if (frequency == RecurrenceFrequency::WEEKLY)
+        {
+            uint8_t days = weekdays != 0 ? weekdays : uint8_t(1 << Calendar::weekday(startDay));
+            int perWeek = __builtin_popcount(days);
+            int firstWeekday = Calendar::weekday(startDay);
+            long long weekStart = startDay - firstWeekday; // Monday of the week of the first occurrence
+            long long span = 7LL * interval;
+
+            // Skip to the last active week starting on or before the window, counting the occurrences skipped
+            long long week = (first - weekStart) / span;
+            long long index = week == 0 ? 0 : __builtin_popcount(days >> firstWeekday) + (week - 1) * perWeek;
+            for (;; week++)
+            {
+                long long monday = weekStart + week * span;
+                if (monday > last)
+                {
+                    return;
+                }
+                for (int weekday = 0; weekday < 7; weekday++)
+                {
+                    long long day = monday + weekday;
+                    if (!(days >> weekday & 1) || day < startDay)
+                    {
+                        continue;
+                    }
+                    if (count != 0 && index >= count)
+                    {
+                        return;
+                    }
+                    index++;
+                    if (day < first)
+                    {
+                        continue;
+                    }
+                    if (day > last || !visit(int(day)))
+                    {
+                        return;
+                    }
+                }
+            }
+        }
+        else
+        {
+            CivilDate start = Calendar::fromDayNumber(startDay);
+            int dayOfMonth = monthDay != 0 ? monthDay : start.day;
+            long long firstMonth = start.year * 12LL + start.month - 1;
+
+            // Without a count the occurrences before the window do not matter, so skip to the month of the window
+            long long step = 0;
+            if (count == 0)
+            {
+                CivilDate from = Calendar::fromDayNumber(int(first));
+                step = max(0LL, (from.year * 12LL + from.month - 1 - firstMonth) / interval);
+            }
+            long long index = 0;
+            int skipped = 0;
+            for (;; step++)
+            {
+                long long month = firstMonth + step * interval;
+                int year = int(month / 12);
+                int monthOfYear = int(month % 12) + 1;
+                if (Calendar::toDayNumber({year, monthOfYear, 1}) > last)
+                {
+                    return;
+                }
+                if (dayOfMonth > Calendar::daysInMonth(year, monthOfYear))
+                {
+                    // Months without the chosen day are skipped, as in iCalendar
+                    if (++skipped > maxSkippedMonths)
+                    {
+                        return;
+                    }
+                    continue;
+                }
+                skipped = 0;
+                int day = Calendar::toDayNumber({year, monthOfYear, dayOfMonth});
+                if (day < startDay)
+                {
+                    continue;
+                }
+                if (count != 0 && index >= count)
+                {
+                    return;
+                }
+                index++;
+                if (day < first)
+                {
+                    continue;
+                }
+                if (day > last || !visit(day))
+                {
+                    return;
+                }
+            }
+        }
+    }
+
+    // Whether the task has an occurrence on a day
+    bool occursOn(int startDay, int day) const
+    {
+        bool found = false;
+        expand(startDay, day, day, [&found](int)
+               { return !(found = true); });
+        return found;
+    }
+
+    // The first occurrence on or after fromDay that was not completed, or INT_MAX if there is none
+    int nextPending(int startDay, int fromDay) const
+    {
+        int result = INT_MAX;
+        expand(startDay, fromDay, INT_MAX, [this, &result](int day)
+               {
+            if (isCompleted(day))
+            {
+                return true;
+            }
+            result = day;
+            return false; });
+        return result;
+    }
+
+    bool isCompleted(int day) const
+    {
+        return binary_search(completedDays.begin(), completedDays.end(), day);
+    }
+
+    // Mark the occurrence of a day as completed or not completed
+    void setCompleted(int day, bool completed)
+    {
+        auto it = lower_bound(completedDays.begin(), completedDays.end(), day);
+        bool present = it != completedDays.end() && *it == day;
+        if (completed && !present)
+        {
+            completedDays.insert(it, day);
+        }
+        else if (!completed && present)
+        {
+            completedDays.erase(it);
+        }
+    }
+
+    // Read a rule: a list of NAME=VALUE parts separated by semicolons, with the names FREQ (DAILY, WEEKLY or MONTHLY), INTERVAL,
+    // BYDAY (MO,TU,WE,TH,FR,SA,SU), BYMONTHDAY, UNTIL (DD/MM/YYYY), COUNT and DONE (the completed occurrences, DD/MM/YYYY separated
+    // by spaces). A part without a name is the frequency, so "weekly" is a rule too. Empty text is a task that does not repeat.
+    // Throws invalid_argument if the rule cannot be read.
+    static RecurrenceRule parse(const string &text)
+    {
+        RecurrenceRule rule;
+        size_t pos = 0;
+        while (pos <= text.size())
+        {
+            size_t end = min(text.find(';', pos), text.size());
+            string part = trim(text.substr(pos, end - pos));
+            pos = end + 1;
+            if (part.empty())
+            {
+                continue;
+            }
+
+            size_t equals = part.find('=');
+            string name = equals == string::npos ? "FREQ" : upper(trim(part.substr(0, equals)));
+            string value = equals == string::npos ? part : trim(part.substr(equals + 1));
+            if (name == "FREQ")
+            {
+                string frequency = upper(value);
+                if (frequency == "DAILY")
+                {
+                    rule.frequency = RecurrenceFrequency::DAILY;
+                }
+                else if (frequency == "WEEKLY")
+                {
+                    rule.frequency = RecurrenceFrequency::WEEKLY;
+                }
+                else if (frequency == "MONTHLY")
+                {
+                    rule.frequency = RecurrenceFrequency::MONTHLY;
+                }
+                else
+                {
+                    throw invalid_argument("The frequency must be DAILY, WEEKLY or MONTHLY!");
+                }
+            }
+            else if (name == "INTERVAL")
+            {
+                rule.interval = readNumber(value, 1, maxInterval, "INTERVAL");
+            }
+            else if (name == "BYDAY")
+            {
+                rule.weekdays = readWeekdays(value);
+            }
+            else if (name == "BYMONTHDAY")
+            {
+                rule.monthDay = readNumber(value, 1, 31, "BYMONTHDAY");
+            }
+            else if (name == "UNTIL")
+            {
+                if (!Calendar::parse(value, rule.untilDay))
+                {
+                    throw invalid_argument("UNTIL must be a date in DD/MM/YYYY format!");
+                }
+            }
+            else if (name == "COUNT")
+            {
+                rule.count = readNumber(value, 1, INT_MAX, "COUNT");
+            }
+            else if (name == "DONE")
+            {
+                rule.completedDays = readDays(value);
+            }
+            else
+            {
+                throw invalid_argument("Unknown part of the rule: " + name);
+            }
+        }
+
+        if (!rule.repeats() && (rule.interval != 1 || rule.weekdays != 0 || rule.monthDay != 0 || rule.untilDay != INT_MAX || rule.count != 0))
+        {
+            throw invalid_argument("The rule needs a frequency (FREQ=DAILY, WEEKLY or MONTHLY)!");
+        }
+        if (rule.weekdays != 0 && rule.frequency != RecurrenceFrequency::WEEKLY)
+        {
+            throw invalid_argument("BYDAY can only be used with FREQ=WEEKLY!");
+        }
+        if (rule.monthDay != 0 && rule.frequency != RecurrenceFrequency::MONTHLY)
+        {
+            throw invalid_argument("BYMONTHDAY can only be used with FREQ=MONTHLY!");
+        }
+        return rule;
+    }
+
+    // Append the rule in the form read by parse() (nothing for a task that does not repeat)
+    void append(string &out) const
+    {
+        if (!repeats())
+        {
+            return;
+        }
+        static const char *const frequencies[] = {"", "DAILY", "WEEKLY", "MONTHLY"};
+        out += "FREQ=";
+        out += frequencies[int(frequency)];
+        if (interval != 1)
+        {
+            out += ";INTERVAL=" + to_string(interval);
+        }
+        if (weekdays != 0)
+        {
+            out += ";BYDAY=";
+            appendWeekdays(out, ",");
+        }
+        if (monthDay != 0)
+        {
+            out += ";BYMONTHDAY=" + to_string(monthDay);
+        }
+        if (untilDay != INT_MAX)
+        {
+            out += ";UNTIL=" + Calendar::format(untilDay);
+        }
+        if (count != 0)
+        {
+            out += ";COUNT=" + to_string(count);
+        }
+        if (!completedDays.empty())
+        {
+            out += ";DONE=";
+            for (size_t i = 0; i < completedDays.size(); i++)
+            {
+                out += (i > 0 ? " " : "") + Calendar::format(completedDays[i]);
+            }
+        }
+    }
+
+    string toString() const
+    {
+        string text;
+        append(text);
+        return text;
+    }
+
+    // Describe the rule in words, e.g. "every 2 weeks on MO, WE until 31/12/2026"
+    string describe() const
+    {
+        static const char *const units[] = {"", "day", "week", "month"};
+        string text = "every ";
+        if (interval != 1)
+        {
+            text += to_string(interval) + " ";
+        }
+        text += units[int(frequency)];
+        text += interval != 1 ? "s" : "";
+        if (weekdays != 0)
+        {
+            text += " on ";
+            appendWeekdays(text, ", ");
+        }
+        if (monthDay != 0)
+        {
+            text += " on day " + to_string(monthDay);
+        }
+        if (untilDay != INT_MAX)
+        {
+            text += " until " + Calendar::format(untilDay);
+        }
+        if (count != 0)
+        {
+            text += ", " + to_string(count) + " time(s)";
+        }
+        return text;
+    }
+
+private:
+    static const char *weekdayName(int weekday)
+    {
+        static const char *const names[] = {"MO", "TU", "WE", "TH", "FR", "SA", "SU"};
+        return names[weekday];
+    }
+
+    void appendWeekdays(string &out, const char *separator) const
+    {
+        bool firstDay = true;
+        for (int weekday = 0; weekday < 7; weekday++)
+        {
+            if (weekdays >> weekday & 1)
+            {
+                out += firstDay ? "" : separator;
+                out += weekdayName(weekday);
+                firstDay = false;
+            }
+        }
+    }
+
+    static string trim(const string &text)
+    {
+        size_t first = text.find_first_not_of(" \t\r\n");
+        if (first == string::npos)
+        {
+            return "";
+        }
+        return text.substr(first, text.find_last_not_of(" \t\r\n") - first + 1);
+    }
+
+    static string upper(string text)
+    {
+        for (char &c : text)
+        {
+            c = char(toupper((unsigned char)c));
+        }
+        return text;
+    }
+
+    static int readNumber(const string &value, int minimum, int maximum, const string &name)
+    {
+        long long number = 0;
+        if (value.empty() || value.size() > 10 || value.find_first_not_of("0123456789") != string::npos ||
+            (number = stoll(value)) < minimum || number > maximum)
+        {
+            throw invalid_argument(name + " must be a number from " + to_string(minimum) + " to " + to_string(maximum) + "!");
+        }
+        return int(number);
+    }
+
+    // Read a list of days of the week such as "MO,WE,FR" into a bit mask
+    static uint8_t readWeekdays(const string &value)
+    {
+        uint8_t days = 0;
+        size_t pos = 0;
+        while (pos <= value.size())
+        {
+            size_t end = min(value.find(',', pos), value.size());
+            string name = upper(trim(value.substr(pos, end - pos)));
+            pos = end + 1;
+            int weekday = 0;
+            while (weekday < 7 && name != weekdayName(weekday))
+            {
+                weekday++;
+            }
+            if (weekday == 7)
+            {
+                throw invalid_argument("BYDAY must list days of the week such as MO,WE,FR!");
+            }
+            days |= uint8_t(1 << weekday);
+        }
+        return days;
+    }
+
+    // Read a list of dates separated by spaces into sorted day numbers
+    static vector<int> readDays(const string &value)
+    {
+        vector<int> days;
+        size_t pos = 0;
+        while ((pos = value.find_first_not_of(' ', pos)) != string::npos)
+        {
+            size_t end = min(value.find(' ', pos), value.size());
+            int day;
+            if (!Calendar::parse(value.substr(pos, end - pos), day))
+            {
+                throw invalid_argument("DONE must list dates in DD/MM/YYYY format!");
+            }
+            days.push_back(day);
+            pos = end;
+        }
+        sort(days.begin(), days.end());
+        days.erase(unique(days.begin(), days.end()), days.end());
+        return days;
+    }
+};
+
+#endif
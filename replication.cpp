@@ -0,0 +1,689 @@
+// This file implements log-shipping replication from a primary task manager to read-only follower processes.
+// The primary listens on a local (Unix domain) socket. Its replication thread follows the change feed of the replicated project
+// and sends every committed change to each connected follower. A follower first receives a snapshot of all tasks
+// and then the changes after it, which it applies to its own in-memory copy of the tasks, so reports and views can be served
+// by the follower without touching the primary.
+// Every message carries the sequence number of the change and the time it was made on the primary, so a follower can report how far
+// behind it is (in changes and in time). A follower that was disconnected, or a primary whose replication thread fell behind the
+// change feed, starts again from a fresh snapshot.
+// Both sides can print a checksum of their tasks serialized in ID order; equal checksums mean the follower holds a byte-identical copy.
+//
+// A follower whose connection drops, or that receives a malformed message, connects again with a growing delay (from 100 ms up to
+// 5 s) until the primary is back, and then starts from the fresh snapshot the primary sends to every new follower.
+//
+// Messages are framed by a 4-byte length, at most ReplicationWire::maxFrameBytes; a larger frame drops the connection. The payload is a header line followed by task records in the task file format:
+//   S <sequence> <time> <count>\n<records>   snapshot of every task, valid up to and including change <sequence> - 1
+//   E <sequence> <time> <type> <id>\n<record> one change (no record for deletions)
+//   H <sequence> <time>\n                     heartbeat: the primary is at <sequence> and still alive
+
+#ifndef TASK_REPLICATION_CPP
+#define TASK_REPLICATION_CPP
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>          // Replicated tasks ordered by ID
+#include <thread>       // Replication threads
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <sstream>
+#include <cstring>      // strerror() and memcpy()
+#include <cerrno>
+#include <sys/socket.h> // Unix domain sockets
+#include <sys/un.h>
+#include <poll.h>       // Waiting for followers and messages with a timeout
+#include <unistd.h>     // close() and unlink()
+#include <fcntl.h>      // Non-blocking listening socket
+#include "change_feed.cpp"   // Committed changes of the replicated project
+#include "task_schema.cpp"   // Task records on the wire
+#include "record_format.cpp" // FieldScanner for reading records
+#include "metrics.cpp"       // Events sent and replication lag
+#include "trace.cpp"         // Names of the replication threads
+
+using namespace std;
+
+// Current time in microseconds, as sent between the processes of one machine
+inline int64_t replicationClockMicros()
+{
+    return chrono::duration_cast<chrono::microseconds>(chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// The ReplicaStore struct holds a replicated copy of the tasks of a project.
+struct ReplicaStore
+{
+    map<int, Task> tasks;      // Tasks by ID
+    uint64_t nextSequence = 0; // Sequence number of the next change to apply
+
+    // Apply one change from the feed
+    void apply(const ChangeEvent &event)
+    {
+        if (event.type == ChangeType::DELETED)
+        {
+            tasks.erase(event.taskID);
+        }
+        else
+        {
+            tasks[event.taskID] = event.task;
+        }
+        nextSequence = event.sequence + 1;
+    }
+
+    // Replace every task
+    void reset(const vector<Task> &snapshot, uint64_t sequence)
+    {
+        tasks.clear();
+        for (const Task &task : snapshot)
+        {
+            tasks[task.getTaskID()] = task;
+        }
+        nextSequence = sequence;
+    }
+
+    // All tasks as records in ID order
+    string serialize() const
+    {
+        string out;
+        for (const auto &entry : tasks)
+        {
+            TaskSchema::appendRecord(out, entry.second);
+        }
+        return out;
+    }
+
+    // Serialize a list of tasks the same way as serialize(), whatever order the list is in
+    static string serialize(const vector<Task> &taskList)
+    {
+        ReplicaStore store;
+        store.reset(taskList, 0);
+        return store.serialize();
+    }
+
+    // FNV-1a hash of serialized tasks, used to compare the primary and its followers
+    static uint64_t checksum(const string &serialized)
+    {
+        uint64_t hash = 14695981039346656037ull;
+        for (unsigned char c : serialized)
+        {
+            hash = (hash ^ c) * 1099511628211ull;
+        }
+        return hash;
+    }
+};
+
+// The ReplicationWire struct encodes, sends and receives replication messages.
+struct ReplicationWire
+{
+    static const uint32_t maxFrameBytes = 1u << 30; // Largest message either side sends or accepts (a snapshot of a very large project)
+
+    static string snapshot(const ReplicaStore &store)
+    {
+        string payload = "S " + to_string(store.nextSequence) + " " + to_string(replicationClockMicros()) + " " + to_string(store.tasks.size()) + "\n";
+        payload += store.serialize();
+        return payload;
+    }
+
+    static string event(const ChangeEvent &change)
+    {
+        string payload = "E " + to_string(change.sequence) + " " + to_string(change.publishedMicros) + " " + to_string(int(change.type)) + " " +
+                         to_string(change.taskID) + "\n";
+        if (change.type != ChangeType::DELETED)
+        {
+            TaskSchema::appendRecord(payload, change.task);
+        }
+        return payload;
+    }
+
+    static string heartbeat(uint64_t sequence)
+    {
+        return "H " + to_string(sequence) + " " + to_string(replicationClockMicros()) + "\n";
+    }
+
+    // Send one message; returns false if the other side is gone or the message is too large to be accepted
+    static bool send(int fd, const string &payload)
+    {
+        if (payload.size() > maxFrameBytes)
+        {
+            cerr << "Replication message of " << payload.size() << " bytes is too large to send." << endl;
+            return false;
+        }
+        uint32_t length = uint32_t(payload.size());
+        unsigned char prefix[4] = {(unsigned char)length, (unsigned char)(length >> 8), (unsigned char)(length >> 16), (unsigned char)(length >> 24)};
+        return sendAll(fd, reinterpret_cast<const char *>(prefix), sizeof(prefix)) && sendAll(fd, payload.data(), payload.size());
+    }
+
+    // Receive one message, waiting at most timeoutMs for it to start.
+    // Returns 1 for a message, 0 on timeout and -1 if the connection was closed or broken, or the message is larger than
+    // maxFrameBytes (the length comes from the other side, so it is checked before anything is allocated for it).
+    static int receive(int fd, string &payload, int timeoutMs)
+    {
+        pollfd waitFor = {fd, POLLIN, 0};
+        int ready = poll(&waitFor, 1, timeoutMs);
+        if (ready == 0)
+        {
+            return 0;
+        }
+        unsigned char prefix[4];
+        if (ready < 0 || !receiveAll(fd, reinterpret_cast<char *>(prefix), sizeof(prefix)))
+        {
+            return -1;
+        }
+        uint32_t length = uint32_t(prefix[0]) | uint32_t(prefix[1]) << 8 | uint32_t(prefix[2]) << 16 | uint32_t(prefix[3]) << 24;
+        if (length > maxFrameBytes)
+        {
+            cerr << "Replication message of " << length << " bytes is too large; dropping the connection." << endl;
+            return -1;
+        }
+        payload.resize(length);
+        return length == 0 || receiveAll(fd, &payload[0], length) ? 1 : -1;
+    }
+
+    // Parse the task records that follow the header line of a message
+    static bool parseTasks(const string &payload, size_t offset, vector<Task> &parsed)
+    {
+        FieldScanner scanner(payload.data() + offset, payload.size() - offset, false);
+        vector<string> fields;
+        while (scanner.nextRecord(fields))
+        {
+            Task task;
+            if (!TaskSchema::parseRecord(fields, task))
+            {
+                return false;
+            }
+            parsed.push_back(task);
+        }
+        return true;
+    }
+
+    // Fill a Unix socket address; returns false if the path is too long
+    static bool address(const string &path, sockaddr_un &addr)
+    {
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(addr.sun_path))
+        {
+            return false;
+        }
+        memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+        return true;
+    }
+
+private:
+    static bool sendAll(int fd, const char *data, size_t size)
+    {
+        while (size > 0)
+        {
+            ssize_t sent = ::send(fd, data, size, MSG_NOSIGNAL); // A follower that went away must not kill the primary
+            if (sent < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (sent <= 0)
+            {
+                return false;
+            }
+            data += sent;
+            size -= size_t(sent);
+        }
+        return true;
+    }
+
+    static bool receiveAll(int fd, char *data, size_t size)
+    {
+        while (size > 0)
+        {
+            ssize_t received = ::recv(fd, data, size, 0);
+            if (received < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (received <= 0)
+            {
+                return false;
+            }
+            data += received;
+            size -= size_t(received);
+        }
+        return true;
+    }
+};
+
+// The ReplicationPrimary class accepts followers and ships the changes of one project to them.
+class ReplicationPrimary
+{
+public:
+    ~ReplicationPrimary()
+    {
+        stop();
+    }
+
+    // Start listening on a socket path and replicating a change feed whose tasks are currently snapshot at position.
+    // Returns false if the socket could not be created.
+    bool start(const string &path, const ChangeFeed &changeFeed, const vector<Task> &snapshot, const ChangeSubscription &position)
+    {
+        sockaddr_un addr;
+        if (!ReplicationWire::address(path, addr))
+        {
+            cerr << "Replication socket path is too long: " << path << endl;
+            return false;
+        }
+        listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+        unlink(path.c_str()); // Remove the socket left behind by an earlier primary
+        if (listenFd < 0 || ::bind(listenFd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 || listen(listenFd, 16) != 0)
+        {
+            cerr << "Unable to listen on replication socket " << path << ": " << strerror(errno) << endl;
+            if (listenFd >= 0)
+            {
+                close(listenFd);
+                listenFd = -1;
+            }
+            return false;
+        }
+        fcntl(listenFd, F_SETFL, fcntl(listenFd, F_GETFL) | O_NONBLOCK);
+
+        socketPath = path;
+        feed = &changeFeed;
+        provideSnapshot(snapshot, position);
+        stopping = false;
+        worker = thread(&ReplicationPrimary::run, this);
+        return true;
+    }
+
+    // Stop replicating and disconnect the followers
+    void stop()
+    {
+        if (!worker.joinable())
+        {
+            return;
+        }
+        stopping = true;
+        worker.join();
+        for (int fd : followers)
+        {
+            close(fd);
+        }
+        followers.clear();
+        close(listenFd);
+        listenFd = -1;
+        unlink(socketPath.c_str());
+    }
+
+    // Whether the replication thread fell behind the change feed and needs a new snapshot from the primary's thread
+    bool snapshotRequested() const
+    {
+        return needSnapshot.load();
+    }
+
+    // Hand over a snapshot of every task together with the feed position it corresponds to (called on the primary's thread)
+    void provideSnapshot(const vector<Task> &snapshot, const ChangeSubscription &position)
+    {
+        lock_guard<mutex> lock(snapshotMutex);
+        pendingSnapshot = snapshot;
+        pendingPosition = position;
+        hasPendingSnapshot = true;
+        needSnapshot = false;
+    }
+
+    // Number of connected followers
+    size_t followerCount() const
+    {
+        return connectedFollowers.load();
+    }
+
+    // Sequence number of the next change the followers will be sent
+    uint64_t shippedSequence() const
+    {
+        return shipped.load();
+    }
+
+private:
+    // Body of the replication thread
+    void run()
+    {
+        Tracer::instance().setThreadName("replication");
+        ReplicaStore store;
+        ChangeSubscription subscription;
+        bool haveStore = false;
+        auto lastHeartbeat = chrono::steady_clock::now();
+        vector<ChangeEvent> delta;
+
+        while (!stopping)
+        {
+            // Start again from a snapshot handed over by the primary's thread
+            {
+                lock_guard<mutex> lock(snapshotMutex);
+                if (hasPendingSnapshot)
+                {
+                    store.reset(pendingSnapshot, pendingPosition.nextSequence);
+                    subscription = pendingPosition;
+                    pendingSnapshot.clear();
+                    hasPendingSnapshot = false;
+                    needSnapshot = false;
+                    haveStore = true;
+                    broadcast(ReplicationWire::snapshot(store));
+                }
+            }
+
+            acceptFollowers(store, haveStore);
+
+            if (!haveStore || !feed->waitForChanges(subscription, chrono::milliseconds(100)))
+            {
+                if (haveStore && chrono::steady_clock::now() - lastHeartbeat > chrono::seconds(1))
+                {
+                    broadcast(ReplicationWire::heartbeat(store.nextSequence));
+                    lastHeartbeat = chrono::steady_clock::now();
+                }
+                if (!haveStore)
+                {
+                    this_thread::sleep_for(chrono::milliseconds(20));
+                }
+                continue;
+            }
+
+            if (feed->read(subscription, delta) == FeedStatus::RESYNC)
+            {
+                // The feed moved on without us; the primary's thread provides a new snapshot at its next change
+                haveStore = false;
+                needSnapshot = true;
+                continue;
+            }
+            for (const ChangeEvent &event : delta)
+            {
+                store.apply(event);
+                broadcast(ReplicationWire::event(event));
+                Metrics::instance().add(MetricCounter::REPLICATION_EVENTS_SENT);
+            }
+            shipped = store.nextSequence;
+        }
+    }
+
+    // Accept the followers waiting to connect and send each of them the current snapshot
+    void acceptFollowers(const ReplicaStore &store, bool haveStore)
+    {
+        int fd;
+        while ((fd = accept(listenFd, nullptr, nullptr)) >= 0)
+        {
+            if (haveStore && !ReplicationWire::send(fd, ReplicationWire::snapshot(store)))
+            {
+                close(fd);
+                continue;
+            }
+            followers.push_back(fd);
+        }
+        connectedFollowers = followers.size();
+    }
+
+    // Send a message to every follower, dropping the ones that disconnected
+    void broadcast(const string &payload)
+    {
+        for (size_t i = 0; i < followers.size();)
+        {
+            if (ReplicationWire::send(followers[i], payload))
+            {
+                i++;
+                continue;
+            }
+            close(followers[i]);
+            followers[i] = followers.back();
+            followers.pop_back();
+        }
+        connectedFollowers = followers.size();
+    }
+
+    string socketPath;                   // Path of the listening socket
+    int listenFd = -1;                   // Listening socket
+    const ChangeFeed *feed = nullptr;    // Change feed of the replicated project
+    vector<int> followers;               // Connected followers (used only by the replication thread)
+    atomic<size_t> connectedFollowers{0};
+    atomic<uint64_t> shipped{0};         // Next sequence number to ship
+    atomic<bool> stopping{false};
+    atomic<bool> needSnapshot{false};    // The replication thread is waiting for a snapshot
+
+    mutex snapshotMutex;                 // Protects the snapshot handed over by the primary's thread
+    vector<Task> pendingSnapshot;
+    ChangeSubscription pendingPosition;
+    bool hasPendingSnapshot = false;
+
+    thread worker; // The replication thread
+};
+
+// Replication state of a follower, for reporting
+struct FollowerStatus
+{
+    bool connected = false;        // Still receiving from the primary
+    uint64_t appliedSequence = 0;  // Next change the follower expects
+    uint64_t primarySequence = 0;  // Next change of the primary, as of its last message
+    int64_t lagMicros = 0;         // Time between the last applied change on the primary and its application here
+    size_t taskCount = 0;
+    uint64_t checksum = 0;         // Checksum of the replicated tasks in ID order
+};
+
+// The ReplicationFollower class keeps a read-only copy of the primary's tasks up to date.
+class ReplicationFollower
+{
+public:
+    ~ReplicationFollower()
+    {
+        stopping = true;
+        if (worker.joinable())
+        {
+            worker.join();
+        }
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+    }
+
+    // Connect to a primary's socket and start applying its changes; returns false if it cannot be reached.
+    // Once connected, the follower reconnects by itself whenever the connection is lost.
+    bool connect(const string &path)
+    {
+        primaryPath = path;
+        if (!openConnection())
+        {
+            cerr << "Unable to connect to primary at " << path << ": " << strerror(errno) << endl;
+            return false;
+        }
+        connected = true;
+        worker = thread(&ReplicationFollower::run, this);
+        return true;
+    }
+
+    // Copy of the replicated tasks in ID order
+    vector<Task> tasks() const
+    {
+        lock_guard<mutex> lock(storeMutex);
+        vector<Task> result;
+        result.reserve(store.tasks.size());
+        for (const auto &entry : store.tasks)
+        {
+            result.push_back(entry.second);
+        }
+        return result;
+    }
+
+    // Serialized copy of the replicated tasks (identical to the primary's once the follower has caught up)
+    string serialize() const
+    {
+        lock_guard<mutex> lock(storeMutex);
+        return store.serialize();
+    }
+
+    FollowerStatus status() const
+    {
+        lock_guard<mutex> lock(storeMutex);
+        FollowerStatus result;
+        result.connected = connected;
+        result.appliedSequence = store.nextSequence;
+        result.primarySequence = max(primarySequence, store.nextSequence);
+        result.lagMicros = lagMicros;
+        result.taskCount = store.tasks.size();
+        result.checksum = ReplicaStore::checksum(store.serialize());
+        return result;
+    }
+
+    // Wait until the follower has applied every change before a sequence number; returns false on timeout
+    bool waitForSequence(uint64_t sequence, chrono::milliseconds timeout) const
+    {
+        auto deadline = chrono::steady_clock::now() + timeout;
+        while (chrono::steady_clock::now() < deadline)
+        {
+            {
+                lock_guard<mutex> lock(storeMutex);
+                if (store.nextSequence >= sequence)
+                {
+                    return true;
+                }
+            }
+            this_thread::sleep_for(chrono::milliseconds(5));
+        }
+        return false;
+    }
+
+private:
+    // Open a new connection to the primary in fd; returns false (with errno set) if it cannot be reached
+    bool openConnection()
+    {
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        sockaddr_un addr;
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0)
+        {
+            return false;
+        }
+        if (!ReplicationWire::address(primaryPath, addr) || ::connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0)
+        {
+            int error = errno;
+            close(fd);
+            fd = -1;
+            errno = error;
+            return false;
+        }
+        return true;
+    }
+
+    // Body of the receiving thread: apply messages, and connect again with a growing delay after the connection is lost
+    void run()
+    {
+        Tracer::instance().setThreadName("follower");
+        string payload;
+        int delayMs = 100;
+        while (!stopping)
+        {
+            if (fd < 0)
+            {
+                // Wait in short steps, so that stopping is not held up by the delay
+                for (int waited = 0; waited < delayMs && !stopping; waited += 50)
+                {
+                    this_thread::sleep_for(chrono::milliseconds(50));
+                }
+                if (stopping || !openConnection())
+                {
+                    delayMs = min(delayMs * 2, 5000);
+                    continue;
+                }
+                delayMs = 100;
+                lock_guard<mutex> lock(storeMutex);
+                connected = true; // The primary starts the new connection with a snapshot
+                continue;
+            }
+
+            int result = ReplicationWire::receive(fd, payload, 100);
+            if (result == 0)
+            {
+                continue;
+            }
+            if (result < 0 || !applyMessage(payload))
+            {
+                close(fd);
+                fd = -1;
+                lock_guard<mutex> lock(storeMutex);
+                connected = false;
+            }
+        }
+    }
+
+    // Apply one message from the primary; returns false if it is malformed
+    bool applyMessage(const string &payload)
+    {
+        size_t headerEnd = payload.find('\n');
+        if (headerEnd == string::npos)
+        {
+            return false;
+        }
+        istringstream header(payload.substr(0, headerEnd));
+        char kind = 0;
+        uint64_t sequence = 0;
+        int64_t sentMicros = 0;
+        header >> kind >> sequence >> sentMicros;
+        if (!header)
+        {
+            return false;
+        }
+
+        if (kind == 'H')
+        {
+            lock_guard<mutex> lock(storeMutex);
+            primarySequence = sequence;
+            if (store.nextSequence >= sequence)
+            {
+                lagMicros = 0; // Caught up
+            }
+            return true;
+        }
+
+        vector<Task> parsed;
+        if (!ReplicationWire::parseTasks(payload, headerEnd + 1, parsed))
+        {
+            return false;
+        }
+        if (kind == 'S')
+        {
+            lock_guard<mutex> lock(storeMutex);
+            store.reset(parsed, sequence);
+            primarySequence = max(primarySequence, sequence);
+            return true;
+        }
+        if (kind != 'E')
+        {
+            return false;
+        }
+
+        int type = 0;
+        ChangeEvent event;
+        header >> type >> event.taskID;
+        if (!header || type < 0 || type > int(ChangeType::DELETED) || (type != int(ChangeType::DELETED) && parsed.size() != 1))
+        {
+            return false;
+        }
+        event.sequence = sequence;
+        event.type = ChangeType(type);
+        if (!parsed.empty())
+        {
+            event.task = parsed[0];
+        }
+
+        lock_guard<mutex> lock(storeMutex);
+        store.apply(event);
+        primarySequence = max(primarySequence, store.nextSequence);
+        lagMicros = max<int64_t>(0, replicationClockMicros() - sentMicros);
+        Metrics::instance().recordLatency(MetricTimer::REPLICATION_LAG, uint64_t(lagMicros) * 1000);
+        return true;
+    }
+
+    string primaryPath;              // Socket of the primary, for connecting again
+    int fd = -1;                     // Connection to the primary (-1 while reconnecting)
+    mutable mutex storeMutex;        // Protects everything below
+    ReplicaStore store;              // Replicated tasks
+    uint64_t primarySequence = 0;    // Primary's position as of its last message
+    int64_t lagMicros = 0;           // Lag of the last applied change
+    bool connected = false;
+    atomic<bool> stopping{false};
+    thread worker; // The receiving thread
+};
+
+#endif
@@ -0,0 +1,713 @@
+// This file implements the full-text search index used by the TaskManager class to find tasks by words in their title or description.
+// The index keeps two kinds of posting lists, both sorted by task ID so that they can be intersected quickly:
+// - token postings map every lowercase word to the tasks containing it, together with how often it appears in the title and description;
+// - trigram postings map every run of three characters to the tasks containing it, which narrows down substring queries before they are verified.
+// The index keeps no text of its own. A query term that is a whole word of a candidate is checked against its token posting; other terms
+// are verified against the text of the task, which the caller looks up (so a description left in the task file by a lazy load is only
+// read back for a term that is not a whole word of the task). The caller also hands in the text a task was indexed with when the task
+// is changed or removed.
+// The index is updated incrementally when tasks are created, edited or deleted, and it is saved in a binary file next to the task file.
+
+#ifndef TASK_SEARCH_INDEX_CPP
+#define TASK_SEARCH_INDEX_CPP
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <unordered_map> // Dictionaries from token/trigram to posting list
+#include <algorithm>     // lower_bound, sort and set intersection helpers
+#include <cstdint>       // Fixed-width integer types for the on-disk format
+#include <cctype>        // isalnum() and tolower() for tokenizing
+#include <filesystem>    // Size of the index file, which bounds the lengths read from it
+
+using namespace std;
+
+// One entry of a token posting list
+struct TokenPosting
+{
+    int taskID;          // Task containing the token
+    uint16_t titleHits;  // Number of times the token appears in the title
+    uint16_t descHits;   // Number of times the token appears in the description
+};
+
+// A ranked search result
+struct SearchHit
+{
+    int taskID; // Matching task
+    int score;  // Higher scores are better matches
+};
+
+// The SearchIndex class maintains the token and trigram postings for a set of tasks.
+class SearchIndex
+{
+public:
+    // Convert text to the normalized form that is indexed and searched (lowercase ASCII)
+    static string normalize(const string &text)
+    {
+        string result(text);
+        transform(result.begin(), result.end(), result.begin(), [](unsigned char c)
+                  { return char(tolower(c)); });
+        return result;
+    }
+
+    // Split normalized text into words made of letters and digits
+    static vector<string> tokenize(const string &normalized)
+    {
+        vector<string> tokens;
+        string current;
+        for (char c : normalized)
+        {
+            if (isalnum((unsigned char)c))
+            {
+                current += c;
+            }
+            else if (!current.empty())
+            {
+                tokens.push_back(current);
+                current.clear();
+            }
+        }
+        if (!current.empty())
+        {
+            tokens.push_back(current);
+        }
+        return tokens;
+    }
+
+    // Pack three characters into one integer key
+    static uint32_t packTrigram(const char *p)
+    {
+        return (uint32_t((unsigned char)p[0]) << 16) | (uint32_t((unsigned char)p[1]) << 8) | uint32_t((unsigned char)p[2]);
+    }
+
+    // Distinct trigrams of a piece of normalized text
+    static vector<uint32_t> trigramsOf(const string &normalized)
+    {
+        vector<uint32_t> trigrams;
+        for (size_t i = 0; i + 3 <= normalized.size(); i++)
+        {
+            trigrams.push_back(packTrigram(normalized.data() + i));
+        }
+        sort(trigrams.begin(), trigrams.end());
+        trigrams.erase(unique(trigrams.begin(), trigrams.end()), trigrams.end());
+        return trigrams;
+    }
+
+    // Start adding many tasks at once. Until endBatch(), addTask() appends IDs that arrive out of order to the end of the posting
+    // lists instead of moving the rest of each list to make room, and endBatch() puts every list it touched back in order with one merge.
+    // Tasks added during a batch must not be in the index already, and the index must not be searched or changed otherwise until endBatch().
+    void beginBatch()
+    {
+        batching = true;
+    }
+
+    void endBatch()
+    {
+        for (auto &entry : unsortedTokens)
+        {
+            vector<TokenPosting> &postings = *entry.first;
+            auto byID = [](const TokenPosting &a, const TokenPosting &b)
+            { return a.taskID < b.taskID; };
+            sort(postings.begin() + entry.second, postings.end(), byID);
+            inplace_merge(postings.begin(), postings.begin() + entry.second, postings.end(), byID);
+        }
+        for (auto &entry : unsortedTrigrams)
+        {
+            vector<int> &ids = *entry.first;
+            sort(ids.begin() + entry.second, ids.end());
+            inplace_merge(ids.begin(), ids.begin() + entry.second, ids.end());
+        }
+        unsortedTokens.clear();
+        unsortedTrigrams.clear();
+        batching = false;
+    }
+
+    // Add a task to the index (it must not be in the index already)
+    void addTask(int taskID, const string &title, const string &description)
+    {
+        string normalizedTitle = normalize(title);
+        string normalizedDescription = normalize(description);
+
+        // Count how often each token occurs in the title and the description
+        unordered_map<string, pair<uint16_t, uint16_t>> hits;
+        for (const string &token : tokenize(normalizedTitle))
+        {
+            hits[token].first++;
+        }
+        for (const string &token : tokenize(normalizedDescription))
+        {
+            hits[token].second++;
+        }
+        for (auto &entry : hits)
+        {
+            vector<TokenPosting> &postings = tokenPostings[entry.first];
+            TokenPosting posting{taskID, entry.second.first, entry.second.second};
+            if (batching)
+            {
+                // The list may already be out of order, so the new posting always goes at the end
+                if (!postings.empty() && postings.back().taskID > taskID)
+                {
+                    unsortedTokens.emplace(&postings, postings.size()); // Sorted by endBatch()
+                }
+                postings.push_back(posting);
+            }
+            else
+            {
+                insertPosting(postings, posting);
+            }
+        }
+
+        // Trigrams are taken from each field separately so that no trigram spans the title and the description
+        for (uint32_t trigram : documentTrigrams(normalizedTitle, normalizedDescription))
+        {
+            vector<int> &ids = trigramPostings[trigram];
+            if (batching)
+            {
+                if (!ids.empty() && ids.back() > taskID)
+                {
+                    unsortedTrigrams.emplace(&ids, ids.size()); // Sorted by endBatch()
+                }
+                ids.push_back(taskID);
+            }
+            else
+            {
+                insertId(ids, taskID);
+            }
+        }
+
+        dirty = true;
+    }
+
+    // Update the indexed text of a task; oldTitle and oldDescription must be the text it was indexed with
+    void updateTask(int taskID, const string &oldTitle, const string &oldDescription, const string &title, const string &description)
+    {
+        if (normalize(oldTitle) == normalize(title) && normalize(oldDescription) == normalize(description))
+        {
+            return; // Nothing indexed has changed
+        }
+        removeTask(taskID, oldTitle, oldDescription);
+        addTask(taskID, title, description);
+    }
+
+    // Remove a task from the index; title and description must be the text it was indexed with
+    void removeTask(int taskID, const string &title, const string &description)
+    {
+        string normalizedTitle = normalize(title);
+        string normalizedDescription = normalize(description);
+        vector<string> tokens = tokenize(normalizedTitle);
+        vector<string> descTokens = tokenize(normalizedDescription);
+        tokens.insert(tokens.end(), descTokens.begin(), descTokens.end());
+        sort(tokens.begin(), tokens.end());
+        tokens.erase(unique(tokens.begin(), tokens.end()), tokens.end());
+
+        for (const string &token : tokens)
+        {
+            auto postings = tokenPostings.find(token);
+            if (postings != tokenPostings.end())
+            {
+                erasePosting(postings->second, taskID);
+                if (postings->second.empty())
+                {
+                    tokenPostings.erase(postings);
+                }
+            }
+        }
+
+        for (uint32_t trigram : documentTrigrams(normalizedTitle, normalizedDescription))
+        {
+            auto postings = trigramPostings.find(trigram);
+            if (postings != trigramPostings.end())
+            {
+                eraseId(postings->second, taskID);
+                if (postings->second.empty())
+                {
+                    trigramPostings.erase(postings);
+                }
+            }
+        }
+
+        dirty = true;
+    }
+
+    // Remove everything from the index
+    void clear()
+    {
+        tokenPostings.clear();
+        trigramPostings.clear();
+        dirty = true;
+    }
+
+    // Search the index and return the matching task IDs, best matches first.
+    // Every term in the query must occur in the title or description as a substring; terms in double quotes may contain spaces.
+    // A term that is a whole word of a candidate is checked and scored from its token posting alone. Other terms are verified against
+    // the text of the candidate: titleOf(taskID, title) copies the title and returns false for a task that no longer exists (which is
+    // then left out), and descriptionOf(taskID, description) copies the description. The description is only asked for when a term
+    // is not a whole word of the task, so a search for words does not read back descriptions that a lazy load left in the task file.
+    template <typename TitleOf, typename DescriptionOf>
+    vector<SearchHit> search(const string &query, TitleOf titleOf, DescriptionOf descriptionOf, size_t limit = SIZE_MAX) const
+    {
+        vector<string> terms = parseQuery(query);
+        vector<SearchHit> hits;
+        if (terms.empty())
+        {
+            return hits;
+        }
+
+        // Find the candidate IDs for every term and intersect them, starting with the shortest list
+        vector<vector<int>> candidateLists;
+        vector<const vector<TokenPosting> *> wordPostings; // Token postings of each term that is a word of some task, or nullptr
+        for (const string &term : terms)
+        {
+            candidateLists.push_back(candidatesFor(term));
+            if (candidateLists.back().empty())
+            {
+                return hits; // A term without candidates means no task can match
+            }
+            auto postings = tokenPostings.find(term);
+            wordPostings.push_back(postings != tokenPostings.end() ? &postings->second : nullptr);
+        }
+        sort(candidateLists.begin(), candidateLists.end(), [](const vector<int> &a, const vector<int> &b)
+             { return a.size() < b.size(); });
+
+        vector<int> candidates = candidateLists[0];
+        for (size_t i = 1; i < candidateLists.size() && !candidates.empty(); i++)
+        {
+            candidates = intersect(candidates, candidateLists[i]);
+        }
+
+        // Verify each candidate and score it, reading its text only for the terms that are not whole words of it
+        string title, description;
+        for (int taskID : candidates)
+        {
+            if (!titleOf(taskID, title))
+            {
+                continue;
+            }
+            bool textRead = false;
+            int score = 0;
+            bool matchesAll = true;
+            for (size_t i = 0; i < terms.size() && matchesAll; i++)
+            {
+                const TokenPosting *posting = wordPostings[i] != nullptr ? findPosting(*wordPostings[i], taskID) : nullptr;
+                if (posting != nullptr)
+                {
+                    // Whole-word matches count more than partial ones, and matches in the title more than in the description
+                    score += posting->titleHits * 3 + posting->descHits + 2;
+                    continue;
+                }
+                if (!textRead)
+                {
+                    descriptionOf(taskID, description);
+                    title = normalize(title);
+                    description = normalize(description);
+                    textRead = true;
+                }
+                int termScore = scoreTerm(title, description, terms[i]);
+                matchesAll = termScore != 0;
+                score += termScore;
+            }
+            if (matchesAll)
+            {
+                hits.push_back(SearchHit{taskID, score});
+            }
+        }
+
+        // Rank by score, then by ID so that the order is stable
+        auto better = [](const SearchHit &a, const SearchHit &b)
+        {
+            return a.score != b.score ? a.score > b.score : a.taskID < b.taskID;
+        };
+        if (hits.size() > limit)
+        {
+            partial_sort(hits.begin(), hits.begin() + limit, hits.end(), better);
+            hits.resize(limit);
+        }
+        else
+        {
+            sort(hits.begin(), hits.end(), better);
+        }
+        return hits;
+    }
+
+    // Whether the index has changes that have not been saved yet
+    bool isDirty() const
+    {
+        return dirty;
+    }
+
+    // Approximate number of bytes of memory used by the index
+    size_t memoryUsage() const
+    {
+        size_t bytes = sizeof(*this);
+        for (const auto &entry : tokenPostings)
+        {
+            bytes += sizeof(entry) + entry.first.capacity() + entry.second.capacity() * sizeof(TokenPosting);
+        }
+        for (const auto &entry : trigramPostings)
+        {
+            bytes += sizeof(entry) + entry.second.capacity() * sizeof(int);
+        }
+        return bytes;
+    }
+
+    // Save the index to a binary file; the signature identifies the version of the task file it was built from
+    bool save(const string &path, uint64_t signature)
+    {
+        ofstream file(path, ios::binary | ios::trunc);
+        if (!file.is_open())
+        {
+            cerr << "Unable to open search index for writing: " << path << endl;
+            return false;
+        }
+
+        file.write(MAGIC, sizeof(MAGIC));
+        writeValue(file, signature);
+
+        writeValue(file, uint64_t(tokenPostings.size()));
+        for (auto &entry : tokenPostings)
+        {
+            writeString(file, entry.first);
+            writeValue(file, uint64_t(entry.second.size()));
+            file.write(reinterpret_cast<const char *>(entry.second.data()), entry.second.size() * sizeof(TokenPosting));
+        }
+
+        writeValue(file, uint64_t(trigramPostings.size()));
+        for (auto &entry : trigramPostings)
+        {
+            writeValue(file, entry.first);
+            writeValue(file, uint64_t(entry.second.size()));
+            file.write(reinterpret_cast<const char *>(entry.second.data()), entry.second.size() * sizeof(int));
+        }
+
+        if (!file)
+        {
+            cerr << "Unable to write search index: " << path << endl;
+            return false;
+        }
+        dirty = false;
+        return true;
+    }
+
+    // Load the index from a binary file.
+    // Returns false (leaving the index empty) if the file is missing, damaged or was built from a different version of the task file.
+    bool load(const string &path, uint64_t expectedSignature)
+    {
+        clear();
+        dirty = false;
+
+        error_code error;
+        ifstream file(path, ios::binary);
+        if (!file.is_open())
+        {
+            return false;
+        }
+
+        char magic[sizeof(MAGIC)];
+        uint64_t signature = 0;
+        file.read(magic, sizeof(magic));
+        readValue(file, signature);
+        if (!file || !equal(magic, magic + sizeof(magic), MAGIC) || signature != expectedSignature)
+        {
+            return false;
+        }
+
+        // Every count and length is checked against the bytes left in the file before anything is allocated for it, so a truncated
+        // or damaged file is rebuilt instead of asking for more memory than the file could possibly describe
+        uint64_t fileSize = filesystem::file_size(path, error);
+        uint64_t count = 0;
+        readValue(file, count);
+        if (error || !file || !fits(file, fileSize, count, sizeof(uint32_t) + sizeof(uint64_t)))
+        {
+            return false;
+        }
+        for (uint64_t i = 0; i < count && file; i++)
+        {
+            string token;
+            uint64_t length = 0;
+            readString(file, token, fileSize);
+            readValue(file, length);
+            if (!file || !fits(file, fileSize, length, sizeof(TokenPosting)))
+            {
+                file.setstate(ios::failbit);
+                break;
+            }
+            vector<TokenPosting> &postings = tokenPostings[token];
+            postings.resize(length);
+            file.read(reinterpret_cast<char *>(postings.data()), length * sizeof(TokenPosting));
+        }
+
+        readValue(file, count);
+        if (file && !fits(file, fileSize, count, sizeof(uint32_t) + sizeof(uint64_t)))
+        {
+            file.setstate(ios::failbit);
+        }
+        for (uint64_t i = 0; i < count && file; i++)
+        {
+            uint32_t trigram = 0;
+            uint64_t length = 0;
+            readValue(file, trigram);
+            readValue(file, length);
+            if (!file || !fits(file, fileSize, length, sizeof(int)))
+            {
+                file.setstate(ios::failbit);
+                break;
+            }
+            vector<int> &postings = trigramPostings[trigram];
+            postings.resize(length);
+            file.read(reinterpret_cast<char *>(postings.data()), length * sizeof(int));
+        }
+
+        if (!file)
+        {
+            clear();
+            dirty = false;
+            return false;
+        }
+        return true;
+    }
+
+private:
+    // Layout of the index file, all integers in native byte order:
+    //   magic "TSIDX002", uint64 signature of the task file,
+    //   uint64 token count, then per token: uint32 length, the token, uint64 posting count, the TokenPosting entries,
+    //   uint64 trigram count, then per trigram: uint32 trigram, uint64 posting count, the task IDs as int.
+    // Version 2 files hold only the postings (version 1 files also held the text of every task and are rebuilt)
+    static constexpr char MAGIC[8] = {'T', 'S', 'I', 'D', 'X', '0', '0', '2'};
+
+    // Trigrams of the normalized title and description of a task, without duplicates
+    static vector<uint32_t> documentTrigrams(const string &title, const string &description)
+    {
+        vector<uint32_t> trigrams = trigramsOf(title);
+        vector<uint32_t> descTrigrams = trigramsOf(description);
+        trigrams.insert(trigrams.end(), descTrigrams.begin(), descTrigrams.end());
+        sort(trigrams.begin(), trigrams.end());
+        trigrams.erase(unique(trigrams.begin(), trigrams.end()), trigrams.end());
+        return trigrams;
+    }
+
+    // Split a query into lowercase terms, keeping quoted phrases together
+    static vector<string> parseQuery(const string &query)
+    {
+        vector<string> terms;
+        string normalized = normalize(query);
+        size_t i = 0;
+        while (i < normalized.size())
+        {
+            if (isspace((unsigned char)normalized[i]))
+            {
+                i++;
+            }
+            else if (normalized[i] == '"')
+            {
+                size_t end = normalized.find('"', i + 1);
+                if (end == string::npos)
+                {
+                    end = normalized.size();
+                }
+                if (end > i + 1)
+                {
+                    terms.push_back(normalized.substr(i + 1, end - i - 1));
+                }
+                i = end + 1;
+            }
+            else
+            {
+                size_t end = i;
+                while (end < normalized.size() && !isspace((unsigned char)normalized[end]) && normalized[end] != '"')
+                {
+                    end++;
+                }
+                terms.push_back(normalized.substr(i, end - i));
+                i = end;
+            }
+        }
+        return terms;
+    }
+
+    // Candidate IDs (a superset of the matches) for a single term
+    vector<int> candidatesFor(const string &term) const
+    {
+        vector<int> result;
+        if (term.size() < 3)
+        {
+            // Too short for trigrams: collect the tasks of every token that contains the term
+            for (auto &entry : tokenPostings)
+            {
+                if (entry.first.find(term) != string::npos)
+                {
+                    vector<int> ids;
+                    ids.reserve(entry.second.size());
+                    for (const TokenPosting &posting : entry.second)
+                    {
+                        ids.push_back(posting.taskID);
+                    }
+                    vector<int> merged;
+                    set_union(result.begin(), result.end(), ids.begin(), ids.end(), back_inserter(merged));
+                    result.swap(merged);
+                }
+            }
+            return result;
+        }
+
+        // Intersect the posting lists of all trigrams of the term, shortest first
+        vector<const vector<int> *> lists;
+        for (uint32_t trigram : trigramsOf(term))
+        {
+            auto it = trigramPostings.find(trigram);
+            if (it == trigramPostings.end())
+            {
+                return result;
+            }
+            lists.push_back(&it->second);
+        }
+        sort(lists.begin(), lists.end(), [](const vector<int> *a, const vector<int> *b)
+             { return a->size() < b->size(); });
+
+        result = *lists[0];
+        for (size_t i = 1; i < lists.size() && !result.empty(); i++)
+        {
+            result = intersect(result, *lists[i]);
+        }
+        return result;
+    }
+
+    // Score a term that is not a whole word of a task against its normalized text (0 if it does not occur)
+    static int scoreTerm(const string &title, const string &description, const string &term)
+    {
+        // Matches in the title count more than matches in the description
+        return countOccurrences(title, term) * 3 + countOccurrences(description, term);
+    }
+
+    // Number of (possibly overlapping) occurrences of a term in a text
+    static int countOccurrences(const string &text, const string &term)
+    {
+        int count = 0;
+        for (size_t pos = text.find(term); pos != string::npos; pos = text.find(term, pos + 1))
+        {
+            count++;
+        }
+        return count;
+    }
+
+    // Intersect two sorted ID lists
+    static vector<int> intersect(const vector<int> &a, const vector<int> &b)
+    {
+        vector<int> result;
+        result.reserve(min(a.size(), b.size()));
+        set_intersection(a.begin(), a.end(), b.begin(), b.end(), back_inserter(result));
+        return result;
+    }
+
+    // Insert an ID into a sorted list (IDs usually arrive in increasing order, which is an append)
+    static void insertId(vector<int> &ids, int taskID)
+    {
+        if (ids.empty() || ids.back() < taskID)
+        {
+            ids.push_back(taskID);
+            return;
+        }
+        auto it = lower_bound(ids.begin(), ids.end(), taskID);
+        if (it == ids.end() || *it != taskID)
+        {
+            ids.insert(it, taskID);
+        }
+    }
+
+    // Remove an ID from a sorted list
+    static void eraseId(vector<int> &ids, int taskID)
+    {
+        auto it = lower_bound(ids.begin(), ids.end(), taskID);
+        if (it != ids.end() && *it == taskID)
+        {
+            ids.erase(it);
+        }
+    }
+
+    // Insert a token posting into a list sorted by task ID
+    static void insertPosting(vector<TokenPosting> &postings, const TokenPosting &posting)
+    {
+        auto it = lower_bound(postings.begin(), postings.end(), posting.taskID, [](const TokenPosting &p, int id)
+                              { return p.taskID < id; });
+        if (it != postings.end() && it->taskID == posting.taskID)
+        {
+            *it = posting;
+        }
+        else
+        {
+            postings.insert(it, posting);
+        }
+    }
+
+    // Find a task's posting in a token posting list (nullptr if the task does not contain the token)
+    static const TokenPosting *findPosting(const vector<TokenPosting> &postings, int taskID)
+    {
+        auto it = lower_bound(postings.begin(), postings.end(), taskID, [](const TokenPosting &p, int id)
+                              { return p.taskID < id; });
+        return it != postings.end() && it->taskID == taskID ? &*it : nullptr;
+    }
+
+    // Remove a task's posting from a token posting list
+    static void erasePosting(vector<TokenPosting> &postings, int taskID)
+    {
+        auto it = lower_bound(postings.begin(), postings.end(), taskID, [](const TokenPosting &p, int id)
+                              { return p.taskID < id; });
+        if (it != postings.end() && it->taskID == taskID)
+        {
+            postings.erase(it);
+        }
+    }
+
+    // Binary helpers for save() and load()
+    template <typename T>
+    static void writeValue(ostream &os, const T &value)
+    {
+        os.write(reinterpret_cast<const char *>(&value), sizeof(T));
+    }
+
+    template <typename T>
+    static void readValue(istream &is, T &value)
+    {
+        is.read(reinterpret_cast<char *>(&value), sizeof(T));
+    }
+
+    // Check that count items of itemSize bytes each fit in what is left of a file of fileSize bytes
+    static bool fits(istream &is, uint64_t fileSize, uint64_t count, uint64_t itemSize)
+    {
+        streamoff position = is.tellg();
+        if (position < 0 || uint64_t(position) > fileSize)
+        {
+            return false;
+        }
+        return count <= (fileSize - uint64_t(position)) / itemSize;
+    }
+
+    static void writeString(ostream &os, const string &value)
+    {
+        writeValue(os, uint32_t(value.size()));
+        os.write(value.data(), value.size());
+    }
+
+    static void readString(istream &is, string &value, uint64_t fileSize)
+    {
+        uint32_t length = 0;
+        readValue(is, length);
+        if (!is || !fits(is, fileSize, length, 1))
+        {
+            is.setstate(ios::failbit);
+            return;
+        }
+        value.resize(length);
+        is.read(&value[0], length);
+    }
+
+    unordered_map<string, vector<TokenPosting>> tokenPostings;   // Token -> tasks containing it
+    unordered_map<uint32_t, vector<int>> trigramPostings;        // Trigram -> tasks containing it
+    bool dirty = false;                                          // Changed since the last save() or load()
+
+    bool batching = false;                                       // Between beginBatch() and endBatch()
+    unordered_map<vector<TokenPosting> *, size_t> unsortedTokens; // Token lists with IDs appended out of order, and where the appended part starts
+    unordered_map<vector<int> *, size_t> unsortedTrigrams;        // Trigram lists with IDs appended out of order, and where the appended part starts
+};
+
+#endif
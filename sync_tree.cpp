@@ -0,0 +1,237 @@
+// This file implements the sync tree of a project: a hash tree over the task IDs that lets two copies of a project find the tasks
+// they differ in without comparing every task (see task_sync.cpp).
+// The ID space is split into buckets of 64 consecutive IDs, the leaves of the tree, and every 16 neighbouring nodes have a parent,
+// up to a single root: 8 levels cover every positive ID. Every task has a 64-bit digest of its record (as the task file stores it,
+// without the checksum) mixed with its ID, and the hash of a node is the sum of the digests of the tasks in its ID range.
+// The shape of the tree depends only on the ID space, so two copies can compare their nodes one to one: equal hashes mean the same
+// tasks below (barring a 64-bit collision), and a comparison only walks down the nodes whose hashes differ. A handful of changed
+// tasks is found with at most 16 comparisons per level and changed task, whatever the number of tasks.
+// Summing the digests, instead of hashing the hashes of the children, lets a change update its path to the root in O(depth) without
+// looking at any other task, like the statistics. Only non-empty nodes are stored. The TaskManager builds the tree the first time it
+// is needed and keeps it up to date with every change after that (an unbuilt tree ignores the changes).
+// verify() rebuilds the tree from the tasks and reports the first node that differs, for testing the incremental updates.
+
+#ifndef TASK_SYNC_TREE_CPP
+#define TASK_SYNC_TREE_CPP
+
+#include <string>
+#include <vector>
+#include <map>           // Digests of the tasks by ID, ordered so that a bucket is a range
+#include <unordered_map> // Non-empty nodes of every level
+#include <cstdint>
+#include "processor.cpp"
+#include "task_schema.cpp" // Task records the digests are computed from
+
+using namespace std;
+
+// The SyncTree class keeps the hashes of the ID ranges of the tasks of a project up to date as tasks are created, changed and deleted.
+class SyncTree
+{
+public:
+    static const int leafBits = 6;                      // A leaf covers 64 consecutive IDs
+    static const int fanoutBits = 4;                    // Every node above the leaves covers 16 nodes of the level below
+    static const uint32_t fanout = 1u << fanoutBits;
+    static const int levelCount = 8;                    // Leaves are level 0, the root is level levelCount - 1
+    static const int rootLevel = levelCount - 1;
+
+    // Key of the node of a level whose ID range holds an ID
+    static uint32_t keyOf(int taskID, int level)
+    {
+        return uint32_t(uint64_t(uint32_t(taskID)) >> (leafBits + fanoutBits * level)); // The root shifts by more than 32 bits
+    }
+
+    // Digest of a task: a hash of its record mixed with its ID
+    static uint64_t digest(const Task &task)
+    {
+        string record;
+        TaskSchema::appendRecord(record, task);
+        uint64_t hash = 14695981039346656037ull; // FNV-1a
+        for (unsigned char c : record)
+        {
+            hash = (hash ^ c) * 1099511628211ull;
+        }
+        return mix(hash ^ mix(uint64_t(uint32_t(task.getTaskID()))));
+    }
+
+    // Whether the tree has been built (an unbuilt tree ignores changes)
+    bool isBuilt() const
+    {
+        return built;
+    }
+
+    // Forget every task; the tree has to be built again before it is used
+    void clear()
+    {
+        built = false;
+        digests.clear();
+        for (auto &level : nodes)
+        {
+            level.clear();
+        }
+    }
+
+    // Build the tree from a list of tasks, replacing its contents
+    void rebuild(const vector<Task> &tasks)
+    {
+        clear();
+        built = true;
+        for (const Task &task : tasks)
+        {
+            update(task);
+        }
+    }
+
+    // Add a task, or move it to its new digest after it changed
+    void update(const Task &task)
+    {
+        if (!built)
+        {
+            return;
+        }
+        int taskID = task.getTaskID();
+        uint64_t value = digest(task);
+        auto it = digests.find(taskID);
+        if (it != digests.end())
+        {
+            if (it->second == value)
+            {
+                return; // Only fields outside the record changed
+            }
+            apply(taskID, it->second, false);
+            it->second = value;
+        }
+        else
+        {
+            digests.emplace(taskID, value);
+        }
+        apply(taskID, value, true);
+    }
+
+    // Take a task out of the tree (does nothing if it is not in it)
+    void remove(int taskID)
+    {
+        auto it = digests.find(taskID);
+        if (!built || it == digests.end())
+        {
+            return;
+        }
+        apply(taskID, it->second, false);
+        digests.erase(it);
+    }
+
+    // Hash of a node (0 for a node without tasks)
+    uint64_t hash(int level, uint32_t key) const
+    {
+        if (level < 0 || level >= levelCount)
+        {
+            return 0;
+        }
+        auto it = nodes[level].find(key);
+        return it == nodes[level].end() ? 0 : it->second.hash;
+    }
+
+    uint64_t rootHash() const
+    {
+        return hash(rootLevel, 0);
+    }
+
+    // Append the ID and digest of every task in a leaf to out, in ID order
+    void leafDigests(uint32_t bucket, vector<pair<int, uint64_t>> &out) const
+    {
+        uint64_t first = uint64_t(bucket) << leafBits;
+        uint64_t last = first + (1u << leafBits);
+        if (first > uint64_t(INT32_MAX))
+        {
+            return;
+        }
+        for (auto it = digests.lower_bound(int(first)); it != digests.end() && uint64_t(it->first) < last; ++it)
+        {
+            out.push_back(*it);
+        }
+    }
+
+    // Number of tasks in the tree
+    size_t taskCount() const
+    {
+        return digests.size();
+    }
+
+    // Compare the tree with one built from the tasks; returns false with a description of the first difference
+    bool verify(const vector<Task> &tasks, string &difference) const
+    {
+        SyncTree rebuilt;
+        rebuilt.rebuild(tasks);
+        if (rebuilt.digests != digests)
+        {
+            difference = "holding " + to_string(digests.size()) + " digest(s) instead of " + to_string(rebuilt.digests.size()) + " or a stale digest";
+            return false;
+        }
+        for (int level = 0; level < levelCount; level++)
+        {
+            if (rebuilt.nodes[level].size() != nodes[level].size())
+            {
+                difference = "level " + to_string(level) + " has " + to_string(nodes[level].size()) + " node(s) instead of " +
+                             to_string(rebuilt.nodes[level].size());
+                return false;
+            }
+            for (const auto &node : rebuilt.nodes[level])
+            {
+                if (hash(level, node.first) != node.second.hash)
+                {
+                    difference = "node " + to_string(node.first) + " of level " + to_string(level) + " has a stale hash";
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    // Approximate number of bytes of memory used by the tree
+    size_t memoryUsage() const
+    {
+        size_t bytes = sizeof(*this) + digests.size() * (sizeof(pair<int, uint64_t>) + 4 * sizeof(void *));
+        for (const auto &level : nodes)
+        {
+            bytes += level.size() * (sizeof(pair<uint32_t, Node>) + 2 * sizeof(void *)) + level.bucket_count() * sizeof(void *);
+        }
+        return bytes;
+    }
+
+private:
+    // A non-empty node: the sum of the digests of its tasks, and how many there are (the node is dropped when none are left)
+    struct Node
+    {
+        uint64_t hash = 0;
+        uint32_t count = 0;
+    };
+
+    // Add a digest to, or take it out of, every node on the path from the leaf of a task to the root
+    void apply(int taskID, uint64_t value, bool adding)
+    {
+        for (int level = 0; level < levelCount; level++)
+        {
+            uint32_t key = keyOf(taskID, level);
+            Node &node = nodes[level][key];
+            node.hash += adding ? value : 0 - value;
+            node.count += adding ? 1 : uint32_t(-1);
+            if (node.count == 0)
+            {
+                nodes[level].erase(key);
+            }
+        }
+    }
+
+    // Final step of SplitMix64, which spreads every input bit over the whole result
+    static uint64_t mix(uint64_t x)
+    {
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+        return x ^ (x >> 31);
+    }
+
+    bool built = false;
+    map<int, uint64_t> digests;                              // Digest of every task by ID
+    vector<unordered_map<uint32_t, Node>> nodes = vector<unordered_map<uint32_t, Node>>(levelCount); // Non-empty nodes of every level by key
+};
+
+#endif
@@ -0,0 +1,391 @@
+// This file implements the cold archive for completed tasks.
+// Old completed tasks are moved out of the task file into an append-only archive file, so loading, viewing and rewriting the task file
+// only pays for the tasks that are still being worked on.
+// The archive is a sequence of compressed blocks of up to 256 tasks sorted by ID. Inside a block the IDs and deadlines are stored
+// as differences from the previous task (which usually fit in one byte), and the remaining fields are stored as task records
+// compressed with the BlockCompressor.
+// Every block header records the range of IDs and deadlines it contains. The headers are read when the archive is opened,
+// so a lookup by ID or by date range only decompresses the blocks that can contain a match.
+
+#ifndef TASK_ARCHIVE_CPP
+#define TASK_ARCHIVE_CPP
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <algorithm>  // sort() and min()/max()
+#include <climits>    // INT_MIN and INT_MAX for empty deadline ranges
+#include <sstream>    // The blocks being appended are built in memory first
+#include <filesystem> // Size of the archive before appending
+#include "task_schema.cpp"       // Records and deadlines of the archived tasks
+#include "block_compression.cpp" // Variable-length integers and block compression
+#include "metrics.cpp"           // Counts the blocks written and decompressed
+#include "task_writer.cpp"       // DurableFile syncs the appended blocks
+
+using namespace std;
+
+// Summary of one block of the archive, kept in memory for every block
+struct ArchiveBlock
+{
+    uint64_t payloadOffset;  // Position of the compressed data in the archive file
+    uint32_t taskCount;      // Number of tasks in the block
+    uint32_t rawSize;        // Size of the data before compression
+    uint32_t compressedSize; // Size of the compressed data
+    uint32_t checksum;       // FNV-1a hash of the compressed data
+    int minID;               // Smallest task ID in the block
+    int maxID;               // Largest task ID in the block
+    int minDay;              // Earliest valid deadline as a day number (INT_MAX if the block has none)
+    int maxDay;              // Latest valid deadline as a day number (INT_MIN if the block has none)
+};
+
+// The TaskArchive class reads and appends to an archive file.
+class TaskArchive
+{
+public:
+    // Open an archive file and read its block headers; a missing file is an empty archive.
+    // Returns false if the file is damaged (the blocks before the damage stay readable).
+    bool open(const string &archivePath)
+    {
+        path = archivePath;
+        blocks.clear();
+        archivedTasks = 0;
+
+        ifstream file(path, ios::binary);
+        if (!file.is_open())
+        {
+            return true;
+        }
+
+        char magic[sizeof(MAGIC)];
+        if (!file.read(magic, sizeof(magic)))
+        {
+            return true; // Empty file
+        }
+        if (!equal(magic, magic + sizeof(magic), MAGIC))
+        {
+            cerr << "Not a task archive: " << path << endl;
+            return false;
+        }
+
+        // Step from header to header without reading the compressed data
+        while (file.peek() != EOF)
+        {
+            uint32_t tag = 0;
+            ArchiveBlock block;
+            readValue(file, tag);
+            readValue(file, block.taskCount);
+            readValue(file, block.rawSize);
+            readValue(file, block.compressedSize);
+            readValue(file, block.checksum);
+            readValue(file, block.minID);
+            readValue(file, block.maxID);
+            readValue(file, block.minDay);
+            readValue(file, block.maxDay);
+            if (!file || tag != BLOCK_TAG)
+            {
+                cerr << "Damaged block in task archive: " << path << endl;
+                return false;
+            }
+            block.payloadOffset = uint64_t(file.tellg());
+            file.seekg(block.compressedSize, ios::cur);
+            blocks.push_back(block);
+            archivedTasks += block.taskCount;
+        }
+        return true;
+    }
+
+    // Append tasks to the archive as new blocks; returns false if the archive could not be written.
+    // The blocks are synced to disk (and the directory too when the archive is created) before this returns, because the caller
+    // then rewrites the task file without the archived tasks.
+    bool append(vector<Task> archived)
+    {
+        if (archived.empty())
+        {
+            return true;
+        }
+        sort(archived.begin(), archived.end(), TaskSchema::Order<TaskSchema::IdField>());
+
+        error_code ec;
+        uint64_t offset = filesystem::file_size(path, ec);
+        if (ec)
+        {
+            offset = 0; // The archive does not exist yet
+        }
+
+        ostringstream file(ios::binary | ios::out);
+        if (offset == 0)
+        {
+            file.write(MAGIC, sizeof(MAGIC));
+            offset = sizeof(MAGIC);
+        }
+
+        vector<ArchiveBlock> written;
+        for (size_t first = 0; first < archived.size(); first += tasksPerBlock)
+        {
+            size_t last = min(first + tasksPerBlock, archived.size());
+            string raw;
+            ArchiveBlock block = encodeBlock(archived, first, last, raw);
+
+            string compressed;
+            BlockCompressor::compress(raw, compressed);
+            block.rawSize = uint32_t(raw.size());
+            block.compressedSize = uint32_t(compressed.size());
+            block.checksum = checksumOf(compressed.data(), compressed.size());
+
+            writeValue(file, BLOCK_TAG);
+            writeValue(file, block.taskCount);
+            writeValue(file, block.rawSize);
+            writeValue(file, block.compressedSize);
+            writeValue(file, block.checksum);
+            writeValue(file, block.minID);
+            writeValue(file, block.maxID);
+            writeValue(file, block.minDay);
+            writeValue(file, block.maxDay);
+            file.write(compressed.data(), compressed.size());
+
+            block.payloadOffset = offset + headerSize;
+            offset = block.payloadOffset + block.compressedSize;
+            written.push_back(block);
+        }
+
+        if (!file || !DurableFile::append(path, file.str()))
+        {
+            return false;
+        }
+        for (const ArchiveBlock &block : written)
+        {
+            blocks.push_back(block);
+            archivedTasks += block.taskCount;
+        }
+        Metrics::instance().add(MetricCounter::ARCHIVE_TASKS_WRITTEN, archived.size());
+        return true;
+    }
+
+    // Find an archived task by its ID; returns false if it is not in the archive
+    bool findById(int taskID, Task &task)
+    {
+        // Later blocks are searched first, so the most recently archived copy wins
+        for (size_t i = blocks.size(); i-- > 0;)
+        {
+            if (taskID < blocks[i].minID || taskID > blocks[i].maxID)
+            {
+                continue;
+            }
+            vector<Task> decoded;
+            if (!decodeBlock(blocks[i], decoded))
+            {
+                continue;
+            }
+            auto it = lower_bound(decoded.begin(), decoded.end(), taskID, [](const Task &a, int id)
+                                  { return a.getTaskID() < id; });
+            if (it != decoded.end() && it->getTaskID() == taskID)
+            {
+                task = *it;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Check whether a task ID is used by an archived task
+    bool contains(int taskID)
+    {
+        Task task;
+        return findById(taskID, task);
+    }
+
+    // Find the archived tasks whose deadline falls between two day numbers (inclusive), ordered by date
+    vector<Task> findByDateRange(int fromDay, int toDay)
+    {
+        vector<Task> result;
+        for (const ArchiveBlock &block : blocks)
+        {
+            if (block.maxDay < fromDay || block.minDay > toDay)
+            {
+                continue;
+            }
+            vector<Task> decoded;
+            if (!decodeBlock(block, decoded))
+            {
+                continue;
+            }
+            for (Task &task : decoded)
+            {
+                int day;
+                if (DeadlineCodec::dayNumber(TaskSchema::DeadlineField::get(task), day) && day >= fromDay && day <= toDay)
+                {
+                    result.push_back(task);
+                }
+            }
+        }
+        stable_sort(result.begin(), result.end(), TaskSchema::ByDate());
+        return result;
+    }
+
+    // Largest task ID in the archive (0 if it is empty), read from the block headers without decoding any block
+    int maxTaskID() const
+    {
+        int largest = 0;
+        for (const ArchiveBlock &block : blocks)
+        {
+            largest = max(largest, block.maxID);
+        }
+        return largest;
+    }
+
+    // Number of tasks in the archive
+    size_t taskCount() const
+    {
+        return archivedTasks;
+    }
+
+    // Number of blocks in the archive
+    size_t blockCount() const
+    {
+        return blocks.size();
+    }
+
+private:
+    static constexpr size_t tasksPerBlock = 256;
+    static constexpr char MAGIC[8] = {'T', 'S', 'A', 'R', 'C', '0', '0', '1'};
+    static constexpr uint32_t BLOCK_TAG = 0x4B4C4254; // "TBLK"
+    static constexpr uint64_t headerSize = 9 * sizeof(uint32_t);
+
+    // Build the uncompressed data of a block from archived[first, last).
+    // Layout: the ID and deadline differences of every task, followed by the task records with the ID and valid deadlines left out.
+    static ArchiveBlock encodeBlock(const vector<Task> &archived, size_t first, size_t last, string &raw)
+    {
+        ArchiveBlock block = {};
+        block.taskCount = uint32_t(last - first);
+        block.minID = archived[first].getTaskID();
+        block.maxID = archived[last - 1].getTaskID();
+        block.minDay = INT_MAX;
+        block.maxDay = INT_MIN;
+
+        string records;
+        int previousID = 0;
+        int previousDay = 0;
+        for (size_t i = first; i < last; i++)
+        {
+            Task task = archived[i];
+            int taskID = TaskSchema::IdField::get(task);
+            appendVarint(raw, zigzagEncode(int64_t(taskID) - previousID));
+            previousID = taskID;
+
+            // Valid deadlines are stored as a difference of day numbers, with the lowest bit marking that a deadline follows
+            int day;
+            if (DeadlineCodec::dayNumber(TaskSchema::DeadlineField::get(task), day))
+            {
+                appendVarint(raw, (zigzagEncode(int64_t(day) - previousDay) << 1) | 1);
+                previousDay = day;
+                block.minDay = min(block.minDay, day);
+                block.maxDay = max(block.maxDay, day);
+                TaskSchema::DeadlineField::get(task).clear();
+            }
+            else
+            {
+                appendVarint(raw, 0); // The deadline text stays in the record
+            }
+
+            TaskSchema::IdField::get(task) = 0;
+            TaskSchema::appendRecord(records, task);
+        }
+        raw += records;
+        return block;
+    }
+
+    // Read and decompress a block; returns false if it is damaged
+    bool decodeBlock(const ArchiveBlock &block, vector<Task> &decoded)
+    {
+        Metrics::instance().add(MetricCounter::ARCHIVE_BLOCKS_DECODED);
+
+        ifstream file(path, ios::binary);
+        string compressed(block.compressedSize, '\0');
+        file.seekg(streamoff(block.payloadOffset));
+        if (!file.read(&compressed[0], compressed.size()) || checksumOf(compressed.data(), compressed.size()) != block.checksum)
+        {
+            cerr << "Damaged block in task archive: " << path << endl;
+            return false;
+        }
+        string raw;
+        if (!BlockCompressor::decompress(compressed.data(), compressed.size(), block.rawSize, raw))
+        {
+            cerr << "Damaged block in task archive: " << path << endl;
+            return false;
+        }
+
+        // Read the ID and deadline columns
+        const char *p = raw.data();
+        const char *end = p + raw.size();
+        vector<int> ids(block.taskCount);
+        vector<int> days(block.taskCount);
+        vector<bool> hasDay(block.taskCount);
+        int64_t previousID = 0;
+        int64_t previousDay = 0;
+        for (uint32_t i = 0; i < block.taskCount; i++)
+        {
+            uint64_t idDelta = 0;
+            uint64_t dayValue = 0;
+            if (!readVarint(p, end, idDelta) || !readVarint(p, end, dayValue))
+            {
+                return false;
+            }
+            previousID += zigzagDecode(idDelta);
+            ids[i] = int(previousID);
+            hasDay[i] = (dayValue & 1) != 0;
+            if (hasDay[i])
+            {
+                previousDay += zigzagDecode(dayValue >> 1);
+                days[i] = int(previousDay);
+            }
+        }
+
+        // Read the records and put the IDs and deadlines back
+        FieldScanner scanner(p, size_t(end - p), false);
+        vector<string> fields;
+        decoded.clear();
+        decoded.reserve(block.taskCount);
+        for (uint32_t i = 0; i < block.taskCount && scanner.nextRecord(fields); i++)
+        {
+            Task task;
+            TaskSchema::parseRecord(fields, task);
+            TaskSchema::IdField::get(task) = ids[i];
+            if (hasDay[i])
+            {
+                TaskSchema::DeadlineField::get(task) = DeadlineCodec::fromDayNumber(days[i]);
+            }
+            decoded.push_back(task);
+        }
+        return decoded.size() == block.taskCount;
+    }
+
+    // FNV-1a hash used to detect damaged blocks
+    static uint32_t checksumOf(const char *data, size_t size)
+    {
+        uint32_t hash = 2166136261u;
+        for (size_t i = 0; i < size; i++)
+        {
+            hash = (hash ^ (unsigned char)data[i]) * 16777619u;
+        }
+        return hash;
+    }
+
+    template <typename T>
+    static void writeValue(ostream &os, const T &value)
+    {
+        os.write(reinterpret_cast<const char *>(&value), sizeof(value));
+    }
+
+    template <typename T>
+    static void readValue(istream &is, T &value)
+    {
+        is.read(reinterpret_cast<char *>(&value), sizeof(value));
+    }
+
+    string path;                  // Path of the archive file
+    vector<ArchiveBlock> blocks;  // Header of every block, in file order
+    size_t archivedTasks = 0;     // Total number of archived tasks
+};
+
+#endif
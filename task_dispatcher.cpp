@@ -0,0 +1,217 @@
+// This file implements the dispatcher that answers "which task should be worked on next?" without sorting the whole task list.
+// The tasks that can be picked up (pending and not waiting on any unfinished task) are kept in an indexed 4-ary heap,
+// ordered by priority (highest first), then by deadline (earliest first), then by task ID.
+// The heap remembers where every task is stored, so a task whose priority or deadline changes is moved up or down in O(log n),
+// and a task that is completed, started or deleted is removed in O(log n).
+// Claiming a task takes a lock, so several worker threads can use the dispatcher as a shared work queue.
+
+#ifndef TASK_DISPATCHER_CPP
+#define TASK_DISPATCHER_CPP
+
+#include <vector>
+#include <unordered_map> // Position of every task in the heap
+#include <mutex>         // Serializes concurrent claims
+#include <climits>       // INT_MAX for tasks without a valid deadline
+#include "task_schema.cpp" // DeadlineCodec turns the deadline into a sort key
+
+using namespace std;
+
+// Sort key of a task in the dispatcher
+struct DispatchKey
+{
+    int priority; // Higher values are dispatched first
+    int deadline; // Deadline as YYYYMMDD (INT_MAX if the deadline is not a valid date)
+    int taskID;   // Keeps tasks with equal priority and deadline in a fixed order
+
+    // Build the key of a task
+    static DispatchKey of(const Task &task)
+    {
+        int deadlineKey = DeadlineCodec::dateKey(task.getDeadline());
+        return {int(task.getPriorityValue()), deadlineKey < 0 ? INT_MAX : deadlineKey, task.getTaskID()};
+    }
+
+    // Check whether this key should be dispatched before another one
+    bool before(const DispatchKey &other) const
+    {
+        if (priority != other.priority)
+        {
+            return priority > other.priority;
+        }
+        if (deadline != other.deadline)
+        {
+            return deadline < other.deadline;
+        }
+        return taskID < other.taskID;
+    }
+};
+
+// The TaskDispatcher class is a thread-safe indexed priority queue of the tasks ready to be worked on.
+class TaskDispatcher
+{
+public:
+    // Add a task, or move it to its new place if it is already queued
+    void push(const DispatchKey &key)
+    {
+        lock_guard<mutex> lock(heapMutex);
+        auto it = position.find(key.taskID);
+        if (it == position.end())
+        {
+            heap.push_back(key);
+            position[key.taskID] = heap.size() - 1;
+            siftUp(heap.size() - 1);
+            return;
+        }
+
+        // Decrease-key or increase-key: the task only moves towards the top or towards the bottom
+        size_t index = it->second;
+        bool moveUp = key.before(heap[index]);
+        heap[index] = key;
+        if (moveUp)
+        {
+            siftUp(index);
+        }
+        else
+        {
+            siftDown(index);
+        }
+    }
+
+    // Remove a task from the queue (does nothing if it is not queued)
+    void remove(int taskID)
+    {
+        lock_guard<mutex> lock(heapMutex);
+        auto it = position.find(taskID);
+        if (it != position.end())
+        {
+            removeAt(it->second);
+        }
+    }
+
+    // Check whether a task is queued
+    bool contains(int taskID) const
+    {
+        lock_guard<mutex> lock(heapMutex);
+        return position.count(taskID) != 0;
+    }
+
+    // Look at the next task without removing it; returns false if the queue is empty
+    bool peek(int &taskID) const
+    {
+        lock_guard<mutex> lock(heapMutex);
+        if (heap.empty())
+        {
+            return false;
+        }
+        taskID = heap.front().taskID;
+        return true;
+    }
+
+    // Take the next task off the queue; returns false if the queue is empty.
+    // Each task is handed to exactly one caller, even when several threads claim at the same time.
+    bool claim(int &taskID)
+    {
+        lock_guard<mutex> lock(heapMutex);
+        if (heap.empty())
+        {
+            return false;
+        }
+        taskID = heap.front().taskID;
+        removeAt(0);
+        return true;
+    }
+
+    // Number of queued tasks
+    size_t size() const
+    {
+        lock_guard<mutex> lock(heapMutex);
+        return heap.size();
+    }
+
+    // Remove every task from the queue
+    void clear()
+    {
+        lock_guard<mutex> lock(heapMutex);
+        heap.clear();
+        position.clear();
+    }
+
+private:
+    static const size_t arity = 4; // Children per node; a wider heap is shallower and reads children from the same cache line
+
+    // Remove the entry at an index by replacing it with the last entry
+    void removeAt(size_t index)
+    {
+        position.erase(heap[index].taskID);
+        size_t last = heap.size() - 1;
+        if (index != last)
+        {
+            heap[index] = heap[last];
+            position[heap[index].taskID] = index;
+        }
+        heap.pop_back();
+        if (index < heap.size())
+        {
+            siftUp(index);
+            siftDown(index);
+        }
+    }
+
+    // Move an entry towards the top until its parent comes before it
+    void siftUp(size_t index)
+    {
+        DispatchKey key = heap[index];
+        while (index > 0)
+        {
+            size_t parent = (index - 1) / arity;
+            if (!key.before(heap[parent]))
+            {
+                break;
+            }
+            heap[index] = heap[parent];
+            position[heap[index].taskID] = index;
+            index = parent;
+        }
+        heap[index] = key;
+        position[key.taskID] = index;
+    }
+
+    // Move an entry towards the bottom until it comes before all of its children
+    void siftDown(size_t index)
+    {
+        DispatchKey key = heap[index];
+        while (true)
+        {
+            size_t first = index * arity + 1;
+            if (first >= heap.size())
+            {
+                break;
+            }
+
+            // Find the child that should be dispatched first
+            size_t best = first;
+            size_t last = min(first + arity, heap.size());
+            for (size_t child = first + 1; child < last; child++)
+            {
+                if (heap[child].before(heap[best]))
+                {
+                    best = child;
+                }
+            }
+            if (!heap[best].before(key))
+            {
+                break;
+            }
+            heap[index] = heap[best];
+            position[heap[index].taskID] = index;
+            index = best;
+        }
+        heap[index] = key;
+        position[key.taskID] = index;
+    }
+
+    mutable mutex heapMutex;                // Protects the heap and the positions
+    vector<DispatchKey> heap;               // 4-ary heap, the next task to dispatch is at index 0
+    unordered_map<int, size_t> position;    // Index of every queued task in the heap
+};
+
+#endif
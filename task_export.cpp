@@ -0,0 +1,797 @@
+// This file implements exporting tasks to JSON Lines and CSV files and importing them back, for exchanging tasks with other systems.
+// JSON Lines files hold one JSON object per task, with a member for every field of the task schema. CSV files start with a header
+// line naming the fields and then hold one record per task, quoted in the RFC-4180 style exactly like the task file.
+// Both directions stream: the exporter formats each task into a fixed-size buffer that is written out whenever it fills up, and the
+// importer reads the file in fixed-size chunks (or one line at a time for JSON Lines), so memory use does not depend on the size
+// of the file. Imported records are checked before they are handed over: the ID must be a number, the priority and status must
+// be known values and the deadline must be a valid DD/MM/YYYY date. Records that fail are reported with their record number and skipped.
+
+#ifndef TASK_EXPORT_CPP
+#define TASK_EXPORT_CPP
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdio>  // FILE for unbuffered block reads and writes
+#include <utility> // index_sequence for walking the field table
+#include "processor.cpp"
+#include "task_schema.cpp"   // Field names and the codecs that read and write field values
+#include "record_format.cpp" // Quoting rules and the scanner for CSV records
+
+using namespace std;
+
+// File formats tasks can be exported to and imported from
+enum class ExportFormat
+{
+    JSON_LINES, // One JSON object per line
+    CSV         // RFC-4180 CSV with a header line
+};
+
+// Read a format name ("jsonl", "json" or "csv"); returns false if the name is unknown
+inline bool parseExportFormat(const string &name, ExportFormat &format)
+{
+    if (name == "jsonl" || name == "json")
+    {
+        format = ExportFormat::JSON_LINES;
+        return true;
+    }
+    if (name == "csv")
+    {
+        format = ExportFormat::CSV;
+        return true;
+    }
+    return false;
+}
+
+// Format of a file judging by its name: CSV for names ending in .csv, JSON Lines otherwise
+inline ExportFormat exportFormatOf(const string &filename)
+{
+    bool csv = filename.size() >= 4 && filename.compare(filename.size() - 4, 4, ".csv") == 0;
+    return csv ? ExportFormat::CSV : ExportFormat::JSON_LINES;
+}
+
+// The BufferedOutput class collects bytes in a buffer of fixed size and writes it to a file whenever it fills up.
+class BufferedOutput
+{
+public:
+    static const size_t defaultCapacity = 64 * 1024;
+
+    explicit BufferedOutput(size_t bufferCapacity = defaultCapacity) : capacity(bufferCapacity)
+    {
+        buffer.reserve(capacity);
+    }
+
+    ~BufferedOutput()
+    {
+        close();
+    }
+
+    // Open a file for writing, replacing its contents ("-" writes to the standard output)
+    bool open(const string &filename)
+    {
+        file = filename == "-" ? stdout : fopen(filename.c_str(), "wb");
+        failed = file == nullptr;
+        return !failed;
+    }
+
+    void append(const string &bytes)
+    {
+        if (buffer.size() + bytes.size() > capacity)
+        {
+            flushBuffer();
+        }
+        if (bytes.size() > capacity)
+        {
+            write(bytes.data(), bytes.size()); // Larger than the whole buffer: write it directly
+            return;
+        }
+        buffer += bytes;
+    }
+
+    // Write what is left in the buffer and close the file; returns false if any write failed
+    bool close()
+    {
+        if (file != nullptr)
+        {
+            flushBuffer();
+            if (file == stdout ? fflush(file) != 0 : fclose(file) != 0)
+            {
+                failed = true;
+            }
+            file = nullptr;
+        }
+        return !failed;
+    }
+
+    // Number of bytes written to the file so far
+    size_t bytesWritten() const
+    {
+        return written;
+    }
+
+private:
+    void flushBuffer()
+    {
+        write(buffer.data(), buffer.size());
+        buffer.clear();
+    }
+
+    void write(const char *data, size_t size)
+    {
+        if (size > 0 && fwrite(data, 1, size, file) != size)
+        {
+            failed = true;
+        }
+        written += size;
+    }
+
+    size_t capacity;        // Size of the buffer
+    string buffer;          // Bytes not written yet
+    FILE *file = nullptr;   // File being written
+    bool failed = false;    // A write failed
+    size_t written = 0;     // Bytes written so far
+};
+
+// The TaskExporter class writes tasks to a JSON Lines or CSV file through a BufferedOutput.
+class TaskExporter
+{
+public:
+    explicit TaskExporter(ExportFormat exportFormat) : format(exportFormat) {}
+
+    // Open the file and write the CSV header line
+    bool open(const string &filename)
+    {
+        if (!output.open(filename))
+        {
+            return false;
+        }
+        if (format == ExportFormat::CSV)
+        {
+            record.clear();
+            appendHeader(record, make_index_sequence<TaskSchema::fieldCount>());
+            record += '\n';
+            output.append(record);
+        }
+        return true;
+    }
+
+    void write(const Task &task)
+    {
+        record.clear();
+        if (format == ExportFormat::CSV)
+        {
+            TaskSchema::appendRecord(record, task);
+        }
+        else
+        {
+            record += '{';
+            appendJsonFields(record, task, make_index_sequence<TaskSchema::fieldCount>());
+            record += "}\n";
+        }
+        output.append(record);
+        records++;
+    }
+
+    // Finish the file; returns false if it could not be written completely
+    bool close()
+    {
+        return output.close();
+    }
+
+    size_t recordCount() const
+    {
+        return records;
+    }
+
+    size_t bytesWritten() const
+    {
+        return output.bytesWritten();
+    }
+
+    // Append a string as a JSON string literal
+    static void appendJsonString(string &out, const string &value)
+    {
+        static const char hexDigits[] = "0123456789abcdef";
+        out += '"';
+        for (char c : value)
+        {
+            switch (c)
+            {
+            case '"':
+                out += "\\\"";
+                break;
+            case '\\':
+                out += "\\\\";
+                break;
+            case '\n':
+                out += "\\n";
+                break;
+            case '\r':
+                out += "\\r";
+                break;
+            case '\t':
+                out += "\\t";
+                break;
+            default:
+                if ((unsigned char)c < 0x20)
+                {
+                    out += "\\u00";
+                    out += hexDigits[(unsigned char)c >> 4];
+                    out += hexDigits[c & 15];
+                }
+                else
+                {
+                    out += c; // Everything else, including UTF-8 sequences (any code point, so no surrogate pairs), is written as it is
+                }
+            }
+        }
+        out += '"';
+    }
+
+private:
+    template <size_t... I>
+    static void appendHeader(string &out, index_sequence<I...>)
+    {
+        ((out += (I > 0 ? "," : ""), out += TaskSchema::FieldAt<I>::name), ...);
+    }
+
+    template <size_t... I>
+    static void appendJsonFields(string &out, const Task &task, index_sequence<I...>)
+    {
+        ((out += (I > 0 ? "," : ""), appendJsonString(out, TaskSchema::FieldAt<I>::name), out += ':',
+          appendJsonValue(out, TaskSchema::FieldAt<I>::get(task))),
+         ...);
+    }
+
+    // JSON value of a field: numbers for IDs, arrays for lists of IDs and strings for everything else
+    static void appendJsonValue(string &out, int value)
+    {
+        IntegerCodec::append(out, value);
+    }
+
+    static void appendJsonValue(string &out, const vector<int> &value)
+    {
+        out += '[';
+        for (size_t i = 0; i < value.size(); i++)
+        {
+            if (i > 0)
+            {
+                out += ',';
+            }
+            IntegerCodec::append(out, value[i]);
+        }
+        out += ']';
+    }
+
+    static void appendJsonValue(string &out, const string &value)
+    {
+        appendJsonString(out, value);
+    }
+
+    static void appendJsonValue(string &out, TaskPriority value)
+    {
+        string text;
+        PriorityCodec::append(text, value);
+        appendJsonString(out, text);
+    }
+
+    static void appendJsonValue(string &out, TaskStatus value)
+    {
+        string text;
+        StatusCodec::append(text, value);
+        appendJsonString(out, text);
+    }
+
+    static void appendJsonValue(string &out, const RecurrenceRule &value)
+    {
+        appendJsonString(out, value.toString());
+    }
+
+    ExportFormat format;  // Format of the file
+    BufferedOutput output; // Buffer in front of the file
+    string record;        // The record being formatted (reused for every task)
+    size_t records = 0;   // Tasks written so far
+};
+
+// The TaskImporter class reads tasks from a JSON Lines or CSV file, checking every record.
+class TaskImporter
+{
+public:
+    static const size_t chunkSize = 64 * 1024; // Bytes read from a CSV file at a time
+
+    explicit TaskImporter(ExportFormat importFormat) : format(importFormat) {}
+
+    ~TaskImporter()
+    {
+        if (file != nullptr)
+        {
+            fclose(file);
+        }
+    }
+
+    bool open(const string &filename)
+    {
+        if (format == ExportFormat::JSON_LINES)
+        {
+            lines.open(filename);
+            return lines.is_open();
+        }
+        file = fopen(filename.c_str(), "rb");
+        return file != nullptr;
+    }
+
+    // Read the next valid task; returns false at the end of the file.
+    // Records that cannot be read or fail the checks are reported on cerr and skipped.
+    bool next(Task &task)
+    {
+        while (true)
+        {
+            string error;
+            bool found = format == ExportFormat::CSV ? nextCsv(task, error) : nextJson(task, error);
+            if (!found)
+            {
+                return false;
+            }
+            if (error.empty() && validate(task, error))
+            {
+                return true;
+            }
+            rejected++;
+            cerr << "Record " << recordNumber << " skipped: " << error << endl;
+        }
+    }
+
+    // Records read so far, including the rejected ones (not counting the CSV header)
+    size_t recordCount() const
+    {
+        return recordNumber;
+    }
+
+    // Records that were skipped because they could not be read or failed the checks
+    size_t rejectedCount() const
+    {
+        return rejected;
+    }
+
+    // Report a record that was read correctly but refused when it was inserted (for example because its ID is taken)
+    void reject(const Task &task, const string &reason)
+    {
+        rejected++;
+        cerr << "Task " << task.getTaskID() << " skipped: " << reason << endl;
+    }
+
+private:
+    // A task whose priority and status are not set, so validate() can tell whether the record set them
+    static Task blankTask()
+    {
+        Task task;
+        TaskSchema::PriorityField::get(task) = TaskPriority(-1);
+        TaskSchema::StatusField::get(task) = TaskStatus(-1);
+        return task;
+    }
+
+    static bool validate(const Task &task, string &error)
+    {
+        int day;
+        if (task.getTaskID() < 0)
+        {
+            error = "the ID must be a positive number (or 0 to assign one)";
+        }
+        else if (int(TaskSchema::PriorityField::get(task)) < 0)
+        {
+            error = "the priority must be Low, Medium or High";
+        }
+        else if (int(TaskSchema::StatusField::get(task)) < 0)
+        {
+            error = "the status must be Pending, In Progress or Completed";
+        }
+        else if (!DeadlineCodec::dayNumber(task.getDeadline(), day))
+        {
+            error = "the deadline \"" + task.getDeadline() + "\" is not a valid DD/MM/YYYY date";
+        }
+        return error.empty();
+    }
+
+    // Read the next CSV record into a task; returns false at the end of the file
+    bool nextCsv(Task &task, string &error)
+    {
+        while (true)
+        {
+            if (start == complete && !fill())
+            {
+                return false;
+            }
+            FieldScanner scanner(buffer.data() + start, complete - start, false);
+            bool read = scanner.nextRecord(fields);
+            start = read ? start + scanner.offset() : complete;
+            if (!read)
+            {
+                continue; // Only blank lines were left in the complete records
+            }
+
+            // The first record is the header; the columns must be the fields of the schema in their usual order
+            if (!headerChecked)
+            {
+                headerChecked = true;
+                if (!fields.empty() && fields[0] == TaskSchema::IdField::name)
+                {
+                    if (!headerMatches())
+                    {
+                        error = "the header line does not list the task fields in the expected order";
+                        recordNumber++;
+                        return true;
+                    }
+                    continue;
+                }
+            }
+
+            recordNumber++;
+            task = blankTask();
+            if (fields.size() > TaskSchema::fieldCount)
+            {
+                error = "the record has " + to_string(fields.size()) + " fields instead of " + to_string(TaskSchema::fieldCount);
+            }
+            else if (!TaskSchema::parseRecord(fields, task))
+            {
+                error = "a field could not be read (such as an ID that is not a number or an unreadable recurrence rule)";
+            }
+            return true;
+        }
+    }
+
+    bool headerMatches() const
+    {
+        return headerMatchesFrom(make_index_sequence<TaskSchema::fieldCount>());
+    }
+
+    // Files written before a field was added to the schema lack its column, so the header may name the first fields only
+    template <size_t... I>
+    bool headerMatchesFrom(index_sequence<I...>) const
+    {
+        return !fields.empty() && fields.size() <= TaskSchema::fieldCount && ((I >= fields.size() || fields[I] == TaskSchema::FieldAt<I>::name) && ...);
+    }
+
+    // Read more of the CSV file, dropping the records already parsed, until the buffer holds at least one complete record.
+    // Returns false at the end of the file.
+    bool fill()
+    {
+        buffer.erase(0, start);
+        scanned = scanned > start ? scanned - start : 0;
+        start = 0;
+        complete = 0;
+        char chunk[chunkSize];
+        while (true)
+        {
+            size_t size = file != nullptr ? fread(chunk, 1, sizeof(chunk), file) : 0;
+            if (size == 0)
+            {
+                complete = buffer.size(); // End of the file: whatever is left is the last record
+                return complete > 0;
+            }
+            buffer.append(chunk, size);
+            complete = lastRecordEnd();
+            if (complete > 0)
+            {
+                return true;
+            }
+        }
+    }
+
+    // End of the last complete record in the buffer: just after the last line break that is not inside quotes (0 if there is none).
+    // Only the bytes added since the previous call are scanned, carrying on with the quote state where it stopped, so a record
+    // that spans many chunks is scanned once rather than once per chunk. The bytes scanned before hold no record end (fill() calls
+    // this until one is found, and drops the records before it), so the result is found among the new bytes.
+    size_t lastRecordEnd()
+    {
+        size_t end = 0;
+        for (; scanned < buffer.size(); scanned++)
+        {
+            char c = buffer[scanned];
+            if (c == '"')
+            {
+                scanQuoted = !scanQuoted; // An escaped quote ("") toggles twice
+            }
+            else if (c == '\n' && !scanQuoted)
+            {
+                end = scanned + 1;
+            }
+        }
+        return end;
+    }
+
+    // Read the next JSON line into a task; returns false at the end of the file
+    bool nextJson(Task &task, string &error)
+    {
+        while (getline(lines, line))
+        {
+            if (line.find_first_not_of(" \t\r") == string::npos)
+            {
+                continue; // Blank line
+            }
+            recordNumber++;
+            task = blankTask();
+            parseJsonObject(task, error);
+            return true;
+        }
+        return false;
+    }
+
+    // Parse a flat JSON object whose members are task fields. Strings and numbers become the text of the field, arrays of numbers
+    // become a list of IDs; the text is then read with the codec of the field, like a field of the task file. Unknown members are ignored.
+    void parseJsonObject(Task &task, string &error)
+    {
+        size_t pos = 0;
+        skipSpace(pos);
+        if (!expect(pos, '{'))
+        {
+            error = "the line is not a JSON object";
+            return;
+        }
+        skipSpace(pos);
+        if (expect(pos, '}'))
+        {
+            return;
+        }
+        while (true)
+        {
+            string name;
+            string value;
+            skipSpace(pos);
+            if (!readString(pos, name))
+            {
+                error = "expected a member name at column " + to_string(pos + 1);
+                return;
+            }
+            skipSpace(pos);
+            if (!expect(pos, ':'))
+            {
+                error = "expected ':' at column " + to_string(pos + 1);
+                return;
+            }
+            skipSpace(pos);
+            if (!readValue(pos, value))
+            {
+                error = "unreadable value for \"" + name + "\" at column " + to_string(pos + 1);
+                return;
+            }
+            if (!setField(task, name, value, make_index_sequence<TaskSchema::fieldCount>()))
+            {
+                error = "the value of \"" + name + "\" could not be read";
+                return;
+            }
+            skipSpace(pos);
+            if (expect(pos, '}'))
+            {
+                return;
+            }
+            if (!expect(pos, ','))
+            {
+                error = "expected ',' or '}' at column " + to_string(pos + 1);
+                return;
+            }
+        }
+    }
+
+    // Set the field with the given name from its text; returns false if the codec could not read it
+    template <size_t... I>
+    static bool setField(Task &task, const string &name, string &value, index_sequence<I...>)
+    {
+        bool ok = true;
+        (void)((name == TaskSchema::FieldAt<I>::name ? (ok = TaskSchema::FieldAt<I>::Codec::parse(value, TaskSchema::FieldAt<I>::get(task)), true)
+                                                     : false) ||
+               ...);
+        return ok;
+    }
+
+    void skipSpace(size_t &pos) const
+    {
+        while (pos < line.size() && (line[pos] == ' ' || line[pos] == '\t' || line[pos] == '\r'))
+        {
+            pos++;
+        }
+    }
+
+    bool expect(size_t &pos, char c) const
+    {
+        if (pos < line.size() && line[pos] == c)
+        {
+            pos++;
+            return true;
+        }
+        return false;
+    }
+
+    // Read a value as the text of a field: a string, a number, null (empty) or an array of numbers (joined with ';')
+    bool readValue(size_t &pos, string &value) const
+    {
+        if (pos >= line.size())
+        {
+            return false;
+        }
+        if (line[pos] == '"')
+        {
+            return readString(pos, value);
+        }
+        if (line.compare(pos, 4, "null") == 0)
+        {
+            pos += 4;
+            return true;
+        }
+        if (line[pos] == '[')
+        {
+            pos++;
+            skipSpace(pos);
+            if (expect(pos, ']'))
+            {
+                return true;
+            }
+            while (true)
+            {
+                skipSpace(pos);
+                if (!readNumber(pos, value))
+                {
+                    return false;
+                }
+                skipSpace(pos);
+                if (expect(pos, ']'))
+                {
+                    return true;
+                }
+                if (!expect(pos, ','))
+                {
+                    return false;
+                }
+                value += ';';
+            }
+        }
+        return readNumber(pos, value);
+    }
+
+    // Append a JSON number (an optional minus sign and digits) to value
+    bool readNumber(size_t &pos, string &value) const
+    {
+        size_t first = pos;
+        if (pos < line.size() && line[pos] == '-')
+        {
+            pos++;
+        }
+        while (pos < line.size() && isdigit((unsigned char)line[pos]))
+        {
+            pos++;
+        }
+        value.append(line, first, pos - first);
+        return pos > first;
+    }
+
+    // Read a JSON string literal, decoding its escape sequences
+    bool readString(size_t &pos, string &value) const
+    {
+        if (!expect(pos, '"'))
+        {
+            return false;
+        }
+        value.clear();
+        while (pos < line.size())
+        {
+            char c = line[pos++];
+            if (c == '"')
+            {
+                return true;
+            }
+            if (c != '\\')
+            {
+                value += c;
+                continue;
+            }
+            if (pos >= line.size())
+            {
+                return false;
+            }
+            char escape = line[pos++];
+            switch (escape)
+            {
+            case 'n':
+                value += '\n';
+                break;
+            case 'r':
+                value += '\r';
+                break;
+            case 't':
+                value += '\t';
+                break;
+            case 'b':
+                value += '\b';
+                break;
+            case 'f':
+                value += '\f';
+                break;
+            case 'u':
+            {
+                unsigned code = 0;
+                if (pos + 4 > line.size() || !readHex(line.substr(pos, 4), code))
+                {
+                    return false;
+                }
+                pos += 4;
+
+                // A code point above U+FFFF is written as a surrogate pair: a high surrogate followed by an escaped low one
+                unsigned low = 0;
+                if (code >= 0xD800 && code < 0xDC00 && line.compare(pos, 2, "\\u") == 0 && pos + 6 <= line.size() &&
+                    readHex(line.substr(pos + 2, 4), low) && low >= 0xDC00 && low < 0xE000)
+                {
+                    code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                    pos += 6;
+                }
+                else if (code >= 0xD800 && code < 0xE000)
+                {
+                    code = 0xFFFD; // A surrogate without its other half is not a character
+                }
+                appendUtf8(value, code);
+                break;
+            }
+            default:
+                value += escape; // \" \\ and \/
+            }
+        }
+        return false; // Unterminated string
+    }
+
+    static bool readHex(const string &digits, unsigned &code)
+    {
+        for (char c : digits)
+        {
+            if (!isxdigit((unsigned char)c))
+            {
+                return false;
+            }
+            code = code * 16 + unsigned(isdigit((unsigned char)c) ? c - '0' : tolower((unsigned char)c) - 'a' + 10);
+        }
+        return true;
+    }
+
+    // Append a code point as UTF-8
+    static void appendUtf8(string &out, unsigned code)
+    {
+        if (code < 0x80)
+        {
+            out += char(code);
+        }
+        else if (code < 0x800)
+        {
+            out += char(0xC0 | code >> 6);
+            out += char(0x80 | (code & 0x3F));
+        }
+        else if (code < 0x10000)
+        {
+            out += char(0xE0 | code >> 12);
+            out += char(0x80 | (code >> 6 & 0x3F));
+            out += char(0x80 | (code & 0x3F));
+        }
+        else
+        {
+            out += char(0xF0 | code >> 18);
+            out += char(0x80 | (code >> 12 & 0x3F));
+            out += char(0x80 | (code >> 6 & 0x3F));
+            out += char(0x80 | (code & 0x3F));
+        }
+    }
+
+    ExportFormat format;        // Format of the file
+    size_t recordNumber = 0;    // Records read so far
+    size_t rejected = 0;        // Records skipped
+    vector<string> fields;      // Fields of the current CSV record (reused)
+
+    FILE *file = nullptr;       // CSV file
+    string buffer;              // Part of the CSV file read but not parsed yet
+    size_t start = 0;           // First unparsed byte in buffer
+    size_t complete = 0;        // End of the complete records in buffer
+    size_t scanned = 0;         // Bytes of buffer lastRecordEnd() has looked at
+    bool scanQuoted = false;    // Whether the byte at scanned is inside quotes
+    bool headerChecked = false; // Whether the first CSV record has been looked at
+
+    ifstream lines;             // JSON Lines file
+    string line;                // Current JSON line
+};
+
+#endif
@@ -0,0 +1,595 @@
+// This file describes the layout of a Task record once, as a compile-time table of field descriptors.
+// Every place that reads, writes or compares task records (saving, loading, the duplicate-ID check, deleting and sorting)
+// goes through the code generated from this table, so the fields are always handled in the same order and with the same spelling.
+// Each field descriptor names the Task member it refers to and a codec that knows how to parse, write and compare values of that type.
+// Because the table is made of types rather than data, the compiler expands and inlines the per-field code for every use.
+
+#ifndef TASK_SCHEMA_CPP
+#define TASK_SCHEMA_CPP
+
+#include <string>
+#include <vector>
+#include <tuple>       // The field table is a tuple of descriptor types
+#include <utility>     // index_sequence for expanding the table
+#include <type_traits> // is_same for checking the column of the description
+#include <charconv>    // from_chars() and to_chars() for integer fields
+#include <cctype>      // tolower() for case-insensitive enum parsing
+#include "processor.cpp"     // Task class
+#include "record_format.cpp" // Quoting rules of the task file
+#include "calendar.cpp"      // Date arithmetic behind the deadline codec
+
+using namespace std;
+
+// Codec for integer fields such as the task ID
+struct IntegerCodec
+{
+    static bool parse(string &text, int &value)
+    {
+        const char *first = text.data();
+        const char *last = first + text.size();
+        while (first < last && isspace((unsigned char)*first))
+        {
+            first++; // Tolerate leading spaces
+        }
+        auto result = from_chars(first, last, value);
+        return result.ec == errc() && result.ptr == last;
+    }
+
+    static void append(string &out, int value)
+    {
+        char buffer[16];
+        auto result = to_chars(buffer, buffer + sizeof(buffer), value);
+        out.append(buffer, result.ptr);
+    }
+
+    static int compare(int a, int b)
+    {
+        return (a > b) - (a < b);
+    }
+};
+
+// Codec for free-text fields
+struct TextCodec
+{
+    // The text is moved out of the field string rather than copied
+    static bool parse(string &text, string &value)
+    {
+        value.swap(text);
+        return true;
+    }
+
+    static void append(string &out, const string &value)
+    {
+        RecordFormat::appendField(out, value);
+    }
+
+    static int compare(const string &a, const string &b)
+    {
+        int result = a.compare(b);
+        return (result > 0) - (result < 0);
+    }
+};
+
+// Codec for the deadline, stored as DD/MM/YYYY text but compared as a date
+struct DeadlineCodec : TextCodec
+{
+    // Sort key of a date in the form YYYYMMDD, or -1 if the text is not a valid DD/MM/YYYY date
+    static int dateKey(const string &date)
+    {
+        return Calendar::dateKey(date);
+    }
+
+    // Number of days between 01/01/1970 and a DD/MM/YYYY date; returns false if the text is not a valid date
+    static bool dayNumber(const string &date, int &day)
+    {
+        return Calendar::parse(date, day);
+    }
+
+    // Format a day number (days since 01/01/1970) as DD/MM/YYYY
+    static string fromDayNumber(int day)
+    {
+        return Calendar::format(day);
+    }
+
+    // Valid dates are ordered chronologically and come before invalid ones, which are ordered as text
+    static int compare(const string &a, const string &b)
+    {
+        int keyA = dateKey(a);
+        int keyB = dateKey(b);
+        if (keyA >= 0 && keyB >= 0)
+        {
+            return IntegerCodec::compare(keyA, keyB);
+        }
+        if (keyA >= 0 || keyB >= 0)
+        {
+            return keyA >= 0 ? -1 : 1;
+        }
+        return TextCodec::compare(a, b);
+    }
+};
+
+// Codec for lists of task IDs, stored separated by semicolons (e.g. "3;5;9") so that they never need quoting
+struct IdListCodec
+{
+    // Unreadable entries are skipped
+    static bool parse(string &text, vector<int> &value)
+    {
+        value.clear();
+        const char *p = text.data();
+        const char *last = p + text.size();
+        while (p < last)
+        {
+            int id = 0;
+            auto result = from_chars(p, last, id);
+            if (result.ec == errc() && id > 0)
+            {
+                value.push_back(id);
+                p = result.ptr;
+            }
+            else
+            {
+                p++;
+            }
+        }
+        return true;
+    }
+
+    static void append(string &out, const vector<int> &value)
+    {
+        for (size_t i = 0; i < value.size(); i++)
+        {
+            if (i > 0)
+            {
+                out += ';';
+            }
+            IntegerCodec::append(out, value[i]);
+        }
+    }
+
+    // Lists are ordered by length, then element by element
+    static int compare(const vector<int> &a, const vector<int> &b)
+    {
+        if (a.size() != b.size())
+        {
+            return a.size() < b.size() ? -1 : 1;
+        }
+        for (size_t i = 0; i < a.size(); i++)
+        {
+            if (a[i] != b[i])
+            {
+                return a[i] < b[i] ? -1 : 1;
+            }
+        }
+        return 0;
+    }
+};
+
+// Lowercase a field in place and turn '_' into ' ' so that "IN_PROGRESS" and "In Progress" are read the same way
+inline void normalizeEnumText(string &text)
+{
+    for (char &c : text)
+    {
+        c = c == '_' ? ' ' : char(tolower((unsigned char)c));
+    }
+}
+
+// Codec for the task priority; an unknown spelling is rejected, so a corrupt field fails the record instead of loading as another value
+struct PriorityCodec
+{
+    static bool parse(string &text, TaskPriority &value)
+    {
+        normalizeEnumText(text);
+        if (text == "low")
+        {
+            value = TaskPriority::LOW;
+        }
+        else if (text == "medium")
+        {
+            value = TaskPriority::MEDIUM;
+        }
+        else if (text == "high")
+        {
+            value = TaskPriority::HIGH;
+        }
+        else
+        {
+            return false;
+        }
+        return true;
+    }
+
+    static void append(string &out, TaskPriority value)
+    {
+        switch (value)
+        {
+        case TaskPriority::LOW:
+            out += "Low";
+            break;
+        case TaskPriority::MEDIUM:
+            out += "Medium";
+            break;
+        case TaskPriority::HIGH:
+            out += "High";
+            break;
+        }
+    }
+
+    static int compare(TaskPriority a, TaskPriority b)
+    {
+        return IntegerCodec::compare(int(a), int(b));
+    }
+};
+
+// Codec for the task status; an unknown spelling is rejected, so a corrupt field fails the record instead of loading as another value
+struct StatusCodec
+{
+    static bool parse(string &text, TaskStatus &value)
+    {
+        normalizeEnumText(text);
+        if (text == "pending")
+        {
+            value = TaskStatus::PENDING;
+        }
+        else if (text == "in progress")
+        {
+            value = TaskStatus::IN_PROGRESS;
+        }
+        else if (text == "completed")
+        {
+            value = TaskStatus::COMPLETED;
+        }
+        else
+        {
+            return false;
+        }
+        return true;
+    }
+
+    static void append(string &out, TaskStatus value)
+    {
+        switch (value)
+        {
+        case TaskStatus::PENDING:
+            out += "Pending";
+            break;
+        case TaskStatus::IN_PROGRESS:
+            out += "In Progress";
+            break;
+        case TaskStatus::COMPLETED:
+            out += "Completed";
+            break;
+        }
+    }
+
+    static int compare(TaskStatus a, TaskStatus b)
+    {
+        return IntegerCodec::compare(int(a), int(b));
+    }
+};
+
+// Codec for the recurrence rule of a task, stored in the form of RecurrenceRule::parse() (empty for tasks that do not repeat)
+struct RecurrenceCodec
+{
+    static bool parse(string &text, RecurrenceRule &value)
+    {
+        try
+        {
+            value = RecurrenceRule::parse(text);
+            return true;
+        }
+        catch (const invalid_argument &)
+        {
+            return false;
+        }
+    }
+
+    // BYDAY lists days separated by commas, so the rule is quoted like free text
+    static void append(string &out, const RecurrenceRule &value)
+    {
+        TextCodec::append(out, value.toString());
+    }
+
+    // Rules are ordered by their text
+    static int compare(const RecurrenceRule &a, const RecurrenceRule &b)
+    {
+        return TextCodec::compare(a.toString(), b.toString());
+    }
+};
+
+// The TaskSchema struct holds the field table and the code generated from it.
+// It is a friend of Task so that the descriptors can point directly at Task's private members.
+struct TaskSchema
+{
+    // A field descriptor: the member it refers to and the codec used for it
+    template <typename T, T Task::*Member, typename FieldCodec>
+    struct Field
+    {
+        typedef T Type;
+        typedef FieldCodec Codec;
+
+        static T &get(Task &task)
+        {
+            return task.*Member;
+        }
+
+        static const T &get(const Task &task)
+        {
+            return task.*Member;
+        }
+
+        // Compare two tasks on this field (negative, zero or positive)
+        static int compare(const Task &a, const Task &b)
+        {
+            return Codec::compare(get(a), get(b));
+        }
+
+        // Write this field of a task as a record field
+        static void append(string &out, const Task &task)
+        {
+            Codec::append(out, get(task));
+        }
+
+        // The value of this field used as a sort key, and the comparison of two such values
+        typedef T KeyType;
+
+        static const T &key(const Task &task)
+        {
+            return get(task);
+        }
+
+        static int compareKeys(const T &a, const T &b)
+        {
+            return Codec::compare(a, b);
+        }
+
+        // Write a sort key as a record field and read it back (the cursors of the views are made of these)
+        static void appendKey(string &out, const T &value)
+        {
+            Codec::append(out, value);
+        }
+
+        static bool parseKey(string &text, T &value)
+        {
+            return Codec::parse(text, value);
+        }
+    };
+
+    // The field table, in the order the fields are stored in a record
+    struct IdField : Field<int, &Task::taskID, IntegerCodec>
+    {
+        static constexpr const char *name = "id";
+    };
+    struct CategoryField : Field<string, &Task::category, TextCodec>
+    {
+        static constexpr const char *name = "category";
+    };
+    struct TitleField : Field<string, &Task::title, TextCodec>
+    {
+        static constexpr const char *name = "title";
+    };
+    struct DescriptionField : Field<string, &Task::description, TextCodec>
+    {
+        static constexpr const char *name = "description";
+
+        // The description is written into (when a record is parsed), so any reference to a cold copy of it is dropped
+        static string &get(Task &task)
+        {
+            task.coldDescription = ColdFieldRef();
+            return task.description;
+        }
+
+        // A description left in the task file by a lazy load is read back, so exports always hold the full text
+        static string get(const Task &task)
+        {
+            return task.loadDescription();
+        }
+
+        // The description of a task may be in the task file rather than in memory, so it is not a sort key: comparing or keying
+        // on the text in memory would sort lazily loaded tasks as empty
+        static int compare(const Task &a, const Task &b) = delete;
+        static const string &key(const Task &task) = delete;
+
+        // A description left in the task file is copied into the record as it is stored there, without reading it back
+        static void append(string &out, const Task &task)
+        {
+            if (task.coldDescription.isCold())
+            {
+                task.coldDescription.appendStored(out);
+                return;
+            }
+            TextCodec::append(out, task.description);
+        }
+    };
+    struct DeadlineField : Field<string, &Task::deadline, DeadlineCodec>
+    {
+        static constexpr const char *name = "deadline";
+    };
+    struct PriorityField : Field<TaskPriority, &Task::priority, PriorityCodec>
+    {
+        static constexpr const char *name = "priority";
+    };
+    struct StatusField : Field<TaskStatus, &Task::status, StatusCodec>
+    {
+        static constexpr const char *name = "status";
+    };
+    struct LabelField : Field<string, &Task::label, TextCodec>
+    {
+        static constexpr const char *name = "label";
+    };
+    struct DependenciesField : Field<vector<int>, &Task::dependencies, IdListCodec>
+    {
+        static constexpr const char *name = "dependencies";
+    };
+
+    struct RecurrenceField : Field<RecurrenceRule, &Task::recurrence, RecurrenceCodec>
+    {
+        static constexpr const char *name = "recurrence";
+    };
+
+    typedef tuple<IdField, CategoryField, TitleField, DescriptionField, DeadlineField, PriorityField, StatusField, LabelField,
+                  DependenciesField, RecurrenceField>
+        Fields;
+
+    static constexpr size_t fieldCount = tuple_size<Fields>::value;
+
+    template <size_t I>
+    using FieldAt = typename tuple_element<I, Fields>::type;
+
+    // Column of the description in a record (read back from there when a lazy load left it in the task file)
+    static constexpr size_t descriptionColumn = 3;
+    static_assert(is_same<FieldAt<descriptionColumn>, DescriptionField>::value, "descriptionColumn must be the column of DescriptionField");
+
+    // Append a task as one record of the task file, followed by a line break
+    static void appendRecord(string &out, const Task &task)
+    {
+        appendFields(out, task, make_index_sequence<fieldCount>());
+        out += '\n';
+    }
+
+    // Fill a task from the fields of a record; the field strings are consumed.
+    // Missing trailing fields are treated as empty. Returns false if a field could not be parsed (for example a non-numeric ID).
+    static bool parseRecord(vector<string> &fields, Task &task)
+    {
+        if (fields.size() < fieldCount)
+        {
+            fields.resize(fieldCount);
+        }
+        return parseFields(fields, task, make_index_sequence<fieldCount>());
+    }
+
+    // Parse only the ID of a record (used when the rest of the record is not needed)
+    static bool parseId(vector<string> &fields, int &id)
+    {
+        return !fields.empty() && IntegerCodec::parse(fields[0], id);
+    }
+
+    // Reverse the order of a sort key
+    template <typename Key>
+    struct Descending
+    {
+        typedef typename Key::KeyType KeyType;
+
+        static int compare(const Task &a, const Task &b)
+        {
+            return Key::compare(b, a);
+        }
+
+        static const KeyType &key(const Task &task)
+        {
+            return Key::key(task);
+        }
+
+        static int compareKeys(const KeyType &a, const KeyType &b)
+        {
+            return Key::compareKeys(b, a);
+        }
+
+        static void appendKey(string &out, const KeyType &value)
+        {
+            Key::appendKey(out, value);
+        }
+
+        static bool parseKey(string &text, KeyType &value)
+        {
+            return Key::parseKey(text, value);
+        }
+    };
+
+    // A sort order made of one or more keys, compared in turn
+    template <typename... Keys>
+    struct Order
+    {
+        static int compare(const Task &a, const Task &b)
+        {
+            int result = 0;
+            // Stop at the first key that tells the tasks apart
+            (void)((result = Keys::compare(a, b), result != 0) || ...);
+            return result;
+        }
+
+        bool operator()(const Task &a, const Task &b) const
+        {
+            return compare(a, b) < 0;
+        }
+
+        // The values a task is sorted on, copied out of the task so they can be kept without it (used by the materialized views)
+        typedef tuple<typename Keys::KeyType...> KeyTuple;
+
+        static KeyTuple keyOf(const Task &task)
+        {
+            return KeyTuple(Keys::key(task)...);
+        }
+
+        // Compare two key tuples the same way compare() compares the tasks they were taken from
+        static int compareKeys(const KeyTuple &a, const KeyTuple &b)
+        {
+            return compareKeysFrom(a, b, index_sequence_for<Keys...>());
+        }
+
+        // Number of fields in a key tuple
+        static constexpr size_t keyCount = sizeof...(Keys);
+
+        // Append a key tuple as comma-separated record fields (each preceded by a comma), so it can be stored outside the program
+        static void appendKey(string &out, const KeyTuple &key)
+        {
+            appendKeyFrom(out, key, index_sequence_for<Keys...>());
+        }
+
+        // Read a key tuple back from keyCount record fields starting at fields[first]; the field strings are consumed
+        static bool parseKey(vector<string> &fields, size_t first, KeyTuple &key)
+        {
+            return fields.size() >= first + keyCount && parseKeyFrom(fields, first, key, index_sequence_for<Keys...>());
+        }
+
+    private:
+        template <size_t... I>
+        static void appendKeyFrom(string &out, const KeyTuple &key, index_sequence<I...>)
+        {
+            ((out += ',', tuple_element<I, tuple<Keys...>>::type::appendKey(out, get<I>(key))), ...);
+        }
+
+        template <size_t... I>
+        static bool parseKeyFrom(vector<string> &fields, size_t first, KeyTuple &key, index_sequence<I...>)
+        {
+            return (tuple_element<I, tuple<Keys...>>::type::parseKey(fields[first + I], get<I>(key)) && ...);
+        }
+
+        template <size_t... I>
+        static int compareKeysFrom(const KeyTuple &a, const KeyTuple &b, index_sequence<I...>)
+        {
+            int result = 0;
+            (void)((result = tuple_element<I, tuple<Keys...>>::type::compareKeys(get<I>(a), get<I>(b)), result != 0) || ...);
+            return result;
+        }
+    };
+
+    // The orders used by the views; the task ID keeps tasks with equal keys in a fixed order
+    typedef Order<DeadlineField, IdField> ByDate;
+    typedef Order<Descending<PriorityField>, IdField> ByPriority;
+    typedef Order<CategoryField, IdField> ByCategory;
+
+private:
+    template <size_t... I>
+    static void appendFields(string &out, const Task &task, index_sequence<I...>)
+    {
+        (appendField<I>(out, task), ...);
+    }
+
+    template <size_t I>
+    static void appendField(string &out, const Task &task)
+    {
+        if (I > 0)
+        {
+            out += ',';
+        }
+        FieldAt<I>::append(out, task);
+    }
+
+    template <size_t... I>
+    static bool parseFields(vector<string> &fields, Task &task, index_sequence<I...>)
+    {
+        return (FieldAt<I>::Codec::parse(fields[I], FieldAt<I>::get(task)) && ...);
+    }
+};
+
+#endif
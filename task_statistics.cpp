@@ -0,0 +1,344 @@
+// This file implements the aggregate statistics of a project: how many tasks there are in every category, by status and priority,
+// and how many deadlines fall on every day.
+// The counters are kept up to date with every change, like the materialized views: the statistics remember the fields each task
+// was counted under, so a changed or deleted task is taken out of its old counters and put into its new ones without looking at
+// any other task. Updating the category counters is O(1); updating the deadline histogram is O(log d), where d is the number of
+// distinct deadline days. Questions such as "how many High tasks are still pending in Work" or "how many unfinished tasks are
+// overdue" are then answered from the counters without reading the tasks.
+// A repeating task is counted once, on the day of its first occurrence (its deadline).
+// verify() recounts everything from the tasks and reports any counter that differs, for testing the incremental updates.
+
+#ifndef TASK_STATISTICS_CPP
+#define TASK_STATISTICS_CPP
+
+#include <string>
+#include <vector>
+#include <map>           // Deadline histogram, ordered by day for range queries
+#include <unordered_map> // Counters of every task and index of every category
+#include <climits>       // INT_MAX marks tasks without a valid deadline
+#include <cstdint>
+#include "processor.cpp"
+#include "task_schema.cpp" // DeadlineCodec turns deadlines into day numbers
+
+using namespace std;
+
+// Number of tasks for every combination of status and priority
+struct StatusPriorityCounts
+{
+    size_t counts[3][3] = {}; // [status][priority]
+
+    size_t get(TaskStatus status, TaskPriority priority) const
+    {
+        return counts[int(status)][int(priority)];
+    }
+
+    size_t byStatus(TaskStatus status) const
+    {
+        const size_t *row = counts[int(status)];
+        return row[0] + row[1] + row[2];
+    }
+
+    size_t byPriority(TaskPriority priority) const
+    {
+        return counts[0][int(priority)] + counts[1][int(priority)] + counts[2][int(priority)];
+    }
+
+    size_t total() const
+    {
+        return byStatus(TaskStatus::PENDING) + byStatus(TaskStatus::IN_PROGRESS) + byStatus(TaskStatus::COMPLETED);
+    }
+
+    void addAll(const StatusPriorityCounts &other)
+    {
+        for (int status = 0; status < 3; status++)
+        {
+            for (int priority = 0; priority < 3; priority++)
+            {
+                counts[status][priority] += other.counts[status][priority];
+            }
+        }
+    }
+};
+
+// Number of deadlines on one day (or without a valid date), split into unfinished and completed tasks
+struct DeadlineCounts
+{
+    size_t unfinished = 0;
+    size_t completed = 0;
+
+    size_t total() const
+    {
+        return unfinished + completed;
+    }
+};
+
+// Tasks a count is restricted to; an empty category, or a negative status or priority, means any
+struct StatisticsFilter
+{
+    string category;
+    int status = -1;
+    int priority = -1;
+};
+
+// The TaskStatistics class keeps the counters of the tasks of a project up to date as tasks are created, changed and deleted.
+class TaskStatistics
+{
+public:
+    // Count a task (a task that is already counted is first taken out of its old counters)
+    void insert(const Task &task)
+    {
+        remove(task.getTaskID());
+        Entry entry = entryOf(task);
+        byID[task.getTaskID()] = entry;
+        apply(entry, true);
+    }
+
+    // Stop counting a task (does nothing if it is not counted)
+    void remove(int taskID)
+    {
+        auto it = byID.find(taskID);
+        if (it != byID.end())
+        {
+            apply(it->second, false);
+            byID.erase(it);
+        }
+    }
+
+    // Move a task to its new counters after some of its fields changed
+    void update(const Task &task)
+    {
+        insert(task);
+    }
+
+    void clear()
+    {
+        byID.clear();
+        categories.clear();
+        categoryIndex.clear();
+        counts.clear();
+        days.clear();
+        undated = DeadlineCounts();
+    }
+
+    // Count a list of tasks, replacing the counters
+    void rebuild(const vector<Task> &tasks)
+    {
+        clear();
+        for (const Task &task : tasks)
+        {
+            insert(task);
+        }
+    }
+
+    // Number of tasks counted
+    size_t taskCount() const
+    {
+        return byID.size();
+    }
+
+    // Number of tasks matching a filter
+    size_t count(const StatisticsFilter &filter) const
+    {
+        StatusPriorityCounts selected;
+        if (filter.category.empty())
+        {
+            selected = totals();
+        }
+        else
+        {
+            auto it = categoryIndex.find(filter.category);
+            if (it == categoryIndex.end())
+            {
+                return 0;
+            }
+            selected = counts[it->second];
+        }
+
+        size_t result = 0;
+        for (int status = 0; status < 3; status++)
+        {
+            for (int priority = 0; priority < 3; priority++)
+            {
+                if ((filter.status < 0 || filter.status == status) && (filter.priority < 0 || filter.priority == priority))
+                {
+                    result += selected.counts[status][priority];
+                }
+            }
+        }
+        return result;
+    }
+
+    // Counters of every category that has tasks, in the order the categories were first seen
+    vector<pair<string, StatusPriorityCounts>> categoryCounts() const
+    {
+        vector<pair<string, StatusPriorityCounts>> result;
+        for (size_t i = 0; i < categories.size(); i++)
+        {
+            if (counts[i].total() > 0)
+            {
+                result.emplace_back(categories[i], counts[i]);
+            }
+        }
+        return result;
+    }
+
+    // Counters of all categories together
+    StatusPriorityCounts totals() const
+    {
+        StatusPriorityCounts result;
+        for (const StatusPriorityCounts &categoryCounts : counts)
+        {
+            result.addAll(categoryCounts);
+        }
+        return result;
+    }
+
+    // Deadlines between two day numbers (inclusive)
+    DeadlineCounts deadlinesBetween(int fromDay, int toDay) const
+    {
+        DeadlineCounts result;
+        for (auto it = days.lower_bound(fromDay); it != days.end() && it->first <= toDay; ++it)
+        {
+            result.unfinished += it->second.unfinished;
+            result.completed += it->second.completed;
+        }
+        return result;
+    }
+
+    // Deadlines on one day
+    DeadlineCounts deadlinesOn(int day) const
+    {
+        auto it = days.find(day);
+        return it == days.end() ? DeadlineCounts() : it->second;
+    }
+
+    // Tasks without a valid deadline
+    const DeadlineCounts &withoutDeadline() const
+    {
+        return undated;
+    }
+
+    // Recount the tasks from scratch and compare every counter with the incremental ones.
+    // Returns true if they all match; otherwise difference describes the first counter that does not.
+    bool verify(const vector<Task> &tasks, string &difference) const
+    {
+        TaskStatistics recount;
+        recount.rebuild(tasks);
+        if (recount.taskCount() != taskCount())
+        {
+            difference = "counting " + to_string(taskCount()) + " task(s) instead of " + to_string(recount.taskCount());
+            return false;
+        }
+
+        // Categories are compared by name, since the two may have seen them in a different order
+        for (size_t i = 0; i < categories.size(); i++)
+        {
+            auto it = recount.categoryIndex.find(categories[i]);
+            StatusPriorityCounts expected = it == recount.categoryIndex.end() ? StatusPriorityCounts() : recount.counts[it->second];
+            for (int status = 0; status < 3; status++)
+            {
+                for (int priority = 0; priority < 3; priority++)
+                {
+                    if (counts[i].counts[status][priority] != expected.counts[status][priority])
+                    {
+                        difference = "category \"" + categories[i] + "\" counts " + to_string(counts[i].counts[status][priority]) + " task(s) of status " +
+                                     to_string(status) + " and priority " + to_string(priority) + " instead of " + to_string(expected.counts[status][priority]);
+                        return false;
+                    }
+                }
+            }
+        }
+        if (recount.totals().total() != totals().total())
+        {
+            difference = "a category is missing from the counters";
+            return false;
+        }
+
+        if (recount.days.size() != days.size() || recount.undated.unfinished != undated.unfinished || recount.undated.completed != undated.completed)
+        {
+            difference = "the deadline histogram has " + to_string(days.size()) + " day(s) instead of " + to_string(recount.days.size());
+            return false;
+        }
+        for (auto it = days.cbegin(), expected = recount.days.cbegin(); it != days.cend(); ++it, ++expected)
+        {
+            if (it->first != expected->first || it->second.unfinished != expected->second.unfinished || it->second.completed != expected->second.completed)
+            {
+                difference = "the deadline histogram differs on " + DeadlineCodec::fromDayNumber(it->first);
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Approximate number of bytes of memory used by the statistics
+    size_t memoryUsage() const
+    {
+        size_t bytes = sizeof(*this) + byID.size() * (sizeof(pair<int, Entry>) + 2 * sizeof(void *));
+        for (const string &category : categories)
+        {
+            bytes += sizeof(string) + category.capacity() + sizeof(StatusPriorityCounts) + sizeof(pair<string, uint32_t>) + 2 * sizeof(void *);
+        }
+        return bytes + days.size() * (sizeof(pair<int, DeadlineCounts>) + 4 * sizeof(void *));
+    }
+
+private:
+    // The counters a task was counted under
+    struct Entry
+    {
+        uint32_t category; // Index of the category in categories
+        uint8_t status;
+        uint8_t priority;
+        int day; // Day number of the deadline (INT_MAX if it is not a valid date)
+    };
+
+    Entry entryOf(const Task &task)
+    {
+        Entry entry;
+        auto it = categoryIndex.find(task.getCategory());
+        if (it == categoryIndex.end())
+        {
+            it = categoryIndex.emplace(task.getCategory(), uint32_t(categories.size())).first;
+            categories.push_back(task.getCategory());
+            counts.emplace_back();
+        }
+        entry.category = it->second;
+        entry.status = uint8_t(task.getStatusValue());
+        entry.priority = uint8_t(task.getPriorityValue());
+        if (!DeadlineCodec::dayNumber(task.getDeadline(), entry.day))
+        {
+            entry.day = INT_MAX;
+        }
+        return entry;
+    }
+
+    // Add a task to, or take it out of, the counters of an entry
+    void apply(const Entry &entry, bool add)
+    {
+        size_t &counter = counts[entry.category].counts[entry.status][entry.priority];
+        counter = add ? counter + 1 : counter - 1;
+
+        bool completed = TaskStatus(entry.status) == TaskStatus::COMPLETED;
+        if (entry.day == INT_MAX)
+        {
+            size_t &dayCounter = completed ? undated.completed : undated.unfinished;
+            dayCounter = add ? dayCounter + 1 : dayCounter - 1;
+            return;
+        }
+        DeadlineCounts &day = days[entry.day];
+        size_t &dayCounter = completed ? day.completed : day.unfinished;
+        dayCounter = add ? dayCounter + 1 : dayCounter - 1;
+        if (day.total() == 0)
+        {
+            days.erase(entry.day); // Keep only the days that have deadlines
+        }
+    }
+
+    unordered_map<int, Entry> byID;               // Counters of every counted task
+    vector<string> categories;                    // Names of the categories seen so far
+    unordered_map<string, uint32_t> categoryIndex; // Index of every category in categories
+    vector<StatusPriorityCounts> counts;          // Counters of every category
+    map<int, DeadlineCounts> days;                // Deadlines by day number
+    DeadlineCounts undated;                       // Tasks without a valid deadline
+};
+
+#endif
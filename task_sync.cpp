@@ -0,0 +1,704 @@
+// This file implements the synchronization of two copies of a project, for example the same task file kept on several hosts.
+// Each copy keeps a sync tree of its tasks (see sync_tree.cpp). Two copies are compared from the root of their trees down: at every
+// level only the children of the nodes whose hashes differed are compared, and at the leaves the digests of the tasks in the
+// differing ID buckets tell exactly which tasks were added, deleted or changed. Only those tasks are then sent from one copy to
+// the other, so copies that differ in a few tasks are reconciled with a few hundred hash comparisons and a few records, however
+// many tasks they hold.
+// A copy is reached through a SyncPeer: a task file opened in this process (LocalSyncPeer), or another process serving its project
+// on a Unix domain socket with --sync-serve (RemoteSyncPeer and SyncServer). A comparison asks each copy for one batch of hashes per
+// level of the tree, so a remote copy is compared in a fixed number of round trips.
+// Tasks carry no modification times, so a synchronization goes one way: the target ends up with exactly the tasks of the source.
+//
+// Requests and replies are framed like replication messages (see replication.cpp); each starts with a header line:
+//   N <level> <key>...\n   ->  N <hash>...\n                          hashes of nodes of a level of the tree (hexadecimal)
+//   L <bucket>...\n        ->  L <count>\n<id> <digest>\n...           IDs and digests of the tasks in leaves, in ID order
+//   F <id>...\n            ->  F <count>\n<records>                    records of tasks
+//   A <id>...\n<records>   ->  A <applied> <refused>\n<reason>\n...    delete the listed tasks, then create or replace the records
+// A request that cannot be answered gets the reply "X <message>\n".
+
+#ifndef TASK_SYNC_CPP
+#define TASK_SYNC_CPP
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>      // unique_ptr for the peers and the task manager of a local copy
+#include <sstream>     // Reading the header line of a message
+#include <filesystem>  // Telling a socket from a task file
+#include <cerrno>
+#include <cstring>     // strerror()
+#include <cstdlib>     // strtoull() for hexadecimal hashes
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>    // close(), unlink() and the stop pipe
+#include <fcntl.h>     // Flags of the stop pipe
+#include <poll.h>      // Waiting for a client or a stop request
+#include <csignal>     // SIGINT and SIGTERM stop the server
+#include "TaskManager.cpp" // Projects, their sync trees and ReplicationWire
+
+using namespace std;
+
+// Tasks two copies differ in, and what it took to find them
+struct SyncDifference
+{
+    vector<int> onlyFirst;     // IDs of the tasks only the first copy has
+    vector<int> onlySecond;    // IDs of the tasks only the second copy has
+    vector<int> changed;       // IDs of the tasks both copies have, with different contents
+    size_t hashesCompared = 0; // Node hashes and task digests compared
+    size_t requests = 0;       // Requests made to the two copies
+
+    bool empty() const
+    {
+        return onlyFirst.empty() && onlySecond.empty() && changed.empty();
+    }
+
+    // The same difference seen from the second copy
+    SyncDifference swapped() const
+    {
+        SyncDifference result = *this;
+        result.onlyFirst.swap(result.onlySecond);
+        return result;
+    }
+};
+
+// One copy of a project taking part in a synchronization
+class SyncPeer
+{
+public:
+    virtual ~SyncPeer() {}
+
+    // Name of the copy, for messages
+    virtual string name() const = 0;
+
+    // Hashes of nodes of one level of the sync tree, in the order of keys (0 for a node without tasks)
+    virtual bool nodeHashes(int level, const vector<uint32_t> &keys, vector<uint64_t> &hashes) = 0;
+
+    // IDs and digests of the tasks in leaves of the sync tree, in ID order (buckets must be given in increasing order)
+    virtual bool leafDigests(const vector<uint32_t> &buckets, vector<pair<int, uint64_t>> &digests) = 0;
+
+    // Tasks with the given IDs (IDs without a task are left out)
+    virtual bool fetch(const vector<int> &ids, vector<Task> &tasks) = 0;
+
+    // Delete tasks, then create or replace others, and write the copy to disk; refused changes are explained in errors
+    virtual bool apply(const vector<Task> &upserts, const vector<int> &deletes, size_t &applied, vector<string> &errors) = 0;
+
+    // Why the last call failed
+    const string &error() const
+    {
+        return lastError;
+    }
+
+    // Bytes of requests and replies exchanged with the copy (0 for a copy in this process)
+    uint64_t bytesTransferred() const
+    {
+        return transferred;
+    }
+
+protected:
+    string lastError;
+    uint64_t transferred = 0;
+};
+
+// A copy of a project opened in this process
+class LocalSyncPeer : public SyncPeer
+{
+public:
+    // Use the current project of a task manager
+    explicit LocalSyncPeer(TaskManager &taskManager) : manager(taskManager) {}
+
+    // Open a task file with a task manager of its own
+    explicit LocalSyncPeer(const string &taskFile) : owned(new TaskManager(taskFile)), manager(*owned) {}
+
+    string name() const override
+    {
+        return manager.currentProject();
+    }
+
+    bool nodeHashes(int level, const vector<uint32_t> &keys, vector<uint64_t> &hashes) override
+    {
+        const SyncTree &tree = manager.getSyncTree();
+        hashes.clear();
+        for (uint32_t key : keys)
+        {
+            hashes.push_back(tree.hash(level, key));
+        }
+        return true;
+    }
+
+    bool leafDigests(const vector<uint32_t> &buckets, vector<pair<int, uint64_t>> &digests) override
+    {
+        const SyncTree &tree = manager.getSyncTree();
+        digests.clear();
+        for (uint32_t bucket : buckets)
+        {
+            tree.leafDigests(bucket, digests);
+        }
+        return true;
+    }
+
+    bool fetch(const vector<int> &ids, vector<Task> &tasks) override
+    {
+        tasks.clear();
+        for (int id : ids)
+        {
+            const Task *task = manager.getTask(id);
+            if (task != nullptr)
+            {
+                tasks.push_back(*task);
+            }
+        }
+        return true;
+    }
+
+    bool apply(const vector<Task> &upserts, const vector<int> &deletes, size_t &applied, vector<string> &errors) override
+    {
+        applied = manager.applyBatch(upserts, deletes, errors);
+        if (!manager.flushWrites())
+        {
+            lastError = "Unable to write " + manager.currentProject();
+            return false;
+        }
+        return true;
+    }
+
+private:
+    unique_ptr<TaskManager> owned; // Task manager opened for a task file (declared first, so it exists before manager refers to it)
+    TaskManager &manager;
+};
+
+// The SyncWire struct encodes and decodes synchronization messages.
+struct SyncWire
+{
+    // Append a list of numbers to a header line, each after a space
+    template <typename Number>
+    static void appendNumbers(string &out, const vector<Number> &numbers, bool hexadecimal = false)
+    {
+        char buffer[24];
+        for (Number number : numbers)
+        {
+            snprintf(buffer, sizeof(buffer), hexadecimal ? " %llx" : " %lld", hexadecimal ? (unsigned long long)number : (long long)number);
+            out += buffer;
+        }
+    }
+
+    // Read the numbers that follow the first word of a header line; returns false if one is malformed
+    template <typename Number>
+    static bool readNumbers(const string &line, vector<Number> &numbers, bool hexadecimal = false, size_t skipWords = 1)
+    {
+        istringstream in(line);
+        string word;
+        for (size_t i = 0; i < skipWords; i++)
+        {
+            in >> word;
+        }
+        numbers.clear();
+        while (in >> word)
+        {
+            char *end = nullptr;
+            errno = 0;
+            unsigned long long value = strtoull(word.c_str(), &end, hexadecimal ? 16 : 10);
+            if (*end != '\0' || errno != 0)
+            {
+                return false;
+            }
+            numbers.push_back(Number(value));
+        }
+        return true;
+    }
+
+    // Split a message into its header line and the offset of what follows; returns false if there is no header line
+    static bool header(const string &payload, string &line, size_t &bodyOffset)
+    {
+        size_t end = payload.find('\n');
+        if (end == string::npos)
+        {
+            return false;
+        }
+        line = payload.substr(0, end);
+        bodyOffset = end + 1;
+        return true;
+    }
+
+    static string failure(const string &message)
+    {
+        return "X " + message + "\n";
+    }
+};
+
+// A copy of a project served by another process with --sync-serve
+class RemoteSyncPeer : public SyncPeer
+{
+public:
+    static const int replyTimeoutMs = 60000; // Longest wait for a reply
+
+    ~RemoteSyncPeer()
+    {
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+    }
+
+    // Connect to the socket of a serving process; returns false with a message in error() if it cannot be reached
+    bool connect(const string &path)
+    {
+        socketPath = path;
+        sockaddr_un addr;
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (!ReplicationWire::address(path, addr) || fd < 0 || ::connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0)
+        {
+            lastError = "Unable to connect to " + path + ": " + strerror(errno);
+            return false;
+        }
+        return true;
+    }
+
+    string name() const override
+    {
+        return socketPath;
+    }
+
+    bool nodeHashes(int level, const vector<uint32_t> &keys, vector<uint64_t> &hashes) override
+    {
+        string request = "N " + to_string(level);
+        SyncWire::appendNumbers(request, keys);
+        string reply, line;
+        size_t body;
+        if (!exchange(request + "\n", reply) || !SyncWire::header(reply, line, body) || !SyncWire::readNumbers(line, hashes, true) ||
+            hashes.size() != keys.size())
+        {
+            return failed("Unexpected reply to a request for hashes");
+        }
+        return true;
+    }
+
+    bool leafDigests(const vector<uint32_t> &buckets, vector<pair<int, uint64_t>> &digests) override
+    {
+        string request = "L";
+        SyncWire::appendNumbers(request, buckets);
+        string reply, line;
+        size_t body;
+        if (!exchange(request + "\n", reply) || !SyncWire::header(reply, line, body))
+        {
+            return failed("Unexpected reply to a request for digests");
+        }
+        digests.clear();
+        istringstream in(reply.substr(body));
+        string id, digest;
+        while (in >> id >> digest)
+        {
+            digests.emplace_back(atoi(id.c_str()), strtoull(digest.c_str(), nullptr, 16));
+        }
+        return true;
+    }
+
+    bool fetch(const vector<int> &ids, vector<Task> &tasks) override
+    {
+        string request = "F";
+        SyncWire::appendNumbers(request, ids);
+        string reply, line;
+        size_t body;
+        tasks.clear();
+        if (!exchange(request + "\n", reply) || !SyncWire::header(reply, line, body) || !ReplicationWire::parseTasks(reply, body, tasks))
+        {
+            return failed("Unexpected reply to a request for tasks");
+        }
+        return true;
+    }
+
+    bool apply(const vector<Task> &upserts, const vector<int> &deletes, size_t &applied, vector<string> &errors) override
+    {
+        string request = "A";
+        SyncWire::appendNumbers(request, deletes);
+        request += '\n';
+        for (const Task &task : upserts)
+        {
+            TaskSchema::appendRecord(request, task);
+        }
+        string reply, line;
+        size_t body;
+        vector<size_t> counts;
+        if (!exchange(request, reply) || !SyncWire::header(reply, line, body) || !SyncWire::readNumbers(line, counts) || counts.size() != 2)
+        {
+            return failed("Unexpected reply to a request to apply changes");
+        }
+        applied = counts[0];
+        istringstream in(reply.substr(body));
+        for (string reason; getline(in, reason);)
+        {
+            errors.push_back(reason);
+        }
+        return true;
+    }
+
+private:
+    // Send a request and wait for its reply; returns false with a message in lastError if the copy failed or went away
+    bool exchange(const string &request, string &reply)
+    {
+        if (!ReplicationWire::send(fd, request) || ReplicationWire::receive(fd, reply, replyTimeoutMs) != 1)
+        {
+            lastError = "Lost the connection to " + socketPath;
+            return false;
+        }
+        transferred += request.size() + reply.size() + 8; // Including the length prefixes
+        if (reply.compare(0, 2, "X ") == 0)
+        {
+            lastError = reply.substr(2, reply.find('\n') - 2);
+            return false;
+        }
+        return true;
+    }
+
+    // Fail with a message, unless the exchange already explained the failure
+    bool failed(const string &message)
+    {
+        if (lastError.empty())
+        {
+            lastError = message + " from " + socketPath;
+        }
+        return false;
+    }
+
+    int fd = -1;
+    string socketPath;
+};
+
+// The SyncServer class answers the requests of other processes synchronizing with the current project of a task manager.
+class SyncServer
+{
+public:
+    explicit SyncServer(TaskManager &taskManager) : local(taskManager) {}
+
+    // Listen on a socket path and serve one client at a time, until the process receives SIGINT or SIGTERM. Changes are on disk
+    // by the time their reply is sent. Returns false if the socket could not be created.
+    bool serve(const string &path)
+    {
+        sockaddr_un addr;
+        if (!ReplicationWire::address(path, addr))
+        {
+            cerr << "Sync socket path is too long: " << path << endl;
+            return false;
+        }
+        int listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+        unlink(path.c_str()); // Remove the socket left behind by an earlier server
+        if (listenFd < 0 || ::bind(listenFd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 || listen(listenFd, 16) != 0)
+        {
+            cerr << "Unable to listen on sync socket " << path << ": " << strerror(errno) << endl;
+            if (listenFd >= 0)
+            {
+                close(listenFd);
+            }
+            return false;
+        }
+        // SIGINT and SIGTERM end the loop below instead of the process, so the caller still writes its changes, metrics and trace
+        // out. The handler writes to a pipe that is polled with the socket, which works whichever thread the signal is delivered to.
+        int stopPipe[2];
+        if (pipe2(stopPipe, O_CLOEXEC | O_NONBLOCK) != 0)
+        {
+            cerr << "Unable to create the stop pipe of the sync server: " << strerror(errno) << endl;
+            close(listenFd);
+            unlink(path.c_str());
+            return false;
+        }
+        stopFd = stopPipe[1];
+        struct sigaction stop = {}, previousInterrupt, previousTerminate;
+        stop.sa_handler = requestStop;
+        sigemptyset(&stop.sa_mask);
+        sigaction(SIGINT, &stop, &previousInterrupt);
+        sigaction(SIGTERM, &stop, &previousTerminate);
+        cout << "Serving " << local.name() << " for synchronization on " << path << "." << endl;
+
+        while (true)
+        {
+            pollfd waitFor[2] = {{listenFd, POLLIN, 0}, {stopPipe[0], POLLIN, 0}};
+            if (poll(waitFor, 2, -1) < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                cerr << "Unable to wait for a sync client: " << strerror(errno) << endl;
+                break;
+            }
+            if (waitFor[1].revents != 0)
+            {
+                cout << "Stopped serving " << local.name() << "." << endl;
+                break;
+            }
+            int fd = accept(listenFd, nullptr, nullptr);
+            if (fd < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                cerr << "Unable to accept a sync client: " << strerror(errno) << endl;
+                break;
+            }
+            serveClient(fd);
+            close(fd);
+        }
+        sigaction(SIGINT, &previousInterrupt, nullptr);
+        sigaction(SIGTERM, &previousTerminate, nullptr);
+        stopFd = -1;
+        close(stopPipe[0]);
+        close(stopPipe[1]);
+        close(listenFd);
+        unlink(path.c_str());
+        return true;
+    }
+
+    // Answer one request
+    string handle(const string &request)
+    {
+        string line;
+        size_t body;
+        if (!SyncWire::header(request, line, body) || line.empty())
+        {
+            return SyncWire::failure("Malformed request");
+        }
+        try
+        {
+            switch (line[0])
+            {
+            case 'N':
+            {
+                vector<uint32_t> keys;
+                vector<uint64_t> hashes;
+                istringstream in(line.substr(1));
+                int level = -1;
+                in >> level;
+                if (level < 0 || level >= SyncTree::levelCount || !SyncWire::readNumbers(line, keys, false, 2))
+                {
+                    return SyncWire::failure("Malformed request for hashes");
+                }
+                local.nodeHashes(level, keys, hashes);
+                string reply = "N";
+                SyncWire::appendNumbers(reply, hashes, true);
+                return reply + "\n";
+            }
+            case 'L':
+            {
+                vector<uint32_t> buckets;
+                vector<pair<int, uint64_t>> digests;
+                if (!SyncWire::readNumbers(line, buckets))
+                {
+                    return SyncWire::failure("Malformed request for digests");
+                }
+                local.leafDigests(buckets, digests);
+                string reply = "L " + to_string(digests.size()) + "\n";
+                char buffer[40];
+                for (const auto &entry : digests)
+                {
+                    snprintf(buffer, sizeof(buffer), "%d %llx\n", entry.first, (unsigned long long)entry.second);
+                    reply += buffer;
+                }
+                return reply;
+            }
+            case 'F':
+            {
+                vector<int> ids;
+                vector<Task> tasks;
+                if (!SyncWire::readNumbers(line, ids))
+                {
+                    return SyncWire::failure("Malformed request for tasks");
+                }
+                local.fetch(ids, tasks);
+                string reply = "F " + to_string(tasks.size()) + "\n";
+                for (const Task &task : tasks)
+                {
+                    TaskSchema::appendRecord(reply, task);
+                }
+                return reply;
+            }
+            case 'A':
+            {
+                vector<int> deletes;
+                vector<Task> upserts;
+                vector<string> errors;
+                size_t applied = 0;
+                if (!SyncWire::readNumbers(line, deletes) || !ReplicationWire::parseTasks(request, body, upserts))
+                {
+                    return SyncWire::failure("Malformed request to apply changes");
+                }
+                if (!local.apply(upserts, deletes, applied, errors))
+                {
+                    return SyncWire::failure(local.error());
+                }
+                string reply = "A " + to_string(applied) + " " + to_string(errors.size()) + "\n";
+                for (const string &reason : errors)
+                {
+                    reply += reason + "\n";
+                }
+                return reply;
+            }
+            default:
+                return SyncWire::failure("Unknown request");
+            }
+        }
+        catch (const exception &ex)
+        {
+            return SyncWire::failure(ex.what());
+        }
+    }
+
+private:
+    // Write end of the stop pipe of the running server (-1 when none is running); only write() is used in the signal handler
+    static inline volatile int stopFd = -1;
+
+    static void requestStop(int)
+    {
+        int savedErrno = errno;
+        if (stopFd >= 0)
+        {
+            ssize_t written = write(stopFd, "s", 1); // A full pipe already holds a stop request
+            (void)written;
+        }
+        errno = savedErrno;
+    }
+
+    // Answer the requests of one client until it disconnects
+    void serveClient(int fd)
+    {
+        string request;
+        size_t requests = 0;
+        while (ReplicationWire::receive(fd, request, -1) == 1)
+        {
+            requests++;
+            if (!ReplicationWire::send(fd, handle(request)))
+            {
+                break;
+            }
+        }
+        cout << "Answered " << requests << " sync request(s)." << endl;
+    }
+
+    LocalSyncPeer local; // The project being served
+};
+
+// The TaskSync class compares two copies of a project and copies the differences from one to the other.
+class TaskSync
+{
+public:
+    // Open the other copy of a synchronization: the socket of a process serving its project, or a task file.
+    // Returns nullptr with a message in error if it cannot be opened.
+    static unique_ptr<SyncPeer> open(const string &path, string &error)
+    {
+        error_code ec;
+        if (filesystem::is_socket(path, ec))
+        {
+            unique_ptr<RemoteSyncPeer> remote(new RemoteSyncPeer());
+            if (!remote->connect(path))
+            {
+                error = remote->error();
+                return nullptr;
+            }
+            return unique_ptr<SyncPeer>(remote.release());
+        }
+        return unique_ptr<SyncPeer>(new LocalSyncPeer(path));
+    }
+
+    // Find the tasks two copies differ in, walking down only the nodes of their sync trees whose hashes differ.
+    // Returns false with a message in error if either copy fails.
+    static bool compare(SyncPeer &first, SyncPeer &second, SyncDifference &difference, string &error)
+    {
+        difference = SyncDifference();
+        vector<uint32_t> keys = {0};
+        vector<uint64_t> firstHashes, secondHashes;
+        for (int level = SyncTree::rootLevel;; level--)
+        {
+            if (!first.nodeHashes(level, keys, firstHashes) || !second.nodeHashes(level, keys, secondHashes))
+            {
+                error = !first.error().empty() ? first.error() : second.error();
+                return false;
+            }
+            difference.requests += 2;
+            difference.hashesCompared += keys.size();
+
+            vector<uint32_t> differing;
+            for (size_t i = 0; i < keys.size(); i++)
+            {
+                if (firstHashes[i] != secondHashes[i])
+                {
+                    differing.push_back(keys[i]);
+                }
+            }
+            if (differing.empty())
+            {
+                return true; // Everything below the nodes compared is the same
+            }
+            if (level == 0)
+            {
+                keys.swap(differing);
+                break;
+            }
+
+            // Compare the children of the nodes that differ at the next level
+            keys.clear();
+            for (uint32_t key : differing)
+            {
+                for (uint32_t child = 0; child < SyncTree::fanout; child++)
+                {
+                    keys.push_back(key << SyncTree::fanoutBits | child);
+                }
+            }
+        }
+
+        // Compare the tasks of the leaves that differ, which both copies list in ID order
+        vector<pair<int, uint64_t>> firstDigests, secondDigests;
+        if (!first.leafDigests(keys, firstDigests) || !second.leafDigests(keys, secondDigests))
+        {
+            error = !first.error().empty() ? first.error() : second.error();
+            return false;
+        }
+        difference.requests += 2;
+        size_t i = 0, j = 0;
+        while (i < firstDigests.size() || j < secondDigests.size())
+        {
+            if (j == secondDigests.size() || (i < firstDigests.size() && firstDigests[i].first < secondDigests[j].first))
+            {
+                difference.onlyFirst.push_back(firstDigests[i++].first);
+                continue;
+            }
+            if (i == firstDigests.size() || secondDigests[j].first < firstDigests[i].first)
+            {
+                difference.onlySecond.push_back(secondDigests[j++].first);
+                continue;
+            }
+            difference.hashesCompared++;
+            if (firstDigests[i].second != secondDigests[j].second)
+            {
+                difference.changed.push_back(firstDigests[i].first);
+            }
+            i++;
+            j++;
+        }
+        return true;
+    }
+
+    // Make target hold the same tasks as source, given the difference between them (with source as the first copy): the tasks
+    // only source has, or that changed, are sent to target, and the tasks only target has are deleted from it.
+    // Returns false with a message in error if either copy fails; changes target refused are appended to refused.
+    static bool copy(SyncPeer &source, SyncPeer &target, const SyncDifference &difference, size_t &sent, size_t &applied,
+                     vector<string> &refused, string &error)
+    {
+        sent = applied = 0;
+        vector<int> wanted = difference.onlyFirst;
+        wanted.insert(wanted.end(), difference.changed.begin(), difference.changed.end());
+        vector<Task> tasks;
+        if (!wanted.empty() && !source.fetch(wanted, tasks))
+        {
+            error = source.error();
+            return false;
+        }
+        sent = tasks.size();
+        if ((!tasks.empty() || !difference.onlySecond.empty()) && !target.apply(tasks, difference.onlySecond, applied, refused))
+        {
+            error = target.error();
+            return false;
+        }
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,198 @@
+// This file implements the materialized views of a project: the tasks kept permanently in the orders the views display them in.
+// Instead of sorting every task each time a view is shown, each view holds a balanced search tree of (sort key, task ID) entries
+// that is updated whenever a task is created, changed or deleted, at a cost of O(log n) per change.
+// Displaying a view is then an in-order walk of its tree.
+// Views can also be read one page at a time. A page ends with a cursor holding the sort key of its last task, and the next page
+// starts just after that key in the tree, so reading a page costs O(log n + page size) however many tasks the view holds.
+// Because the cursor holds the key rather than a position, pages stay consistent while tasks are added or removed between them.
+// The sort key is copied out of the task (only the fields the order looks at), so the view does not depend on where the task is stored.
+// Any order built with TaskSchema::Order can be used as a view, including orders defined outside this file.
+
+#ifndef TASK_VIEWS_CPP
+#define TASK_VIEWS_CPP
+
+#include <string>
+#include <vector>
+#include <set>           // The ordered entries of a view
+#include <unordered_map> // Entry of every task in a view
+#include <memory>        // unique_ptr for views created from a definition
+#include <functional>    // Callbacks for walking a view and creating views
+#include "task_schema.cpp" // Sort orders and the keys they compare
+#include "record_format.cpp" // Cursors are written as record fields
+
+using namespace std;
+
+// The TaskView class is the interface the TaskManager uses for every materialized view, whatever its order.
+class TaskView
+{
+public:
+    virtual ~TaskView() {}
+
+    // Add a task to the view
+    virtual void insert(const Task &task) = 0;
+
+    // Remove a task from the view (does nothing if it is not in the view)
+    virtual void remove(int taskID) = 0;
+
+    // Remove every task from the view
+    virtual void clear() = 0;
+
+    // Call visit(taskID) for every task, in the order of the view
+    virtual void forEach(const function<void(int)> &visit) const = 0;
+
+    // Call visit(taskID) for at most limit tasks, in the order of the view, starting after the position of a cursor ("" for the first page).
+    // nextCursor is set to the cursor of the following page, or "" if the page reached the end of the view.
+    // Returns false, without visiting anything, if the cursor could not be read. A cursor is only meaningful for the view that returned it.
+    virtual bool page(const string &cursor, size_t limit, const function<void(int)> &visit, string &nextCursor) const = 0;
+
+    // Number of tasks in the view
+    virtual size_t size() const = 0;
+
+    // Approximate number of bytes of memory used by the view
+    virtual size_t memoryUsage() const = 0;
+
+    // Move a task to its new place after some of its fields changed
+    void update(const Task &task)
+    {
+        remove(task.getTaskID());
+        insert(task);
+    }
+
+    // Fill the view with a list of tasks, replacing its contents
+    void rebuild(const vector<Task> &tasks)
+    {
+        clear();
+        for (const Task &task : tasks)
+        {
+            insert(task);
+        }
+    }
+};
+
+// A view that keeps tasks in the order given by a TaskSchema::Order
+template <typename Order>
+class MaterializedView : public TaskView
+{
+public:
+    void insert(const Task &task) override
+    {
+        int taskID = task.getTaskID();
+        remove(taskID); // A task appears in the view only once
+        byID[taskID] = entries.emplace(Order::keyOf(task), taskID).first;
+    }
+
+    void remove(int taskID) override
+    {
+        auto it = byID.find(taskID);
+        if (it != byID.end())
+        {
+            entries.erase(it->second);
+            byID.erase(it);
+        }
+    }
+
+    void clear() override
+    {
+        entries.clear();
+        byID.clear();
+    }
+
+    void forEach(const function<void(int)> &visit) const override
+    {
+        for (const Entry &entry : entries)
+        {
+            visit(entry.second);
+        }
+    }
+
+    bool page(const string &cursor, size_t limit, const function<void(int)> &visit, string &nextCursor) const override
+    {
+        auto it = entries.begin();
+        if (!cursor.empty())
+        {
+            Entry after;
+            if (!decodeCursor(cursor, after))
+            {
+                return false;
+            }
+            it = entries.upper_bound(after);
+        }
+
+        nextCursor.clear();
+        for (size_t count = 0; count < limit && it != entries.end(); count++)
+        {
+            visit(it->second);
+            auto last = it++;
+            if (count + 1 == limit && it != entries.end())
+            {
+                nextCursor = encodeCursor(*last);
+            }
+        }
+        return true;
+    }
+
+    size_t size() const override
+    {
+        return entries.size();
+    }
+
+    size_t memoryUsage() const override
+    {
+        // A tree node and a hash table node per task (string fields of the key are usually short enough to be stored inline)
+        static const size_t nodeOverhead = 4 * sizeof(void *) + 2 * sizeof(void *) + sizeof(int);
+        return sizeof(*this) + entries.size() * (sizeof(Entry) + nodeOverhead + sizeof(typename EntrySet::iterator));
+    }
+
+private:
+    // The sort key of a task followed by its ID, which keeps the entries unique even for orders that do not end with the ID
+    typedef pair<typename Order::KeyTuple, int> Entry;
+
+    struct EntryLess
+    {
+        bool operator()(const Entry &a, const Entry &b) const
+        {
+            int result = Order::compareKeys(a.first, b.first);
+            return result != 0 ? result < 0 : a.second < b.second;
+        }
+    };
+
+    typedef set<Entry, EntryLess> EntrySet;
+
+    // A cursor is the task ID followed by the sort key, written as the fields of a task file record.
+    // The ID comes first so the text never starts with a character the scanner treats specially.
+    static string encodeCursor(const Entry &entry)
+    {
+        string cursor;
+        IntegerCodec::append(cursor, entry.second);
+        Order::appendKey(cursor, entry.first);
+        return cursor;
+    }
+
+    static bool decodeCursor(const string &cursor, Entry &entry)
+    {
+        vector<string> fields;
+        FieldScanner scanner(cursor.data(), cursor.size(), false);
+        return scanner.nextRecord(fields) && fields.size() == 1 + Order::keyCount && IntegerCodec::parse(fields[0], entry.second) &&
+               Order::parseKey(fields, 1, entry.first);
+    }
+
+    EntrySet entries;                                     // Tasks in the order of the view
+    unordered_map<int, typename EntrySet::iterator> byID; // Entry of every task, so a task can be moved without knowing its old key
+};
+
+// A named view order; every project gets one view for each definition
+struct ViewDefinition
+{
+    string name;                           // Name shown to the user
+    function<unique_ptr<TaskView>()> make; // Create an empty view with this order
+
+    // Definition of a view for an order built with TaskSchema::Order
+    template <typename Order>
+    static ViewDefinition of(const string &viewName)
+    {
+        return {viewName, []
+                { return unique_ptr<TaskView>(new MaterializedView<Order>()); }};
+    }
+};
+
+#endif
@@ -0,0 +1,286 @@
+// This file implements the background writer that saves task files without making the menu wait for the disk.
+// The TaskManager updates its tasks in memory, hands the new file contents (or the bytes to append) to the writer and returns at once.
+// A single I/O thread performs the writes. Writes that are still waiting when a newer one arrives for the same file are combined:
+// a full rewrite replaces everything queued before it, and appends are added to whatever is queued, so a burst of edits
+// costs one write instead of one per edit.
+// Callers that need the data on disk before continuing (for example before exiting) call flush(), which waits for every earlier write
+// and reports any failure since the previous flush(). Code that only needs a file to be up to date before reading it calls wait(),
+// which leaves failures in place for the next flush() to report, so a failed write is never reported as a success.
+// Full rewrites go to a temporary file that is then renamed over the task file, so the file is never left half written.
+// Every write is synced with fsync() before it counts as done: a rewrite syncs the temporary file before the rename and the directory
+// after it, and an append syncs the file. Once flush() returns true the data survives a crash or a power loss, not just the process.
+// The sync costs one fsync() per batch rather than per edit, since queued writes to a file are combined first.
+
+#ifndef TASK_WRITER_CPP
+#define TASK_WRITER_CPP
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <map>                // Queued writes by file name
+#include <set>                // Files whose writes failed
+#include <thread>             // The I/O thread
+#include <mutex>              // Protects the queue
+#include <condition_variable> // Wakes the I/O thread and the callers of flush()
+#include <cstdio>             // rename() for replacing the file in one step
+#include <cerrno>             // Retrying interrupted writes
+#include <filesystem>         // Directory of a file, which is synced after a rename
+#include <fcntl.h>            // open()
+#include <unistd.h>           // write(), fsync() and close()
+#include "metrics.cpp"        // Bytes written and write latency
+#include "trace.cpp"          // Spans for the writes on the I/O thread
+
+using namespace std;
+
+// The DurableFile class writes files with POSIX calls and fsync(), so a write that returned true is on the disk itself.
+// The TaskManager uses it for the writes it makes without the background writer (converting a file to the current format).
+class DurableFile
+{
+public:
+    // Replace the contents of a file: write them to a temporary file next to it, sync it, rename it over the file, then sync the
+    // directory so that the rename is durable too. The file is never left half written.
+    static bool replace(const string &filename, const string &data)
+    {
+        string temporary = filename + ".tmp";
+        int fd = open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0)
+        {
+            return false;
+        }
+        bool ok = writeAll(fd, data) && fsync(fd) == 0;
+        ok = close(fd) == 0 && ok;
+        if (!ok || rename(temporary.c_str(), filename.c_str()) != 0)
+        {
+            remove(temporary.c_str());
+            return false;
+        }
+        return syncDirectory(filename);
+    }
+
+    // Add bytes to the end of a file and sync it; a file created by the append also has its directory synced
+    static bool append(const string &filename, const string &data)
+    {
+        bool created = false;
+        int fd = open(filename.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC);
+        if (fd < 0 && errno == ENOENT)
+        {
+            fd = open(filename.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+            created = true;
+        }
+        if (fd < 0)
+        {
+            return false;
+        }
+        bool ok = writeAll(fd, data) && fdatasync(fd) == 0;
+        ok = close(fd) == 0 && ok;
+        return ok && (!created || syncDirectory(filename));
+    }
+
+    // Sync the directory holding a file, which makes the creation or renaming of the file durable
+    static bool syncDirectory(const string &filename)
+    {
+        string directory = filesystem::path(filename).parent_path().string();
+        int fd = open(directory.empty() ? "." : directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            return false;
+        }
+        bool ok = fsync(fd) == 0;
+        close(fd);
+        return ok;
+    }
+
+private:
+    // Write all the bytes, carrying on after short writes and interrupted calls
+    static bool writeAll(int fd, const string &data)
+    {
+        size_t written = 0;
+        while (written < data.size())
+        {
+            ssize_t result = write(fd, data.data() + written, data.size() - written);
+            if (result < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (result <= 0)
+            {
+                return false;
+            }
+            written += size_t(result);
+        }
+        return true;
+    }
+};
+
+// The BackgroundWriter class owns the I/O thread and the queue of writes waiting for it.
+class BackgroundWriter
+{
+public:
+    BackgroundWriter() : worker(&BackgroundWriter::run, this) {}
+
+    // Finish every queued write before the I/O thread stops
+    ~BackgroundWriter()
+    {
+        {
+            lock_guard<mutex> lock(queueMutex);
+            stopping = true;
+        }
+        workAvailable.notify_one();
+        worker.join();
+    }
+
+    // Replace the whole contents of a file; anything still queued for the file is dropped because it would be overwritten anyway
+    void replace(const string &filename, string contents)
+    {
+        {
+            lock_guard<mutex> lock(queueMutex);
+            PendingWrite &pending = queued[filename];
+            if (pending.queued)
+            {
+                Metrics::instance().add(MetricCounter::WRITES_COALESCED);
+            }
+            pending.queued = true;
+            pending.replace = true;
+            pending.data = move(contents);
+            submitted++;
+        }
+        workAvailable.notify_one();
+    }
+
+    // Add bytes to the end of a file; they are joined to anything still queued for the file
+    void append(const string &filename, const string &bytes)
+    {
+        {
+            lock_guard<mutex> lock(queueMutex);
+            PendingWrite &pending = queued[filename];
+            if (pending.queued)
+            {
+                Metrics::instance().add(MetricCounter::WRITES_COALESCED);
+            }
+            pending.queued = true;
+            pending.data += bytes;
+            submitted++;
+        }
+        workAvailable.notify_one();
+    }
+
+    // Wait until every write queued before this call is on disk and synced, so that it survives a crash.
+    // Returns false if any write failed since the previous flush().
+    bool flush()
+    {
+        unique_lock<mutex> lock(queueMutex);
+        waitForQueued(lock);
+        bool ok = failedFiles.empty();
+        failedFiles.clear();
+        return ok;
+    }
+
+    // Wait like flush(), but only report whether a write to one file failed since the previous flush(). The failure is kept, so
+    // the next flush() still reports it.
+    bool wait(const string &filename)
+    {
+        unique_lock<mutex> lock(queueMutex);
+        waitForQueued(lock);
+        return failedFiles.count(filename) == 0;
+    }
+
+    // Check whether any writes are waiting or in progress
+    bool isIdle()
+    {
+        lock_guard<mutex> lock(queueMutex);
+        return completed == submitted;
+    }
+
+private:
+    // Writes queued for one file
+    struct PendingWrite
+    {
+        bool queued = false;  // Something is waiting to be written
+        bool replace = false; // Rewrite the file with data instead of appending it
+        string data;          // New contents of the file, or the bytes to append
+    };
+
+    // Wait until every write queued so far has been performed (the lock must be held)
+    void waitForQueued(unique_lock<mutex> &lock)
+    {
+        uint64_t target = submitted;
+        writesDone.wait(lock, [this, target]
+                        { return completed >= target; });
+    }
+
+    // Body of the I/O thread: take everything queued, write it, and repeat
+    void run()
+    {
+        Tracer::instance().setThreadName("writer");
+        unique_lock<mutex> lock(queueMutex);
+        while (true)
+        {
+            workAvailable.wait(lock, [this]
+                               { return stopping || !queued.empty(); });
+            if (queued.empty())
+            {
+                return; // Stopping and nothing left to write
+            }
+
+            // Write the batch without holding the lock, so new writes can be queued meanwhile
+            map<string, PendingWrite> batch;
+            batch.swap(queued);
+            uint64_t batchEnd = submitted;
+            lock.unlock();
+
+            vector<string> failures;
+            for (auto &entry : batch)
+            {
+                if (!writeFile(entry.first, entry.second))
+                {
+                    failures.push_back(entry.first);
+                }
+            }
+
+            lock.lock();
+            completed = batchEnd;
+            failedFiles.insert(failures.begin(), failures.end());
+            writesDone.notify_all();
+        }
+    }
+
+    // Perform one queued write; returns false if it failed
+    static bool writeFile(const string &filename, const PendingWrite &pending)
+    {
+        ScopedTimer timer(MetricTimer::BACKGROUND_WRITE);
+        TraceSpan span(pending.replace ? "backgroundRewrite" : "backgroundAppend", "io");
+
+        if (pending.replace)
+        {
+            // Write the new contents next to the file, then swap it in with a single rename
+            if (!DurableFile::replace(filename, pending.data))
+            {
+                cerr << "Unable to open file for writing: " << filename << endl;
+                return false;
+            }
+            Metrics::instance().add(MetricCounter::REWRITE_BYTES_WRITTEN, pending.data.size());
+            return true;
+        }
+
+        if (!DurableFile::append(filename, pending.data))
+        {
+            cerr << "Unable to open file: " << filename << endl;
+            return false;
+        }
+        Metrics::instance().add(MetricCounter::APPEND_BYTES_WRITTEN, pending.data.size());
+        return true;
+    }
+
+    mutex queueMutex;                   // Protects everything below
+    condition_variable workAvailable;   // Signalled when writes are queued or the writer is stopping
+    condition_variable writesDone;      // Signalled when a batch of writes has finished
+    map<string, PendingWrite> queued;   // Writes waiting for the I/O thread
+    uint64_t submitted = 0;             // Number of writes queued so far
+    uint64_t completed = 0;             // Number of queued writes that have been performed
+    set<string> failedFiles;            // Files a write failed for since the last flush()
+    bool stopping = false;              // The writer is being destroyed
+    thread worker;                      // The I/O thread (declared last so it starts after the members it uses)
+};
+
+#endif
@@ -0,0 +1,442 @@
+// This file implements the C API declared in taskstore.h on top of the TaskManager.
+// It is one of the two translation units of libtaskstore, next to taskstore_core.cpp (the C++ API of the command line client); the
+// Makefile builds both into the static and shared library, and the shared library exports only the ts_* functions and the classes of
+// taskstore_core.h (see taskstore.map). Each function converts between the C structures and Task objects, calls the TaskManager operations
+// that never prompt or print (addTask(), getTask(), updateTask(), removeTask(), readViewPage(), searchTaskIDs(), claimNext()), and turns
+// their results, and any exception, into a ts_status with a message for ts_last_error(). No exception ever reaches the caller.
+
+#ifndef TASK_STORE_CPP
+#define TASK_STORE_CPP
+
+#include <string>
+#include <vector>
+#include <new>        // bad_alloc when a store cannot be allocated
+#include <mutex>      // Failures of concurrent claims
+#include "taskstore.h"
+#include "TaskManager.cpp" // The task manager behind the API
+
+using namespace std;
+
+// An open task file
+struct ts_store
+{
+    TaskManager manager;       // The task manager of the file
+    string lastError;          // Message of the last failure
+    Task current;              // Task returned by the last ts_get()
+    string currentDescription; // Description of current (which may have been left in the task file)
+    string currentRecurrence;  // Recurrence rule of current as text
+    mutex claimErrorMutex;     // Protects lastError while threads claim tasks at the same time
+
+    explicit ts_store(const string &path) : manager(path) {}
+};
+
+// Position in the results of a query
+struct ts_cursor
+{
+    ts_store *store;
+    size_t view = 0;           // View read by the cursor (when not searching)
+    bool searching = false;    // Whether the cursor reads search results
+    vector<int> hits;          // IDs of the search results
+    size_t nextHit = 0;        // Next search result to read
+    vector<Task> page;         // Page of the view being read
+    size_t nextOnPage = 0;     // Next task of page to read
+    string nextPage;           // Cursor of the following page of the view ("" after the last page)
+    bool started = false;      // Whether the first page has been read
+    Task current;              // Task returned by the last ts_next()
+    string currentDescription; // Description of current (which may have been left in the task file)
+    string currentRecurrence;  // Recurrence rule of current as text
+};
+
+namespace
+{
+    // Message of the last failed ts_open() of each thread
+    thread_local string openError;
+
+    // Tasks a cursor over a view reads at a time
+    const size_t cursorPageSize = 256;
+
+    ts_status statusOf(StoreStatus status)
+    {
+        switch (status)
+        {
+        case StoreStatus::OK:
+            return TS_OK;
+        case StoreStatus::NOT_FOUND:
+            return TS_NOT_FOUND;
+        case StoreStatus::ALREADY_EXISTS:
+            return TS_EXISTS;
+        case StoreStatus::INVALID:
+            return TS_INVALID;
+        default:
+            return TS_IO_ERROR;
+        }
+    }
+
+    ts_status fail(ts_store *store, ts_status status, const string &message)
+    {
+        store->lastError = message;
+        return status;
+    }
+
+    // Convert a C task to a Task, checking it like an imported record; returns false with a message if it is refused
+    bool toTask(const ts_task *in, Task &out, string &error)
+    {
+        auto text = [](const char *value)
+        { return string(value != nullptr ? value : ""); };
+
+        int day;
+        if (in->id < 0)
+        {
+            error = "Task ID must be zero or a positive integer";
+            return false;
+        }
+        if (int(in->priority) < 0 || int(in->priority) > 2 || int(in->status) < 0 || int(in->status) > 2)
+        {
+            error = "Unknown priority or status";
+            return false;
+        }
+        if (!DeadlineCodec::dayNumber(text(in->deadline), day))
+        {
+            error = "Invalid deadline \"" + text(in->deadline) + "\"; dates must be in DD/MM/YYYY format";
+            return false;
+        }
+        if (in->dependency_count > 0 && in->dependencies == nullptr)
+        {
+            error = "dependency_count is set but dependencies is NULL";
+            return false;
+        }
+
+        out = Task(in->id, text(in->title), text(in->description), text(in->deadline), TaskPriority(in->priority), TaskStatus(in->status),
+                   text(in->label), text(in->category));
+        vector<int> dependencies(in->dependencies, in->dependencies + in->dependency_count);
+        for (int dependency : dependencies)
+        {
+            if (dependency <= 0)
+            {
+                error = "Task IDs must be positive integers";
+                return false;
+            }
+        }
+        out.setDependencies(dependencies); // Throws if the task depends on itself
+        out.setRecurrence(RecurrenceRule::parse(text(in->recurrence)));
+        return true;
+    }
+
+    // Point a C task at the fields of a Task, and at the strings a description read back from the task file and the recurrence
+    // rule are copied to (which must all outlive the C task)
+    void fromTask(const Task &in, string &description, string &recurrence, ts_task *out)
+    {
+        recurrence = in.getRecurrence().toString();
+        out->id = in.getTaskID();
+        out->category = in.getCategory().c_str();
+        out->title = in.getTitle().c_str();
+        description = in.loadDescription();
+        out->description = description.c_str();
+        out->deadline = in.getDeadline().c_str();
+        out->label = in.getLabel().c_str();
+        out->priority = ts_priority(in.getPriorityValue());
+        out->status = ts_task_status(in.getStatusValue());
+        out->dependencies = in.getDependencies().data();
+        out->dependency_count = in.getDependencies().size();
+        out->recurrence = recurrence.c_str();
+    }
+
+    // Run a call, turning any exception into a failure of the store
+    template <typename Call>
+    ts_status guarded(ts_store *store, Call call)
+    {
+        if (store == nullptr)
+        {
+            return TS_INVALID;
+        }
+        try
+        {
+            return call();
+        }
+        catch (const invalid_argument &ex)
+        {
+            return fail(store, TS_INVALID, ex.what());
+        }
+        catch (const exception &ex)
+        {
+            return fail(store, TS_IO_ERROR, ex.what());
+        }
+        catch (...)
+        {
+            return fail(store, TS_IO_ERROR, "Unknown error");
+        }
+    }
+}
+
+extern "C"
+{
+    TS_API int ts_api_version(void)
+    {
+        return TS_API_VERSION;
+    }
+
+    TS_API ts_status ts_open(const char *path, ts_store **store)
+    {
+        if (store == nullptr)
+        {
+            return TS_INVALID;
+        }
+        *store = nullptr;
+        if (path == nullptr || *path == '\0')
+        {
+            openError = "No task file given";
+            return TS_INVALID;
+        }
+        // Creating the task manager can fail too (memory, unreadable files next to the task file), so it is guarded like every call
+        ts_store *opened = nullptr;
+        try
+        {
+            opened = new ts_store(path);
+        }
+        catch (const bad_alloc &)
+        {
+            openError = "Out of memory";
+            return TS_IO_ERROR;
+        }
+        catch (const exception &ex)
+        {
+            openError = ex.what();
+            return TS_IO_ERROR;
+        }
+        catch (...)
+        {
+            openError = "Unknown error";
+            return TS_IO_ERROR;
+        }
+
+        // Read the tasks now, so a damaged file is reported here rather than by the first call that needs them
+        ts_status status = guarded(opened, [opened]()
+                                   { opened->manager.getStatistics();
+                                     return TS_OK; });
+        if (status != TS_OK)
+        {
+            openError = opened->lastError;
+            delete opened;
+            return status;
+        }
+        *store = opened;
+        return TS_OK;
+    }
+
+    TS_API void ts_close(ts_store *store)
+    {
+        delete store; // The TaskManager writes everything out when it is destroyed
+    }
+
+    TS_API const char *ts_last_error(const ts_store *store)
+    {
+        return store != nullptr ? store->lastError.c_str() : openError.c_str();
+    }
+
+    TS_API void ts_task_init(ts_task *task)
+    {
+        if (task != nullptr)
+        {
+            *task = ts_task();
+            task->category = task->title = task->description = task->deadline = task->label = task->recurrence = "";
+            task->priority = TS_PRIORITY_LOW;
+            task->status = TS_STATUS_PENDING;
+        }
+    }
+
+    TS_API ts_status ts_create(ts_store *store, const ts_task *task, int *id)
+    {
+        return guarded(store, [store, task, id]()
+                       {
+            Task created;
+            string error;
+            if (task == nullptr || !toTask(task, created, error))
+            {
+                return fail(store, TS_INVALID, task == nullptr ? "No task given" : error);
+            }
+            ts_status status = statusOf(store->manager.addTask(created, error));
+            if (status != TS_OK)
+            {
+                return fail(store, status, error);
+            }
+            if (id != nullptr)
+            {
+                *id = created.getTaskID();
+            }
+            return TS_OK; });
+    }
+
+    TS_API ts_status ts_get(ts_store *store, int id, ts_task *task)
+    {
+        return guarded(store, [store, id, task]()
+                       {
+            const Task *found = store->manager.getTask(id);
+            if (found == nullptr || task == nullptr)
+            {
+                return fail(store, found == nullptr ? TS_NOT_FOUND : TS_INVALID, "Task with ID " + to_string(id) + " not found.");
+            }
+            store->current = *found;
+            fromTask(store->current, store->currentDescription, store->currentRecurrence, task);
+            return TS_OK; });
+    }
+
+    TS_API ts_status ts_update(ts_store *store, const ts_task *task)
+    {
+        return guarded(store, [store, task]()
+                       {
+            Task changed;
+            string error;
+            if (task == nullptr || !toTask(task, changed, error))
+            {
+                return fail(store, TS_INVALID, task == nullptr ? "No task given" : error);
+            }
+            ts_status status = statusOf(store->manager.updateTask(changed, error));
+            return status == TS_OK ? TS_OK : fail(store, status, error); });
+    }
+
+    TS_API ts_status ts_delete(ts_store *store, int id)
+    {
+        return guarded(store, [store, id]()
+                       {
+            string error;
+            ts_status status = statusOf(store->manager.removeTask(id, error));
+            return status == TS_OK ? TS_OK : fail(store, status, error); });
+    }
+
+    TS_API ts_status ts_query(ts_store *store, const char *view, const char *search, ts_cursor **cursor)
+    {
+        return guarded(store, [store, view, search, cursor]()
+                       {
+            if (cursor == nullptr)
+            {
+                return fail(store, TS_INVALID, "No cursor given");
+            }
+            *cursor = nullptr;
+            unique_ptr<ts_cursor> opened(new ts_cursor());
+            opened->store = store;
+            if (search != nullptr && *search != '\0')
+            {
+                opened->searching = true;
+                opened->hits = store->manager.searchTaskIDs(search);
+            }
+            else
+            {
+                opened->view = store->manager.findView(view != nullptr ? view : "date");
+                if (opened->view == SIZE_MAX)
+                {
+                    return fail(store, TS_INVALID, string("Unknown view: ") + view);
+                }
+            }
+            *cursor = opened.release();
+            return TS_OK; });
+    }
+
+    TS_API ts_status ts_next(ts_cursor *cursor, ts_task *task)
+    {
+        if (cursor == nullptr || task == nullptr)
+        {
+            return TS_INVALID;
+        }
+        return guarded(cursor->store, [cursor, task]()
+                       {
+            TaskManager &manager = cursor->store->manager;
+            if (cursor->searching)
+            {
+                // Tasks deleted since the search are skipped
+                while (cursor->nextHit < cursor->hits.size())
+                {
+                    const Task *found = manager.getTask(cursor->hits[cursor->nextHit++]);
+                    if (found != nullptr)
+                    {
+                        cursor->current = *found;
+                        fromTask(cursor->current, cursor->currentDescription, cursor->currentRecurrence, task);
+                        return TS_OK;
+                    }
+                }
+                return TS_END;
+            }
+
+            // Read the next page of the view when the current one is used up
+            if (cursor->nextOnPage == cursor->page.size())
+            {
+                if (cursor->started && cursor->nextPage.empty())
+                {
+                    return TS_END;
+                }
+                string following;
+                if (!manager.readViewPage(cursor->view, cursor->nextPage, cursorPageSize, cursor->page, following))
+                {
+                    return fail(cursor->store, TS_INVALID, "The cursor no longer matches its view");
+                }
+                cursor->started = true;
+                cursor->nextPage = following;
+                cursor->nextOnPage = 0;
+                if (cursor->page.empty())
+                {
+                    return TS_END;
+                }
+            }
+            cursor->current = cursor->page[cursor->nextOnPage++];
+            fromTask(cursor->current, cursor->currentDescription, cursor->currentRecurrence, task);
+            return TS_OK; });
+    }
+
+    TS_API void ts_cursor_close(ts_cursor *cursor)
+    {
+        delete cursor;
+    }
+
+    TS_API ts_status ts_count(ts_store *store, const char *category, int status, int priority, size_t *count)
+    {
+        return guarded(store, [store, category, status, priority, count]()
+                       {
+            if (count == nullptr)
+            {
+                return fail(store, TS_INVALID, "No count given");
+            }
+            StatisticsFilter filter;
+            filter.category = category != nullptr ? category : "";
+            filter.status = status;
+            filter.priority = priority;
+            *count = store->manager.getStatistics().count(filter);
+            return TS_OK; });
+    }
+
+    TS_API ts_status ts_claim_next(ts_store *store, int *id)
+    {
+        if (store == nullptr || id == nullptr)
+        {
+            return TS_INVALID;
+        }
+        // Not guarded(): other threads may be claiming, so a failure is recorded under the lock
+        string error;
+        try
+        {
+            Task claimed;
+            if (!store->manager.claimNext(claimed))
+            {
+                return TS_END;
+            }
+            *id = claimed.getTaskID();
+            return TS_OK;
+        }
+        catch (const exception &ex)
+        {
+            error = ex.what();
+        }
+        catch (...)
+        {
+            error = "Unknown error";
+        }
+        lock_guard<mutex> lock(store->claimErrorMutex);
+        return fail(store, TS_IO_ERROR, error);
+    }
+
+    TS_API ts_status ts_flush(ts_store *store)
+    {
+        return guarded(store, [store]()
+                       { return store->manager.flushWrites() ? TS_OK : fail(store, TS_IO_ERROR, "Some changes could not be saved to the task file."); });
+    }
+}
+
+#endif
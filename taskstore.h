@@ -0,0 +1,134 @@
+/* This file declares the C API of the task store, for programs that embed the task manager instead of running its menu.
+ * The API is plain C, so it can be called from C, C++ or any language with a C foreign function interface, and it does not
+ * change when the C++ classes behind it do. It is implemented in taskstore.cpp, which is built into libtaskstore (see the README).
+ *
+ * A store is one task file opened in the calling process, with the same files next to it as the interactive program uses
+ * (search index, archive, ID high-water mark). Every function returns a ts_status; when it is not TS_OK, ts_last_error()
+ * describes what went wrong. A store and its cursors must be used by one thread at a time, except for ts_claim_next(), which
+ * worker threads may call on the same store at the same time (see below).
+ *
+ * Tasks are passed in a ts_task. Strings given to the store are copied. Strings and arrays returned by ts_get() and ts_next()
+ * belong to the store (or cursor) and stay valid until the next call on it.
+ */
+
+#ifndef TASKSTORE_H
+#define TASKSTORE_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#if defined(__GNUC__)
+#define TS_API __attribute__((visibility("default")))
+#else
+#define TS_API
+#endif
+
+/* Version of the API; it changes only when existing declarations change */
+#define TS_API_VERSION 1
+
+typedef struct ts_store ts_store;   /* An open task file */
+typedef struct ts_cursor ts_cursor; /* Position in the results of a query */
+
+/* Result of every call */
+typedef enum ts_status
+{
+    TS_OK = 0,          /* The call succeeded */
+    TS_NOT_FOUND = 1,   /* No task has the given ID */
+    TS_EXISTS = 2,      /* The ID is already used by a task or an archived task */
+    TS_INVALID = 3,     /* An argument was refused (unknown view, invalid date, dependency cycle, ...) */
+    TS_IO_ERROR = 4,    /* A file could not be read or written */
+    TS_END = 5          /* A cursor has no more tasks, or no task is ready to be claimed */
+} ts_status;
+
+typedef enum ts_priority
+{
+    TS_PRIORITY_LOW = 0,
+    TS_PRIORITY_MEDIUM = 1,
+    TS_PRIORITY_HIGH = 2
+} ts_priority;
+
+typedef enum ts_task_status
+{
+    TS_STATUS_PENDING = 0,
+    TS_STATUS_IN_PROGRESS = 1,
+    TS_STATUS_COMPLETED = 2
+} ts_task_status;
+
+/* A task. NULL strings are read as empty strings. */
+typedef struct ts_task
+{
+    int id;                  /* Unique ID; 0 when creating a task assigns the next free one */
+    const char *category;    /* Category (Personal, Work, ...) */
+    const char *title;       /* Title */
+    const char *description; /* Description */
+    const char *deadline;    /* Deadline in DD/MM/YYYY format (the first occurrence of a repeating task) */
+    const char *label;       /* Label */
+    ts_priority priority;    /* Priority */
+    ts_task_status status;   /* Status */
+    const int *dependencies; /* IDs of the tasks this task depends on */
+    size_t dependency_count; /* Number of entries in dependencies */
+    const char *recurrence;  /* Recurrence rule such as "FREQ=WEEKLY;BYDAY=MO,WE" (empty for a task that does not repeat) */
+} ts_task;
+
+/* Version of the library, to compare with TS_API_VERSION */
+TS_API int ts_api_version(void);
+
+/* Open the task file at path (created on the first change if it does not exist). On failure *store is set to NULL and
+ * ts_last_error(NULL) describes the problem. */
+TS_API ts_status ts_open(const char *path, ts_store **store);
+
+/* Write every change to disk and close the store (does nothing for NULL) */
+TS_API void ts_close(ts_store *store);
+
+/* Description of the last failure of a call on the store, or of the last failed ts_open() of this thread if store is NULL */
+TS_API const char *ts_last_error(const ts_store *store);
+
+/* Fill a task with empty strings, no dependencies, low priority and pending status */
+TS_API void ts_task_init(ts_task *task);
+
+/* Add a task; the ID it was stored under is written to *id if id is not NULL */
+TS_API ts_status ts_create(ts_store *store, const ts_task *task, int *id);
+
+/* Read the task with an ID */
+TS_API ts_status ts_get(ts_store *store, int id, ts_task *task);
+
+/* Replace the task with the ID of task->id */
+TS_API ts_status ts_update(ts_store *store, const ts_task *task);
+
+/* Delete the task with an ID */
+TS_API ts_status ts_delete(ts_store *store, int id);
+
+/* Start reading tasks in the order of a view ("date", "priority" or "category"; NULL for "date"), or, if search is neither
+ * NULL nor empty, the tasks matching a search query, best match first. Tasks are read a page at a time, so a cursor over a
+ * view stays valid, and consistent, while tasks are changed between calls. */
+TS_API ts_status ts_query(ts_store *store, const char *view, const char *search, ts_cursor **cursor);
+
+/* Read the next task of a query; returns TS_END after the last one */
+TS_API ts_status ts_next(ts_cursor *cursor, ts_task *task);
+
+/* Release a cursor (does nothing for NULL) */
+TS_API void ts_cursor_close(ts_cursor *cursor);
+
+/* Count the tasks of a category (NULL or "" for every category) with a status and priority (-1 for any), from the
+ * statistics kept up to date with every change */
+TS_API ts_status ts_count(ts_store *store, const char *category, int status, int priority, size_t *count);
+
+/* Take the task that should be worked on next (pending, not waiting on any unfinished task, highest priority and then earliest
+ * deadline first), mark it In Progress and write its ID to *id; returns TS_END if no task is ready.
+ * Several threads may call this on the same store at the same time, and each task is handed to exactly one of them; no other call
+ * may be made on the store meanwhile. Claims are not written to the task file one by one: ts_flush() and ts_close() write them.
+ * ts_last_error() is only meaningful once the claiming threads have stopped. */
+TS_API ts_status ts_claim_next(ts_store *store, int *id);
+
+/* Wait until every change made so far is on disk */
+TS_API ts_status ts_flush(ts_store *store);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
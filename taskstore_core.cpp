@@ -0,0 +1,340 @@
+// This file implements the C++ API declared in taskstore_core.h, which the interactive program is built on.
+// It is a translation unit of libtaskstore, next to taskstore.cpp (the C API): it holds the task manager and the other modes of the
+// program, and each class of the header forwards to them. The command line client (main.cpp) includes only the header and links
+// against the library.
+
+#ifndef TASK_STORE_CORE_CPP
+#define TASK_STORE_CORE_CPP
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <chrono>  // Timing a synchronization
+#include <iomanip> // Formatting the scrub and sync reports
+#include "taskstore_core.h"
+#include "TaskManager.cpp" // The task manager behind the API
+#include "workload.cpp"    // Scripted workloads for performance tests
+#include "task_sync.cpp"   // Comparing and synchronizing copies of a project
+
+using namespace std;
+
+// The defaults of the settings must match the ones of the task manager
+static_assert(TaskSessionSettings::defaultProjectCacheBytes == ProjectCache::defaultBudget, "default project cache budget");
+static_assert(TaskSessionSettings::defaultPageSize == TaskManager::defaultPageSize, "default page size");
+static_assert(TaskSessionSettings::defaultDescriptionCacheBytes == ColdFieldCache::defaultBudget, "default description cache budget");
+
+namespace
+{
+    // Format of an exported or imported file: the one named by format, or the one its name suggests if format is empty
+    ExportFormat exchangeFormat(const string &filename, const string &format)
+    {
+        ExportFormat chosen = exportFormatOf(filename);
+        if (!format.empty() && !parseExportFormat(format, chosen))
+        {
+            throw invalid_argument("Unknown file format: " + format + " (use jsonl or csv)");
+        }
+        return chosen;
+    }
+
+    // Print up to a few task IDs of a list
+    void printTaskIDs(const string &heading, const vector<int> &ids)
+    {
+        static const size_t shown = 20;
+        if (ids.empty())
+        {
+            return;
+        }
+        cout << "  " << heading << ":";
+        for (size_t i = 0; i < ids.size() && i < shown; i++)
+        {
+            cout << " " << ids[i];
+        }
+        cout << (ids.size() > shown ? " ... (" + to_string(ids.size()) + " in all)" : "") << endl;
+    }
+}
+
+TaskSession::TaskSession(const TaskSessionSettings &settings) : manager(new TaskManager(settings.projectFile, settings.projectCacheBytes))
+{
+    UrgencyHorizons horizons;
+    horizons.todayDays = settings.dueTodayDays;
+    horizons.weekDays = settings.dueThisWeekDays;
+    manager->setPageSize(settings.pageSize);
+    manager->setUrgencyHorizons(horizons);
+    manager->setVerifyStatistics(settings.verifyStatistics);
+    if (settings.lazyDescriptions)
+    {
+        manager->setLazyDescriptions(settings.descriptionCacheBytes);
+    }
+}
+
+TaskSession::~TaskSession() = default;
+
+const string &TaskSession::currentProject() const { return manager->currentProject(); }
+void TaskSession::openProject(const string &filename) { manager->openProject(filename); }
+void TaskSession::createTask() { manager->createTask(); }
+void TaskSession::viewTask(int sortingMethod) { manager->viewTask(sortingMethod); }
+void TaskSession::viewChanges() { manager->viewChanges(); }
+void TaskSession::viewDueTasks() { manager->viewDueTasks(); }
+void TaskSession::viewAgenda(int days) { manager->viewAgenda(days); }
+void TaskSession::viewStatistics() { manager->viewStatistics(); }
+void TaskSession::editTaskPriorityAndStatus(int taskID) { manager->editTaskPriorityAndStatus(taskID); }
+void TaskSession::deleteTask(int taskID) { manager->deleteTask(taskID); }
+void TaskSession::searchTasks(const string &query) { manager->searchTasks(query); }
+void TaskSession::viewReadyTasks() { manager->viewReadyTasks(); }
+void TaskSession::viewCriticalPath() { manager->viewCriticalPath(); }
+void TaskSession::checkDependencyCycles() { manager->checkDependencyCycles(); }
+void TaskSession::editTaskDependencies(int taskID) { manager->editTaskDependencies(taskID); }
+void TaskSession::claimNextTask() { manager->claimNextTask(); }
+void TaskSession::archiveCompletedTasks(int olderThanDays) { manager->archiveCompletedTasks(olderThanDays); }
+void TaskSession::findArchivedTask(int taskID) { manager->findArchivedTask(taskID); }
+void TaskSession::findArchivedTasksByDate(const string &fromDate, const string &toDate) { manager->findArchivedTasksByDate(fromDate, toDate); }
+void TaskSession::listProjects() { manager->listProjects(); }
+void TaskSession::viewReplicationStatus() { manager->viewReplicationStatus(); }
+void TaskSession::checkStatistics() { manager->checkStatistics(); }
+bool TaskSession::flushWrites() { return manager->flushWrites(); }
+bool TaskSession::startReplication(const string &socketPath) { return manager->startReplication(socketPath); }
+bool TaskSession::migrateTaskFile(const string &filename) { return manager->migrateTaskFile(filename); }
+
+bool TaskSession::importTasks(const string &filename, const string &format)
+{
+    return manager->importTasks(filename, exchangeFormat(filename, format));
+}
+
+bool TaskSession::exportTasks(const string &filename, const string &format, const string &view, const string &query)
+{
+    ExportFormat chosen = exchangeFormat(filename, format);
+    if (!query.empty())
+    {
+        return manager->exportSearch(filename, chosen, query);
+    }
+    size_t viewNumber = manager->findView(view);
+    if (viewNumber == SIZE_MAX)
+    {
+        throw invalid_argument("Unknown view: " + view + " (use date, priority or category)");
+    }
+    return manager->exportView(filename, chosen, viewNumber);
+}
+
+int TaskSession::sync(const string &mode, const string &peer)
+{
+    try
+    {
+        string error;
+        unique_ptr<SyncPeer> other = TaskSync::open(peer, error);
+        if (other == nullptr)
+        {
+            cerr << error << endl;
+            return 1;
+        }
+        LocalSyncPeer local(*manager);
+
+        // Find the tasks the two copies differ in
+        auto start = chrono::steady_clock::now();
+        SyncDifference difference;
+        if (!TaskSync::compare(local, *other, difference, error))
+        {
+            cerr << "Unable to compare " << local.name() << " with " << other->name() << ": " << error << endl;
+            return 1;
+        }
+        cout << "Compared " << local.name() << " with " << other->name() << ": " << difference.hashesCompared << " hash(es) in "
+             << difference.requests << " request(s); " << difference.onlyFirst.size() << " task(s) only in " << local.name() << ", "
+             << difference.onlySecond.size() << " only in " << other->name() << ", " << difference.changed.size() << " changed." << endl;
+        printTaskIDs("Only in " + local.name(), difference.onlyFirst);
+        printTaskIDs("Only in " + other->name(), difference.onlySecond);
+        printTaskIDs("Changed", difference.changed);
+        if (mode == "diff" || difference.empty())
+        {
+            return difference.empty() || mode != "diff" ? 0 : 1;
+        }
+
+        // Copy the tasks that differ from one copy to the other
+        bool pull = mode == "pull";
+        SyncPeer &source = pull ? *other : static_cast<SyncPeer &>(local);
+        SyncPeer &target = pull ? static_cast<SyncPeer &>(local) : *other;
+        size_t sent = 0, applied = 0;
+        vector<string> refused;
+        if (!TaskSync::copy(source, target, pull ? difference.swapped() : difference, sent, applied, refused, error))
+        {
+            cerr << "Unable to synchronize " << target.name() << " with " << source.name() << ": " << error << endl;
+            return 1;
+        }
+        for (const string &reason : refused)
+        {
+            cerr << "Refused by " << target.name() << ": " << reason << endl;
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        cout << "Copied " << sent << " task(s) from " << source.name() << " to " << target.name() << " and deleted "
+             << (pull ? difference.onlyFirst.size() : difference.onlySecond.size()) << "; " << applied << " change(s) applied, "
+             << refused.size() << " refused, " << other->bytesTransferred() << " byte(s) exchanged in " << fixed << setprecision(3)
+             << seconds << " s." << endl;
+        return refused.empty() ? 0 : 1;
+    }
+    catch (const exception &ex)
+    {
+        cerr << "Synchronization failed: " << ex.what() << endl;
+        return 1;
+    }
+}
+
+bool TaskSession::serveSync(const string &socketPath)
+{
+    return SyncServer(*manager).serve(socketPath);
+}
+
+TaskFollower::TaskFollower() : follower(new ReplicationFollower()) {}
+
+TaskFollower::~TaskFollower() = default;
+
+bool TaskFollower::connect(const string &socketPath)
+{
+    return follower->connect(socketPath);
+}
+
+void TaskFollower::viewTasks(int sortingMethod)
+{
+    // The follower's tasks are a copy, so they are sorted here without affecting replication
+    vector<Task> tasks = follower->tasks();
+    if (sortingMethod == 1)
+    {
+        sort(tasks.begin(), tasks.end(), TaskSchema::ByDate());
+    }
+    else if (sortingMethod == 2)
+    {
+        sort(tasks.begin(), tasks.end(), TaskSchema::ByPriority());
+    }
+    else
+    {
+        sort(tasks.begin(), tasks.end(), TaskSchema::ByCategory());
+    }
+    if (tasks.empty())
+    {
+        cout << "No tasks have been replicated." << endl;
+    }
+    for (const Task &task : tasks)
+    {
+        task.getTaskDetails();
+        cout << endl;
+    }
+}
+
+void TaskFollower::viewStatus()
+{
+    FollowerStatus status = follower->status();
+    cout << (status.connected ? "Connected to the primary." : "Disconnected from the primary.") << endl;
+    cout << "Changes applied: " << (status.appliedSequence > 0 ? status.appliedSequence - 1 : 0) << ", behind the primary by "
+         << status.primarySequence - status.appliedSequence << " change(s), lag of the last change " << status.lagMicros / 1000.0 << " ms" << endl;
+    cout << "Tasks: " << status.taskCount << ", checksum: " << hex << status.checksum << dec << endl;
+}
+
+bool TaskFollower::saveSnapshot(const string &path)
+{
+    // The tasks come in ID order, and are written the way the primary writes its task file, so a follower that has caught up saves
+    // the same bytes as the task file of a primary whose tasks are in ID order (and the snapshot can be opened as a project)
+    string snapshot = RecordFormat::header() + "\n";
+    for (const Task &task : follower->tasks())
+    {
+        TaskManager::appendTaskRecord(snapshot, task);
+    }
+    ofstream file(path, ios::binary | ios::trunc);
+    file.write(snapshot.data(), snapshot.size());
+    file.close();
+    return bool(file);
+}
+
+bool TaskTools::runWorkload(const WorkloadSettings &settings)
+{
+    WorkloadOptions options;
+    options.replayFile = settings.replayFile;
+    options.recordFile = settings.recordFile;
+    options.directory = settings.directory;
+    options.operations = settings.operations;
+    options.datasetSize = settings.datasetSize;
+    options.rate = settings.rate;
+    options.seed = settings.seed;
+    options.verifyStatistics = settings.verifyStatistics;
+    options.lazyDescriptions = settings.lazyDescriptions;
+    options.descriptionCacheBytes = settings.descriptionCacheBytes;
+    if (!settings.mix.empty())
+    {
+        try
+        {
+            WorkloadDriver::parseMix(settings.mix, options);
+        }
+        catch (const exception &ex)
+        {
+            cerr << "Invalid value for --workload-mix: " << ex.what() << endl;
+        }
+    }
+    return WorkloadDriver(options).run();
+}
+
+int TaskTools::scrub(const string &path, unsigned threads)
+{
+    ScrubReport report;
+    if (!TaskFileScrubber::scrub(path, threads, report))
+    {
+        cerr << "Unable to open file: " << path << endl;
+        return 1;
+    }
+    if (report.format != TaskFileFormat::CHECKSUMMED && report.format != TaskFileFormat::EMPTY)
+    {
+        cout << path << " has no record checksums to verify; convert it with --migrate first." << endl;
+        return 1;
+    }
+    for (const auto &range : report.damaged)
+    {
+        cout << "Damaged: bytes " << range.first << "-" << range.second << " (" << range.second - range.first << " bytes)" << endl;
+    }
+    double megabytes = report.bytes / (1024.0 * 1024.0);
+    cout << "Verified " << report.records << " record(s) in " << fixed << setprecision(1) << megabytes << " MB with "
+         << report.threads << " thread(s) (" << Crc32c::implementationName() << ") in " << setprecision(3) << report.seconds << " s ("
+         << setprecision(0) << (report.seconds > 0 ? megabytes / report.seconds : 0) << " MB/s); " << report.damaged.size()
+         << " damaged range(s), " << report.damagedBytes() << " damaged byte(s)." << endl;
+    return report.damaged.empty() ? 0 : 1;
+}
+
+void TaskTools::startDiagnostics(bool collectMetrics, const string &traceFile)
+{
+    Metrics::instance().setEnabled(collectMetrics);
+    if (!traceFile.empty())
+    {
+        Tracer::instance().start(traceFile);
+        Tracer::instance().setThreadName("main");
+    }
+}
+
+void TaskTools::reportDiagnostics(bool printSummary, const string &metricsFile)
+{
+    if (printSummary)
+    {
+        cout << endl
+             << "Statistics:" << endl;
+        Metrics::instance().printSummary(cout);
+    }
+    if (!metricsFile.empty())
+    {
+        Metrics::instance().writeMetricsFile(metricsFile);
+    }
+    Tracer::instance().writeTrace();
+}
+
+MenuSpan::MenuSpan(const char *spanName) : name(spanName), active(Tracer::instance().isEnabled())
+{
+    if (active)
+    {
+        start = Tracer::instance().now();
+    }
+}
+
+MenuSpan::~MenuSpan()
+{
+    if (active)
+    {
+        Tracer &tracer = Tracer::instance();
+        tracer.record(name, "menu", start, tracer.now());
+    }
+}
+
+#endif
@@ -0,0 +1,191 @@
+// This file declares the C++ API of libtaskstore that the interactive program (main.cpp) is built on.
+// The C API in taskstore.h is for programs that embed the task store; this header is for the command line client, which needs the
+// menu operations of the task manager (they prompt on the standard input and print their results) and its other modes (workload,
+// scrub, follower, sync, import and export). Everything is implemented in taskstore_core.cpp inside the library, so the client only
+// sees these declarations and the task manager behind them can change without the client being rebuilt.
+// Names are qualified with std:: here, rather than relying on "using namespace std;", so that including the header does not change
+// the names visible to the client. Errors are reported the way the task manager reports them: operations print their own messages,
+// and the few that can refuse their arguments throw invalid_argument.
+
+#ifndef TASKSTORE_CORE_H
+#define TASKSTORE_CORE_H
+
+#include <string>
+#include <memory>  // unique_ptr owns the objects behind the classes below
+#include <cstddef> // size_t
+#include <cstdint> // Timestamps of the menu spans
+
+#if defined(__GNUC__)
+#define TS_CXX_API __attribute__((visibility("default")))
+#else
+#define TS_CXX_API
+#endif
+
+class TaskManager;         // Defined in TaskManager.cpp, inside the library
+class ReplicationFollower; // Defined in replication.cpp, inside the library
+
+// Settings of a TaskSession
+struct TaskSessionSettings
+{
+    static const size_t defaultProjectCacheBytes = 64 * 1024 * 1024; // Same as ProjectCache::defaultBudget
+    static const size_t defaultPageSize = 50;                        // Same as TaskManager::defaultPageSize
+    static const size_t defaultDescriptionCacheBytes = 1024 * 1024;  // Same as ColdFieldCache::defaultBudget
+
+    std::string projectFile = "project.txt";               // Project opened at startup
+    size_t projectCacheBytes = defaultProjectCacheBytes;   // Memory budget of the loaded projects
+    size_t pageSize = defaultPageSize;                      // Tasks shown on each page of a view (0 for a single page)
+    int dueTodayDays = 0;                                   // Deadlines up to this many days away are due today
+    int dueThisWeekDays = 7;                                // Deadlines up to this many days away are due this week
+    bool verifyStatistics = false;                          // Recount the statistics after every operation
+    bool lazyDescriptions = false;                          // Leave long descriptions in the task file when projects are loaded
+    size_t descriptionCacheBytes = defaultDescriptionCacheBytes; // Memory budget of the descriptions read back
+};
+
+// Settings of a scripted workload run (see workload.cpp)
+struct WorkloadSettings
+{
+    std::string replayFile;         // Trace to replay (empty to generate operations)
+    std::string recordFile;         // File to save the operations that were run to (empty for none)
+    std::string directory;          // Directory to run in (empty for a new temporary directory)
+    std::string mix;                // Relative weights of the operations, e.g. "create=20,view=40" (empty for the default mix)
+    int operations = 1000;          // Number of generated operations
+    int datasetSize = 1000;         // Tasks created before the measured operations start
+    double rate = 0;                // Operations per second (0 for as fast as possible)
+    unsigned seed = 1;              // Seed of the generated operations
+    bool verifyStatistics = false;  // Recount the statistics after every operation
+    bool lazyDescriptions = false;  // Leave long descriptions in the task file
+    size_t descriptionCacheBytes = TaskSessionSettings::defaultDescriptionCacheBytes; // Memory budget of the descriptions read back
+};
+
+// The TaskSession class is the task manager of the interactive program: a set of projects, one of them open, with the operations
+// of the menu. Every operation works on the open project.
+class TS_CXX_API TaskSession
+{
+public:
+    explicit TaskSession(const TaskSessionSettings &settings);
+    ~TaskSession(); // Writes every change out
+    TaskSession(const TaskSession &) = delete;
+    TaskSession &operator=(const TaskSession &) = delete;
+
+    // Task file of the open project
+    const std::string &currentProject() const;
+
+    // Open the project stored in a file
+    void openProject(const std::string &filename);
+
+    // Menu operations; each prompts for what it needs and prints its result
+    void createTask();
+    void viewTask(int sortingMethod); // 1 by date, 2 by priority, 3 by category
+    void viewChanges();
+    void viewDueTasks();
+    void viewAgenda(int days);
+    void viewStatistics();
+    void editTaskPriorityAndStatus(int taskID);
+    void deleteTask(int taskID);
+    void searchTasks(const std::string &query);
+    void viewReadyTasks();
+    void viewCriticalPath();
+    void checkDependencyCycles();
+    void editTaskDependencies(int taskID);
+    void claimNextTask();
+    void archiveCompletedTasks(int olderThanDays);
+    void findArchivedTask(int taskID);
+    void findArchivedTasksByDate(const std::string &fromDate, const std::string &toDate);
+    void listProjects();
+    void viewReplicationStatus();
+
+    // Recount the statistics and report any difference (only with TaskSessionSettings::verifyStatistics)
+    void checkStatistics();
+
+    // Wait until every change is on disk; returns false if any could not be saved
+    bool flushWrites();
+
+    // Ship every change of the open project to followers connecting to a Unix socket; returns false if the socket cannot be used
+    bool startReplication(const std::string &socketPath);
+
+    // Convert a task file in an older format to the current format
+    bool migrateTaskFile(const std::string &filename);
+
+    // Add the tasks of a JSON Lines or CSV file to the project. format is "jsonl", "csv" or "" to choose by the name of the file;
+    // throws invalid_argument for an unknown format. Returns false if the file could not be read.
+    bool importTasks(const std::string &filename, const std::string &format);
+
+    // Write the tasks of the project to a JSON Lines or CSV file ("-" for the standard output), either the tasks matching a search
+    // query (if query is not empty), best match first, or every task in the order of a view ("date", "priority" or "category").
+    // Throws invalid_argument for an unknown format or view. Returns false if the file could not be written.
+    bool exportTasks(const std::string &filename, const std::string &format, const std::string &view, const std::string &query);
+
+    // Compare the project with another copy of it (a task file or the socket of a serving process) and, for mode "pull" or "push",
+    // copy the tasks that differ from one to the other; mode "diff" only lists them. Prints what it found and did, and returns the
+    // exit status of the command line option (for "diff", 1 if the copies differ; otherwise 1 if the copies could not be synchronized).
+    int sync(const std::string &mode, const std::string &peer);
+
+    // Serve the project on a Unix socket to other processes comparing or synchronizing with it, until the process receives SIGINT
+    // or SIGTERM; returns false if the socket cannot be used
+    bool serveSync(const std::string &socketPath);
+
+private:
+    std::unique_ptr<TaskManager> manager;
+};
+
+// The TaskFollower class is a read-only copy of the tasks of another process, kept up to date through its replication socket.
+class TS_CXX_API TaskFollower
+{
+public:
+    TaskFollower();
+    ~TaskFollower();
+    TaskFollower(const TaskFollower &) = delete;
+    TaskFollower &operator=(const TaskFollower &) = delete;
+
+    // Connect to the primary and start receiving its changes; returns false if it cannot be reached
+    bool connect(const std::string &socketPath);
+
+    // Print the replicated tasks sorted by date (1), priority (2) or category (3)
+    void viewTasks(int sortingMethod);
+
+    // Print whether the follower is connected, how far behind it is and the checksum of its tasks
+    void viewStatus();
+
+    // Write the replicated tasks to a file in the task file format, in ID order; returns false if it could not be written
+    bool saveSnapshot(const std::string &path);
+
+private:
+    std::unique_ptr<ReplicationFollower> follower;
+};
+
+// The TaskTools class holds the modes of the program that do not need a session.
+class TS_CXX_API TaskTools
+{
+public:
+    // Run a scripted workload in a scratch directory and report its throughput and latency percentiles; returns false if it could
+    // not be run
+    static bool runWorkload(const WorkloadSettings &settings);
+
+    // Verify the checksum of every record of a task file and print the damaged ranges; returns the exit status (1 if anything is
+    // damaged or the file cannot be verified)
+    static int scrub(const std::string &path, unsigned threads);
+
+    // Start collecting metrics and, if traceFile is not empty, trace spans (the calling thread is named "main" in the trace)
+    static void startDiagnostics(bool collectMetrics, const std::string &traceFile);
+
+    // Print the metrics summary and write the metrics and trace files that were asked for
+    static void reportDiagnostics(bool printSummary, const std::string &metricsFile);
+};
+
+// MenuSpan records the lifetime of a scope as a span of the "menu" category in the trace (see trace.cpp).
+// The name must be a string literal.
+class TS_CXX_API MenuSpan
+{
+public:
+    explicit MenuSpan(const char *spanName);
+    ~MenuSpan();
+    MenuSpan(const MenuSpan &) = delete;
+    MenuSpan &operator=(const MenuSpan &) = delete;
+
+private:
+    const char *name;
+    bool active;
+    uint64_t start = 0;
+};
+
+#endif
@@ -0,0 +1,154 @@
+// This program checks that comparing and serializing tasks does not allocate memory.
+// It replaces the global operator new with one that counts every allocation, builds a set of tasks whose strings are too long for
+// the small string optimization (so any copy of them would allocate), and then counts the allocations made by the accessors (the
+// description included), by the comparisons of the date, priority and category orders, and by TaskSchema::appendRecord() into a
+// buffer that is already large enough.
+// Every count must be zero. Run by "make test"; the exit status is 1 if any check fails.
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <atomic>  // The allocation counter
+#include <cstdlib> // malloc() and free() behind the replaced operators
+#include <new>     // bad_alloc
+#include "../task_schema.cpp"
+
+using namespace std;
+
+// Number of allocations made through operator new since the program started
+static atomic<size_t> allocations{0};
+
+// The replaced operators pair malloc() with free(), which GCC cannot tell from a mismatched new and free()
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+
+void *operator new(size_t size)
+{
+    allocations.fetch_add(1, memory_order_relaxed);
+    void *memory = malloc(size == 0 ? 1 : size);
+    if (memory == nullptr)
+    {
+        throw bad_alloc();
+    }
+    return memory;
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *memory) noexcept
+{
+    free(memory);
+}
+
+void operator delete[](void *memory) noexcept
+{
+    free(memory);
+}
+
+void operator delete(void *memory, size_t) noexcept
+{
+    free(memory);
+}
+
+void operator delete[](void *memory, size_t) noexcept
+{
+    free(memory);
+}
+
+// Count the allocations made by a piece of code and report them; returns false if there were any
+template <typename Body>
+bool expectNoAllocations(const char *what, size_t operations, Body body)
+{
+    size_t before = allocations.load(memory_order_relaxed);
+    body();
+    size_t made = allocations.load(memory_order_relaxed) - before;
+    cout << (made == 0 ? "PASS " : "FAIL ") << what << ": " << made << " allocation(s) in " << operations << " operation(s)" << endl;
+    return made == 0;
+}
+
+int main()
+{
+    // Tasks with long strings, spread over several categories, priorities, statuses and deadlines
+    const char *categories[] = {"Work: quarterly planning and reviews", "Personal errands and appointments", "Home maintenance and repairs"};
+    vector<Task> tasks;
+    for (int i = 1; i <= 60; i++)
+    {
+        Task task(i, "A title long enough to live on the heap, number " + to_string(i),
+                  "A description that is also far too long for the small string optimization of std::string, task " + to_string(i),
+                  to_string(10 + i % 18) + "/" + to_string(1 + i % 12) + "/" + to_string(2026 + i % 3), TaskPriority(i % 3),
+                  TaskStatus((i / 3) % 3), "label-long-enough-to-allocate-" + to_string(i), categories[i % 3]);
+        task.setDependencies(i > 2 ? vector<int>{i - 1, i - 2} : vector<int>());
+        tasks.push_back(task);
+    }
+
+    bool ok = true;
+    volatile size_t sink = 0; // Keeps the compiler from dropping the work being measured
+
+    ok = expectNoAllocations("accessors", tasks.size(), [&]()
+                             {
+        for (const Task &task : tasks)
+        {
+            sink = sink + task.getTitle().size() + task.getDescription().size() + task.getDeadline().size() + task.getCategory().size() +
+                   task.getLabel().size() + task.getPriority().size() + task.getStatus().size() + task.getDependencies().size() + size_t(task.getPriorityValue()) +
+                   size_t(task.getStatusValue());
+        } }) && ok;
+
+    size_t comparisons = tasks.size() * tasks.size();
+    ok = expectNoAllocations("TaskSchema::ByDate comparisons", comparisons, [&]()
+                             {
+        TaskSchema::ByDate less;
+        for (const Task &a : tasks)
+        {
+            for (const Task &b : tasks)
+            {
+                sink = sink + less(a, b);
+            }
+        } }) && ok;
+    ok = expectNoAllocations("TaskSchema::ByPriority comparisons", comparisons, [&]()
+                             {
+        TaskSchema::ByPriority less;
+        for (const Task &a : tasks)
+        {
+            for (const Task &b : tasks)
+            {
+                sink = sink + less(a, b);
+            }
+        } }) && ok;
+    ok = expectNoAllocations("TaskSchema::ByCategory comparisons", comparisons, [&]()
+                             {
+        TaskSchema::ByCategory less;
+        for (const Task &a : tasks)
+        {
+            for (const Task &b : tasks)
+            {
+                sink = sink + less(a, b);
+            }
+        } }) && ok;
+
+    // Serializing appends to the caller's buffer, so once it has room no field allocates
+    string record;
+    record.reserve(64 * 1024);
+    ok = expectNoAllocations("TaskSchema::appendRecord", tasks.size() * TaskSchema::fieldCount, [&]()
+                             {
+        for (const Task &task : tasks)
+        {
+            record.clear();
+            TaskSchema::appendRecord(record, task);
+            sink = sink + record.size();
+        } }) && ok;
+
+    // The record written must still read back as the same task, so the checks above measured real work
+    vector<string> fields;
+    FieldScanner scanner(record.data(), record.size(), false);
+    Task parsed;
+    if (!scanner.nextRecord(fields) || !TaskSchema::parseRecord(fields, parsed) || parsed.getTaskID() != tasks.back().getTaskID() ||
+        parsed.getTitle() != tasks.back().getTitle())
+    {
+        cout << "FAIL the last record does not read back as the task it was written from" << endl;
+        ok = false;
+    }
+
+    return ok ? 0 : 1;
+}
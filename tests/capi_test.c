@@ -0,0 +1,163 @@
+/* This program checks the C API of the task store as a C client sees it.
+ * It is compiled as C and linked only against the shared library, so it also checks that every ts_* function is exported and
+ * callable through the C ABI. It opens a task file, creates, reads, updates, deletes, queries and counts tasks, closes the store and
+ * opens it again, and checks the status and ts_last_error() of the calls that must fail. Run by "make test"; the exit status is 1
+ * if any check fails. */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h> /* getpid() and unlink() */
+#include "../taskstore.h"
+
+static int expect(const char *what, int result)
+{
+    printf("%s %s\n", result ? "PASS" : "FAIL", what);
+    return result;
+}
+
+/* Check that a call failed with a status and left a message in ts_last_error() */
+static int expectError(const char *what, ts_status status, ts_status expected, const ts_store *store)
+{
+    const char *error = ts_last_error(store);
+    return expect(what, status == expected && error != NULL && *error != '\0');
+}
+
+int main(void)
+{
+    char path[64], sidecar[80];
+    const char *suffixes[] = {".ids", ".idx", ".archive", ".tmp", ".damaged"};
+    ts_store *store = NULL;
+    ts_cursor *cursor = NULL;
+    ts_task task, read;
+    int first = 0, second = 0, dependencies[1], i, ok = 1, seen, inOrder;
+    size_t count = 0;
+    ts_status status;
+
+    ok = expect("the library matches the header", ts_api_version() == TS_API_VERSION) && ok;
+    ok = expect("ts_open() refuses a missing store pointer", ts_open("unused.txt", NULL) == TS_INVALID) && ok;
+    status = ts_open("", &store);
+    ok = expectError("ts_open() refuses an empty path", status, TS_INVALID, NULL) && store == NULL && ok;
+
+    snprintf(path, sizeof(path), "/tmp/capi_test.%d.txt", (int)getpid());
+    if (ts_open(path, &store) != TS_OK)
+    {
+        printf("FAIL ts_open: %s\n", ts_last_error(NULL));
+        return 1;
+    }
+
+    /* Create */
+    ts_task_init(&task);
+    task.category = "Work";
+    task.title = "Alpha report";
+    task.description = "Numbers for the quarter";
+    task.deadline = "20/11/2099";
+    task.priority = TS_PRIORITY_HIGH;
+    ok = expect("ts_create() assigns an ID", ts_create(store, &task, &first) == TS_OK && first > 0) && ok;
+    dependencies[0] = first;
+    task.title = "Beta review";
+    task.deadline = "01/11/2099";
+    task.priority = TS_PRIORITY_LOW;
+    task.dependencies = dependencies;
+    task.dependency_count = 1;
+    task.recurrence = "FREQ=WEEKLY;BYDAY=MO,WE";
+    ok = expect("ts_create() stores a second task", ts_create(store, &task, &second) == TS_OK && second != first) && ok;
+
+    task.deadline = "31/02/2099";
+    ok = expectError("ts_create() refuses an invalid date", ts_create(store, &task, NULL), TS_INVALID, store) && ok;
+    task.deadline = "01/11/2099";
+    task.dependency_count = 0;
+    task.id = first;
+    ok = expectError("ts_create() refuses an ID in use", ts_create(store, &task, NULL), TS_EXISTS, store) && ok;
+    ok = expectError("ts_create() refuses a missing task", ts_create(store, NULL, NULL), TS_INVALID, store) && ok;
+    ok = expect("ts_create() refuses a missing store", ts_create(NULL, &task, NULL) == TS_INVALID) && ok;
+
+    /* Get */
+    ok = expect("ts_get() reads every field back",
+                ts_get(store, second, &read) == TS_OK && read.id == second && strcmp(read.category, "Work") == 0 &&
+                    strcmp(read.title, "Beta review") == 0 && strcmp(read.description, "Numbers for the quarter") == 0 &&
+                    strcmp(read.deadline, "01/11/2099") == 0 && read.priority == TS_PRIORITY_LOW &&
+                    read.status == TS_STATUS_PENDING && read.dependency_count == 1 && read.dependencies[0] == first &&
+                    strcmp(read.recurrence, "FREQ=WEEKLY;BYDAY=MO,WE") == 0) &&
+         ok;
+    ok = expectError("ts_get() reports an unknown ID", ts_get(store, 999999, &read), TS_NOT_FOUND, store) && ok;
+
+    /* Update */
+    ts_get(store, first, &read);
+    dependencies[0] = second;
+    read.dependencies = dependencies;
+    read.dependency_count = 1;
+    ok = expectError("ts_update() refuses a dependency cycle", ts_update(store, &read), TS_INVALID, store) && ok;
+    ts_get(store, first, &read);
+    read.status = TS_STATUS_COMPLETED;
+    ok = expect("ts_update() changes a task", ts_update(store, &read) == TS_OK) && ok;
+    ok = expect("the change is read back", ts_get(store, first, &read) == TS_OK && read.status == TS_STATUS_COMPLETED) && ok;
+    ts_task_init(&task);
+    task.id = 999999;
+    task.deadline = "01/01/2099";
+    ok = expectError("ts_update() reports an unknown ID", ts_update(store, &task), TS_NOT_FOUND, store) && ok;
+
+    /* Query and count */
+    for (i = 0; i < 120; i++)
+    {
+        ts_task_init(&task);
+        task.category = i % 2 ? "Home" : "Work";
+        task.title = "Bulk task";
+        task.deadline = "05/12/2099";
+        task.priority = (ts_priority)(i % 3);
+        ok = (ts_create(store, &task, NULL) == TS_OK) && ok;
+    }
+    ok = expect("ts_count() counts every task", ts_count(store, NULL, -1, -1, &count) == TS_OK && count == 122) && ok;
+    ok = expect("ts_count() filters by category and status",
+                ts_count(store, "Work", TS_STATUS_COMPLETED, -1, &count) == TS_OK && count == 1) &&
+         ok;
+    ok = expectError("ts_count() refuses a missing count", ts_count(store, NULL, -1, -1, NULL), TS_INVALID, store) && ok;
+
+    ok = expect("ts_query() opens a view", ts_query(store, "priority", NULL, &cursor) == TS_OK) && ok;
+    seen = 0;
+    inOrder = 1;
+    {
+        int previous = TS_PRIORITY_HIGH;
+        while ((status = ts_next(cursor, &read)) == TS_OK)
+        {
+            inOrder = inOrder && (int)read.priority <= previous;
+            previous = read.priority;
+            seen++;
+        }
+    }
+    ok = expect("ts_next() walks the view in order and then returns TS_END", seen == 122 && inOrder && status == TS_END) && ok;
+    ts_cursor_close(cursor);
+
+    ok = expect("ts_query() searches", ts_query(store, NULL, "beta", &cursor) == TS_OK) && ok;
+    ok = expect("the search finds the matching task", ts_next(cursor, &read) == TS_OK && read.id == second &&
+                                                            ts_next(cursor, &read) == TS_END) &&
+         ok;
+    ts_cursor_close(cursor);
+    ts_cursor_close(NULL);
+    ok = expectError("ts_query() refuses an unknown view", ts_query(store, "nope", NULL, &cursor), TS_INVALID, store) && ok;
+    ok = expect("ts_next() refuses a missing cursor", ts_next(NULL, &read) == TS_INVALID) && ok;
+
+    /* Delete */
+    ok = expect("ts_delete() removes a task", ts_delete(store, second) == TS_OK) && ok;
+    ok = expect("a deleted task is gone", ts_get(store, second, &read) == TS_NOT_FOUND) && ok;
+    ok = expectError("ts_delete() reports an unknown ID", ts_delete(store, second), TS_NOT_FOUND, store) && ok;
+
+    /* Close and open again */
+    ok = expect("ts_flush() writes every change", ts_flush(store) == TS_OK) && ok;
+    ts_close(store);
+    ts_close(NULL);
+    ok = expect("the task file opens again", ts_open(path, &store) == TS_OK) && ok;
+    ok = expect("the reopened store holds every change",
+                store != NULL && ts_count(store, NULL, -1, -1, &count) == TS_OK && count == 121 &&
+                    ts_get(store, first, &read) == TS_OK && read.status == TS_STATUS_COMPLETED &&
+                    ts_get(store, second, &read) == TS_NOT_FOUND) &&
+         ok;
+    ts_close(store);
+
+    unlink(path);
+    for (i = 0; i < 5; i++)
+    {
+        snprintf(sidecar, sizeof(sidecar), "%s%s", path, suffixes[i]);
+        unlink(sidecar);
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,118 @@
+/* This program checks that worker threads claiming tasks from the same store never get the same task.
+ * It creates tasks through the C API, starts several threads that call ts_claim_next() until it returns TS_END, and checks that
+ * every task was claimed exactly once. It then reopens the task file and checks that every claim was written, with each task
+ * In Progress. Run by "make test" against the shared library; the exit status is 1 if any check fails. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h> /* getpid() and unlink() */
+#include "../taskstore.h"
+
+#define TASKS 2000
+#define THREADS 8
+
+static ts_store *store;
+static int claimedBy[TASKS + 1]; /* Number of times each task ID was claimed */
+static pthread_mutex_t claimedLock = PTHREAD_MUTEX_INITIALIZER;
+static int failures;
+
+static void *worker(void *unused)
+{
+    int id;
+    ts_status status;
+    (void)unused;
+    while ((status = ts_claim_next(store, &id)) == TS_OK)
+    {
+        pthread_mutex_lock(&claimedLock);
+        if (id < 1 || id > TASKS)
+        {
+            failures++;
+        }
+        else
+        {
+            claimedBy[id]++;
+        }
+        pthread_mutex_unlock(&claimedLock);
+    }
+    if (status != TS_END)
+    {
+        pthread_mutex_lock(&claimedLock);
+        failures++;
+        pthread_mutex_unlock(&claimedLock);
+    }
+    return NULL;
+}
+
+static int expect(const char *what, int result)
+{
+    printf("%s %s\n", result ? "PASS" : "FAIL", what);
+    return result;
+}
+
+int main(void)
+{
+    char path[64], sidecar[80];
+    const char *suffixes[] = {".ids", ".idx", ".archive", ".tmp"};
+    pthread_t threads[THREADS];
+    ts_task task;
+    int i, ok = 1, once = 1, inProgress = 1, id;
+
+    snprintf(path, sizeof(path), "/tmp/claim_test.%d.txt", (int)getpid());
+    if (ts_open(path, &store) != TS_OK)
+    {
+        printf("FAIL ts_open: %s\n", ts_last_error(NULL));
+        return 1;
+    }
+    for (i = 1; i <= TASKS; i++)
+    {
+        ts_task_init(&task);
+        task.id = i;
+        task.title = "Claimable task";
+        task.deadline = "01/01/2099";
+        task.priority = (ts_priority)(i % 3);
+        if (ts_create(store, &task, &id) != TS_OK)
+        {
+            printf("FAIL ts_create: %s\n", ts_last_error(store));
+            return 1;
+        }
+    }
+
+    for (i = 0; i < THREADS; i++)
+    {
+        pthread_create(&threads[i], NULL, worker, NULL);
+    }
+    for (i = 0; i < THREADS; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+    for (i = 1; i <= TASKS; i++)
+    {
+        once = once && claimedBy[i] == 1;
+    }
+    ok = expect("every task is claimed exactly once by the worker threads", once && failures == 0) && ok;
+    ok = expect("nothing is left to claim", ts_claim_next(store, &id) == TS_END) && ok;
+    ok = expect("the claims are flushed", ts_flush(store) == TS_OK) && ok;
+    ts_close(store);
+
+    if (ts_open(path, &store) != TS_OK)
+    {
+        printf("FAIL reopening: %s\n", ts_last_error(NULL));
+        return 1;
+    }
+    for (i = 1; i <= TASKS; i++)
+    {
+        inProgress = inProgress && ts_get(store, i, &task) == TS_OK && task.status == TS_STATUS_IN_PROGRESS;
+    }
+    ok = expect("every claimed task is In Progress in the reopened file", inProgress) && ok;
+    ts_close(store);
+
+    unlink(path);
+    for (i = 0; i < 4; i++)
+    {
+        snprintf(sidecar, sizeof(sidecar), "%s%s", path, suffixes[i]);
+        unlink(sidecar);
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,136 @@
+#!/bin/bash
+# This script checks that followers converge to a byte-identical copy of the primary's tasks.
+# It starts a primary with --replicate and two followers with --follow, all driven through their menus. The first follower connects
+# before the changes are made, so it receives them as they are shipped; the second connects afterwards, so it starts from a snapshot.
+# Once the checksum of each follower equals the primary's, the primary is stopped and started again with one more task; the followers
+# must notice the lost connection, connect to the new primary and reach its checksum. Each follower then saves its snapshot, and the
+# snapshots must be the same bytes as the primary's task file. Run by "make test" with the path of the program; the exit status is 1 if any check fails.
+
+PROGRAM=$(realpath "${1:-./task_manager}")
+DIR=$(mktemp -d)
+PIDS=()
+
+cleanup()
+{
+    for pid in "${PIDS[@]}"; do
+        kill "$pid" 2>/dev/null
+    done
+    rm -rf "$DIR"
+}
+trap cleanup EXIT
+
+fail()
+{
+    echo "FAIL $1"
+    exit 1
+}
+
+# Start a process whose menu reads from the fifo $DIR/<name>.in (kept open on file descriptor <fd>) and writes to $DIR/<name>.out
+start()
+{
+    local name=$1 fd=$2
+    shift 2
+    mkfifo "$DIR/$name.in"
+    (cd "$DIR" && exec "$PROGRAM" "$@" <"$DIR/$name.in" >"$DIR/$name.out" 2>&1) &
+    PIDS+=($!)
+    eval "exec $fd>\"$DIR/$name.in\""
+}
+
+# Wait until a file contains a line matching a pattern (at most 10 seconds)
+waitFor()
+{
+    local file=$1 pattern=$2
+    for _ in $(seq 100); do
+        grep -q "$pattern" "$file" 2>/dev/null && return 0
+        sleep 0.1
+    done
+    fail "timed out waiting for \"$pattern\" in $(basename "$file")"
+}
+
+# The checksum in the last status a process printed
+lastChecksum()
+{
+    grep -o 'checksum: [0-9a-f]*' "$1" | tail -n 1
+}
+
+# Create a task through the primary's menu: ID, title, description, deadline, priority, status (no dependencies, no recurrence)
+createTask()
+{
+    printf '1\nWork\nw\n%s\n%s\n%s\n%s\n%s\n%s\n\n\n' "$@" >&3
+}
+
+start primary 3 --replicate "$DIR/replication.sock" --project "$DIR/project.txt"
+waitFor "$DIR/primary.out" "Enter your choice"
+for _ in $(seq 100); do
+    [ -S "$DIR/replication.sock" ] && break
+    sleep 0.1
+done
+[ -S "$DIR/replication.sock" ] || fail "the primary did not open its replication socket"
+
+createTask 1 "First, task" '"quoted" description' 15/03/2099 High Pending
+start follower1 4 --follow "$DIR/replication.sock"
+waitFor "$DIR/follower1.out" "Enter your choice"
+
+# Changes shipped to the first follower as they are made: creations, an edit and a deletion
+createTask 2 "Second task" "Plain description" 01/06/2099 Low Pending
+createTask 3 "Third task, with a comma" "Description with, commas" 20/11/2099 Medium "In Progress"
+createTask 4 "Fourth task" "To be deleted" 02/02/2099 High Pending
+createTask 5 "Fifth task" 'Line with "quotes", and a comma' 30/12/2099 Medium Pending
+printf '3\n2\nHigh\nCompleted\n' >&3
+printf '4\n4\n' >&3
+
+start follower2 5 --follow "$DIR/replication.sock"
+waitFor "$DIR/follower2.out" "Enter your choice"
+
+# Ask for the status of every process until the followers report the primary's checksum
+converge()
+{
+    local primary=$1
+    for _ in $(seq 50); do
+        printf '9\n3\n' >&3
+        printf '4\n' >&4
+        printf '4\n' >&5
+        sleep 0.2
+        expected=$(lastChecksum "$DIR/$primary.out")
+        if [ -n "$expected" ] && [ "$(lastChecksum "$DIR/follower1.out")" = "$expected" ] &&
+            [ "$(lastChecksum "$DIR/follower2.out")" = "$expected" ]; then
+            return 0
+        fi
+    done
+    return 1
+}
+converge primary || fail "the followers did not reach the primary's checksum"
+
+# Stop the primary; the followers lose their connection and keep trying to connect again
+printf '10\n' >&3
+exec 3>&-
+wait "${PIDS[0]}"
+for _ in $(seq 50); do
+    printf '4\n' >&4
+    sleep 0.1
+    grep -q "Disconnected from the primary" "$DIR/follower1.out" && break
+done
+grep -q "Disconnected from the primary" "$DIR/follower1.out" || fail "follower1 did not notice that the primary stopped"
+
+# A new primary on the same socket, with one more task: the followers connect to it and start from its snapshot
+start primary2 3 --replicate "$DIR/replication.sock" --project "$DIR/project.txt"
+waitFor "$DIR/primary2.out" "Enter your choice"
+createTask 6 "Sixth task" "Made after the restart" 10/10/2099 Low Pending
+converge primary2 || fail "the followers did not reconnect to the restarted primary"
+echo "PASS the followers reconnected to the restarted primary"
+
+printf '5\n%s\n6\n' "$DIR/snapshot1.txt" >&4
+printf '5\n%s\n6\n' "$DIR/snapshot2.txt" >&5
+printf '10\n' >&3
+exec 3>&- 4>&- 5>&-
+wait "${PIDS[@]}"
+PIDS=()
+
+grep -q "Tasks: 4," "$DIR/primary.out" || fail "the primary does not hold the 4 tasks left"
+grep -q "Tasks: 5," "$DIR/primary2.out" || fail "the restarted primary does not hold 5 tasks"
+for snapshot in snapshot1.txt snapshot2.txt; do
+    [ -f "$DIR/$snapshot" ] || fail "$snapshot was not written"
+    cmp "$DIR/project.txt" "$DIR/$snapshot" || fail "$snapshot differs from the primary's task file"
+    echo "PASS $snapshot is byte-identical to the primary's task file"
+done
+exit 0
@@ -0,0 +1,102 @@
+#!/bin/bash
+# This script checks that two local copies of a project are compared and synchronized correctly.
+# It makes a task file, copies it and changes both copies through the menu (tasks created, edited and deleted on either side). Then
+# --sync-diff must find the copies different, --sync-pull and --sync-push must leave them byte-identical, and --sync-diff must then find
+# nothing; the same is checked with the other copy served by a --sync-serve process, which must stop on SIGTERM with status 0 and
+# write its metrics file on the way out. Run by "make test" with the path of the program; the exit status is 1 if any check fails.
+
+PROGRAM=$(realpath "${1:-./task_manager}")
+DIR=$(mktemp -d)
+SERVER=
+
+cleanup()
+{
+    [ -n "$SERVER" ] && kill "$SERVER" 2>/dev/null
+    rm -rf "$DIR"
+}
+trap cleanup EXIT
+cd "$DIR" || exit 1
+
+fail()
+{
+    echo "FAIL $1"
+    exit 1
+}
+
+# Run the program with a time limit and check its exit status
+expectStatus()
+{
+    local expected=$1 what=$2
+    shift 2
+    timeout 30 "$PROGRAM" "$@" >>"$DIR/sync.out" 2>&1
+    local status=$?
+    [ "$status" = "$expected" ] || fail "$what exited with status $status instead of $expected"
+    echo "PASS $what"
+}
+
+# Change the project in a task file through the menu, reading the menu input from the standard input; the menu is left at the end.
+# It runs in the subshell of a pipeline, so callers exit when it fails
+edit()
+{
+    local file=$1
+    { cat; printf '10\n'; } | timeout 30 "$PROGRAM" --project "$file" >/dev/null 2>&1 ||
+        fail "the menu did not run on $file"
+}
+
+# Menu input creating a task: ID, title, description, deadline, priority, status (no dependencies, no recurrence)
+task()
+{
+    printf '1\nWork\nw\n%s\n%s\n%s\n%s\n%s\n%s\n\n\n' "$@"
+}
+
+{
+    task 1 "First, task" '"quoted" description' 15/03/2099 High Pending
+    task 2 "Second task" "Plain description" 01/06/2099 Low Pending
+    task 3 "Third task" "Description with, commas" 20/11/2099 Medium Pending
+} | edit a.txt || exit 1
+cp a.txt b.txt || fail "the task file was not written"
+
+# Both copies change: b gets a new task, an edit and a deletion; a gets a new task of its own
+{
+    task 4 "Fourth task" 'Line with "quotes", and a comma' 30/12/2099 Medium Pending
+    printf '3\n2\nHigh\nCompleted\n4\n3\n'
+} | edit b.txt || exit 1
+task 5 "Fifth task" "Only in a" 02/02/2099 Low "In Progress" | edit a.txt || exit 1
+
+expectStatus 1 "sync-diff of two different task files" --project a.txt --sync-diff b.txt
+expectStatus 0 "sync-pull from a task file" --project a.txt --sync-pull b.txt
+cmp a.txt b.txt || fail "the copies differ after sync-pull"
+expectStatus 0 "sync-diff after sync-pull" --project a.txt --sync-diff b.txt
+
+{
+    task 6 "Sixth task" "Pushed" 06/06/2099 High Pending
+    printf '3\n1\nLow\nIn Progress\n'
+} | edit a.txt || exit 1
+expectStatus 0 "sync-push to a task file" --project a.txt --sync-push b.txt
+cmp a.txt b.txt || fail "the copies differ after sync-push"
+
+# The same through a process serving b.txt
+{
+    task 7 "Seventh task" "Over the socket" 07/07/2099 Medium Pending
+    printf '4\n2\n'
+} | edit a.txt || exit 1
+"$PROGRAM" --project b.txt --sync-serve "$DIR/sync.sock" --metrics-file "$DIR/metrics.json" >"$DIR/serve.out" 2>&1 &
+SERVER=$!
+for _ in $(seq 100); do
+    [ -S "$DIR/sync.sock" ] && break
+    sleep 0.1
+done
+[ -S "$DIR/sync.sock" ] || fail "the server did not open its socket"
+expectStatus 1 "sync-diff with a serving process" --project a.txt --sync-diff "$DIR/sync.sock"
+expectStatus 0 "sync-push to a serving process" --project a.txt --sync-push "$DIR/sync.sock"
+expectStatus 0 "sync-diff with a serving process after sync-push" --project a.txt --sync-diff "$DIR/sync.sock"
+kill -TERM "$SERVER"
+wait "$SERVER"
+status=$?
+SERVER=
+[ "$status" = 0 ] || fail "the server exited with status $status after SIGTERM"
+[ -s "$DIR/metrics.json" ] || fail "the server did not write its metrics file"
+echo "PASS sync-serve stops on SIGTERM and writes its metrics"
+cmp a.txt b.txt || fail "the copies differ after sync-push to a serving process"
+echo "PASS the copies are byte-identical"
+exit 0
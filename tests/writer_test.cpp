@@ -0,0 +1,50 @@
+// This program checks how the background writer reports failed writes.
+// A write that fails must be reported by the next flush() even if wait() was called for the file in between (wait() is what the
+// TaskManager uses before it reads or converts a file), wait() must report it only for the file that failed, and a flush() that
+// reported it starts afresh. Run by "make test"; the exit status is 1 if any check fails.
+
+#include <iostream>
+#include <fstream>
+#include <iterator>   // Reading the written file back
+#include <string>
+#include <filesystem> // Scratch directory
+#include "../task_writer.cpp"
+
+using namespace std;
+
+// Report one check; returns its result
+static bool expect(const char *what, bool result)
+{
+    cout << (result ? "PASS " : "FAIL ") << what << endl;
+    return result;
+}
+
+int main()
+{
+    filesystem::path directory = filesystem::temp_directory_path() / ("writer_test." + to_string(getpid()));
+    filesystem::create_directories(directory);
+    string good = (directory / "good.txt").string();
+    string bad = (directory / "missing" / "bad.txt").string(); // Its directory does not exist, so every write to it fails
+
+    bool ok = true;
+    {
+        BackgroundWriter writer;
+        writer.replace(good, "first\n");
+        writer.append(good, "second\n");
+        ok = expect("writes to a good file succeed", writer.flush()) && ok;
+
+        writer.replace(bad, "lost\n");
+        writer.append(good, "third\n");
+        ok = expect("wait() reports the failed file", !writer.wait(bad)) && ok;
+        ok = expect("wait() does not report other files", writer.wait(good)) && ok;
+        ok = expect("wait() keeps reporting the failure", !writer.wait(bad)) && ok;
+        ok = expect("flush() reports a failure that wait() saw", !writer.flush()) && ok;
+        ok = expect("flush() starts afresh after reporting a failure", writer.flush()) && ok;
+    }
+
+    ifstream file(good, ios::binary);
+    string contents((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+    ok = expect("the good file holds every write", contents == "first\nsecond\nthird\n") && ok;
+    filesystem::remove_all(directory);
+    return ok ? 0 : 1;
+}
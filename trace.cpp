@@ -0,0 +1,230 @@
+// This file implements scoped trace spans that can be written out as a Chrome/Perfetto trace-event JSON file.
+// While the metrics in metrics.cpp give aggregate numbers, a trace shows the timeline of every individual operation
+// (load vs. parse vs. sort vs. printTaskWithColour) and which thread it ran on.
+// Each thread records its spans into its own buffer, behind a lock of its own that only writeTrace() ever contends for, so tracing does
+// not distort the timings being measured. A buffer keeps at most maxEventsPerThread spans; later spans are counted and dropped, so a
+// long session cannot grow the buffers without bound.
+// Tracing is enabled with the --trace <path> option or the TASKMANAGER_TRACE environment variable, and the file is written when the program exits.
+
+#ifndef TASK_TRACE_CPP
+#define TASK_TRACE_CPP
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <memory>  // unique_ptr owns the per-thread buffers
+#include <mutex>   // Protects the list of per-thread buffers and each buffer
+#include <atomic>  // The enabled flag is read on every span
+#include <chrono>  // steady_clock timestamps for the spans
+#include <cstdint> // Fixed-width integer types for the timestamps
+
+using namespace std;
+
+// A single completed span
+struct TraceEvent
+{
+    const char *name;       // Name of the span (a string literal, so nothing is copied)
+    const char *category;   // Category of the span, used for filtering in the trace viewer
+    uint64_t startNanos;    // Start time relative to the start of tracing
+    uint64_t durationNanos; // Duration of the span
+};
+
+// Spans recorded by one thread
+struct TraceBuffer
+{
+    int threadId;              // Small sequential ID used as "tid" in the trace
+    mutex lock;                // Taken by the owning thread to record and by writeTrace() to take the spans out
+    string threadName;         // Optional name shown by the trace viewer
+    vector<TraceEvent> events; // Completed spans in the order they finished
+    uint64_t dropped = 0;      // Spans not recorded because the buffer was full
+};
+
+// The Tracer class owns all per-thread buffers and writes them to the trace file.
+class Tracer
+{
+public:
+    static const size_t maxEventsPerThread = size_t(1) << 20; // 32 MB of spans per thread
+
+    // Access the single tracer instance
+    static Tracer &instance()
+    {
+        static Tracer tracer;
+        return tracer;
+    }
+
+    // Start tracing; the trace will be written to the given path by writeTrace()
+    void start(const string &path)
+    {
+        outputPath = path;
+        epoch = chrono::steady_clock::now();
+        enabled.store(true, memory_order_relaxed);
+    }
+
+    // Check whether spans are being recorded
+    bool isEnabled() const
+    {
+        return enabled.load(memory_order_relaxed);
+    }
+
+    // Nanoseconds elapsed since tracing started
+    uint64_t now() const
+    {
+        return uint64_t(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - epoch).count());
+    }
+
+    // Buffer of the calling thread, created and registered on first use
+    TraceBuffer &threadBuffer()
+    {
+        thread_local TraceBuffer *buffer = nullptr;
+        if (buffer == nullptr)
+        {
+            lock_guard<mutex> lock(buffersMutex);
+            buffers.push_back(unique_ptr<TraceBuffer>(new TraceBuffer()));
+            buffer = buffers.back().get();
+            buffer->threadId = int(buffers.size());
+            buffer->events.reserve(1024); // Avoid reallocating while the first spans are recorded
+        }
+        return *buffer;
+    }
+
+    // Give the calling thread a name in the trace viewer
+    void setThreadName(const string &name)
+    {
+        if (isEnabled())
+        {
+            TraceBuffer &buffer = threadBuffer();
+            lock_guard<mutex> lock(buffer.lock);
+            buffer.threadName = name;
+        }
+    }
+
+    // Record a completed span in the calling thread's buffer
+    void record(const char *name, const char *category, uint64_t startNanos, uint64_t endNanos)
+    {
+        TraceBuffer &buffer = threadBuffer();
+        lock_guard<mutex> lock(buffer.lock);
+        if (buffer.events.size() >= maxEventsPerThread)
+        {
+            buffer.dropped++;
+            return;
+        }
+        buffer.events.push_back({name, category, startNanos, endNanos - startNanos});
+    }
+
+    // Write all buffered spans to the trace file in the Chrome trace-event JSON format.
+    // The spans of each thread are taken out of its buffer under the buffer's lock, so threads that are still running (the background
+    // writer, replication or sync threads at exit) can keep recording; their later spans are simply not in the file.
+    bool writeTrace()
+    {
+        if (!isEnabled())
+        {
+            return true;
+        }
+
+        ofstream file(outputPath);
+        if (!file.is_open())
+        {
+            cerr << "Unable to open trace file: " << outputPath << endl;
+            return false;
+        }
+
+        lock_guard<mutex> lock(buffersMutex);
+        file << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+        bool first = true;
+        uint64_t dropped = 0;
+        for (auto &buffer : buffers)
+        {
+            // Take the spans out of the buffer, so the file is written without holding up the thread
+            vector<TraceEvent> events;
+            string threadName;
+            {
+                lock_guard<mutex> bufferLock(buffer->lock);
+                events.swap(buffer->events);
+                threadName = buffer->threadName;
+                dropped += buffer->dropped;
+                buffer->dropped = 0;
+            }
+
+            // Metadata event naming the thread
+            if (!threadName.empty())
+            {
+                file << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->threadId
+                     << ",\"args\":{\"name\":\"" << threadName << "\"}}";
+                first = false;
+            }
+
+            // One complete ("X") event per span; timestamps are in microseconds
+            for (const TraceEvent &event : events)
+            {
+                file << (first ? "" : ",") << "\n{\"name\":\"" << event.name << "\",\"cat\":\"" << event.category << "\",\"ph\":\"X\",\"ts\":"
+                     << event.startNanos / 1000 << "." << formatFraction(event.startNanos % 1000) << ",\"dur\":" << event.durationNanos / 1000
+                     << "." << formatFraction(event.durationNanos % 1000) << ",\"pid\":1,\"tid\":" << buffer->threadId << "}";
+                first = false;
+            }
+        }
+        file << "\n]}" << endl;
+        if (dropped > 0)
+        {
+            cerr << "The trace is missing " << dropped << " span(s) recorded after a thread had buffered " << maxEventsPerThread << "." << endl;
+        }
+        return true;
+    }
+
+private:
+    Tracer() : epoch(chrono::steady_clock::now()) {} // Use instance() instead
+
+    // Format the sub-microsecond part of a timestamp as three digits
+    static string formatFraction(uint64_t nanos)
+    {
+        string digits = to_string(nanos);
+        return string(3 - digits.size(), '0') + digits;
+    }
+
+    atomic<bool> enabled{false};
+    string outputPath;
+    chrono::steady_clock::time_point epoch;
+    mutex buffersMutex;
+    vector<unique_ptr<TraceBuffer>> buffers;
+};
+
+// TraceSpan records the lifetime of a scope as one span.
+// The name and category must be string literals (or otherwise outlive the tracer).
+class TraceSpan
+{
+public:
+    TraceSpan(const char *spanName, const char *spanCategory = "task") : name(spanName), category(spanCategory), active(Tracer::instance().isEnabled())
+    {
+        if (active)
+        {
+            start = Tracer::instance().now();
+        }
+    }
+
+    ~TraceSpan()
+    {
+        end();
+    }
+
+    // Finish the span now instead of at the end of the scope (later calls do nothing)
+    void end()
+    {
+        if (active)
+        {
+            Tracer &tracer = Tracer::instance();
+            tracer.record(name, category, start, tracer.now());
+            active = false;
+        }
+    }
+
+    TraceSpan(const TraceSpan &) = delete;
+    TraceSpan &operator=(const TraceSpan &) = delete;
+
+private:
+    const char *name;
+    const char *category;
+    bool active;
+    uint64_t start = 0;
+};
+
+#endif
@@ -0,0 +1,286 @@
+// This file implements the classification of tasks by how urgent their deadline is.
+// A classification takes one snapshot of the current date and puts every task in a deadline bucket (overdue, due today, due this
+// week, later, or no valid deadline), combined with its status and priority into one byte. Rendering picks the colour of a task
+// from that byte, and filters and reminders select tasks by it, so the deadline of a task is parsed and compared only once.
+// The tasks are first packed into flat arrays: the deadline as a day number and the status and priority as small integers.
+// The buckets are then computed without branches, by adding up comparison masks, 8 tasks at a time with AVX2 or 4 at a time
+// with SSE2, and one at a time on other processors. The implementation is chosen once, based on what the processor supports.
+// How far ahead "due today" and "due this week" reach is set with UrgencyHorizons.
+// Repeating tasks are classified by their next occurrence that was not completed.
+
+#ifndef TASK_URGENCY_CPP
+#define TASK_URGENCY_CPP
+
+#include <string>
+#include <vector>
+#include <ctime>   // The current date
+#include <climits> // INT_MAX marks tasks without a valid deadline
+#include <cstdint>
+#include <cstring> // memcpy() for unaligned loads and stores of packed bytes
+#include "processor.cpp"
+#include "task_schema.cpp" // DeadlineCodec turns dates into day numbers
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h> // SSE2 and AVX2 intrinsics
+#define TASK_URGENCY_X86 1
+#endif
+
+using namespace std;
+
+// Deadline buckets, from most to least urgent
+enum class Urgency
+{
+    OVERDUE,       // The deadline has passed
+    DUE_TODAY,     // Due within UrgencyHorizons::todayDays days (0: today only)
+    DUE_THIS_WEEK, // Due within UrgencyHorizons::weekDays days
+    LATER,         // Due after that
+    NO_DEADLINE    // The deadline is not a valid DD/MM/YYYY date
+};
+
+// How many days ahead of today each bucket reaches
+struct UrgencyHorizons
+{
+    int todayDays = 0; // Deadlines up to this many days from today are DUE_TODAY
+    int weekDays = 7;  // Deadlines up to this many days from today are DUE_THIS_WEEK (if not DUE_TODAY)
+};
+
+// The classification of one task packed into a byte: the bucket in bits 0-2, the status in bits 3-4 and the priority in bits 5-6
+struct UrgencyClass
+{
+    uint8_t bits = uint8_t(Urgency::NO_DEADLINE);
+
+    Urgency urgency() const
+    {
+        return Urgency(bits & 7);
+    }
+
+    TaskStatus status() const
+    {
+        return TaskStatus((bits >> 3) & 3);
+    }
+
+    TaskPriority priority() const
+    {
+        return TaskPriority((bits >> 5) & 3);
+    }
+
+    bool completed() const
+    {
+        return status() == TaskStatus::COMPLETED;
+    }
+
+    // Not completed and due today or earlier
+    bool needsAttention() const
+    {
+        return !completed() && urgency() <= Urgency::DUE_TODAY;
+    }
+};
+
+static_assert(sizeof(UrgencyClass) == 1, "classes are written as an array of bytes");
+
+// The UrgencyClassifier class buckets tasks by deadline, status and priority against one snapshot of the current date.
+class UrgencyClassifier
+{
+public:
+    static const int maxHorizonDays = 100000; // Longest horizon accepted (keeps the limits far from overflowing)
+
+    explicit UrgencyClassifier(UrgencyHorizons bucketHorizons = UrgencyHorizons())
+    {
+        setHorizons(bucketHorizons);
+        snapshot();
+    }
+
+    // Change how far ahead the buckets reach (the week horizon is never shorter than the today horizon)
+    void setHorizons(UrgencyHorizons bucketHorizons)
+    {
+        horizons.todayDays = min(max(0, bucketHorizons.todayDays), maxHorizonDays);
+        horizons.weekDays = min(max(horizons.todayDays, bucketHorizons.weekDays), maxHorizonDays);
+    }
+
+    const UrgencyHorizons &getHorizons() const
+    {
+        return horizons;
+    }
+
+    // Take a new snapshot of the current date; every classification until the next snapshot uses it
+    void snapshot(time_t now = time(nullptr))
+    {
+        char todayText[16];
+        strftime(todayText, sizeof(todayText), "%d/%m/%Y", localtime(&now));
+        DeadlineCodec::dayNumber(todayText, today);
+    }
+
+    // Day number of the snapshot (days since 01/01/1970)
+    int snapshotDay() const
+    {
+        return today;
+    }
+
+    // Classify a list of tasks in one pass; classes[i] is the class of tasks[i]
+    template <typename TaskList>
+    void classify(const TaskList &tasks, vector<UrgencyClass> &classes)
+    {
+        pack(tasks);
+        classes.resize(days.size());
+        static const ClassifyFunction run = chooseClassify();
+        run(days.data(), enumBits.data(), days.size(), limits(), reinterpret_cast<uint8_t *>(classes.data()));
+    }
+
+    // Classify a single task
+    UrgencyClass classify(const Task &task) const
+    {
+        UrgencyClass result;
+        int day = dayOf(task);
+        uint8_t bits = enumBitsOf(task);
+        classifyScalar(&day, &bits, 1, limits(), &result.bits);
+        return result;
+    }
+
+private:
+    // Day numbers the buckets are compared against: before today, up to the end of "today", up to the end of "this week"
+    struct Limits
+    {
+        int today;
+        int todayEnd;
+        int weekEnd;
+    };
+
+    typedef void (*ClassifyFunction)(const int *, const uint8_t *, size_t, Limits, uint8_t *);
+
+    Limits limits() const
+    {
+        return {today, today + horizons.todayDays, today + horizons.weekDays};
+    }
+
+    // Day number of the deadline of a task. A repeating task is as urgent as its next occurrence from today on that was not
+    // completed (its deadline is only the first occurrence); occurrences missed before today do not make it overdue.
+    int dayOf(const Task &task) const
+    {
+        int day;
+        if (!DeadlineCodec::dayNumber(task.getDeadline(), day))
+        {
+            return INT_MAX;
+        }
+        return task.isRecurring() ? task.getRecurrence().nextPending(day, today) : day;
+    }
+
+    static uint8_t enumBitsOf(const Task &task)
+    {
+        return uint8_t(int(task.getStatusValue()) << 3 | int(task.getPriorityValue()) << 5);
+    }
+
+    static const Task &taskOf(const Task &task)
+    {
+        return task;
+    }
+
+    static const Task &taskOf(const Task *task)
+    {
+        return *task;
+    }
+
+    // Pack the deadlines and enums of the tasks into flat arrays
+    template <typename TaskList>
+    void pack(const TaskList &tasks)
+    {
+        days.clear();
+        enumBits.clear();
+        for (const auto &entry : tasks)
+        {
+            const Task &task = taskOf(entry);
+            days.push_back(dayOf(task));
+            enumBits.push_back(enumBitsOf(task));
+        }
+    }
+
+    // bucket = 3 - (day <= weekEnd) - (day <= todayEnd) - (day < today) + (day == INT_MAX); the horizons are nested, so this counts
+    // how many limits the deadline is within. A missing deadline (INT_MAX) is within none of them and gets bucket 4.
+    static void classifyScalar(const int *day, const uint8_t *bits, size_t count, Limits limits, uint8_t *out)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            int bucket = 3 - (day[i] <= limits.weekEnd) - (day[i] <= limits.todayEnd) - (day[i] < limits.today) + (day[i] == INT_MAX);
+            out[i] = uint8_t(bucket | bits[i]);
+        }
+    }
+
+#ifdef TASK_URGENCY_X86
+    // SSE2 version, 4 tasks at a time (SSE2 is available on every x86-64 processor).
+    // Comparison masks are -1 where true, so adding them subtracts one for every limit the deadline is within.
+    __attribute__((target("sse2"))) static void classifySse2(const int *day, const uint8_t *bits, size_t count, Limits limits, uint8_t *out)
+    {
+        const __m128i three = _mm_set1_epi32(3);
+        const __m128i today = _mm_set1_epi32(limits.today);
+        const __m128i afterToday = _mm_set1_epi32(limits.todayEnd + 1);
+        const __m128i afterWeek = _mm_set1_epi32(limits.weekEnd + 1);
+        const __m128i missing = _mm_set1_epi32(INT_MAX);
+        const __m128i zero = _mm_setzero_si128();
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i *>(day + i));
+            __m128i bucket = _mm_add_epi32(three, _mm_cmplt_epi32(d, afterWeek));
+            bucket = _mm_add_epi32(bucket, _mm_cmplt_epi32(d, afterToday));
+            bucket = _mm_add_epi32(bucket, _mm_cmplt_epi32(d, today));
+            bucket = _mm_sub_epi32(bucket, _mm_cmpeq_epi32(d, missing));
+
+            // Widen the 4 enum bytes to 32 bits, combine, and narrow the result back to bytes
+            int32_t packedBits;
+            memcpy(&packedBits, bits + i, sizeof(packedBits));
+            __m128i b = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(packedBits), zero), zero);
+            __m128i combined = _mm_or_si128(bucket, b);
+            combined = _mm_packus_epi16(_mm_packs_epi32(combined, combined), zero);
+            int32_t result = _mm_cvtsi128_si32(combined);
+            memcpy(out + i, &result, sizeof(result));
+        }
+        classifyScalar(day + i, bits + i, count - i, limits, out + i);
+    }
+
+    // AVX2 version, 8 tasks at a time
+    __attribute__((target("avx2"))) static void classifyAvx2(const int *day, const uint8_t *bits, size_t count, Limits limits, uint8_t *out)
+    {
+        const __m256i three = _mm256_set1_epi32(3);
+        const __m256i today = _mm256_set1_epi32(limits.today);
+        const __m256i afterToday = _mm256_set1_epi32(limits.todayEnd + 1);
+        const __m256i afterWeek = _mm256_set1_epi32(limits.weekEnd + 1);
+        const __m256i missing = _mm256_set1_epi32(INT_MAX);
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(day + i));
+            __m256i bucket = _mm256_add_epi32(three, _mm256_cmpgt_epi32(afterWeek, d));
+            bucket = _mm256_add_epi32(bucket, _mm256_cmpgt_epi32(afterToday, d));
+            bucket = _mm256_add_epi32(bucket, _mm256_cmpgt_epi32(today, d));
+            bucket = _mm256_sub_epi32(bucket, _mm256_cmpeq_epi32(d, missing));
+
+            // Widen the 8 enum bytes to 32 bits, combine, and narrow the result back to bytes
+            __m256i b = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(bits + i)));
+            __m256i combined = _mm256_or_si256(bucket, b);
+            __m128i words = _mm_packus_epi32(_mm256_castsi256_si128(combined), _mm256_extracti128_si256(combined, 1));
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(out + i), _mm_packus_epi16(words, words));
+        }
+        classifySse2(day + i, bits + i, count - i, limits, out + i);
+    }
+#endif
+
+    // Pick the fastest implementation the processor supports
+    static ClassifyFunction chooseClassify()
+    {
+#ifdef TASK_URGENCY_X86
+        if (__builtin_cpu_supports("avx2"))
+        {
+            return classifyAvx2;
+        }
+        return classifySse2;
+#else
+        return classifyScalar;
+#endif
+    }
+
+    UrgencyHorizons horizons; // How far ahead the buckets reach
+    int today = 0;            // Day number of the snapshot
+    vector<int> days;         // Packed deadlines of the tasks being classified (INT_MAX for none)
+    vector<uint8_t> enumBits; // Packed status and priority of the tasks being classified
+};
+
+#endif
@@ -0,0 +1,548 @@
+// This file implements the workload driver used for end-to-end performance tests.
+// It runs a sequence of menu operations (creates, views, edits, deletes, searches and "work on next task") against a TaskManager,
+// feeding each operation the same input a user would type, and measures how long each operation takes.
+// The sequence is either generated from an operation mix and a starting dataset size, or replayed from a trace file
+// (which can be recorded from a generated run). Operations can be issued as fast as possible or at a fixed rate.
+// At the end it reports the throughput and the latency percentiles of each operation type.
+// The driver works in its own directory so that it never touches the user's task file.
+//
+// Trace files have one operation per line ('#' starts a comment):
+//   create <id> <Low|Medium|High> <Pending|In_Progress|Completed> <DD/MM/YYYY> <category>
+//   view <1|2|3>
+//   edit <id> <Low|Medium|High> <Pending|In_Progress|Completed>
+//   delete <id>
+//   search <word>
+//   next
+
+#ifndef TASK_WORKLOAD_CPP
+#define TASK_WORKLOAD_CPP
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <random>     // Generated operations
+#include <chrono>     // Timing and pacing of the operations
+#include <thread>     // sleep_until() for the fixed rate
+#include <filesystem> // Working directory of the run
+#include "TaskManager.cpp"
+
+using namespace std;
+
+// Kinds of operation the driver can run
+enum class WorkloadOp
+{
+    CREATE,
+    VIEW,
+    EDIT,
+    DELETE,
+    SEARCH,
+    NEXT,
+    COUNT // Number of operation kinds (must stay last)
+};
+
+// One operation of a workload
+struct WorkloadStep
+{
+    WorkloadOp op = WorkloadOp::VIEW;
+    int taskID = 0;     // Task created, edited or deleted
+    int view = 1;       // Sort order for VIEW
+    string priority;    // Priority for CREATE and EDIT
+    string status;      // Status for CREATE and EDIT (with '_' instead of spaces)
+    string deadline;    // Deadline for CREATE
+    string category;    // Category for CREATE
+    string word;        // Search word for SEARCH
+};
+
+// Settings of a workload run
+struct WorkloadOptions
+{
+    string replayFile;         // Trace to replay (empty to generate operations)
+    string recordFile;         // File to save the operations that were run to (empty for none)
+    string directory;          // Directory to run in (empty for a new temporary directory)
+    int operations = 1000;     // Number of generated operations
+    int datasetSize = 1000;    // Tasks created before the measured operations start
+    double rate = 0;           // Operations per second (0 for as fast as possible)
+    unsigned seed = 1;         // Seed of the generated operations
+    bool verifyStatistics = false; // Recount the statistics after every operation (not part of the measured latency)
+    bool lazyDescriptions = false; // Leave long descriptions in the task file (see TaskManager::setLazyDescriptions())
+    size_t descriptionCacheBytes = ColdFieldCache::defaultBudget; // Memory budget of the descriptions read back
+    int mix[int(WorkloadOp::COUNT)] = {20, 40, 20, 10, 8, 2}; // Relative weight of each operation kind
+};
+
+// The WorkloadDriver class generates or reads the operations, runs them and reports the results.
+class WorkloadDriver
+{
+public:
+    explicit WorkloadDriver(const WorkloadOptions &workloadOptions) : options(workloadOptions), random(workloadOptions.seed) {}
+
+    // Name of an operation kind, as used in trace files, in --workload-mix and in the report
+    static const char *opName(WorkloadOp op)
+    {
+        switch (op)
+        {
+        case WorkloadOp::CREATE:
+            return "create";
+        case WorkloadOp::VIEW:
+            return "view";
+        case WorkloadOp::EDIT:
+            return "edit";
+        case WorkloadOp::DELETE:
+            return "delete";
+        case WorkloadOp::SEARCH:
+            return "search";
+        case WorkloadOp::NEXT:
+            return "next";
+        default:
+            return "unknown";
+        }
+    }
+
+    // Parse an operation mix such as "create=30,view=40,edit=20,delete=10" into the option weights (kinds not listed get 0)
+    static void parseMix(const string &text, WorkloadOptions &workloadOptions)
+    {
+        int weights[int(WorkloadOp::COUNT)] = {};
+        stringstream ss(text);
+        string item;
+        while (getline(ss, item, ','))
+        {
+            size_t equals = item.find('=');
+            string name = item.substr(0, equals);
+            int kind = findOp(name);
+            if (kind < 0 || equals == string::npos)
+            {
+                throw invalid_argument("Invalid workload mix entry: " + item);
+            }
+            weights[kind] = stoi(item.substr(equals + 1));
+        }
+        copy(begin(weights), end(weights), workloadOptions.mix);
+    }
+
+    // Run the workload; returns false if it could not be started
+    bool run()
+    {
+        vector<WorkloadStep> steps;
+        if (!options.replayFile.empty())
+        {
+            if (!readTrace(options.replayFile, steps))
+            {
+                return false;
+            }
+        }
+
+        // Work in a directory of our own, so the user's project.txt is never touched
+        filesystem::path originalDirectory = filesystem::current_path();
+        filesystem::path directory = options.directory.empty()
+                                         ? filesystem::temp_directory_path() / ("taskmanager-workload-" + to_string(chrono::steady_clock::now().time_since_epoch().count()))
+                                         : filesystem::path(options.directory);
+        error_code ec;
+        filesystem::create_directories(directory, ec);
+        filesystem::current_path(directory, ec);
+        if (ec)
+        {
+            cerr << "Unable to use workload directory: " << directory << endl;
+            return false;
+        }
+        for (const char *file : {"project.txt", "project.txt.idx", "project.txt.archive"})
+        {
+            filesystem::remove(file, ec); // Every run starts from an empty project
+        }
+
+        cout << "Running workload in " << directory.string() << endl;
+        {
+            TaskManager taskManager;
+            taskManager.setVerifyStatistics(options.verifyStatistics);
+            if (options.lazyDescriptions)
+            {
+                taskManager.setLazyDescriptions(options.descriptionCacheBytes);
+            }
+
+            // Build the starting dataset (not measured); a replayed trace brings its own creates
+            if (options.replayFile.empty())
+            {
+                vector<WorkloadStep> dataset;
+                for (int i = 0; i < options.datasetSize; i++)
+                {
+                    dataset.push_back(makeCreate());
+                }
+                for (const WorkloadStep &step : dataset)
+                {
+                    runStep(taskManager, step);
+                }
+                taskManager.flushWrites();
+                steps = generate(options.operations);
+                steps.insert(steps.begin(), dataset.begin(), dataset.end());
+                measuredFrom = dataset.size();
+            }
+
+            runMeasured(taskManager, steps);
+        }
+        filesystem::current_path(originalDirectory, ec);
+        if (options.directory.empty())
+        {
+            filesystem::remove_all(directory, ec); // The temporary directory is only needed during the run
+        }
+
+        if (!options.recordFile.empty())
+        {
+            writeTrace(options.recordFile, steps);
+        }
+        report();
+        return true;
+    }
+
+private:
+    // Find an operation kind by name; returns -1 if there is none
+    static int findOp(const string &name)
+    {
+        for (int i = 0; i < int(WorkloadOp::COUNT); i++)
+        {
+            if (name == opName(WorkloadOp(i)))
+            {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    // Run the steps after the dataset, pacing them if a rate was given, and record their latencies
+    void runMeasured(TaskManager &taskManager, const vector<WorkloadStep> &steps)
+    {
+        auto start = chrono::steady_clock::now();
+        auto interval = chrono::duration<double>(options.rate > 0 ? 1.0 / options.rate : 0);
+        for (size_t i = measuredFrom; i < steps.size(); i++)
+        {
+            // With a fixed rate, latency is measured from when the operation should have started,
+            // so a slow operation also counts against the ones that had to wait for it
+            auto scheduled = start + chrono::duration_cast<chrono::steady_clock::duration>(interval * double(i - measuredFrom));
+            if (options.rate > 0)
+            {
+                this_thread::sleep_until(scheduled);
+            }
+            else
+            {
+                scheduled = chrono::steady_clock::now();
+            }
+
+            runStep(taskManager, steps[i]);
+            auto finished = chrono::steady_clock::now();
+            latencies[int(steps[i].op)].push_back(uint64_t(chrono::duration_cast<chrono::nanoseconds>(finished - scheduled).count()));
+            if (options.verifyStatistics && !taskManager.checkStatistics())
+            {
+                statisticsMismatches++;
+            }
+        }
+
+        // Waiting for the queued writes is part of the run
+        auto flushStart = chrono::steady_clock::now();
+        taskManager.flushWrites();
+        auto end = chrono::steady_clock::now();
+        flushNanos = uint64_t(chrono::duration_cast<chrono::nanoseconds>(end - flushStart).count());
+        elapsedNanos = uint64_t(chrono::duration_cast<chrono::nanoseconds>(end - start).count());
+    }
+
+    // Run one step with its input fed through cin and its output thrown away, exactly as the menu would run it
+    void runStep(TaskManager &taskManager, const WorkloadStep &step)
+    {
+        istringstream input(inputFor(step));
+        ostringstream output;
+        streambuf *originalInput = cin.rdbuf(input.rdbuf());
+        streambuf *originalOutput = cout.rdbuf(output.rdbuf());
+        try
+        {
+            switch (step.op)
+            {
+            case WorkloadOp::CREATE:
+                taskManager.createTask();
+                break;
+            case WorkloadOp::VIEW:
+                taskManager.viewTask(step.view);
+                break;
+            case WorkloadOp::EDIT:
+                taskManager.editTaskPriorityAndStatus(step.taskID);
+                break;
+            case WorkloadOp::DELETE:
+                taskManager.deleteTask(step.taskID);
+                break;
+            case WorkloadOp::SEARCH:
+                taskManager.searchTasks(step.word);
+                break;
+            default:
+                taskManager.claimNextTask();
+                break;
+            }
+        }
+        catch (const exception &ex)
+        {
+            cerr << "Workload step failed: " << ex.what() << endl;
+        }
+        cin.rdbuf(originalInput);
+        cout.rdbuf(originalOutput);
+        cin.clear();
+    }
+
+    // The text a user would type for a step
+    static string inputFor(const WorkloadStep &step)
+    {
+        string status = step.status;
+        replace(status.begin(), status.end(), '_', ' ');
+        if (step.op == WorkloadOp::CREATE)
+        {
+            return step.category + "\nworkload\n" + to_string(step.taskID) + "\n" + titleFor(step.taskID) + "\n" + descriptionFor(step.taskID) + "\n" +
+                   step.deadline + "\n" + step.priority + "\n" + status + "\n\n\n";
+        }
+        if (step.op == WorkloadOp::EDIT)
+        {
+            return step.priority + "\n" + status + "\n";
+        }
+        return "";
+    }
+
+    // Titles and descriptions are built from a small vocabulary so that searches have realistic numbers of matches
+    static const vector<string> &vocabulary()
+    {
+        static const vector<string> words = {"report", "review", "deploy", "invoice", "meeting", "budget", "design", "release",
+                                             "backup", "migrate", "refactor", "customer", "schedule", "parser", "dashboard", "audit"};
+        return words;
+    }
+
+    static string titleFor(int taskID)
+    {
+        const vector<string> &words = vocabulary();
+        return words[taskID % words.size()] + " " + words[(taskID / 7) % words.size()] + " " + to_string(taskID);
+    }
+
+    static string descriptionFor(int taskID)
+    {
+        const vector<string> &words = vocabulary();
+        string description = "Follow up on the " + words[(taskID / 3) % words.size()];
+        for (int i = 1; i <= 6; i++)
+        {
+            description += " " + words[(taskID * 31 + i * 17) % words.size()];
+        }
+        return description;
+    }
+
+    // Generate a number of operations following the mix
+    vector<WorkloadStep> generate(int count)
+    {
+        discrete_distribution<int> pick(begin(options.mix), end(options.mix));
+        vector<WorkloadStep> steps;
+        for (int i = 0; i < count; i++)
+        {
+            WorkloadOp op = WorkloadOp(pick(random));
+            if ((op == WorkloadOp::EDIT || op == WorkloadOp::DELETE) && plannedTasks.empty())
+            {
+                op = WorkloadOp::CREATE; // Nothing to edit or delete yet
+            }
+
+            WorkloadStep step;
+            switch (op)
+            {
+            case WorkloadOp::CREATE:
+                step = makeCreate();
+                break;
+            case WorkloadOp::EDIT:
+                step.op = op;
+                step.taskID = plannedTasks[random() % plannedTasks.size()];
+                step.priority = pickOne({"Low", "Medium", "High"});
+                step.status = pickOne({"Pending", "In_Progress", "Completed"});
+                break;
+            case WorkloadOp::DELETE:
+            {
+                size_t index = random() % plannedTasks.size();
+                step.op = op;
+                step.taskID = plannedTasks[index];
+                plannedTasks[index] = plannedTasks.back();
+                plannedTasks.pop_back();
+                break;
+            }
+            case WorkloadOp::VIEW:
+                step.op = op;
+                step.view = 1 + int(random() % 3);
+                break;
+            case WorkloadOp::SEARCH:
+                step.op = op;
+                step.word = vocabulary()[random() % vocabulary().size()];
+                break;
+            default:
+                step.op = WorkloadOp::NEXT;
+                break;
+            }
+            steps.push_back(step);
+        }
+        return steps;
+    }
+
+    // A create step for the next unused ID
+    WorkloadStep makeCreate()
+    {
+        WorkloadStep step;
+        step.op = WorkloadOp::CREATE;
+        step.taskID = nextTaskID++;
+        step.priority = pickOne({"Low", "Medium", "High"});
+        step.status = pickOne({"Pending", "Pending", "In_Progress", "Completed"});
+        step.deadline = DeadlineCodec::fromDayNumber(20454 + int(random() % 730)); // Some time in 2026 or 2027
+        step.category = pickOne({"Work", "Personal", "School", "Home"});
+        plannedTasks.push_back(step.taskID);
+        return step;
+    }
+
+    string pickOne(initializer_list<const char *> choices)
+    {
+        return *(choices.begin() + random() % choices.size());
+    }
+
+    // Read a trace file; returns false if it cannot be read
+    bool readTrace(const string &filename, vector<WorkloadStep> &steps)
+    {
+        ifstream file(filename);
+        if (!file.is_open())
+        {
+            cerr << "Unable to open workload trace: " << filename << endl;
+            return false;
+        }
+
+        string line;
+        int lineNumber = 0;
+        while (getline(file, line))
+        {
+            lineNumber++;
+            istringstream ss(line);
+            string name;
+            if (!(ss >> name) || name[0] == '#')
+            {
+                continue;
+            }
+
+            WorkloadStep step;
+            int kind = findOp(name);
+            bool ok = kind >= 0;
+            if (ok)
+            {
+                step.op = WorkloadOp(kind);
+                switch (step.op)
+                {
+                case WorkloadOp::CREATE:
+                    ok = bool(ss >> step.taskID >> step.priority >> step.status >> step.deadline >> step.category);
+                    break;
+                case WorkloadOp::VIEW:
+                    ok = bool(ss >> step.view);
+                    break;
+                case WorkloadOp::EDIT:
+                    ok = bool(ss >> step.taskID >> step.priority >> step.status);
+                    break;
+                case WorkloadOp::DELETE:
+                    ok = bool(ss >> step.taskID);
+                    break;
+                case WorkloadOp::SEARCH:
+                    ok = bool(ss >> step.word);
+                    break;
+                default:
+                    break;
+                }
+            }
+            if (!ok)
+            {
+                cerr << "Invalid workload trace line " << lineNumber << ": " << line << endl;
+                return false;
+            }
+            steps.push_back(step);
+        }
+        return true;
+    }
+
+    // Save operations in the trace format
+    static void writeTrace(const string &filename, const vector<WorkloadStep> &steps)
+    {
+        ofstream file(filename);
+        if (!file.is_open())
+        {
+            cerr << "Unable to write workload trace: " << filename << endl;
+            return;
+        }
+        file << "# Task manager workload trace" << endl;
+        for (const WorkloadStep &step : steps)
+        {
+            file << opName(step.op);
+            switch (step.op)
+            {
+            case WorkloadOp::CREATE:
+                file << " " << step.taskID << " " << step.priority << " " << step.status << " " << step.deadline << " " << step.category;
+                break;
+            case WorkloadOp::VIEW:
+                file << " " << step.view;
+                break;
+            case WorkloadOp::EDIT:
+                file << " " << step.taskID << " " << step.priority << " " << step.status;
+                break;
+            case WorkloadOp::DELETE:
+                file << " " << step.taskID;
+                break;
+            case WorkloadOp::SEARCH:
+                file << " " << step.word;
+                break;
+            default:
+                break;
+            }
+            file << endl;
+        }
+    }
+
+    // Print the throughput and the latency percentiles of each operation type
+    void report()
+    {
+        size_t total = 0;
+        for (auto &samples : latencies)
+        {
+            total += samples.size();
+        }
+        double seconds = elapsedNanos / 1e9;
+
+        cout << endl
+             << "Workload results:" << endl;
+        cout << "  " << total << " operations in " << fixed << setprecision(3) << seconds << " s ("
+             << setprecision(1) << (seconds > 0 ? total / seconds : 0) << " ops/s), final flush " << flushNanos / 1000.0 << " us" << endl;
+        cout << "Latencies (microseconds):" << endl;
+        cout << "  " << left << setw(10) << "operation" << right << setw(8) << "count" << setw(12) << "ops/s" << setw(12) << "p50"
+             << setw(12) << "p95" << setw(12) << "p99" << setw(12) << "max" << endl;
+        for (int i = 0; i < int(WorkloadOp::COUNT); i++)
+        {
+            vector<uint64_t> &samples = latencies[i];
+            if (samples.empty())
+            {
+                continue;
+            }
+            sort(samples.begin(), samples.end());
+            cout << "  " << left << setw(10) << opName(WorkloadOp(i)) << right << setw(8) << samples.size()
+                 << setw(12) << (seconds > 0 ? samples.size() / seconds : 0) << setw(12) << percentile(samples, 50) / 1000.0
+                 << setw(12) << percentile(samples, 95) / 1000.0 << setw(12) << percentile(samples, 99) / 1000.0
+                 << setw(12) << samples.back() / 1000.0 << endl;
+        }
+        cout.unsetf(ios::fixed);
+        if (options.verifyStatistics)
+        {
+            cout << "Statistics verified after every operation: " << statisticsMismatches << " mismatch(es)." << endl;
+        }
+    }
+
+    // Nearest-rank percentile of sorted samples
+    static uint64_t percentile(const vector<uint64_t> &sorted, double pct)
+    {
+        size_t rank = size_t(pct / 100.0 * sorted.size() + 0.5);
+        return sorted[rank == 0 ? 0 : min(rank, sorted.size()) - 1];
+    }
+
+    WorkloadOptions options;
+    mt19937 random;
+    int nextTaskID = 1;                              // ID of the next generated task
+    vector<int> plannedTasks;                        // Tasks that exist at this point of the generated sequence
+    size_t measuredFrom = 0;                         // Index of the first measured step
+    vector<uint64_t> latencies[int(WorkloadOp::COUNT)]; // Latency of every measured step, by operation kind
+    uint64_t elapsedNanos = 0;                       // Duration of the measured steps including the final flush
+    uint64_t flushNanos = 0;                         // Duration of the final flush
+    size_t statisticsMismatches = 0;                 // Operations after which the statistics differed from a full recount
+};
+
+#endif